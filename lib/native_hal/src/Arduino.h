@@ -0,0 +1,109 @@
+#pragma once
+/*
+- Native (Linux) stand-in for the Arduino-ESP32 core: only what the OTA core (src/configOTASecure.cpp & src/utils) uses.
+- Used by the `native` PlatformIO environment, e.g. to run & profile check_update() against a local server.
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "WString.h"
+#include "Stream.h"
+#include "freertos_shim.h"
+#include "esp_partition.h"
+
+typedef uint8_t byte;
+using std::max;
+using std::min;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+// Tests: a simulated clock from `start_ms` on (e.g. right before the millis() wraparound). millis() & micros() read it,
+// delay() & the waits of ulTaskNotifyTake() advance it instead of sleeping (an endless wait returns at once)
+void simulate_clock(uint32_t start_ms);
+void advance_clock(uint32_t ms);
+void yield();
+uint32_t esp_random();
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define RTC_DATA_ATTR // no deep sleep on the host: plain memory
+#define SPI_FLASH_SEC_SIZE 4096
+#define ENCRYPTED_BLOCK_SIZE 16
+
+#if !defined(__GLIBC__) || __GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size > 0)
+    {
+        size_t n = (len < size - 1) ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+// ---------- logging: like esp32-hal-log.h, filtered by CORE_DEBUG_LEVEL ----------
+#ifndef CORE_DEBUG_LEVEL
+#define CORE_DEBUG_LEVEL 3
+#endif
+void hal_log(char level, const char *file, int line, const char *func, const char *format, ...); // no format check: size_t is 32-bit on the device
+#define HAL_LOG(level, letter, format, ...)                                            \
+    do                                                                                 \
+    {                                                                                  \
+        if (CORE_DEBUG_LEVEL >= level)                                                 \
+            hal_log(letter, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__); \
+    } while (0)
+#define log_e(format, ...) HAL_LOG(1, 'E', format, ##__VA_ARGS__)
+#define log_w(format, ...) HAL_LOG(2, 'W', format, ##__VA_ARGS__)
+#define log_i(format, ...) HAL_LOG(3, 'I', format, ##__VA_ARGS__)
+#define log_d(format, ...) HAL_LOG(4, 'D', format, ##__VA_ARGS__)
+#define log_v(format, ...) HAL_LOG(5, 'V', format, ##__VA_ARGS__)
+
+// ---------- Serial: stdout ----------
+class HardwareSerial
+{
+public:
+    void begin(unsigned long) {}
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char *s) { return fputs(s, stdout) >= 0 ? strlen(s) : 0; }
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t print(long n) { return ::printf("%ld", n); }
+    size_t println(const char *s = "") { return print(s) + print("\n"); }
+    size_t println(const String &s) { return println(s.c_str()); }
+    size_t println(long n) { return print(n) + print("\n"); }
+};
+extern HardwareSerial Serial;
+
+// ---------- ESP: partitions, restart ----------
+class EspClass
+{
+public:
+    // "Reboot": exit the process, the next run boots from the (new) boot partition. A test catches it with on_restart
+    // (called first, it must not return: e.g. it throws)
+    [[noreturn]] void restart();
+    void (*on_restart)(){nullptr};
+    uint32_t getFreeHeap() { return UINT32_MAX; }
+    uint32_t getSketchSize() { return 1024 * 1024; } // no app image on the host: a typical size
+    uint64_t getEfuseMac(); // a hash of the state directory: one "device" per directory
+    bool partitionRead(const esp_partition_t *partition, uint32_t offset, uint32_t *data, size_t size)
+    {
+        return esp_partition_read(partition, offset, data, size) == ESP_OK;
+    }
+    bool partitionWrite(const esp_partition_t *partition, uint32_t offset, uint32_t *data, size_t size)
+    {
+        return esp_partition_write(partition, offset, data, size) == ESP_OK;
+    }
+    bool partitionEraseRange(const esp_partition_t *partition, uint32_t offset, size_t size)
+    {
+        return esp_partition_erase_range(partition, offset, size) == ESP_OK;
+    }
+};
+extern EspClass ESP;
@@ -0,0 +1,80 @@
+#include "AsyncUDP.h"
+#include "WiFi.h"
+#include "lwip/sockets.h"
+
+bool AsyncUDP::listen(uint16_t port)
+{
+    close();
+    fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close();
+        return false;
+    }
+    xTaskCreate(receive_task, "async_udp", 4096, this, 1, nullptr);
+    return true;
+}
+
+void AsyncUDP::receive_task(void *arg)
+{
+    AsyncUDP *self = (AsyncUDP *)arg;
+    uint8_t buf[1500];
+    while (true)
+    {
+        sockaddr_in from{};
+        socklen_t from_len = sizeof(from);
+        int fd = self->fd;
+        if (fd < 0)
+            return;
+        ssize_t len = recvfrom(fd, buf, sizeof(buf), 0, (sockaddr *)&from, &from_len);
+        if (len < 0)
+            return; // closed
+        std::lock_guard<std::mutex> lock(self->mutex);
+        if (self->handler)
+        {
+            AsyncUDPPacket packet(buf, len, IPAddress(from.sin_addr.s_addr));
+            self->handler(packet);
+        }
+    }
+}
+
+size_t AsyncUDP::broadcastTo(uint8_t *data, size_t len, uint16_t port)
+{
+    if (fd < 0)
+        return 0;
+    // from WiFi.localIP(): the simulated hosts of OTA_LOCAL_IP are told apart by the receivers
+    int send_fd = fd;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    if (getenv("OTA_LOCAL_IP") != nullptr)
+    {
+        send_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        int on = 1;
+        setsockopt(send_fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+        addr.sin_addr.s_addr = WiFi.localIP();
+        bind(send_fd, (sockaddr *)&addr, sizeof(addr));
+    }
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    ssize_t sent = sendto(send_fd, data, len, 0, (sockaddr *)&addr, sizeof(addr));
+    if (send_fd != fd)
+        ::close(send_fd);
+    return sent < 0 ? 0 : sent;
+}
+
+void AsyncUDP::close()
+{
+    if (fd >= 0)
+    {
+        shutdown(fd, SHUT_RDWR);
+        ::close(fd);
+    }
+    fd = -1;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <functional>
+#include "Arduino.h"
+#include "IPAddress.h"
+
+// Native stand-in for Arduino's AsyncUDP: a UDP socket served by a receiving thread.
+class AsyncUDPPacket
+{
+public:
+    AsyncUDPPacket(const uint8_t *data, size_t len, IPAddress remote) : data_(data), len(len), remote(remote) {}
+    uint8_t *data() { return (uint8_t *)data_; }
+    size_t length() { return len; }
+    IPAddress remoteIP() { return remote; }
+
+private:
+    const uint8_t *data_;
+    size_t len;
+    IPAddress remote;
+};
+
+class AsyncUDP
+{
+public:
+    using PacketHandler = std::function<void(AsyncUDPPacket &packet)>;
+
+    ~AsyncUDP() { close(); }
+    bool listen(uint16_t port);
+    void onPacket(PacketHandler handler) { this->handler = handler; }
+    size_t broadcastTo(uint8_t *data, size_t len, uint16_t port);
+    void close();
+
+private:
+    int fd{-1};
+    PacketHandler handler;
+    std::mutex mutex;
+
+    static void receive_task(void *arg);
+};
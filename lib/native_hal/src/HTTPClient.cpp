@@ -0,0 +1,175 @@
+#include "HTTPClient.h"
+
+#include <memory>
+
+namespace
+{
+    constexpr const int max_redirects = 10;
+
+    std::string lower(std::string s)
+    {
+        for (char &c : s)
+            c = tolower(c);
+        return s;
+    }
+
+    // http://host[:port]/path --> host, port, path. Return false for the other schemes (https isn't emulated)
+    bool split_url(const std::string &url, std::string &host, uint16_t &port, std::string &path)
+    {
+        if (url.compare(0, 7, "http://") != 0)
+            return false;
+        size_t host_start = 7;
+        size_t path_start = url.find('/', host_start);
+        std::string authority = url.substr(host_start, path_start == std::string::npos ? std::string::npos : path_start - host_start);
+        path = (path_start == std::string::npos) ? "/" : url.substr(path_start);
+        size_t colon = authority.find(':');
+        host = authority.substr(0, colon);
+        port = (colon == std::string::npos) ? 80 : atoi(authority.c_str() + colon + 1);
+        return !host.empty();
+    }
+}
+
+bool HTTPClient::begin(const String &url)
+{
+    own_client.reset(new WiFiClient());
+    return begin(*own_client, url);
+}
+
+bool HTTPClient::begin(WiFiClient &client, const String &url)
+{
+    this->client = &client;
+    this->url = url.c_str();
+    request_headers.clear();
+    response_headers.clear();
+    size = -1;
+    std::string host, path;
+    uint16_t port;
+    if (!split_url(this->url, host, port, path))
+    {
+        log_e("native HTTPClient: unsupported URL (plain http only): %s", url.c_str());
+        return false;
+    }
+    // a client connected by the caller is taken as connected to the URL's host, like on the device (no 2nd connect)
+    connected_origin = client.connected() ? host + ":" + std::to_string(port) : "";
+    return true;
+}
+
+void HTTPClient::end()
+{
+    if (client != nullptr && reuse && can_reuse)
+    {
+        while (client->available() > 0) // the rest of the body, like the device's HTTPClient
+            client->read();
+    }
+    else if (client != nullptr)
+    {
+        client->stop();
+    }
+    client = nullptr;
+    own_client.reset();
+}
+
+void HTTPClient::addHeader(const String &name, const String &value)
+{
+    request_headers += std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+}
+
+void HTTPClient::collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+{
+    collect.clear();
+    for (size_t i = 0; i < headerKeysCount; i++)
+        collect.push_back(lower(headerKeys[i]));
+}
+
+int HTTPClient::GET()
+{
+    if (client == nullptr)
+        return HTTPC_ERROR_NOT_CONNECTED;
+
+    std::string target = url;
+    for (int redirects = 0;; redirects++)
+    {
+        int code = send_request(target);
+        bool redirect = (code == 301 || code == 302 || code == 303 || code == 307 || code == 308);
+        if (!redirect || followRedirects == HTTPC_DISABLE_FOLLOW_REDIRECTS || redirects == max_redirects ||
+            (followRedirects == HTTPC_STRICT_FOLLOW_REDIRECTS && code == 303) || !hasHeader("Location"))
+            return code;
+        target = header("Location").c_str();
+        log_d("redirect to %s", target.c_str());
+    }
+}
+
+int HTTPClient::send_request(const std::string &target)
+{
+    std::string host, path;
+    uint16_t port;
+    if (!split_url(target, host, port, path))
+    {
+        log_e("native HTTPClient: unsupported URL (plain http only): %s", target.c_str());
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    std::string origin = host + ":" + std::to_string(port);
+    if (!(reuse && origin == connected_origin && client->connected()))
+    {
+        if (!client->connect(host.c_str(), port, connectTimeout))
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    connected_origin = origin;
+    client->setTimeout(timeout);
+
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nUser-Agent: ESP32HTTPClient\r\nConnection: " +
+                          (reuse ? "keep-alive" : "close") + "\r\n" + request_headers + "\r\n";
+    if (client->write((const uint8_t *)request.data(), request.size()) != request.size())
+        return HTTPC_ERROR_SEND_HEADER_FAILED;
+
+    String status = client->readStringUntil('\n');
+    int space = status.indexOf(' ');
+    if (!status.startsWith("HTTP/1.") || space < 0)
+        return HTTPC_ERROR_READ_TIMEOUT;
+    int code = status.substring(space + 1).toInt();
+
+    response_headers.clear();
+    while (true)
+    {
+        String line = client->readStringUntil('\n');
+        line.trim();
+        if (line.isEmpty())
+            break;
+        int colon = line.indexOf(':');
+        if (colon <= 0)
+            continue;
+        String name = line.substring(0, colon);
+        String value = line.substring(colon + 1);
+        name.toLowerCase();
+        value.trim();
+        std::string key = name.c_str();
+        if (key == "content-length" || key == "location" || key == "connection" ||
+            std::find(collect.begin(), collect.end(), key) != collect.end())
+            response_headers[key] = value.c_str();
+    }
+    size = hasHeader("Content-Length") ? header("Content-Length").toInt() : -1;
+    can_reuse = reuse && size >= 0 && !header("Connection").equalsIgnoreCase("close");
+    return code;
+}
+
+String HTTPClient::header(const char *name)
+{
+    auto it = response_headers.find(lower(name));
+    return it == response_headers.end() ? String() : String(it->second);
+}
+
+bool HTTPClient::hasHeader(const char *name)
+{
+    return response_headers.count(lower(name)) > 0;
+}
+
+String HTTPClient::getString()
+{
+    std::string body;
+    if (size > 0)
+    {
+        body.resize(size);
+        body.resize(client->readBytes((uint8_t *)&body[0], size));
+    }
+    return String(body);
+}
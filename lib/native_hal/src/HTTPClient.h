@@ -0,0 +1,68 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+// Native stand-in for Arduino's HTTPClient: HTTP/1.1 GET over a socket (plain http only, no chunked bodies).
+// The body is read from getStream() like on the device. setReuse(true): keep-alive, like the device's HTTPClient.
+typedef enum
+{
+    HTTPC_DISABLE_FOLLOW_REDIRECTS,
+    HTTPC_STRICT_FOLLOW_REDIRECTS,
+    HTTPC_FORCE_FOLLOW_REDIRECTS,
+} followRedirects_t;
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_PARTIAL_CONTENT 206
+#define HTTP_CODE_NOT_MODIFIED 304
+
+class HTTPClient
+{
+public:
+    ~HTTPClient() { end(); }
+
+    bool begin(const String &url);
+    bool begin(WiFiClient &client, const String &url);
+    void end();
+
+    void setFollowRedirects(followRedirects_t follow) { followRedirects = follow; }
+    void setReuse(bool reuse) { this->reuse = reuse; } // keep the connection for the next request to the same host
+    void setTimeout(uint16_t timeout_ms) { timeout = timeout_ms; }
+    void setConnectTimeout(int32_t timeout_ms) { connectTimeout = timeout_ms; }
+    void addHeader(const String &name, const String &value);
+    void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+
+    int GET();
+
+    String header(const char *name);
+    bool hasHeader(const char *name);
+    int getSize() { return size; }
+    WiFiClient &getStream() { return *client; }
+    String getString();
+    bool connected() { return client != nullptr && client->connected(); }
+
+private:
+    std::unique_ptr<WiFiClient> own_client;
+    WiFiClient *client{nullptr};
+    std::string url;
+    std::string request_headers;
+    std::vector<std::string> collect;
+    std::map<std::string, std::string> response_headers; // lower-case names
+    followRedirects_t followRedirects{HTTPC_DISABLE_FOLLOW_REDIRECTS};
+    uint16_t timeout{5000};
+    int32_t connectTimeout{5000};
+    int size{-1};
+    bool reuse{false};
+    bool can_reuse{false};        // the server keeps the connection open
+    std::string connected_origin; // host:port of the client's connection
+
+    int send_request(const std::string &url);
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include "WString.h"
+
+// Native stand-in for Arduino's IPAddress (IPv4, network byte order like lwIP's)
+class IPAddress
+{
+public:
+    IPAddress() = default;
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
+    IPAddress(uint32_t address) { memcpy(bytes, &address, 4); }
+
+    operator uint32_t() const
+    {
+        uint32_t address;
+        memcpy(&address, bytes, 4);
+        return address;
+    }
+    bool operator==(const IPAddress &rhs) const { return memcmp(bytes, rhs.bytes, 4) == 0; }
+    bool operator!=(const IPAddress &rhs) const { return !(*this == rhs); }
+    uint8_t operator[](int index) const { return bytes[index]; }
+    uint8_t &operator[](int index) { return bytes[index]; }
+
+    String toString() const
+    {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+        return String(buf);
+    }
+
+private:
+    uint8_t bytes[4]{};
+};
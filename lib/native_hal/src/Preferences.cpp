@@ -0,0 +1,267 @@
+#include "Preferences.h"
+#include "flash_emulator.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+
+namespace
+{
+    constexpr const size_t max_key_len = 15; // NVS_KEY_NAME_MAX_SIZE - 1
+    Preferences::Stats nvs_stats;
+
+    std::string nvs_dir()
+    {
+        return std::string(FlashEmulator::state_dir()) + "/nvs";
+    }
+
+    // File format, per entry: type (u8) | key length (u8) | key | value length (u32) | value.
+    // on_entry(type, key, value) for each entry of a namespace's file, false if there's none
+    template <typename F>
+    bool read_entries(const std::string &path, F on_entry)
+    {
+        FILE *f = fopen(path.c_str(), "rb");
+        if (f == nullptr)
+            return false;
+        uint8_t header[2];
+        while (fread(header, 1, 2, f) == 2)
+        {
+            std::string key(header[1], '\0');
+            uint32_t len;
+            if (fread(&key[0], 1, header[1], f) != header[1] || fread(&len, sizeof(len), 1, f) != 1)
+                break;
+            std::vector<uint8_t> value(len);
+            if (len > 0 && fread(value.data(), 1, len, f) != len)
+                break;
+            on_entry(header[0], std::move(key), std::move(value));
+        }
+        fclose(f);
+        return true;
+    }
+}
+
+struct nvs_opaque_iterator_t
+{
+    std::string namespace_name;
+    std::vector<std::pair<std::string, nvs_type_t>> entries;
+    size_t next{0};
+};
+
+esp_err_t nvs_flash_init()
+{
+    mkdir(FlashEmulator::state_dir(), 0755);
+    return (mkdir(nvs_dir().c_str(), 0755) == 0 || errno == EEXIST) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t nvs_flash_erase()
+{
+    DIR *dir = opendir(nvs_dir().c_str());
+    if (dir == nullptr)
+        return ESP_OK;
+    while (dirent *file = readdir(dir))
+    {
+        if (file->d_name[0] != '.')
+            unlink((nvs_dir() + "/" + file->d_name).c_str());
+    }
+    closedir(dir);
+    return ESP_OK;
+}
+
+// The entries are listed by a scan of the namespace's file (their values aren't kept), like NVS' page scan
+nvs_iterator_t nvs_entry_find(const char *, const char *namespace_name, nvs_type_t type)
+{
+    if (namespace_name == nullptr || strlen(namespace_name) > max_key_len)
+        return nullptr;
+    nvs_stats.scans++;
+    nvs_iterator_t it = new nvs_opaque_iterator_t{namespace_name, {}, 0};
+    read_entries(nvs_dir() + "/" + namespace_name, [&](uint8_t entry_type, std::string &&key, std::vector<uint8_t> &&)
+                 {
+                     // Preferences::Type: 1 I32, 2 Float (a blob in NVS), 3 Str, 4 Blob
+                     nvs_type_t nvs_type = (entry_type == 1) ? NVS_TYPE_I32 : (entry_type == 3) ? NVS_TYPE_STR : NVS_TYPE_BLOB;
+                     if (type == NVS_TYPE_ANY || type == nvs_type)
+                         it->entries.emplace_back(std::move(key), nvs_type); });
+    if (it->entries.empty())
+    {
+        delete it;
+        return nullptr;
+    }
+    return it;
+}
+
+nvs_iterator_t nvs_entry_next(nvs_iterator_t iterator)
+{
+    if (iterator == nullptr || ++iterator->next >= iterator->entries.size())
+    {
+        delete iterator;
+        return nullptr;
+    }
+    return iterator;
+}
+
+void nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t *out_info)
+{
+    strlcpy(out_info->namespace_name, iterator->namespace_name.c_str(), sizeof(out_info->namespace_name));
+    strlcpy(out_info->key, iterator->entries[iterator->next].first.c_str(), sizeof(out_info->key));
+    out_info->type = iterator->entries[iterator->next].second;
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator)
+{
+    delete iterator;
+}
+
+bool Preferences::begin(const char *name, bool readOnly, const char *)
+{
+    if (started || name == nullptr || strlen(name) > max_key_len)
+        return false;
+    path = nvs_dir() + "/" + name;
+    read_only = readOnly;
+    entries.clear();
+    nvs_stats.opens++;
+
+    bool exists = read_entries(path, [this](uint8_t type, std::string &&key, std::vector<uint8_t> &&value)
+                               { entries[key] = Entry{(Type)type, std::move(value)}; });
+    if (!exists && readOnly) // like NVS: a namespace is created on the first read-write open
+        return false;
+    started = true;
+    return true;
+}
+
+void Preferences::end()
+{
+    started = false;
+    entries.clear();
+}
+
+bool Preferences::clear()
+{
+    if (!started || read_only)
+        return false;
+    entries.clear();
+    return save();
+}
+
+bool Preferences::remove(const char *key)
+{
+    if (!started || read_only || entries.erase(key) == 0)
+        return false;
+    return save();
+}
+
+bool Preferences::isKey(const char *key)
+{
+    return started && entries.count(key) > 0;
+}
+
+const Preferences::Entry *Preferences::find(const char *key, Type type)
+{
+    if (!started)
+        return nullptr;
+    nvs_stats.reads++;
+    auto it = entries.find(key);
+    return (it == entries.end() || it->second.type != type) ? nullptr : &it->second;
+}
+
+size_t Preferences::put(const char *key, Type type, const void *value, size_t len)
+{
+    if (!started || read_only || key == nullptr || strlen(key) > max_key_len)
+        return 0;
+    entries[key] = Entry{type, std::vector<uint8_t>((const uint8_t *)value, (const uint8_t *)value + len)};
+    return save() ? len : 0;
+}
+
+bool Preferences::save()
+{
+    nvs_stats.writes++;
+    std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+    bool ok = true;
+    for (const auto &kv : entries)
+    {
+        uint8_t header[2]{(uint8_t)kv.second.type, (uint8_t)kv.first.size()};
+        uint32_t len = kv.second.value.size();
+        ok = ok && fwrite(header, 1, 2, f) == 2 && fwrite(kv.first.data(), 1, kv.first.size(), f) == kv.first.size() &&
+             fwrite(&len, sizeof(len), 1, f) == 1 && (len == 0 || fwrite(kv.second.value.data(), 1, len, f) == len);
+    }
+    ok = (fclose(f) == 0) && ok;
+    return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+size_t Preferences::putInt(const char *key, int32_t value)
+{
+    return put(key, Type::I32, &value, sizeof(value));
+}
+
+size_t Preferences::putFloat(const char *key, float value)
+{
+    return put(key, Type::Float, &value, sizeof(value));
+}
+
+size_t Preferences::putString(const char *key, const char *value)
+{
+    return put(key, Type::Str, value, strlen(value) + 1) ? strlen(value) : 0;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len)
+{
+    return (value == nullptr || len == 0) ? 0 : put(key, Type::Blob, value, len);
+}
+
+int32_t Preferences::getInt(const char *key, int32_t defaultValue)
+{
+    const Entry *entry = find(key, Type::I32);
+    int32_t value = defaultValue;
+    if (entry != nullptr)
+        memcpy(&value, entry->value.data(), sizeof(value));
+    return value;
+}
+
+float Preferences::getFloat(const char *key, float defaultValue)
+{
+    const Entry *entry = find(key, Type::Float);
+    float value = defaultValue;
+    if (entry != nullptr)
+        memcpy(&value, entry->value.data(), sizeof(value));
+    return value;
+}
+
+size_t Preferences::getString(const char *key, char *value, size_t maxLen)
+{
+    const Entry *entry = find(key, Type::Str);
+    if (entry == nullptr || value == nullptr || entry->value.size() > maxLen)
+        return 0;
+    memcpy(value, entry->value.data(), entry->value.size());
+    return entry->value.size();
+}
+
+String Preferences::getString(const char *key, const String &defaultValue)
+{
+    const Entry *entry = find(key, Type::Str);
+    return entry == nullptr ? defaultValue : String((const char *)entry->value.data());
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+    const Entry *entry = find(key, Type::Blob);
+    return entry == nullptr ? 0 : entry->value.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen)
+{
+    const Entry *entry = find(key, Type::Blob);
+    if (entry == nullptr || buf == nullptr || entry->value.size() > maxLen)
+        return 0;
+    memcpy(buf, entry->value.data(), entry->value.size());
+    return entry->value.size();
+}
+
+const Preferences::Stats &Preferences::stats()
+{
+    return nvs_stats;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+// Native stand-in for Arduino's Preferences: a file-backed NVS emulator.
+// - One file per namespace ("<state dir>/nvs/<namespace>"), loaded by begin(), rewritten (atomically) on each put.
+// - Typed entries like NVS: e.g. getInt() on a float key returns the default value.
+class Preferences
+{
+public:
+    bool begin(const char *name, bool readOnly = false, const char *partition_label = nullptr);
+    void end();
+
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+
+    size_t putInt(const char *key, int32_t value);
+    size_t putFloat(const char *key, float value);
+    size_t putString(const char *key, const char *value);
+    size_t putString(const char *key, const String &value) { return putString(key, value.c_str()); }
+    size_t putBytes(const char *key, const void *value, size_t len);
+
+    int32_t getInt(const char *key, int32_t defaultValue = 0);
+    float getFloat(const char *key, float defaultValue = NAN);
+    size_t getString(const char *key, char *value, size_t maxLen);
+    String getString(const char *key, const String &defaultValue = String());
+    size_t getBytesLength(const char *key);
+    size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+    // emulator counters (all the Preferences objects)
+    struct Stats
+    {
+        uint32_t opens{0};
+        uint32_t reads{0};
+        uint32_t writes{0};
+        uint32_t scans{0}; // nvs_entry_find(): the entries of a namespace listed
+    };
+    static const Stats &stats();
+
+private:
+    enum class Type : uint8_t
+    {
+        I32 = 1,
+        Float = 2,
+        Str = 3,
+        Blob = 4,
+    };
+    struct Entry
+    {
+        Type type;
+        std::vector<uint8_t> value;
+    };
+
+    bool started{false};
+    bool read_only{false};
+    std::string path;
+    std::map<std::string, Entry> entries;
+
+    const Entry *find(const char *key, Type type);
+    size_t put(const char *key, Type type, const void *value, size_t len);
+    bool save();
+};
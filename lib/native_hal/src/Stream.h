@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "WString.h"
+
+uint32_t millis();
+
+// Native stand-in for Arduino's Stream: the byte-wise read() with a timeout, readBytes() on top of it.
+class Stream
+{
+public:
+    virtual ~Stream() = default;
+
+    virtual int available() = 0;
+    virtual int read() = 0; // -1 if no byte is available
+    virtual size_t write(const uint8_t *buf, size_t size) = 0;
+
+    void setTimeout(unsigned long timeout_ms) { timeout = timeout_ms; }
+
+    // Read up to `length` bytes, wait at most `timeout` ms for each byte. Return the number of bytes read.
+    virtual size_t readBytes(uint8_t *buffer, size_t length)
+    {
+        size_t count = 0;
+        while (count < length)
+        {
+            int c = timed_read();
+            if (c < 0)
+                break;
+            buffer[count++] = (uint8_t)c;
+        }
+        return count;
+    }
+    size_t readBytes(char *buffer, size_t length) { return readBytes((uint8_t *)buffer, length); }
+
+    String readStringUntil(char terminator)
+    {
+        String result;
+        int c = timed_read();
+        while (c >= 0 && c != terminator)
+        {
+            result += (char)c;
+            c = timed_read();
+        }
+        return result;
+    }
+
+protected:
+    unsigned long timeout{1000};
+
+    int timed_read()
+    {
+        uint32_t start = millis();
+        do
+        {
+            int c = read();
+            if (c >= 0)
+                return c;
+        } while (millis() - start < timeout);
+        return -1;
+    }
+};
@@ -0,0 +1,99 @@
+#include "Update.h"
+
+#include <memory>
+
+UpdateClass Update;
+
+bool UpdateClass::begin(size_t size)
+{
+    if (running)
+        abort();
+    error = UPDATE_ERROR_OK;
+    partition = esp_ota_get_next_update_partition(NULL);
+    if (partition == nullptr)
+    {
+        error = UPDATE_ERROR_NO_PARTITION;
+        return false;
+    }
+    if (size != UPDATE_SIZE_UNKNOWN && size > partition->size)
+    {
+        error = UPDATE_ERROR_SIZE;
+        return false;
+    }
+    // like the Arduino core: the sectors are erased on the write path
+    if (esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &handle) != ESP_OK)
+    {
+        error = UPDATE_ERROR_ERASE;
+        return false;
+    }
+    size_ = (size == UPDATE_SIZE_UNKNOWN) ? partition->size : size;
+    progress_ = 0;
+    running = true;
+    return true;
+}
+
+size_t UpdateClass::write(uint8_t *data, size_t len)
+{
+    if (!running || hasError())
+        return 0;
+    len = std::min(len, remaining());
+    esp_err_t err = esp_ota_write(handle, data, len);
+    if (err != ESP_OK)
+    {
+        error = (err == ESP_ERR_OTA_VALIDATE_FAILED) ? UPDATE_ERROR_MAGIC_BYTE : UPDATE_ERROR_WRITE;
+        return 0;
+    }
+    progress_ += len;
+    return len;
+}
+
+size_t UpdateClass::writeStream(Stream &data)
+{
+    constexpr const size_t bufferSize = SPI_FLASH_SEC_SIZE;
+    std::unique_ptr<uint8_t[]> buffer{new uint8_t[bufferSize]};
+    size_t written = 0;
+    while (running && remaining() > 0)
+    {
+        size_t len = data.readBytes(buffer.get(), std::min(bufferSize, remaining()));
+        if (len == 0)
+        {
+            error = UPDATE_ERROR_STREAM;
+            break;
+        }
+        if (write(buffer.get(), len) != len)
+            break;
+        written += len;
+    }
+    return written;
+}
+
+bool UpdateClass::end(bool evenIfRemaining)
+{
+    if (!running || hasError())
+        return false;
+    if (!isFinished() && !evenIfRemaining)
+    {
+        error = UPDATE_ERROR_ABORT;
+        abort();
+        return false;
+    }
+    running = false;
+    if (esp_ota_end(handle) != ESP_OK)
+    {
+        error = UPDATE_ERROR_MAGIC_BYTE;
+        return false;
+    }
+    if (esp_ota_set_boot_partition(partition) != ESP_OK)
+    {
+        error = UPDATE_ERROR_ACTIVATE;
+        return false;
+    }
+    return true;
+}
+
+void UpdateClass::abort()
+{
+    if (running)
+        esp_ota_abort(handle);
+    running = false;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Arduino.h"
+#include "esp_ota_ops.h"
+
+// Native stand-in for Arduino's Update (UpdateClass) on top of the emulated esp_ota_ops:
+// the image is written into the next OTA partition, end() validates it & sets the boot partition.
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+#define UPDATE_ERROR_OK 0
+#define UPDATE_ERROR_WRITE 1
+#define UPDATE_ERROR_ERASE 2
+#define UPDATE_ERROR_READ 3
+#define UPDATE_ERROR_SPACE 4
+#define UPDATE_ERROR_SIZE 5
+#define UPDATE_ERROR_STREAM 6
+#define UPDATE_ERROR_MAGIC_BYTE 8
+#define UPDATE_ERROR_ACTIVATE 9
+#define UPDATE_ERROR_NO_PARTITION 10
+#define UPDATE_ERROR_ABORT 13
+
+class UpdateClass
+{
+public:
+    bool begin(size_t size = UPDATE_SIZE_UNKNOWN);
+    size_t write(uint8_t *data, size_t len);
+    size_t writeStream(Stream &data);
+    bool end(bool evenIfRemaining = false);
+    void abort();
+
+    uint8_t getError() { return error; }
+    bool hasError() { return error != UPDATE_ERROR_OK; }
+    bool isRunning() { return running; }
+    bool isFinished() { return progress_ == size_; }
+    size_t size() { return size_; }
+    size_t progress() { return progress_; }
+    size_t remaining() { return size_ - progress_; }
+
+private:
+    esp_ota_handle_t handle{0};
+    const esp_partition_t *partition{nullptr};
+    size_t size_{0};
+    size_t progress_{0};
+    uint8_t error{UPDATE_ERROR_OK};
+    bool running{false};
+};
+
+extern UpdateClass Update;
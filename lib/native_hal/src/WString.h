@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Native stand-in for Arduino's String (the subset used by the OTA core), on top of std::string.
+class String
+{
+public:
+    String(const char *cstr = "") : s(cstr != nullptr ? cstr : "") {}
+    String(const std::string &str) : s(str) {}
+    explicit String(char c) : s(1, c) {}
+    explicit String(int value) : s(std::to_string(value)) {}
+    explicit String(unsigned int value) : s(std::to_string(value)) {}
+    explicit String(long value) : s(std::to_string(value)) {}
+    explicit String(unsigned long value) : s(std::to_string(value)) {}
+
+    bool reserve(unsigned int size)
+    {
+        s.reserve(size);
+        return true;
+    }
+    const char *c_str() const { return s.c_str(); }
+    unsigned int length() const { return s.length(); }
+    bool isEmpty() const { return s.empty(); }
+    char operator[](unsigned int index) const { return index < s.size() ? s[index] : '\0'; }
+
+    String &operator+=(const String &rhs)
+    {
+        s += rhs.s;
+        return *this;
+    }
+    String &operator+=(const char *rhs)
+    {
+        s += (rhs != nullptr ? rhs : "");
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        s += c;
+        return *this;
+    }
+    friend String operator+(String lhs, const String &rhs) { return lhs += rhs; }
+    friend String operator+(String lhs, const char *rhs) { return lhs += rhs; }
+
+    bool operator==(const String &rhs) const { return s == rhs.s; }
+    bool operator==(const char *rhs) const { return s == (rhs != nullptr ? rhs : ""); }
+    bool operator!=(const String &rhs) const { return s != rhs.s; }
+    bool operator!=(const char *rhs) const { return !(*this == rhs); }
+    bool equalsIgnoreCase(const String &rhs) const { return strcasecmp(s.c_str(), rhs.s.c_str()) == 0; }
+    bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+
+    int indexOf(char c, unsigned int from = 0) const { return to_index(s.find(c, from)); }
+    int indexOf(const String &str, unsigned int from = 0) const { return to_index(s.find(str.s, from)); }
+    String substring(unsigned int from) const { return from < s.size() ? String(s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const { return from < to && from < s.size() ? String(s.substr(from, to - from)) : String(); }
+
+    void trim()
+    {
+        size_t first = s.find_first_not_of(" \t\r\n");
+        size_t last = s.find_last_not_of(" \t\r\n");
+        s = (first == std::string::npos) ? "" : s.substr(first, last - first + 1);
+    }
+    void toLowerCase()
+    {
+        for (char &c : s)
+            c = tolower(c);
+    }
+
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return atof(s.c_str()); }
+
+private:
+    std::string s;
+
+    static int to_index(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+// Native stand-in for Arduino's WiFi: the host's network is always "connected".
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_CONNECTED = 3,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+class WiFiClass
+{
+public:
+    wl_status_t begin(const char *, const char * = nullptr) { return WL_CONNECTED; }
+    wl_status_t status() { return WL_CONNECTED; }
+    // OTA_LOCAL_IP=127.0.0.<n>: this process is a host of a LAN simulated on the loopback (its broadcasts come from there)
+    IPAddress localIP()
+    {
+        const char *ip = getenv("OTA_LOCAL_IP");
+        in_addr addr;
+        return (ip != nullptr && inet_aton(ip, &addr)) ? IPAddress((uint32_t)addr.s_addr) : IPAddress(127, 0, 0, 1);
+    }
+    String SSID() { return String("native"); }
+    bool getAutoReconnect() { return true; }
+    int hostByName(const char *host, IPAddress &ip)
+    {
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        addrinfo *result = nullptr;
+        if (getaddrinfo(host, nullptr, &hints, &result) != 0 || result == nullptr)
+            return 0;
+        ip = IPAddress((uint32_t)((sockaddr_in *)result->ai_addr)->sin_addr.s_addr);
+        freeaddrinfo(result);
+        return 1;
+    }
+};
+inline WiFiClass WiFi;
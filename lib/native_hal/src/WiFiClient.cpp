@@ -0,0 +1,190 @@
+#include "WiFiClient.h"
+
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace
+{
+    struct Link
+    {
+        double kbps{0};
+        double fail_rate{0};
+        std::mt19937 random{std::random_device{}()};
+        std::mutex mutex; // random
+        WiFiClient::LinkStats stats;
+
+        Link()
+        {
+            const char *value = getenv("OTA_LINK_KBPS");
+            kbps = value ? atof(value) : 0;
+            value = getenv("OTA_LINK_FAIL_RATE");
+            fail_rate = value ? atof(value) : 0;
+        }
+
+        // true with the probability p
+        bool roll(double p)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return p > 0 && std::uniform_real_distribution<double>(0, 1)(random) < p;
+        }
+
+        uint64_t drop_point()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return std::uniform_int_distribution<uint64_t>(0, 128 * 1024)(random);
+        }
+    };
+
+    Link &link()
+    {
+        static Link instance;
+        return instance;
+    }
+}
+
+const WiFiClient::LinkStats &WiFiClient::link_stats()
+{
+    return link().stats;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port, int32_t timeout_ms)
+{
+    stop();
+    if (link().roll(link().fail_rate / 2))
+    {
+        link().stats.injected_failures++;
+        log_e("connect to %s:%u failed (OTA_LINK_FAIL_RATE)", host, port);
+        return 0;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &result) != 0 || result == nullptr)
+    {
+        log_e("DNS lookup failed: %s", host);
+        return 0;
+    }
+
+    fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    timeval timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    int ok = (fd >= 0 && ::connect(fd, result->ai_addr, result->ai_addrlen) == 0);
+    freeaddrinfo(result);
+    if (!ok)
+    {
+        log_e("connect to %s:%u failed", host, port);
+        stop();
+        return 0;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    received = 0;
+    drop_after = link().roll(link().fail_rate / 2) ? link().drop_point() : UINT64_MAX;
+    return 1;
+}
+
+void WiFiClient::stop()
+{
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+    rx_pos = rx_len = 0;
+}
+
+uint8_t WiFiClient::connected()
+{
+    if (fd < 0)
+        return 0;
+    if (rx_pos < rx_len)
+        return 1;
+    uint8_t byte;
+    ssize_t len = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+bool WiFiClient::fill(int32_t wait_ms)
+{
+    if (fd < 0)
+        return false;
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, wait_ms) <= 0)
+        return false;
+    ssize_t len = recv(fd, rx_buf, sizeof(rx_buf), 0);
+    if (len <= 0)
+        return false;
+    received += len;
+    link().stats.bytes_received += len;
+    if (received > drop_after)
+    {
+        link().stats.injected_failures++;
+        stop();
+        return false;
+    }
+    if (link().kbps > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)(len * 1e6 / (link().kbps * 1024))));
+    rx_pos = 0;
+    rx_len = len;
+    return true;
+}
+
+int WiFiClient::available()
+{
+    int pending = 0;
+    if (fd >= 0)
+        ioctl(fd, FIONREAD, &pending);
+    return (rx_len - rx_pos) + pending;
+}
+
+int WiFiClient::read()
+{
+    if (rx_pos == rx_len && !fill(0))
+        return -1;
+    return rx_buf[rx_pos++];
+}
+
+size_t WiFiClient::readBytes(uint8_t *buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length)
+    {
+        if (rx_pos == rx_len && !fill(timeout))
+            break;
+        size_t chunk = std::min(length - count, rx_len - rx_pos);
+        memcpy(buffer + count, rx_buf + rx_pos, chunk);
+        rx_pos += chunk;
+        count += chunk;
+    }
+    return count;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+    size_t sent = 0;
+    while (fd >= 0 && sent < size)
+    {
+        ssize_t len = send(fd, buf + sent, size - sent, MSG_NOSIGNAL);
+        if (len <= 0)
+            break;
+        sent += len;
+    }
+    return sent;
+}
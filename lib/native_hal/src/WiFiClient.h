@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include "Arduino.h"
+#include "IPAddress.h"
+
+// Native stand-in for Arduino's WiFiClient: a blocking TCP socket (with read timeouts) as a Stream.
+// A simulated link (e.g. the devices of tools/fleet_loadgen.py --native), from the environment:
+// - OTA_LINK_KBPS=<kB/s>: the reads are paced at that rate
+// - OTA_LINK_FAIL_RATE=<fraction>: half of it fails connects, half drops connections after a random 0-128 KB received
+class WiFiClient : public Stream
+{
+public:
+    struct LinkStats
+    {
+        std::atomic<uint64_t> bytes_received{0};
+        std::atomic<uint32_t> injected_failures{0}; // connects failed & connections dropped on purpose (OTA_LINK_FAIL_RATE)
+    };
+    static const LinkStats &link_stats();
+
+    WiFiClient() = default;
+    ~WiFiClient() { stop(); }
+    WiFiClient(const WiFiClient &) = delete;
+    WiFiClient &operator=(const WiFiClient &) = delete;
+
+    int connect(const char *host, uint16_t port, int32_t timeout_ms = 5000);
+    int connect(IPAddress ip, uint16_t port, int32_t timeout_ms = 5000) { return connect(ip.toString().c_str(), port, timeout_ms); }
+    void stop();
+    uint8_t connected();
+    operator bool() { return connected(); }
+
+    int available() override;
+    int read() override;
+    size_t readBytes(uint8_t *buffer, size_t length) override;
+    using Stream::readBytes;
+    size_t write(const uint8_t *buf, size_t size) override;
+    size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    void flush() {}
+
+private:
+    int fd{-1};
+    uint8_t rx_buf[1460];
+    size_t rx_pos{0};
+    size_t rx_len{0};
+    uint64_t received{0};
+    uint64_t drop_after{UINT64_MAX}; // an injected failure: the connection drops after that many bytes
+
+    bool fill(int32_t wait_ms);
+};
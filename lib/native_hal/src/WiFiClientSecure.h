@@ -0,0 +1,17 @@
+#pragma once
+#include "WiFiClient.h"
+
+// Native stand-in for Arduino's WiFiClientSecure: no TLS on the host (the native HTTPClient is plain http only),
+// connect() fails.
+class WiFiClientSecure : public WiFiClient
+{
+public:
+    void setCACert(const char *) {}
+    void setHandshakeTimeout(unsigned long) {}
+
+    int connect(const char *host, uint16_t port, int32_t = 5000)
+    {
+        log_e("native HAL: no TLS, https://%s:%u isn't supported", host, port);
+        return 0;
+    }
+};
@@ -0,0 +1,322 @@
+#include "flash_emulator.h"
+#include "esp_ota_ops.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace FlashEmulator
+{
+    namespace
+    {
+        constexpr const uint32_t sector_erase_us = 45000;
+        constexpr const uint32_t block_erase_us = 150000;
+        constexpr const uint32_t page_program_us = 700;
+        constexpr const uint32_t read_bytes_per_us = 40;
+
+        std::recursive_mutex flash_mutex;
+        std::mutex cache_mutex; // held during the flash busy time: the cache is off
+        int flash_fd = -1;
+        Stats flash_stats;
+
+        int fd()
+        {
+            if (flash_fd < 0)
+            {
+                std::string dir = state_dir();
+                mkdir(dir.c_str(), 0755);
+                std::string path = dir + "/flash.bin";
+                flash_fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+                if (flash_fd < 0 || ftruncate(flash_fd, flash_size) != 0)
+                {
+                    perror(path.c_str());
+                    abort();
+                }
+            }
+            return flash_fd;
+        }
+
+        void busy(uint64_t us)
+        {
+            flash_stats.busy_us += us;
+            static const bool timing = getenv("OTA_FLASH_TIMING") == nullptr || strcmp(getenv("OTA_FLASH_TIMING"), "0") != 0;
+            if (timing)
+            {
+                std::lock_guard<std::mutex> cache_off(cache_mutex);
+                std::this_thread::sleep_for(std::chrono::microseconds(us));
+            }
+        }
+    }
+
+    const char *state_dir()
+    {
+        const char *dir = getenv("OTA_STATE_DIR");
+        return (dir != nullptr && *dir) ? dir : ".pio/native_state";
+    }
+
+    bool read(uint32_t address, void *dst, size_t size)
+    {
+        std::lock_guard<std::recursive_mutex> lock(flash_mutex);
+        if (address + size > flash_size || pread(fd(), dst, size, address) != (ssize_t)size)
+            return false;
+        for (size_t i = 0; i < size; i++) // the file holds the inverted content
+            ((uint8_t *)dst)[i] = ~((uint8_t *)dst)[i];
+        flash_stats.bytes_read += size;
+        busy(size / read_bytes_per_us);
+        return true;
+    }
+
+    bool write(uint32_t address, const void *src, size_t size)
+    {
+        std::lock_guard<std::recursive_mutex> lock(flash_mutex);
+        if (address + size > flash_size)
+            return false;
+        uint8_t buf[page_size];
+        size_t done = 0;
+        while (done < size)
+        { // page by page: flash = flash & data <--> inverted = inverted | ~data
+            size_t chunk = std::min<size_t>(page_size - (address + done) % page_size, size - done);
+            if (pread(fd(), buf, chunk, address + done) != (ssize_t)chunk)
+                return false;
+            for (size_t i = 0; i < chunk; i++)
+                buf[i] |= ~((const uint8_t *)src)[done + i];
+            if (pwrite(fd(), buf, chunk, address + done) != (ssize_t)chunk)
+                return false;
+            done += chunk;
+            busy(page_program_us);
+        }
+        flash_stats.bytes_programmed += size;
+        return true;
+    }
+
+    bool erase(uint32_t address, size_t size)
+    {
+        std::lock_guard<std::recursive_mutex> lock(flash_mutex);
+        if (address % sector_size || size % sector_size || address + size > flash_size)
+            return false;
+        static const uint8_t zeros[sector_size] = {};
+        uint32_t end = address + size;
+        while (address < end)
+        {
+            bool whole_block = (address % block_size == 0) && (end - address >= block_size);
+            uint32_t len = whole_block ? block_size : sector_size;
+            for (uint32_t offset = 0; offset < len; offset += sector_size)
+                if (pwrite(fd(), zeros, sector_size, address + offset) != (ssize_t)sector_size)
+                    return false;
+            if (whole_block)
+            {
+                flash_stats.block_erases++;
+                busy(block_erase_us);
+            }
+            else
+            {
+                flash_stats.sector_erases++;
+                busy(sector_erase_us);
+            }
+            address += len;
+        }
+        return true;
+    }
+
+    void wait_cache()
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+    }
+
+    const Stats &stats()
+    {
+        return flash_stats;
+    }
+
+    void reset_stats()
+    {
+        flash_stats = Stats{};
+    }
+}
+
+// ---------- esp_partition ----------
+namespace
+{
+    const esp_partition_t partitions[]{
+        {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, 0x9000, 0x5000, "nvs", false},
+        {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_OTA, 0xe000, 0x2000, "otadata", false},
+        {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, 0x140000, "app0", false},
+        {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x150000, 0x140000, "app1", false},
+        {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 0x290000, 0x170000, "spiffs", false},
+    };
+    const esp_partition_t *const otadata = &partitions[1];
+    const esp_partition_t *const app[2]{&partitions[2], &partitions[3]};
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    for (const esp_partition_t &p : partitions)
+    {
+        if (p.type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || p.subtype == subtype) && (label == nullptr || strcmp(p.label, label) == 0))
+            return &p;
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (partition == nullptr || src_offset + size > partition->size)
+        return ESP_ERR_INVALID_SIZE;
+    return FlashEmulator::read(partition->address + src_offset, dst, size) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (partition == nullptr || dst_offset + size > partition->size)
+        return ESP_ERR_INVALID_SIZE;
+    return FlashEmulator::write(partition->address + dst_offset, src, size) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (partition == nullptr || offset + size > partition->size)
+        return ESP_ERR_INVALID_SIZE;
+    if (offset % FlashEmulator::sector_size || size % FlashEmulator::sector_size)
+        return ESP_ERR_INVALID_ARG;
+    return FlashEmulator::erase(partition->address + offset, size) ? ESP_OK : ESP_FAIL;
+}
+
+// ---------- esp_ota_ops ----------
+namespace
+{
+    constexpr const uint8_t app_image_magic = 0xE9;
+
+    struct OtaWrite
+    {
+        const esp_partition_t *partition;
+        uint32_t written; // sequential writes
+        uint32_t erased;  // erased bytes from the start (lazy erase of OTA_WITH_SEQUENTIAL_WRITES)
+        bool lazy_erase;
+    };
+    std::map<esp_ota_handle_t, OtaWrite> ota_writes;
+    esp_ota_handle_t last_handle = 0;
+
+    // otadata: the index (0/1) of the boot app partition in its first word, erased --> app0
+    int boot_index()
+    {
+        uint32_t index = 0xffffffff;
+        esp_partition_read(otadata, 0, &index, sizeof(index));
+        return (index == 1) ? 1 : 0;
+    }
+
+    bool is_valid_image(const esp_partition_t *partition)
+    {
+        uint8_t magic = 0;
+        return esp_partition_read(partition, 0, &magic, 1) == ESP_OK && magic == app_image_magic;
+    }
+}
+
+const esp_partition_t *esp_ota_get_running_partition()
+{
+    static const esp_partition_t *running = app[boot_index()]; // decided once, at "boot"
+    return running;
+}
+
+const esp_partition_t *esp_ota_get_boot_partition()
+{
+    return app[boot_index()];
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    if (start_from == nullptr)
+        start_from = esp_ota_get_running_partition();
+    return (start_from == app[0]) ? app[1] : app[0];
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    if (partition != app[0] && partition != app[1])
+        return ESP_ERR_INVALID_ARG;
+    if (!is_valid_image(partition))
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    uint32_t index = (partition == app[1]) ? 1 : 0;
+    esp_err_t err = esp_partition_erase_range(otadata, 0, FlashEmulator::sector_size);
+    return err != ESP_OK ? err : esp_partition_write(otadata, 0, &index, sizeof(index));
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    if (partition == nullptr || out_handle == nullptr || (partition != app[0] && partition != app[1]))
+        return ESP_ERR_INVALID_ARG;
+    if (partition == esp_ota_get_running_partition())
+        return ESP_ERR_OTA_PARTITION_CONFLICT;
+
+    bool lazy_erase = (image_size == OTA_WITH_SEQUENTIAL_WRITES);
+    if (!lazy_erase)
+    {
+        size_t erase_size = (image_size == OTA_SIZE_UNKNOWN) ? partition->size : image_size;
+        if (erase_size > partition->size)
+            return ESP_ERR_INVALID_SIZE;
+        erase_size = (erase_size + FlashEmulator::sector_size - 1) / FlashEmulator::sector_size * FlashEmulator::sector_size;
+        esp_err_t err = esp_partition_erase_range(partition, 0, erase_size);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    *out_handle = ++last_handle;
+    ota_writes[*out_handle] = OtaWrite{partition, 0, 0, lazy_erase};
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    auto it = ota_writes.find(handle);
+    if (it == ota_writes.end())
+        return ESP_ERR_INVALID_ARG;
+    OtaWrite &ota = it->second;
+    if (ota.written == 0 && size > 0 && ((const uint8_t *)data)[0] != app_image_magic)
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+
+    if (ota.lazy_erase)
+    {
+        while (ota.erased < ota.written + size)
+        {
+            esp_err_t err = esp_partition_erase_range(ota.partition, ota.erased, FlashEmulator::sector_size);
+            if (err != ESP_OK)
+                return err;
+            ota.erased += FlashEmulator::sector_size;
+        }
+    }
+    esp_err_t err = esp_partition_write(ota.partition, ota.written, data, size);
+    if (err == ESP_OK)
+        ota.written += size;
+    return err;
+}
+
+esp_err_t esp_ota_write_with_offset(esp_ota_handle_t handle, const void *data, size_t size, uint32_t offset)
+{
+    auto it = ota_writes.find(handle);
+    if (it == ota_writes.end())
+        return ESP_ERR_INVALID_ARG;
+    return esp_partition_write(it->second.partition, offset, data, size);
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    auto it = ota_writes.find(handle);
+    if (it == ota_writes.end())
+        return ESP_ERR_NOT_FOUND;
+    const esp_partition_t *partition = it->second.partition;
+    ota_writes.erase(it);
+    return is_valid_image(partition) ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    return ota_writes.erase(handle) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// NOR flash emulator behind the native esp_partition API:
+// - A 4MB sparse file "<state dir>/flash.bin" holds the inverted flash content (a hole reads as erased 0xFF).
+// - Programming can only clear bits (NOR semantics), erasing works on 4KB sectors (64KB blocks when aligned).
+// - Realistic timing (typical SPI NOR figures), spent as sleeps unless OTA_FLASH_TIMING=0 in the environment:
+//   sector erase 45 ms, block erase 150 ms, page (256 bytes) program 0.7 ms, read 40 MB/s.
+// - The state directory is $OTA_STATE_DIR, ".pio/native_state" by default (shared with the NVS emulator).
+// - Like the ESP32 (its flash cache is off during a flash operation), code "running from flash" stalls meanwhile:
+//   an emulated task calls wait_cache() before its work, e.g. the sensor task of the native program.
+namespace FlashEmulator
+{
+    constexpr const uint32_t flash_size = 4 * 1024 * 1024;
+    constexpr const uint32_t sector_size = 4096;
+    constexpr const uint32_t block_size = 65536;
+    constexpr const uint32_t page_size = 256;
+
+    struct Stats
+    {
+        uint32_t sector_erases{0};
+        uint32_t block_erases{0};
+        uint64_t bytes_programmed{0};
+        uint64_t bytes_read{0};
+        uint64_t busy_us{0}; // emulated flash busy time
+    };
+
+    const char *state_dir();
+    bool read(uint32_t address, void *dst, size_t size);
+    bool write(uint32_t address, const void *src, size_t size);
+    bool erase(uint32_t address, size_t size); // sector-aligned
+    void wait_cache(); // return when no flash operation is in progress
+    const Stats &stats();
+    void reset_stats();
+}
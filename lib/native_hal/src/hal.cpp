@@ -0,0 +1,175 @@
+#include "Arduino.h"
+#include "esp_ota_ops.h"
+#include "flash_emulator.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <random>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+namespace
+{
+    const auto boot_time = std::chrono::steady_clock::now();
+    std::atomic<bool> clock_simulated{false};
+    std::atomic<uint64_t> simulated_us{0};
+
+    // per-thread task notification (FreeRTOS direct-to-task notification as a counting semaphore)
+    struct Notification
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        uint32_t count{0};
+    };
+    thread_local Notification this_task;
+}
+
+uint32_t millis()
+{
+    if (clock_simulated)
+        return (uint32_t)(simulated_us / 1000);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - boot_time).count();
+}
+
+uint32_t micros()
+{
+    if (clock_simulated)
+        return (uint32_t)simulated_us;
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot_time).count();
+}
+
+void simulate_clock(uint32_t start_ms)
+{
+    simulated_us = (uint64_t)start_ms * 1000;
+    clock_simulated = true;
+}
+
+void advance_clock(uint32_t ms)
+{
+    simulated_us += (uint64_t)ms * 1000;
+}
+
+void delay(uint32_t ms)
+{
+    if (clock_simulated)
+    {
+        advance_clock(ms);
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+uint32_t esp_random()
+{
+    thread_local std::mt19937 generator{std::random_device{}()};
+    return generator();
+}
+
+void hal_log(char level, const char *file, int line, const char *func, const char *format, ...)
+{
+    const char *name = strrchr(file, '/');
+    fprintf(stdout, "[%6u][%c][%s:%d] %s(): ", millis(), level, name ? name + 1 : file, line, func);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stdout, format, args);
+    va_end(args);
+    fputc('\n', stdout);
+}
+
+int HardwareSerial::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = vfprintf(stdout, format, args);
+    va_end(args);
+    return len;
+}
+
+uint64_t EspClass::getEfuseMac()
+{
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a
+    for (const char *c = FlashEmulator::state_dir(); *c; c++)
+        hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+    return hash & 0xFFFFFFFFFFFFULL;
+}
+
+void EspClass::restart()
+{
+    printf("ESP.restart(): rebooting into '%s' (next run)\n", esp_ota_get_boot_partition()->label);
+    fflush(stdout);
+    if (on_restart != nullptr)
+        on_restart();
+    exit(0);
+}
+
+// ---------- FreeRTOS ----------
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *, uint32_t, void *arg, UBaseType_t, TaskHandle_t *handle)
+{
+    std::thread task(fn, arg);
+    if (handle != nullptr)
+        *handle = nullptr; // not addressable from the creating thread
+    task.detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t) {}
+
+void vTaskDelay(TickType_t ticks)
+{
+    delay(ticks * portTICK_PERIOD_MS);
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment)
+{
+    *previous_wake += increment;
+    std::this_thread::sleep_until(boot_time + std::chrono::milliseconds(*previous_wake * portTICK_PERIOD_MS));
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return millis() / portTICK_PERIOD_MS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return &this_task;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    std::unique_lock<std::mutex> lock(this_task.mutex);
+    auto notified = [] { return this_task.count > 0; };
+    if (clock_simulated)
+    {
+        if (!notified() && ticks_to_wait != portMAX_DELAY)
+            advance_clock(ticks_to_wait * portTICK_PERIOD_MS); // timed out, at once
+    }
+    else if (ticks_to_wait == portMAX_DELAY)
+        this_task.cv.wait(lock, notified);
+    else
+        this_task.cv.wait_for(lock, std::chrono::milliseconds(ticks_to_wait * portTICK_PERIOD_MS), notified);
+
+    uint32_t count = this_task.count;
+    if (count > 0)
+        this_task.count = clear_on_exit ? 0 : count - 1;
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    Notification *notification = (Notification *)task;
+    {
+        std::lock_guard<std::mutex> lock(notification->mutex);
+        notification->count++;
+    }
+    notification->cv.notify_one();
+    return pdPASS;
+}
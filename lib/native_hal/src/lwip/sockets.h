@@ -0,0 +1,7 @@
+#pragma once
+// Native stand-in for lwIP's BSD sockets: the host's own
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
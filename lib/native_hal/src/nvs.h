@@ -0,0 +1,31 @@
+#pragma once
+#include "esp_partition.h"
+
+// Native stand-in: the entry iteration of the NVS emulator (ESP-IDF 4.4 API), over Preferences' namespace files.
+#define NVS_DEFAULT_PART_NAME "nvs"
+#define NVS_KEY_NAME_MAX_SIZE 16
+#define NVS_NS_NAME_MAX_SIZE NVS_KEY_NAME_MAX_SIZE
+
+typedef enum
+{
+    NVS_TYPE_I32 = 0x14,
+    NVS_TYPE_STR = 0x21,
+    NVS_TYPE_BLOB = 0x42, // also the floats of Preferences
+    NVS_TYPE_ANY = 0xff,
+} nvs_type_t;
+
+typedef struct
+{
+    char namespace_name[NVS_NS_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+} nvs_entry_info_t;
+
+typedef struct nvs_opaque_iterator_t *nvs_iterator_t;
+
+// The first entry of a namespace (of `type`, or any), nullptr if none
+nvs_iterator_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type);
+// The next entry, nullptr (the iterator released) after the last one
+nvs_iterator_t nvs_entry_next(nvs_iterator_t iterator);
+void nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t *out_info);
+void nvs_release_iterator(nvs_iterator_t iterator);
@@ -0,0 +1,6 @@
+#pragma once
+#include "esp_partition.h"
+
+// Native stand-in: the NVS emulator (Preferences) keeps one file per namespace in "<state dir>/nvs/".
+esp_err_t nvs_flash_init();
+esp_err_t nvs_flash_erase();
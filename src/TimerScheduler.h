@@ -0,0 +1,237 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+- Multi-timer scheduler (periodic & one-shot timers with a context pointer), a replacement for PeriodicTimer.
+- The pending timers are kept in a fixed-capacity min-heap ordered by deadline (no heap allocation).
+- Deadlines are compared by signed difference --> safe across the millis() wraparound (~49.7 days),
+  as long as an interval stays below 2^31 ms.
+- loop() runs the due callbacks, then blocks the calling task until the next deadline or wake(),
+  so the CPU stays idle between deadlines instead of polling millis() every few ms.
+- Usage:
+    TimerScheduler<> timers;
+    auto id = timers.every(5000, callback, &ctx); // periodic
+    timers.after(100, callback);                   // one-shot
+    void loop() { timers.loop(); }
+*/
+template <uint8_t Capacity = 8>
+class TimerScheduler
+{
+public:
+    using Callback = void (*)(void *ctx);
+    using TimerId = uint8_t; // also the heap's entries & the slot index
+    static constexpr TimerId InvalidTimer = 0xFF;
+    static_assert(Capacity < InvalidTimer, "TimerScheduler: Capacity must be below 255");
+
+    // Periodic timer: the first call is `interval_ms` from now; the next ones `interval_ms` after each callback returns.
+    TimerId every(uint32_t interval_ms, Callback fn, void *ctx = nullptr)
+    {
+        return add(interval_ms, interval_ms, fn, ctx);
+    }
+
+    // One-shot timer: called once, `delay_ms` from now.
+    TimerId after(uint32_t delay_ms, Callback fn, void *ctx = nullptr)
+    {
+        return add(delay_ms, 0, fn, ctx);
+    }
+
+    // Change the period of a periodic timer, counted from now (it may be called from the timer's own callback).
+    void set_interval(TimerId id, uint32_t interval_ms)
+    {
+        if (!is_active(id))
+            return;
+        timers[id].interval = interval_ms;
+        if (timers[id].heap_pos != not_queued)
+            reschedule(id, millis() + interval_ms);
+    }
+
+    // Make a timer due right away (e.g. an external event asks for an early check).
+    void trigger_now(TimerId id)
+    {
+        if (!is_active(id))
+            return;
+        reschedule(id, millis());
+        wake();
+    }
+
+    void cancel(TimerId id)
+    {
+        if (!is_active(id))
+            return;
+        if (timers[id].heap_pos != not_queued)
+            remove(timers[id].heap_pos);
+        timers[id].active = false;
+    }
+
+    bool is_active(TimerId id) const
+    {
+        return id < Capacity && timers[id].active;
+    }
+
+    // Run all due callbacks, then sleep until the next deadline (or until wake() is called from another task).
+    void loop()
+    {
+        if (owner == nullptr)
+            owner = xTaskGetCurrentTaskHandle();
+
+        run_due();
+
+        uint32_t wait_ms = until_next_deadline();
+        if (wait_ms > 0)
+        {
+            uint32_t start = millis();
+            ulTaskNotifyTake(pdTRUE, (heap_size == 0) ? portMAX_DELAY : pdMS_TO_TICKS(min(wait_ms, max_sleep_ms)));
+            stats.idle_ms += millis() - start;
+        }
+        stats.wakeups++;
+    }
+
+    // Wake up the task blocked in loop(), e.g. after trigger_now() from another task.
+    void wake()
+    {
+        if (owner != nullptr && owner != xTaskGetCurrentTaskHandle())
+            xTaskNotifyGive(owner);
+    }
+
+    // Milliseconds until the earliest deadline (0 if already due).
+    uint32_t until_next_deadline() const
+    {
+        if (heap_size == 0)
+            return UINT32_MAX;
+        int32_t remain = (int32_t)(timers[heap[0]].deadline - millis());
+        return remain > 0 ? remain : 0;
+    }
+
+    struct Stats
+    {
+        uint32_t wakeups{0};   // loop() iterations, i.e. times the task was woken up
+        uint32_t callbacks{0}; // callbacks run
+        uint32_t idle_ms{0};   // time spent blocked between deadlines
+    };
+    const Stats &get_stats() const { return stats; }
+
+private:
+    static constexpr uint8_t not_queued = 0xFF;
+    static constexpr uint32_t max_sleep_ms = 60000U; // keeps pdMS_TO_TICKS() from overflowing on long intervals
+
+    struct Timer
+    {
+        uint32_t deadline{0};
+        uint32_t interval{0}; // 0 --> one-shot
+        Callback fn{nullptr};
+        void *ctx{nullptr};
+        uint8_t heap_pos{not_queued};
+        bool active{false};
+    };
+
+    Timer timers[Capacity];
+    TimerId heap[Capacity]; // min-heap on deadline
+    uint8_t heap_size{0};
+    TaskHandle_t owner{nullptr};
+    Stats stats;
+
+    TimerId add(uint32_t delay_ms, uint32_t interval_ms, Callback fn, void *ctx)
+    {
+        for (TimerId id = 0; id < Capacity; id++)
+        {
+            if (!timers[id].active)
+            {
+                timers[id] = Timer{millis() + delay_ms, interval_ms, fn, ctx, not_queued, true};
+                push(id);
+                wake();
+                return id;
+            }
+        }
+        log_e("TimerScheduler is full (capacity: %d)", Capacity);
+        return InvalidTimer;
+    }
+
+    void run_due()
+    {
+        while (heap_size > 0 && (int32_t)(timers[heap[0]].deadline - millis()) <= 0)
+        {
+            TimerId id = heap[0];
+            remove(0);
+            Timer &t = timers[id];
+            if (t.interval == 0)
+                t.active = false; // one-shot: free the slot before the call, so the callback may re-arm
+            t.fn(t.ctx);
+            stats.callbacks++;
+            // re-arm periodic timers from the callback's end (like PeriodicTimer), unless cancelled/re-armed meanwhile
+            if (t.active && t.interval != 0 && t.heap_pos == not_queued)
+            {
+                t.deadline = millis() + t.interval;
+                push(id);
+            }
+        }
+    }
+
+    static bool earlier(const Timer &a, const Timer &b)
+    {
+        return (int32_t)(a.deadline - b.deadline) < 0;
+    }
+
+    void reschedule(TimerId id, uint32_t deadline)
+    {
+        if (timers[id].heap_pos != not_queued)
+            remove(timers[id].heap_pos);
+        timers[id].deadline = deadline;
+        push(id);
+    }
+
+    void push(TimerId id)
+    {
+        heap[heap_size] = id;
+        timers[id].heap_pos = heap_size;
+        sift_up(heap_size++);
+    }
+
+    void remove(uint8_t pos)
+    {
+        timers[heap[pos]].heap_pos = not_queued;
+        if (--heap_size == pos)
+            return;
+        TimerId moved = heap[heap_size];
+        place(pos, moved);
+        sift_up(pos);
+        sift_down(timers[moved].heap_pos);
+    }
+
+    void place(uint8_t pos, TimerId id)
+    {
+        heap[pos] = id;
+        timers[id].heap_pos = pos;
+    }
+
+    void sift_up(uint8_t pos)
+    {
+        TimerId id = heap[pos];
+        while (pos > 0)
+        {
+            uint8_t parent = (pos - 1) / 2;
+            if (!earlier(timers[id], timers[heap[parent]]))
+                break;
+            place(pos, heap[parent]);
+            pos = parent;
+        }
+        place(pos, id);
+    }
+
+    void sift_down(uint8_t pos)
+    {
+        TimerId id = heap[pos];
+        while (true)
+        {
+            uint8_t child = 2 * pos + 1;
+            if (child >= heap_size)
+                break;
+            if (child + 1 < heap_size && earlier(timers[heap[child + 1]], timers[heap[child]]))
+                child++;
+            if (!earlier(timers[heap[child]], timers[id]))
+                break;
+            place(pos, heap[child]);
+            pos = child;
+        }
+        place(pos, id);
+    }
+};
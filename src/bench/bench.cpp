@@ -0,0 +1,377 @@
+/*
+  Micro-benchmarks of the OTA hot paths (the `native_bench` & `devkit-v1-bench` environments).
+  - One JSON object per line: {"bench": name, "iterations": n, "ns_per_op": median, "min_ns_per_op": best, "bytes": per op}
+    or, for a memory figure: {"bench": name, "memory_bytes": n}
+  - Host:   pio run -e native_bench && .pio/build/native_bench/program > bench.json
+  - Target: pio run -e devkit-v1-bench -t upload && pio device monitor | tee bench.json
+  - Compare with the stored baseline (non-zero exit on a regression): python tools/bench_compare.py bench.json
+*/
+#include "../configOTASecure.h"
+#include <Preferences.h>
+#include <mbedtls/md.h>
+#include <mbedtls/pk.h>
+#include <algorithm>
+#include <memory>
+
+#include "bench_vectors.h"
+
+namespace
+{
+    constexpr const uint8_t rounds = 7;        // rounds per benchmark, the median & the best are reported
+    constexpr const uint32_t round_us = 50000; // minimum duration of a round (the iteration count is calibrated to it)
+    constexpr const size_t sha_sizes[] = {64, 1024, 4096, 65536};
+    constexpr const size_t partition_read_size = 64 * 1024;
+    constexpr const uint8_t catalog_sizes[] = {1, 8, 32}; // entries (max_catalog_size: 32)
+    constexpr const size_t ota_write_size = 128 * 1024;    // into the next OTA partition (its content is lost)
+    constexpr const size_t tcp_chunk = 1460;               // the chunks a download hands to the flash writer
+
+    constexpr const size_t dynamic_doc_capacity = 3072; // the DynamicJsonDocument of check_update() before Manifest::parse
+
+    volatile int sink; // keeps the results "used"
+
+    const char *platform_name()
+    {
+#ifdef ARDUINO_ARCH_ESP32
+        return "esp32";
+#else
+        return "native";
+#endif
+    }
+
+    // Runs `op` in rounds of >= round_us, prints one JSON line
+    template <typename Op>
+    void bench(const char *name, size_t bytes, Op op)
+    {
+        op(); // warm-up (caches, lazy allocations)
+
+        uint32_t iterations = 1;
+        while (true) // calibrate
+        {
+            uint32_t start = micros();
+            for (uint32_t i = 0; i < iterations; i++)
+                op();
+            uint32_t elapsed = micros() - start;
+            if (elapsed >= round_us || iterations >= (1U << 24))
+                break;
+            iterations = (elapsed < round_us / 16) ? iterations * 16 : iterations * 2;
+        }
+
+        double ns_per_op[rounds];
+        for (uint8_t r = 0; r < rounds; r++)
+        {
+            uint32_t start = micros();
+            for (uint32_t i = 0; i < iterations; i++)
+                op();
+            ns_per_op[r] = (micros() - start) * 1000.0 / iterations;
+        }
+        std::sort(ns_per_op, ns_per_op + rounds);
+
+        Serial.printf("{\"bench\": \"%s\", \"platform\": \"%s\", \"iterations\": %u, \"ns_per_op\": %.1f, \"min_ns_per_op\": %.1f, \"bytes\": %u}\n",
+                      name, platform_name(), (unsigned)iterations, ns_per_op[rounds / 2], ns_per_op[0], (unsigned)bytes);
+    }
+
+    void report_memory(const char *name, size_t memory_bytes)
+    {
+        Serial.printf("{\"bench\": \"%s\", \"platform\": \"%s\", \"memory_bytes\": %u}\n", name, platform_name(), (unsigned)memory_bytes);
+    }
+
+    void bench_semver()
+    {
+        bench("semver_parse", 0, []
+              {
+                  semver_t version = {};
+                  sink = semver_parse("1.12.3-rc.1+build.5", &version);
+                  semver_free(&version); });
+
+        semver_t current = {}, remote = {};
+        semver_parse("0.0.15", &current);
+        semver_parse("0.0.16-rc.1", &remote);
+        bench("semver_compare", 0, [&]
+              { sink = semver_compare(remote, current); });
+        semver_free(&current);
+        semver_free(&remote);
+    }
+
+    void bench_json()
+    {
+        const size_t len = sizeof(bench_config_json) - 1;
+        // Both parse a copy of the input, as the device does in place (uint8_t* / char* input: zero-copy strings)
+        char json[sizeof(bench_config_json)];
+
+        // before: the whole document into a heap document
+        size_t used = 0;
+        bench("json_deserialize_config", len, [&json, len, &used]
+              {
+                  memcpy(json, bench_config_json, len);
+                  DynamicJsonDocument doc(dynamic_doc_capacity);
+                  sink = (int)deserializeJson(doc, (uint8_t *)json, len).code();
+                  used = doc.memoryUsage(); });
+        report_memory("json_deserialize_config_reserved", dynamic_doc_capacity);
+        report_memory("json_deserialize_config_used", used);
+
+        // after: the known fields only, into a fixed-size document on the stack, resolved into typed fields
+        bench("manifest_parse", len, [&json, len]
+              {
+                  memcpy(json, bench_config_json, len);
+                  Manifest manifest;
+                  sink = (int)manifest.parse_json(json, len); });
+        report_memory("manifest_parse_reserved", manifest_doc_capacity);
+
+        // the same manifest in the binary format: read in place (no copy needed, no document)
+        bench("manifest_parse_tlv", sizeof(bench_config_tlv), []
+              {
+                  Manifest manifest;
+                  sink = (int)manifest.parse_tlv(bench_config_tlv, sizeof(bench_config_tlv)); });
+        report_memory("manifest_parse_tlv_reserved", 0);
+        report_memory("manifest_json_size", len);
+        report_memory("manifest_tlv_size", sizeof(bench_config_tlv));
+
+        // a manifest with the optional fields too (mirrors, notify_url, sha256 & size, activate_at, budget, poll)
+        const size_t full_len = sizeof(bench_full_manifest_json) - 1;
+        char full[sizeof(bench_full_manifest_json)];
+        bench("manifest_parse_full", full_len, [&full, full_len]
+              {
+                  memcpy(full, bench_full_manifest_json, full_len);
+                  Manifest manifest;
+                  sink = (int)manifest.parse_json(full, full_len); });
+        bench("manifest_parse_full_tlv", sizeof(bench_full_manifest_tlv), []
+              {
+                  Manifest manifest;
+                  sink = (int)manifest.parse_tlv(bench_full_manifest_tlv, sizeof(bench_full_manifest_tlv)); });
+        report_memory("manifest_full_json_size", full_len);
+        report_memory("manifest_full_tlv_size", sizeof(bench_full_manifest_tlv));
+    }
+
+    void bench_rsa()
+    {
+        bench("rsa_parse_pem_key", sizeof(bench_pub_key), []
+              {
+                  RSA_PKI rsa(bench_pub_key, sizeof(bench_pub_key));
+                  sink = rsa.is_key_valid(); });
+
+        // the same key as the KeyStore keeps it (DER): no PEM armor & base64 to decode
+        uint8_t der_buf[KeyStore::max_der_size];
+        mbedtls_pk_context pk;
+        mbedtls_pk_init(&pk);
+        mbedtls_pk_parse_public_key(&pk, bench_pub_key, sizeof(bench_pub_key));
+        int der_len = mbedtls_pk_write_pubkey_der(&pk, der_buf, sizeof(der_buf));
+        mbedtls_pk_free(&pk);
+        const uint8_t *der = der_buf + sizeof(der_buf) - der_len;
+        bench("rsa_parse_der_key", der_len, [&]
+              {
+                  RSA_PKI rsa(der, der_len);
+                  sink = rsa.is_key_valid(); });
+
+        RSA_PKI rsa(bench_pub_key, sizeof(bench_pub_key));
+        const size_t len = sizeof(bench_config_json) - 1;
+        if (!rsa.verify_signature((const uint8_t *)bench_config_json, len, bench_signature))
+        {
+            log_e("The benchmark's signature doesn't verify");
+            return;
+        }
+        bench("rsa4096_verify_config", len, [&]
+              { sink = rsa.verify_signature((const uint8_t *)bench_config_json, len, bench_signature); });
+    }
+
+    void bench_sha256()
+    {
+        std::unique_ptr<uint8_t[]> buf{new uint8_t[sha_sizes[3]]};
+        memset(buf.get(), 0xA5, sha_sizes[3]);
+
+        mbedtls_md_context_t sha;
+        mbedtls_md_init(&sha);
+        mbedtls_md_setup(&sha, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+        for (size_t size : sha_sizes)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "sha256_%u", (unsigned)size);
+            bench(name, size, [&]
+                  {
+                      uint8_t hash[32];
+                      mbedtls_md_starts(&sha);
+                      mbedtls_md_update(&sha, buf.get(), size);
+                      mbedtls_md_finish(&sha, hash);
+                      sink = hash[0]; });
+        }
+        mbedtls_md_free(&sha);
+    }
+
+    // Index lookup in catalogs of growing size (the rest of a catalog read is hashing: see sha256_*)
+    void bench_catalog()
+    {
+        std::unique_ptr<uint8_t[]> index{new uint8_t[max_catalog_size * Catalog::index_entry_size]()};
+        for (uint8_t count : catalog_sizes)
+        {
+            for (uint8_t i = 0; i < count; i++) // sorted by type, like tools/ota_catalog.py
+            {
+                uint8_t *record = index.get() + i * Catalog::index_entry_size;
+                memset(record, 0, Catalog::index_entry_size);
+                snprintf((char *)record, Catalog::type_size, "device_type_%02u", i);
+                record[Catalog::type_size] = 0; // any hardware revision
+            }
+            char type[Catalog::type_size];
+            snprintf(type, sizeof(type), "device_type_%02u", count - 1);
+            char name[32];
+            snprintf(name, sizeof(name), "catalog_find_%u", count);
+            bench(name, count * Catalog::index_entry_size, [&]
+                  {
+                      Catalog::Entry entry;
+                      sink = Catalog::find(index.get(), count, type, hardware_rev, entry); });
+        }
+    }
+
+    // CPU time of an unchanged config.img poll (after the download): verify & parse vs the digest of the last settled image
+    void bench_unchanged_poll()
+    {
+        const size_t len = sizeof(bench_config_json) - 1;
+        bench("unchanged_poll_verify_parse", len, [len]
+              {
+                  RSA_PKI rsa(bench_pub_key, sizeof(bench_pub_key));
+                  bool valid = rsa.verify_signature((const uint8_t *)bench_config_json, len, bench_signature);
+                  DynamicJsonDocument doc(dynamic_doc_capacity);
+                  sink = valid && !deserializeJson(doc, (const uint8_t *)bench_config_json, len); });
+
+        uint8_t last_digest[SHA256::digest_len] = {};
+        bench("unchanged_poll_digest", len, [&]
+              {
+                  uint8_t digest[SHA256::digest_len];
+                  SHA256::Hasher hasher;
+                  hasher.update(bench_pub_key, sizeof(bench_pub_key));
+                  hasher.update(bench_signature, sizeof(bench_signature));
+                  hasher.update((const uint8_t *)bench_config_json, len);
+                  hasher.finish(digest);
+                  sink = memcmp(digest, last_digest, sizeof(digest)); });
+    }
+
+    void bench_nvs()
+    {
+        bench("nvs_init_int", 0, []
+              {
+                  int value = 1;
+                  sink = NVS::init_int("bench", "counter", value); });
+
+        int counter = 0;
+        bench("nvs_update_get_int", 0, [&counter]
+              {
+                  NVS::update_int("bench", "counter", ++counter);
+                  int value = 0;
+                  NVS::get_int("bench", "counter", value);
+                  sink = value; });
+
+        bench("nvs_init_string", 0, []
+              {
+                  char url[max_url_size] = "http://10.130.0.141/m5stack/firmware.img";
+                  sink = NVS::init_string("bench", "url", url, sizeof(url)); });
+
+        // the boot's read of a namespace (Config_Params): a lookup & an open per key vs NVS::load()'s single pass
+        char version[max_version_size] = "0.0.1", url[max_url_size] = "http://10.130.0.141/config.img";
+        char mirrors[Mirrors::max_mirror_list_size] = "", notify_url[max_url_size] = "";
+        bench("nvs_boot_4_keys_per_key", 0, [&]
+              {
+                  sink = NVS::init_string("bench", "version", version, sizeof(version)) +
+                         NVS::init_string("bench", "url", url, sizeof(url)) +
+                         NVS::init_string("bench", "mirrors", mirrors, sizeof(mirrors)) +
+                         NVS::init_string("bench", "notify_url", notify_url, sizeof(notify_url)); });
+        bench("nvs_boot_4_keys_load", 0, [&]
+              {
+                  NVS::Field fields[]{
+                      {"version", version, sizeof(version)},
+                      {"url", url, sizeof(url)},
+                      {"mirrors", mirrors, sizeof(mirrors)},
+                      {"notify_url", notify_url, sizeof(notify_url)},
+                  };
+                  sink = NVS::load("bench", fields); });
+    }
+
+    // Reads of the running app partition in SPI_FLASH_SEC_SIZE chunks, as the firmware verification does
+    void bench_partition_read()
+    {
+        const esp_partition_t *partition = esp_ota_get_running_partition();
+        std::unique_ptr<uint8_t[]> buf{new uint8_t[SPI_FLASH_SEC_SIZE]};
+        bench("partition_read_64k", partition_read_size, [&]
+              {
+                  for (uint32_t offset = 0; offset < partition_read_size; offset += SPI_FLASH_SEC_SIZE)
+                      ESP.partitionRead(partition, offset, (uint32_t *)buf.get(), SPI_FLASH_SEC_SIZE);
+                  sink = buf[0]; });
+    }
+
+    // An app image of `len` bytes: the magic byte, then pseudo-random bytes of `seed`
+    std::unique_ptr<uint8_t[]> make_image(const size_t len, uint32_t seed)
+    {
+        std::unique_ptr<uint8_t[]> image{new uint8_t[len]};
+        for (size_t i = 0; i < len; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            image[i] = seed >> 16;
+        }
+        image[0] = 0xE9;
+        return image;
+    }
+
+    // Writes of a firmware image into the next OTA partition, in download-sized chunks (bytes / ns_per_op: the
+    // effective write bandwidth): the Update path (every sector erased when reached, then programmed) vs OTA_Writer
+    // on the same image (every sector skipped) & on a new image (erase-ahead by 64KB blocks after 2 changed sectors)
+    void bench_ota_write()
+    {
+        std::unique_ptr<uint8_t[]> images[]{make_image(ota_write_size, 1), make_image(ota_write_size, 2)};
+        bench("ota_write_update_128k", ota_write_size, [&]
+              {
+                  Update.begin(ota_write_size);
+                  for (size_t pos = 0; pos < ota_write_size; pos += tcp_chunk)
+                      Update.write(images[0].get() + pos, min(tcp_chunk, ota_write_size - pos));
+                  sink = Update.progress();
+                  Update.abort(); });
+
+        OTA_Writer writer;
+        auto write_image = [&writer](const uint8_t *image)
+        {
+            writer.begin(ota_write_size);
+            for (size_t pos = 0; pos < ota_write_size; pos += tcp_chunk)
+                writer.write(image + pos, min(tcp_chunk, ota_write_size - pos));
+            sink = writer.finish();
+        };
+        bench("ota_write_writer_same_128k", ota_write_size, [&]
+              { write_image(images[0].get()); });
+        uint8_t next = 0;
+        bench("ota_write_writer_new_128k", ota_write_size, [&]
+              { write_image(images[next ^= 1].get()); });
+    }
+
+    void run_all()
+    {
+        nvs_flash_init();
+        bench_semver();
+        bench_json();
+        bench_sha256();
+        bench_rsa();
+        bench_catalog();
+        bench_unchanged_poll();
+        bench_nvs();
+        bench_partition_read();
+        bench_ota_write();
+        Preferences prefs;
+        prefs.begin("bench");
+        prefs.clear();
+        prefs.end();
+    }
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+void setup()
+{
+    Serial.begin(115200);
+    delay(2000); // let the monitor attach
+    run_all();
+}
+
+void loop()
+{
+    delay(1000);
+}
+#else
+int main()
+{
+    run_all();
+    return 0;
+}
+#endif
@@ -0,0 +1,175 @@
+#pragma once
+// Fixed inputs of the benchmarks (throw-away RSA-4096 test key): a config.json-sized document signed with the
+// matching private key (openssl dgst -sha256 -sign), as for config.img.
+#include <stdint.h>
+
+static const char bench_config_json[] = R"~~~({
+    "type": "ch4_generator",
+    "config": {
+      "version": "0.0.15",
+      "url_change?": true,
+      "url": "https://raw.githubusercontent.com/LeTuanAnhEP0818E/OTA_ESP32/Blink.ino.bin",
+      "public_key_change?": false,
+      "public_key_url": "http://10.130.0.154/config_key.pub"
+    },
+    "device": {
+      "ch4_factor": 25.5,
+      "power_factor": 12.25,
+      "checking_interval": 15
+    },
+    "firmware": {
+      "version": "0.0.5",
+      "url": "http://10.130.0.141/m5stack/firmware.img",
+      "public_key_change?": false,
+      "public_key_url": "http://10.130.0.141/m5stack/firmware_key.pub"
+    }
+  })~~~";
+
+// bench_config_json as a binary manifest (python3 tools/manifest_tlv.py --c-array)
+static const uint8_t bench_config_tlv[] = {
+    0x4f, 0x54, 0x4d, 0x01, 0x01, 0x0e, 0x00, 0x63, 0x68, 0x34, 0x5f, 0x67, 0x65, 0x6e, 0x65, 0x72,
+    0x61, 0x74, 0x6f, 0x72, 0x00, 0x10, 0x07, 0x00, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x35, 0x00, 0x11,
+    0x4b, 0x00, 0x68, 0x74, 0x74, 0x70, 0x73, 0x3a, 0x2f, 0x2f, 0x72, 0x61, 0x77, 0x2e, 0x67, 0x69,
+    0x74, 0x68, 0x75, 0x62, 0x75, 0x73, 0x65, 0x72, 0x63, 0x6f, 0x6e, 0x74, 0x65, 0x6e, 0x74, 0x2e,
+    0x63, 0x6f, 0x6d, 0x2f, 0x4c, 0x65, 0x54, 0x75, 0x61, 0x6e, 0x41, 0x6e, 0x68, 0x45, 0x50, 0x30,
+    0x38, 0x31, 0x38, 0x45, 0x2f, 0x4f, 0x54, 0x41, 0x5f, 0x45, 0x53, 0x50, 0x33, 0x32, 0x2f, 0x42,
+    0x6c, 0x69, 0x6e, 0x6b, 0x2e, 0x69, 0x6e, 0x6f, 0x2e, 0x62, 0x69, 0x6e, 0x00, 0x12, 0x01, 0x00,
+    0x01, 0x13, 0x01, 0x00, 0x00, 0x14, 0x23, 0x00, 0x68, 0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f, 0x31,
+    0x30, 0x2e, 0x31, 0x33, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x35, 0x34, 0x2f, 0x63, 0x6f, 0x6e, 0x66,
+    0x69, 0x67, 0x5f, 0x6b, 0x65, 0x79, 0x2e, 0x70, 0x75, 0x62, 0x00, 0x20, 0x06, 0x00, 0x30, 0x2e,
+    0x30, 0x2e, 0x35, 0x00, 0x21, 0x29, 0x00, 0x68, 0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f, 0x31, 0x30,
+    0x2e, 0x31, 0x33, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x34, 0x31, 0x2f, 0x6d, 0x35, 0x73, 0x74, 0x61,
+    0x63, 0x6b, 0x2f, 0x66, 0x69, 0x72, 0x6d, 0x77, 0x61, 0x72, 0x65, 0x2e, 0x69, 0x6d, 0x67, 0x00,
+    0x23, 0x01, 0x00, 0x00, 0x24, 0x2d, 0x00, 0x68, 0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f, 0x31, 0x30,
+    0x2e, 0x31, 0x33, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x34, 0x31, 0x2f, 0x6d, 0x35, 0x73, 0x74, 0x61,
+    0x63, 0x6b, 0x2f, 0x66, 0x69, 0x72, 0x6d, 0x77, 0x61, 0x72, 0x65, 0x5f, 0x6b, 0x65, 0x79, 0x2e,
+    0x70, 0x75, 0x62, 0x00, 0x30, 0x04, 0x00, 0x00, 0x00, 0xcc, 0x41, 0x31, 0x04, 0x00, 0x00, 0x00,
+    0x44, 0x41, 0x32, 0x04, 0x00, 0x0f, 0x00, 0x00, 0x00};
+
+// A manifest with the optional fields of the later releases (mirrors, notify_url, sha256 & size, a scheduled activation,
+// a download budget, a poll hint): parsed only, not signed
+static const char bench_full_manifest_json[] = R"~~~({
+    "type": "ch4_generator",
+    "poll": {"interval": 60, "ttl": 7200},
+    "config": {
+      "version": "0.0.16",
+      "url": "http://10.130.0.141/config.img",
+      "url_change?": false,
+      "public_key_change?": false,
+      "public_key_url": "",
+      "notify_url": "http://10.130.0.141:8081/notify",
+      "mirrors": ["http://10.130.0.142/config.img", "http://cache.example.com/ota/config.img"]
+    },
+    "device": {
+      "ch4_factor": 25.5,
+      "power_factor": 12.25,
+      "checking_interval": 15
+    },
+    "firmware": {
+      "version": "0.0.6",
+      "url": "http://10.130.0.141/fw/5f2b8a4d0c7e1f3a9b6d2c4e8f0a1b3c5d7e9f1a2b4c6d8e0f1a3b5c7d9e1f2a.img",
+      "public_key_change?": false,
+      "public_key_url": "",
+      "sha256": "9c1185a5c5e9fc54612808977ee8f548b2258d31c5a3e3f8a8b8c27c0b1d6f10",
+      "size": 912384,
+      "activate_at": 1767225600,
+      "stage_window": 3600,
+      "budget": {"rate": 64, "slice": 10, "pause": 40},
+      "mirrors": [
+        "http://10.130.0.142/fw/5f2b8a4d0c7e1f3a9b6d2c4e8f0a1b3c5d7e9f1a2b4c6d8e0f1a3b5c7d9e1f2a.img",
+        "http://cache.example.com/ota/fw/5f2b8a4d0c7e1f3a9b6d2c4e8f0a1b3c5d7e9f1a2b4c6d8e0f1a3b5c7d9e1f2a.img"
+      ]
+    }
+  })~~~";
+
+// bench_full_manifest_json as a binary manifest (python3 tools/manifest_tlv.py --c-array)
+static const uint8_t bench_full_manifest_tlv[] = {
+    0x4f, 0x54, 0x4d, 0x01, 0x01, 0x0e, 0x00, 0x63, 0x68, 0x34, 0x5f, 0x67, 0x65, 0x6e, 0x65, 0x72,
+    0x61, 0x74, 0x6f, 0x72, 0x00, 0x10, 0x07, 0x00, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x36, 0x00, 0x11,
+    0x1f, 0x00, 0x68, 0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f, 0x31, 0x30, 0x2e, 0x31, 0x33, 0x30, 0x2e,
+    0x30, 0x2e, 0x31, 0x34, 0x31, 0x2f, 0x63, 0x6f, 0x6e, 0x66, 0x69, 0x67, 0x2e, 0x69, 0x6d, 0x67,
+    0x00, 0x12, 0x01, 0x00, 0x00, 0x13, 0x01, 0x00, 0x00, 0x14, 0x01, 0x00, 0x00, 0x17, 0x1f, 0x00,
+    0x68, 0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f, 0x31, 0x30, 0x2e, 0x31, 0x33, 0x30, 0x2e, 0x30, 0x2e,
+    0x31, 0x34, 0x32, 0x2f, 0x63, 0x6f, 0x6e, 0x66, 0x69, 0x67, 0x2e, 0x69, 0x6d, 0x67, 0x00, 0x17,
+    0x28, 0x00, 0x68, 0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f, 0x63, 0x61, 0x63, 0x68, 0x65, 0x2e, 0x65,
+    0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d, 0x2f, 0x6f, 0x74, 0x61, 0x2f, 0x63,
+    0x6f, 0x6e, 0x66, 0x69, 0x67, 0x2e, 0x69, 0x6d, 0x67, 0x00, 0x18, 0x20, 0x00, 0x68, 0x74, 0x74,
+    0x70, 0x3a, 0x2f, 0x2f, 0x31, 0x30, 0x2e, 0x31, 0x33, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x34, 0x31,
+    0x3a, 0x38, 0x30, 0x38, 0x31, 0x2f, 0x6e, 0x6f, 0x74, 0x69, 0x66, 0x79, 0x00, 0x20, 0x06, 0x00,
+    0x30, 0x2e, 0x30, 0x2e, 0x36, 0x00, 0x21, 0x5c, 0x00, 0x68, 0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f,
+    0x31, 0x30, 0x2e, 0x31, 0x33, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x34, 0x31, 0x2f, 0x66, 0x77, 0x2f,
+    0x35, 0x66, 0x32, 0x62, 0x38, 0x61, 0x34, 0x64, 0x30, 0x63, 0x37, 0x65, 0x31, 0x66, 0x33, 0x61,
+    0x39, 0x62, 0x36, 0x64, 0x32, 0x63, 0x34, 0x65, 0x38, 0x66, 0x30, 0x61, 0x31, 0x62, 0x33, 0x63,
+    0x35, 0x64, 0x37, 0x65, 0x39, 0x66, 0x31, 0x61, 0x32, 0x62, 0x34, 0x63, 0x36, 0x64, 0x38, 0x65,
+    0x30, 0x66, 0x31, 0x61, 0x33, 0x62, 0x35, 0x63, 0x37, 0x64, 0x39, 0x65, 0x31, 0x66, 0x32, 0x61,
+    0x2e, 0x69, 0x6d, 0x67, 0x00, 0x23, 0x01, 0x00, 0x00, 0x24, 0x01, 0x00, 0x00, 0x27, 0x5c, 0x00,
+    0x68, 0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f, 0x31, 0x30, 0x2e, 0x31, 0x33, 0x30, 0x2e, 0x30, 0x2e,
+    0x31, 0x34, 0x32, 0x2f, 0x66, 0x77, 0x2f, 0x35, 0x66, 0x32, 0x62, 0x38, 0x61, 0x34, 0x64, 0x30,
+    0x63, 0x37, 0x65, 0x31, 0x66, 0x33, 0x61, 0x39, 0x62, 0x36, 0x64, 0x32, 0x63, 0x34, 0x65, 0x38,
+    0x66, 0x30, 0x61, 0x31, 0x62, 0x33, 0x63, 0x35, 0x64, 0x37, 0x65, 0x39, 0x66, 0x31, 0x61, 0x32,
+    0x62, 0x34, 0x63, 0x36, 0x64, 0x38, 0x65, 0x30, 0x66, 0x31, 0x61, 0x33, 0x62, 0x35, 0x63, 0x37,
+    0x64, 0x39, 0x65, 0x31, 0x66, 0x32, 0x61, 0x2e, 0x69, 0x6d, 0x67, 0x00, 0x27, 0x65, 0x00, 0x68,
+    0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f, 0x63, 0x61, 0x63, 0x68, 0x65, 0x2e, 0x65, 0x78, 0x61, 0x6d,
+    0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d, 0x2f, 0x6f, 0x74, 0x61, 0x2f, 0x66, 0x77, 0x2f, 0x35,
+    0x66, 0x32, 0x62, 0x38, 0x61, 0x34, 0x64, 0x30, 0x63, 0x37, 0x65, 0x31, 0x66, 0x33, 0x61, 0x39,
+    0x62, 0x36, 0x64, 0x32, 0x63, 0x34, 0x65, 0x38, 0x66, 0x30, 0x61, 0x31, 0x62, 0x33, 0x63, 0x35,
+    0x64, 0x37, 0x65, 0x39, 0x66, 0x31, 0x61, 0x32, 0x62, 0x34, 0x63, 0x36, 0x64, 0x38, 0x65, 0x30,
+    0x66, 0x31, 0x61, 0x33, 0x62, 0x35, 0x63, 0x37, 0x64, 0x39, 0x65, 0x31, 0x66, 0x32, 0x61, 0x2e,
+    0x69, 0x6d, 0x67, 0x00, 0x29, 0x20, 0x00, 0x9c, 0x11, 0x85, 0xa5, 0xc5, 0xe9, 0xfc, 0x54, 0x61,
+    0x28, 0x08, 0x97, 0x7e, 0xe8, 0xf5, 0x48, 0xb2, 0x25, 0x8d, 0x31, 0xc5, 0xa3, 0xe3, 0xf8, 0xa8,
+    0xb8, 0xc2, 0x7c, 0x0b, 0x1d, 0x6f, 0x10, 0x2a, 0x04, 0x00, 0x00, 0xec, 0x0d, 0x00, 0x30, 0x04,
+    0x00, 0x00, 0x00, 0xcc, 0x41, 0x31, 0x04, 0x00, 0x00, 0x00, 0x44, 0x41, 0x32, 0x04, 0x00, 0x0f,
+    0x00, 0x00, 0x00, 0x50, 0x04, 0x00, 0x40, 0x00, 0x00, 0x00, 0x51, 0x02, 0x00, 0x0a, 0x00, 0x52,
+    0x02, 0x00, 0x28, 0x00, 0x60, 0x04, 0x00, 0x00, 0xb9, 0x55, 0x69, 0x61, 0x04, 0x00, 0x10, 0x0e,
+    0x00, 0x00, 0x70, 0x04, 0x00, 0x3c, 0x00, 0x00, 0x00, 0x71, 0x04, 0x00, 0x20, 0x1c, 0x00, 0x00};
+
+static const unsigned char bench_pub_key[] = R"~~~(-----BEGIN PUBLIC KEY-----
+MIICIjANBgkqhkiG9w0BAQEFAAOCAg8AMIICCgKCAgEA58hpOIa2dVqsXZCiwj3L
+mDj8oJc4IE5gBeAmBsUSJo2Zia8sXuOZKqTc9MuM7hTvsCXWTkLyNore5gI80o3p
+rexyLb/5YQgKt1gOoRtQ/XQO8jglbzlNiLzNnPkbFA2GyECXBSLR50N+dFhRl9Id
+8ep1bBloG565OSfPg1ZjJm5m9p6XIDCQlb3hYUwOmTnfLo7lHVjkp5r7xCz8W8UF
+n5IibZfC0qiy/UjHiYBq0lwynvJ243FeQtwKrApIu5XZqqI2dPSu/peGfKq5W8Ys
+5dfAAZY838XOMw0+VuLl18MKsZQ6UCsYw3csqnLIIaonhhIzk0ktrtyw/P8FTYIx
+PQdMinXxFLU0a3LRJtmaELaXn/8OnmLFqLr0lhtvEsrcgo524QMZXmi9WmlYieSL
+ktSCwEM/GckB4Z5WStbRhbI2D9uMzwffkL9+4MXsrGb3hlqTHv0+3xCZlSJ8H8s4
+Prw0Am6hmxS8YJspOlKZDoexEgTJ8DRSrCOt+Pii+84LdTxFqzQPDXjgeaDCKD+9
+njeUWCyYolcm/NQIjfXed2A62y2Ag3MBo1CK+Xm4fwGq03T3JGqe/9/BTWxY8k4F
+LKqR60npI0sSn8PEML9ufSUQ/WQ16YCMczK21e/0+JruyWM3B+fI3W+2dZ8BGYNe
+YCv6Wi4pvXK6BLqNkuqrslECAwEAAQ==
+-----END PUBLIC KEY-----
+)~~~";
+
+static const uint8_t bench_signature[512] = {
+    0xb3, 0x53, 0x89, 0x4a, 0xcd, 0x0a, 0x1d, 0xbf, 0x4b, 0x12, 0xeb, 0x5b, 0x04, 0xc1, 0x48, 0xe6,
+    0xe4, 0xed, 0x75, 0x52, 0x23, 0xa4, 0x80, 0x35, 0xa4, 0xbb, 0xf4, 0xd5, 0x26, 0x3e, 0xf5, 0x3a,
+    0xd8, 0xb3, 0xcd, 0xa4, 0xa8, 0xcd, 0xd2, 0x8e, 0xfe, 0x42, 0x04, 0x22, 0x85, 0x84, 0x80, 0x55,
+    0xa5, 0x47, 0x2e, 0x27, 0x87, 0x29, 0xb9, 0x20, 0x98, 0xb4, 0x35, 0x93, 0xb9, 0xcd, 0xac, 0x31,
+    0xa1, 0x54, 0xf0, 0x1b, 0x31, 0x49, 0x57, 0xa6, 0xc9, 0x64, 0xdd, 0x26, 0x4c, 0x4f, 0x9a, 0xdf,
+    0x3e, 0x91, 0xb9, 0xe0, 0xba, 0xb0, 0x48, 0x94, 0xed, 0xd1, 0xe9, 0x25, 0x0c, 0x2d, 0xca, 0xc4,
+    0x7b, 0xd2, 0x21, 0xf9, 0x19, 0xb0, 0x8f, 0x39, 0x65, 0x8b, 0x17, 0xd2, 0x1f, 0xd6, 0xb9, 0xef,
+    0xbf, 0x76, 0xa0, 0xed, 0x02, 0xf8, 0xb7, 0x93, 0xbb, 0x2b, 0x94, 0x79, 0xab, 0x21, 0x91, 0x01,
+    0xee, 0x39, 0x38, 0x2e, 0xdb, 0x3a, 0xb6, 0x2e, 0x46, 0xa4, 0x2d, 0x02, 0x7e, 0xc2, 0xec, 0x9f,
+    0xe4, 0x77, 0x64, 0xe0, 0xdd, 0x64, 0xe7, 0x1b, 0x6c, 0x1c, 0xd2, 0xe5, 0xbd, 0x6b, 0xce, 0x72,
+    0x9d, 0xcb, 0xd4, 0x80, 0x28, 0x4c, 0x07, 0x20, 0x7d, 0xfb, 0xf1, 0x7b, 0xb7, 0xf2, 0xb5, 0xb9,
+    0x6b, 0x99, 0xe7, 0x69, 0xb5, 0xab, 0x37, 0xbc, 0x74, 0x6d, 0xd0, 0x6f, 0x0d, 0x77, 0x07, 0xf4,
+    0xa6, 0x12, 0x5b, 0x3d, 0x01, 0x75, 0x7e, 0x03, 0x3b, 0x4a, 0xf5, 0x0c, 0xad, 0xe4, 0xc2, 0x2c,
+    0x6c, 0x96, 0x5b, 0xde, 0x04, 0x69, 0x37, 0x74, 0x58, 0x21, 0xfb, 0xc7, 0x28, 0xb9, 0xdd, 0x34,
+    0x7d, 0x11, 0xb1, 0xfe, 0x47, 0x3b, 0xba, 0xbf, 0xa3, 0xf8, 0xc5, 0x74, 0xa6, 0xf6, 0xba, 0x52,
+    0xf5, 0xbc, 0x64, 0x35, 0x05, 0x3f, 0x6c, 0x74, 0x3d, 0x60, 0xe6, 0x37, 0x09, 0xe1, 0xf3, 0x34,
+    0x3d, 0x13, 0x41, 0xd0, 0x7d, 0x72, 0xb6, 0xc7, 0x9e, 0x0f, 0x25, 0xa6, 0x75, 0x02, 0x57, 0x43,
+    0xf9, 0x98, 0xca, 0x10, 0x7e, 0x0c, 0x71, 0x16, 0x91, 0x26, 0xec, 0xfa, 0x92, 0x77, 0xf5, 0x77,
+    0xf2, 0x6b, 0xc0, 0x62, 0x60, 0xd9, 0xb1, 0xad, 0x90, 0x5f, 0x16, 0xff, 0xb9, 0x12, 0xff, 0xc5,
+    0xe3, 0xec, 0x1c, 0x72, 0x90, 0x73, 0xfd, 0x04, 0x38, 0x6b, 0xa3, 0xb8, 0x59, 0xfc, 0xeb, 0x24,
+    0x3b, 0x7d, 0x91, 0x0b, 0x33, 0x66, 0x8e, 0x3d, 0x6b, 0xb0, 0xae, 0x42, 0x71, 0x8e, 0x2e, 0xe3,
+    0x34, 0xc2, 0xae, 0x1f, 0x64, 0x47, 0x8a, 0x09, 0xeb, 0xe1, 0x5a, 0xab, 0x43, 0x28, 0x8c, 0x29,
+    0x78, 0xe1, 0xd3, 0x1a, 0x10, 0xf3, 0x98, 0xeb, 0x21, 0xa9, 0xdf, 0x12, 0x8c, 0x1b, 0x67, 0x21,
+    0xc1, 0xaa, 0xf1, 0x5e, 0xb2, 0xb2, 0xae, 0x20, 0x5a, 0x7b, 0x1b, 0xf7, 0x73, 0xef, 0xc3, 0x01,
+    0x0d, 0xca, 0xdf, 0x7b, 0x1a, 0xcd, 0xfa, 0x99, 0xdf, 0x7c, 0x24, 0xa7, 0x05, 0xfd, 0xef, 0x18,
+    0x66, 0x02, 0x5c, 0xa5, 0xc4, 0xae, 0x48, 0xe6, 0xd7, 0x10, 0xae, 0xd6, 0xbc, 0x99, 0xa8, 0x62,
+    0xe6, 0xe1, 0x48, 0x50, 0x37, 0x7a, 0xbd, 0x2b, 0x1b, 0xdc, 0x40, 0x51, 0x02, 0x71, 0x0f, 0x22,
+    0x4a, 0xc4, 0x9e, 0x8c, 0x61, 0xe6, 0x2c, 0xc8, 0x45, 0x1e, 0x1c, 0xab, 0x3e, 0x9b, 0x63, 0x15,
+    0x72, 0xbe, 0x9d, 0x23, 0xa8, 0x89, 0x5d, 0x79, 0xfa, 0x77, 0xec, 0x04, 0xd2, 0x58, 0x15, 0x71,
+    0x6c, 0x13, 0xa7, 0x97, 0x0c, 0xdf, 0xc4, 0xe9, 0x08, 0x79, 0x9d, 0x9c, 0x0e, 0x28, 0x7d, 0xf1,
+    0xea, 0xfe, 0xe7, 0x07, 0x71, 0x9d, 0x32, 0x3f, 0x69, 0x01, 0xbe, 0x36, 0xcf, 0xb8, 0xe9, 0x98,
+    0x89, 0x83, 0x91, 0x19, 0x17, 0x88, 0x29, 0x07, 0x3a, 0xe3, 0xfc, 0x8d, 0xa9, 0x9f, 0x42, 0x27,
+};
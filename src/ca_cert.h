@@ -0,0 +1,7 @@
+#pragma once
+// The CAs pinned for the HTTPS OTA URLs (HTTP::client(), see utils/http_utilities.h): the server certificate must chain
+// to one of them, there is no unauthenticated HTTPS. Default: the roots of raw.githubusercontent.com's certificates
+// (DigiCert Global Root G2, DigiCert Global Root CA, USERTrust RSA).
+// Own server: paste its CA (PEM) in ca_cert.cpp instead, e.g. the last certificate of
+// `openssl s_client -showcerts -connect host:443`. The plain http URLs (a LAN update server) don't use it.
+extern const char https_ca_cert[];
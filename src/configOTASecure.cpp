@@ -1,23 +1,474 @@
 #include "configOTASecure.h"
+#include <memory>
 
-bool Config::is_signature_valid(const uint8_t *pub_key, const size_t pk_len, const uint8_t *content, const size_t contentLen, const uint8_t *signature)
+namespace
 {
-    RSA_PKI rsa(pub_key, pk_len);
-    return rsa.verify_signature(content, contentLen, signature);
+    // The last settled config.img: its digest (with the config public key) & its verdict (a ConfigErr, -1: none).
+    // In RTC memory: kept through deep sleep, reset by a (re)boot.
+    RTC_DATA_ATTR uint8_t last_img_digest[SHA256::digest_len];
+    RTC_DATA_ATTR int8_t last_img_verdict = -1;
+    // Its firmware waits for this device's stage slot (Unix time), 0: none. Then the same image is applied again,
+    // without a new verify (the digest is the one verified)
+    RTC_DATA_ATTR uint32_t last_img_stage_at = 0;
+
+    // The verdict on a config.img only depends on the image & the key checking it (its ID: a hash of the key)
+    void img_digest(const Config_Params &configParams, const uint8_t *signature, const uint8_t *signed_digest, uint8_t *digest)
+    {
+        SHA256::Hasher hasher;
+        hasher.update((const uint8_t *)configParams.key.id(), strlen(configParams.key.id()));
+        hasher.update(signature, SIGN_LEN);
+        hasher.update(signed_digest, SHA256::digest_len);
+        hasher.finish(digest);
+    }
+
+    // Unix time, 0 if the clock isn't set (yet)
+    uint32_t clock_s()
+    {
+        time_t now = time(nullptr);
+        return (now >= (time_t)min_clock_s) ? (uint32_t)now : 0;
+    }
+
+    // This device's offset (seconds) in a staging window: spread over the fleet, a new order for each version
+    uint32_t stage_slot(const char *version, const uint32_t window_s)
+    {
+        uint64_t mac = ESP.getEfuseMac();
+        uint32_t hash = 2166136261U; // FNV-1a
+        for (uint8_t i = 0; i < 6; i++)
+            hash = (hash ^ (uint8_t)(mac >> (8 * i))) * 16777619U;
+        for (const char *c = version; *c; c++)
+            hash = (hash ^ (uint8_t)*c) * 16777619U;
+        return (window_s > 0) ? hash % window_s : 0;
+    }
+
+    // SHA-256 of the first `len` bytes of a partition
+    bool partition_digest(const esp_partition_t *partition, const int len, uint8_t *digest)
+    {
+        std::unique_ptr<uint8_t[]> buffer{new uint8_t[SPI_FLASH_SEC_SIZE]};
+        SHA256::Hasher hasher;
+        for (int offset = 0; offset < len; offset += SPI_FLASH_SEC_SIZE)
+        {
+            int n = min(len - offset, (int)SPI_FLASH_SEC_SIZE);
+            if (!ESP.partitionRead(partition, offset, (uint32_t *)buffer.get(), n))
+                return false;
+            hasher.update(buffer.get(), n);
+        }
+        hasher.finish(digest);
+        return true;
+    }
+}
+
+namespace
+{
+    // Only the fields of Manifest are kept by the parser (the other members of config.json are skipped)
+    const JsonDocument &manifest_filter()
+    {
+        static StaticJsonDocument<manifest_filter_capacity> filter;
+        if (filter.isNull())
+        {
+            filter["type"] = true;
+            filter["base"] = true;
+            filter["poll"] = true;
+            for (const char *section : {"config", "firmware"})
+            {
+                JsonObject obj = filter.createNestedObject(section);
+                obj["version"] = true;
+                obj["url"] = true;
+                obj["url_change?"] = true;
+                obj["public_key_change?"] = true;
+                obj["public_key_url"] = true;
+                obj["public_key"] = true;
+                obj["mirrors"] = true;
+            }
+            filter["config"]["notify_url"] = true;
+            filter["firmware"]["multicast"] = true;
+            filter["firmware"]["budget"] = true;
+            filter["firmware"]["activate_at"] = true;
+            filter["firmware"]["stage_window"] = true;
+            filter["firmware"]["sha256"] = true;
+            filter["firmware"]["size"] = true;
+            JsonObject device = filter.createNestedObject("device");
+            device["ch4_factor"] = true;
+            device["power_factor"] = true;
+            device["checking_interval"] = true;
+        }
+        return filter;
+    }
+
+    // Past the end of the JSON string starting at json[i] (its opening quote)
+    size_t skip_string(const char *json, const size_t len, size_t i)
+    {
+        for (i++; i < len && json[i] != '"'; i++)
+        {
+            if (json[i] == '\\')
+                i++;
+        }
+        return i + 1;
+    }
+
+    // Blank out (in place, with spaces) the elements of the "mirrors" arrays after the first Mirrors::max_mirrors: the
+    // document has room for that many (more would fail the whole parse with NoMemory), the device uses no more
+    void truncate_mirrors(char *json, const size_t len)
+    {
+        constexpr const char key[] = "\"mirrors\"";
+        size_t i = 0;
+        while (i < len)
+        {
+            if (json[i] != '"')
+            {
+                i++;
+                continue;
+            }
+            size_t start = i;
+            i = skip_string(json, len, i);
+            if (i - start != sizeof(key) - 1 || strncmp(json + start, key, sizeof(key) - 1) != 0)
+                continue;
+            while (i < len && isspace((unsigned char)json[i]))
+                i++;
+            if (i >= len || json[i] != ':')
+                continue;
+            for (i++; i < len && isspace((unsigned char)json[i]); i++)
+                ;
+            if (i >= len || json[i] != '[')
+                continue;
+
+            int depth = 0;
+            uint8_t commas = 0;
+            size_t cut = 0; // the comma before the first element dropped
+            while (i < len)
+            {
+                char c = json[i];
+                if (c == '"')
+                {
+                    i = skip_string(json, len, i);
+                    continue;
+                }
+                if (c == '[' || c == '{')
+                    depth++;
+                else if ((c == ']' || c == '}') && --depth == 0)
+                    break;
+                else if (c == ',' && depth == 1 && ++commas == Mirrors::max_mirrors)
+                    cut = i;
+                i++;
+            }
+            if (cut > 0 && i < len)
+                memset(json + cut, ' ', i - cut);
+        }
+    }
+
+    // Return false if a field is malformed
+    bool read_section(const JsonObject &obj, Manifest::Section &section)
+    {
+        section.version = obj["version"];
+        section.url = obj["url"];
+        section.url_change = obj["url_change?"] | false;
+        section.public_key_change = obj["public_key_change?"] | false;
+        section.public_key_url = obj["public_key_url"];
+        section.notify_url = obj["notify_url"];
+        section.notify_url_set = obj.containsKey("notify_url");
+        section.mirrors_set = obj.containsKey("mirrors");
+        section.key_id = obj["public_key"]["id"];
+        section.key_der = obj["public_key"]["der"];
+        for (JsonVariant mirror : obj["mirrors"].as<JsonArray>())
+        {
+            const char *mirror_url = mirror;
+            if (mirror_url != nullptr && section.mirror_count < Mirrors::max_mirrors)
+                section.mirrors[section.mirror_count++] = mirror_url;
+        }
+        section.size = obj["size"] | 0;
+        const char *sha256 = obj["sha256"];
+        section.has_sha256 = sha256 != nullptr;
+        return sha256 == nullptr || SHA256::from_hex(sha256, strlen(sha256), section.sha256);
+    }
+
+    // The tags of the binary manifest (tools/manifest_tlv.py): records of tag (1 byte), length (2 bytes LE), value.
+    // Strings are null-terminated inside their value, numbers little-endian, unknown tags skipped.
+    enum TLV_Tag : uint8_t
+    {
+        TAG_TYPE = 0x01,
+        TAG_BASE = 0x02,
+        TAG_CONFIG = 0x10,   // + Section_Field
+        TAG_FIRMWARE = 0x20, // + Section_Field
+        TAG_CH4_FACTOR = 0x30,
+        TAG_POWER_FACTOR = 0x31,
+        TAG_CHECKING_INTERVAL = 0x32,
+        TAG_MULTICAST = 0x40,
+        TAG_MULTICAST_GROUP = 0x41,
+        TAG_MULTICAST_PORT = 0x42,
+        TAG_MULTICAST_TIMEOUT = 0x43,
+        TAG_BUDGET_RATE = 0x50,
+        TAG_BUDGET_SLICE = 0x51,
+        TAG_BUDGET_PAUSE = 0x52,
+        TAG_ACTIVATE_AT = 0x60,
+        TAG_STAGE_WINDOW = 0x61,
+        TAG_POLL_INTERVAL = 0x70,
+        TAG_POLL_TTL = 0x71,
+    };
+    enum Section_Field : uint8_t
+    {
+        FIELD_VERSION = 0,
+        FIELD_URL,
+        FIELD_URL_CHANGE,
+        FIELD_PUBLIC_KEY_CHANGE,
+        FIELD_PUBLIC_KEY_URL,
+        FIELD_KEY_ID,
+        FIELD_KEY_DER,
+        FIELD_MIRROR, // repeated: one record per mirror
+        FIELD_NOTIFY_URL,
+        FIELD_SHA256, // raw
+        FIELD_SIZE,
+    };
+
+    // A string value must hold its null-terminator
+    const char *tlv_string(const uint8_t *value, const uint16_t len)
+    {
+        return (len > 0 && value[len - 1] == '\0') ? (const char *)value : nullptr;
+    }
+
+    template <typename T>
+    T tlv_number(const uint8_t *value, const uint16_t len, T fallback)
+    {
+        if (len != sizeof(T))
+        {
+            return fallback;
+        }
+        T number;
+        memcpy(&number, value, sizeof(T)); // unaligned, little-endian like the ESP32
+        return number;
+    }
+
+    bool read_field(Manifest::Section &section, const uint8_t field, const uint8_t *value, const uint16_t len)
+    {
+        switch (field)
+        {
+        case FIELD_VERSION:
+            return (section.version = tlv_string(value, len)) != nullptr;
+        case FIELD_URL:
+            return (section.url = tlv_string(value, len)) != nullptr;
+        case FIELD_URL_CHANGE:
+            section.url_change = tlv_number<uint8_t>(value, len, 0) != 0;
+            return true;
+        case FIELD_PUBLIC_KEY_CHANGE:
+            section.public_key_change = tlv_number<uint8_t>(value, len, 0) != 0;
+            return true;
+        case FIELD_PUBLIC_KEY_URL:
+            return (section.public_key_url = tlv_string(value, len)) != nullptr;
+        case FIELD_KEY_ID:
+            return (section.key_id = tlv_string(value, len)) != nullptr;
+        case FIELD_KEY_DER:
+            section.key_der = (const char *)value;
+            section.key_der_len = len;
+            return len > 0;
+        case FIELD_MIRROR:
+        {
+            section.mirrors_set = true;
+            if (len == 0)
+                return true; // null: a patch removes the mirrors
+            const char *mirror_url = tlv_string(value, len);
+            if (mirror_url != nullptr && section.mirror_count < Mirrors::max_mirrors)
+                section.mirrors[section.mirror_count++] = mirror_url;
+            return mirror_url != nullptr;
+        }
+        case FIELD_NOTIFY_URL:
+            section.notify_url_set = true;
+            return len == 0 || (section.notify_url = tlv_string(value, len)) != nullptr; // len 0: null
+        case FIELD_SHA256:
+            if (len != SHA256::digest_len)
+                return false;
+            memcpy(section.sha256, value, len);
+            return section.has_sha256 = true;
+        case FIELD_SIZE:
+            section.size = tlv_number<uint32_t>(value, len, 0);
+            return true;
+        default:
+            return true; // a newer field
+        }
+    }
+}
+
+ConfigErr Manifest::parse(uint8_t *content, const size_t len)
+{
+    bool is_tlv = len >= sizeof(manifest_tlv_magic) && memcmp(content, manifest_tlv_magic, sizeof(manifest_tlv_magic)) == 0;
+    ConfigErr err = is_tlv ? parse_tlv(content, len) : parse_json((char *)content, len);
+    if (base == nullptr) // a full config.json: what it lacks is none
+    {
+        for (Section *section : {&config, &firmware})
+            section->mirrors_set = section->notify_url_set = true;
+    }
+    return err;
+}
+
+// Read in place: no document, no copy
+ConfigErr Manifest::parse_tlv(const uint8_t *tlv, const size_t len)
+{
+    size_t pos = sizeof(manifest_tlv_magic);
+    while (pos < len)
+    {
+        if (len - pos < 3)
+        {
+            log_i("Binary manifest: truncated record at %u", (unsigned)pos);
+            return ConfigErr::DeserializeErr;
+        }
+        const uint8_t tag = tlv[pos];
+        const uint16_t value_len = tlv[pos + 1] | (tlv[pos + 2] << 8);
+        const uint8_t *value = tlv + pos + 3;
+        if (len - pos - 3 < value_len)
+        {
+            log_i("Binary manifest: truncated record at %u", (unsigned)pos);
+            return ConfigErr::DeserializeErr;
+        }
+        pos += 3 + value_len;
+
+        bool valid = true;
+        if (tag == TAG_TYPE)
+            valid = (type = tlv_string(value, value_len)) != nullptr;
+        else if (tag == TAG_BASE)
+            valid = (base = tlv_string(value, value_len)) != nullptr;
+        else if (tag >= TAG_CONFIG && tag < TAG_CONFIG + 0x10)
+            valid = read_field(config, tag - TAG_CONFIG, value, value_len);
+        else if (tag >= TAG_FIRMWARE && tag < TAG_FIRMWARE + 0x10)
+            valid = read_field(firmware, tag - TAG_FIRMWARE, value, value_len);
+        else if (tag == TAG_CH4_FACTOR)
+            device.ch4_factor = tlv_number<float>(value, value_len, 0.0f);
+        else if (tag == TAG_POWER_FACTOR)
+            device.power_factor = tlv_number<float>(value, value_len, 0.0f);
+        else if (tag == TAG_CHECKING_INTERVAL)
+            device.checking_interval = tlv_number<int32_t>(value, value_len, 0);
+        else if (tag == TAG_MULTICAST)
+            multicast.enabled = true;
+        else if (tag == TAG_MULTICAST_GROUP)
+            valid = (multicast.group = tlv_string(value, value_len)) != nullptr;
+        else if (tag == TAG_MULTICAST_PORT)
+            multicast.port = tlv_number<uint16_t>(value, value_len, multicast.port);
+        else if (tag == TAG_MULTICAST_TIMEOUT)
+            multicast.timeout_s = tlv_number<uint32_t>(value, value_len, multicast.timeout_s);
+        else if (tag == TAG_BUDGET_RATE)
+            budget.rate_kb = tlv_number<uint32_t>(value, value_len, 0);
+        else if (tag == TAG_BUDGET_SLICE)
+            budget.slice_ms = tlv_number<uint16_t>(value, value_len, 0);
+        else if (tag == TAG_BUDGET_PAUSE)
+            budget.pause_ms = tlv_number<uint16_t>(value, value_len, 0);
+        else if (tag == TAG_ACTIVATE_AT)
+            staging.activate_at = tlv_number<uint32_t>(value, value_len, 0);
+        else if (tag == TAG_STAGE_WINDOW)
+            staging.stage_window = tlv_number<uint32_t>(value, value_len, 0);
+        else if (tag == TAG_POLL_INTERVAL)
+            poll.interval_s = tlv_number<uint32_t>(value, value_len, 0);
+        else if (tag == TAG_POLL_TTL)
+            poll.ttl_s = tlv_number<uint32_t>(value, value_len, 0);
+        if (!valid)
+        {
+            log_i("Binary manifest: invalid value of tag 0x%02x", tag);
+            return ConfigErr::DeserializeErr;
+        }
+    }
+
+    if (config.version == nullptr || (base == nullptr && firmware.version == nullptr)) // a patch may keep the firmware
+    {
+        return ConfigErr::NoVersion;
+    }
+    return ConfigErr::NoErr;
+}
+
+ConfigErr Manifest::parse_json(char *json, const size_t len)
+{
+    // char* input --> zero-copy: the strings stay in `json`, the document only holds the (filtered) tree
+    truncate_mirrors(json, len);
+    StaticJsonDocument<manifest_doc_capacity> doc;
+    DeserializationError jsonError = deserializeJson(doc, json, len, DeserializationOption::Filter(manifest_filter()));
+    if (jsonError)
+    {
+        log_i("deserializeJson() failed: %s", jsonError.c_str());
+        return ConfigErr::DeserializeErr; // deserialize error
+    }
+    if (!doc.is<JsonObject>())
+    {
+        log_i("Invalid JSON format: config.json's root is not an object");
+        return ConfigErr::InvalidJsonFormat;
+    }
+    JsonObject config_obj = doc["config"];
+    JsonObject device_obj = doc["device"];
+    JsonObject firmware_obj = doc["firmware"];
+    base = doc["base"];
+    if (config_obj.isNull() || (base == nullptr && (device_obj.isNull() || firmware_obj.isNull())))
+    {
+        log_i("Invalid JSON format: There must be \"config\" and \"device\" and \"firmware\" objects in config.json file.");
+        return ConfigErr::InvalidJsonFormat;
+    }
+
+    type = doc["type"];
+    if (!read_section(config_obj, config) || !read_section(firmware_obj, firmware))
+    {
+        log_i("Invalid JSON format: \"sha256\" must be 64 hex digits");
+        return ConfigErr::InvalidJsonFormat;
+    }
+    device.ch4_factor = device_obj["ch4_factor"] | 0.0f;
+    device.power_factor = device_obj["power_factor"] | 0.0f;
+    device.checking_interval = device_obj["checking_interval"] | 0;
+    JsonObject multicast_obj = firmware_obj["multicast"];
+    if (!multicast_obj.isNull())
+    {
+        multicast.enabled = true;
+        multicast.group = multicast_obj["group"] | multicast.group;
+        multicast.port = multicast_obj["port"] | multicast.port;
+        multicast.timeout_s = multicast_obj["timeout"] | multicast.timeout_s;
+    }
+    JsonObject budget_obj = firmware_obj["budget"];
+    budget.rate_kb = budget_obj["rate"] | 0;
+    budget.slice_ms = budget_obj["slice"] | 0;
+    budget.pause_ms = budget_obj["pause"] | 0;
+    staging.activate_at = firmware_obj["activate_at"] | 0;
+    staging.stage_window = firmware_obj["stage_window"] | 0;
+    poll.interval_s = doc["poll"]["interval"] | 0;
+    poll.ttl_s = doc["poll"]["ttl"] | 0;
+
+    if (config.version == nullptr || (base == nullptr && firmware.version == nullptr)) // a patch may keep the firmware
+    {
+        return ConfigErr::NoVersion;
+    }
+    return ConfigErr::NoErr;
 }
 
-int Config::get_img(uint8_t *signature, uint8_t *content, const char *config_url)
+bool Config::is_signature_valid(const char *key_id, const uint8_t *signed_digest, const uint8_t *signature)
+{
+    uint8_t der[KeyStore::max_der_size];
+    RSA_PKI rsa(der, KeyStore::load(key_id, der, KeyStore::max_der_size));
+    return rsa.verify_hash(signed_digest, signature);
+}
+
+// Get config.img's signature & content (config.json or a binary manifest). From a catalog.img: the entry of this
+// device only, the SHA-256 of the whole (signed) catalog is put in `catalog_digest`.
+// `base_version`: the applied config version is sent (?base=...), the server may answer with a merge patch against it.
+int Config::get_img(uint8_t *signature, uint8_t *content, const char *config_url, const char *base_version, uint8_t *catalog_digest, bool &is_catalog)
 {
     int result;
 
-    HTTPClient http;
+    char url[max_url_size + max_version_size + 8];
+    if (base_version != nullptr)
+    {
+        snprintf(url, sizeof(url), "%s%cbase=%s", config_url, strchr(config_url, '?') ? '&' : '?', base_version);
+        config_url = url;
+    }
+
+    HTTPClient &http = HTTP::client();
     int imageLength = HTTP::get_length(http, config_url);
 
     int contentLength = imageLength - SIGN_LEN;
-    if (contentLength > 0 && contentLength <= max_content_size)
+    is_catalog = false;
+    if (contentLength > (int)sizeof(Catalog::magic))
     {
         http.getStream().readBytes(signature, SIGN_LEN);
-        http.getStream().readBytes(content, contentLength);
+        http.getStream().readBytes(content, sizeof(Catalog::magic));
+        is_catalog = memcmp(content, Catalog::magic, sizeof(Catalog::magic)) == 0;
+    }
+
+    if (is_catalog)
+    {
+        result = Catalog::read_entry(http.getStream(), contentLength, device_type, hardware_rev, max_catalog_size,
+                                     content, max_content_size, catalog_digest);
+    }
+    else if (contentLength > (int)sizeof(Catalog::magic) && contentLength <= max_content_size)
+    {
+        http.getStream().readBytes(content + sizeof(Catalog::magic), contentLength - sizeof(Catalog::magic));
         result = contentLength; // OK
     }
     else if (contentLength > (int)max_content_size)
@@ -27,11 +478,18 @@ int Config::get_img(uint8_t *signature, uint8_t *content, const char *config_url
     }
     else
     {
-        log_i("config.img's size Error: the image's length must > %d", SIGN_LEN);
+        log_i("config.img's size Error: the image's length must > %d", (int)(SIGN_LEN + sizeof(Catalog::magic)));
         result = -1; // HTTP GET error or imageLength <= SIGN_LEN
     }
 
-    http.end();
+    if (result > 0)
+    {
+        http.end();
+    }
+    else
+    {
+        HTTP::close(http);
+    }
     return result;
 }
 
@@ -43,8 +501,10 @@ const char *Config::translate_err(ConfigErr errCode)
         "Invalid Sematic Versioning",
         "Not a JSON Object",
         "HTTP GET config.img Failed",
-        "\"version\" Not Found"
+        "\"version\" Not Found",
         "JSON Deserialization Failed",
+        "Not This Device Type",
+        "Config Patch Of Another Version",
     };
     return errMsg[(int)errCode];
 }
@@ -53,108 +513,406 @@ const char *Config::translate_err(ConfigErr errCode)
 ConfigErr Config::check_update(Device_Params &device)
 {
     uint8_t signature[SIGN_LEN];
-    uint8_t content[max_content_size];
+    std::unique_ptr<uint8_t[]> content_buf{new uint8_t[max_content_size]}; // off the loop task's stack
+    uint8_t *content = content_buf.get();
     Config_Params configParams;
+    activate_staged(); // due while the server is unreachable: no download needed
 
-    int contentLength = get_img(signature, content, configParams.url);
-    if (contentLength <= 0)
+    // Ask for a merge patch against the applied config version (the servers without patches send the full image),
+    // fall back to the full image if the patch doesn't apply
+    ConfigErr err = poll_img(device, configParams, configParams.version, signature, content);
+    if (err == ConfigErr::PatchBaseMismatch)
     {
-        return ConfigErr::HttpGetErr;
+        log_i("The config patch doesn't apply to version %s: getting the full config.img", configParams.version);
+        err = poll_img(device, configParams, nullptr, signature, content);
     }
-    if (!is_signature_valid(configParams.public_key, configParams.pubkey_size, content, contentLength, signature))
+    if (notifier != nullptr)
+        notifier->set_target(configParams.notify_url, configParams.version);
+    return err;
+}
+
+// get config.img (a patch against `base_version`, nullptr: the full image), check & apply it
+ConfigErr Config::poll_img(Device_Params &device, Config_Params &configParams, const char *base_version, uint8_t *signature, uint8_t *content)
+{
+    uint8_t signed_digest[SHA256::digest_len]; // SHA-256 of the signed bytes (config.json, or the whole catalog)
+    bool is_catalog = false;
+
+    // config.img is mutable: a stale mirror must not shadow the origin, so the mirrors are only fallbacks (ranked),
+    // unless the origin failed recently
+    char mirror_list[Mirrors::max_mirror_list_size];
+    strlcpy(mirror_list, configParams.mirrors, sizeof(mirror_list));
+    const char *urls[Mirrors::max_urls]{configParams.url};
+    uint8_t url_count = 1 + Mirrors::split(mirror_list, urls + 1, Mirrors::max_mirrors);
+    Mirrors::rank(urls + 1, url_count - 1, max_content_size);
+    if (url_count > 1 && Mirrors::is_backed_off(configParams.url))
     {
-        return ConfigErr::InvalidSign;
+        memmove(urls, urls + 1, (url_count - 1) * sizeof(urls[0]));
+        urls[url_count - 1] = configParams.url;
     }
 
-    DynamicJsonDocument doc(json_doc_capacity);
-    DeserializationError jsonError = deserializeJson(doc, content, max_content_size);
-    if (jsonError)
+    int contentLength = -1;
+    uint32_t retry_after = 0; // the soonest one of the failed servers
+    for (uint8_t i = 0; i < url_count && contentLength < 0; i++) // 0: too large, not a failure of the server
     {
-        log_i("deserializeJson() failed: %s", jsonError.c_str());
-        return ConfigErr::DeserializeErr; // deserialize error
+        uint32_t request_us = micros();
+        contentLength = get_img(signature, content, urls[i], base_version, signed_digest, is_catalog);
+        if (contentLength < 0)
+        {
+            uint32_t server_retry_after = HTTP::retry_after_s();
+            Mirrors::report_failure(urls[i], server_retry_after * 1000UL);
+            if (server_retry_after > 0 && (retry_after == 0 || server_retry_after < retry_after))
+                retry_after = server_retry_after;
+        }
+        else
+            Mirrors::report_success(urls[i], micros() - request_us, 0, 0);
     }
-    if (!doc.is<JsonObject>())
+    retry_after_s = (contentLength < 0) ? retry_after : 0;
+    if (contentLength <= 0)
     {
-        log_i("Invalid JSON format: config.json's root is not an object");
-        return ConfigErr::InvalidJsonFormat;
+        if (retry_after_s > 0)
+        {
+            stats.retry_afters++;
+            log_i("config.img: the server asks to retry after %u s", retry_after_s);
+        }
+        return ConfigErr::HttpGetErr;
     }
+    stats.polls++;
 
-    if (!doc["device"].is<JsonObject>() || !doc["config"].is<JsonObject>() || !doc["firmware"].is<JsonObject>())
+    // An identical config.img has the same verdict: skip the RSA verify & the parsing (even without HTTP 304)
+    uint32_t start_us = micros();
+    if (!is_catalog)
     {
-        log_i("Invalid JSON format: There must be \"config\" and \"device\" and \"firmware\" objects in config.json file.");
-        return ConfigErr::InvalidJsonFormat;
+        SHA256::Hasher hasher;
+        hasher.update(content, contentLength);
+        hasher.finish(signed_digest);
+    }
+    uint8_t digest[SHA256::digest_len];
+    img_digest(configParams, signature, signed_digest, digest);
+    bool unchanged = last_img_verdict >= 0 && memcmp(digest, last_img_digest, SHA256::digest_len) == 0;
+    stats.digest_us += micros() - start_us;
+    uint32_t now = clock_s();
+    bool stage_due = unchanged && last_img_stage_at != 0 && now != 0 && (int32_t)(now - last_img_stage_at) >= 0;
+    if (unchanged && !stage_due)
+    {
+        stats.unchanged++;
+        log_i("config.img unchanged: %s", translate_err((ConfigErr)last_img_verdict));
+        return (ConfigErr)last_img_verdict;
     }
 
-    const char *json_cf_ver = doc["config"]["version"];
-    const char *json_fw_ver = doc["firmware"]["version"];
-    if (json_cf_ver == nullptr || json_fw_ver == nullptr)
+    bool pending = false;
+    ConfigErr err = apply_img(device, configParams, signature, signed_digest, content, contentLength, stage_due, pending);
+    if (!pending) // settled (e.g. not a failed firmware update to retry) --> remember the verdict
     {
-        return ConfigErr::NoVersion;
+        memcpy(last_img_digest, digest, SHA256::digest_len);
+        last_img_verdict = (int8_t)err;
+        last_img_stage_at = deferred_stage_at;
+    }
+    return err;
+}
+
+// verify, parse & apply a fetched config.img (`reapply`: the last settled one, already verified & applied, whose firmware
+// is due for staging). `pending` tells if the same image needs another try (a failed firmware update)
+ConfigErr Config::apply_img(Device_Params &device, Config_Params &configParams, const uint8_t *signature, const uint8_t *signed_digest,
+                            uint8_t *content, const int contentLength, const bool reapply, bool &pending)
+{
+    uint32_t start_us = micros();
+    deferred_stage_at = 0;
+    bool valid = reapply;
+    if (!reapply)
+    {
+        stats.verified++;
+        valid = is_signature_valid(configParams.key.id(), signed_digest, signature);
+    }
+    Manifest manifest;
+    ConfigErr err = valid ? manifest.parse(content, contentLength) : ConfigErr::InvalidSign;
+    stats.verify_us += micros() - start_us;
+    if (err != ConfigErr::NoErr)
+    {
+        return err;
+    }
+    if (manifest.type != nullptr && strcmp(manifest.type, device_type) != 0)
+    {
+        log_e("The manifest is for \"%s\" devices, this one is \"%s\"", manifest.type, device_type);
+        return ConfigErr::WrongDeviceType;
+    }
+    if (manifest.base != nullptr && strcmp(manifest.base, configParams.version) != 0)
+    {
+        pending = true; // not a verdict on this config: the full image is fetched instead
+        return ConfigErr::PatchBaseMismatch;
+    }
+    if (!reapply)
+    {
+        apply_poll_hint(manifest.poll);
     }
 
     Firmware_Params firmwareParams;
-    Semver configSemver(configParams.version, json_cf_ver);
+    Semver configSemver(configParams.version, manifest.config.version);
     if (configSemver.is_newer_version())
     {
-        log_i("Found a new config version: %s --> Update params.", json_cf_ver);
-        configParams.update(doc["config"]);
-        device.update(doc["device"]);
-        firmwareParams.update_pubkey(doc["firmware"]);
+        log_i("Found a new config version: %s --> Update params.", manifest.config.version);
+        configParams.update(manifest.config);
+        device.update(manifest.device);
+        firmwareParams.update_pubkey(manifest.firmware);
     }
     else
     {
         log_i("No newer config version");
     }
 
-    Semver firmwareSemver(firmwareParams.version, json_fw_ver);
+    if (manifest.firmware.version == nullptr) // a patch which doesn't touch the firmware
+    {
+        return ConfigErr::NoErr;
+    }
+    if (firmwareParams.staged[0] != '\0' && strcmp(firmwareParams.staged, manifest.firmware.version) != 0)
+    {
+        log_i("The staged firmware %s is withdrawn (the manifest has %s)", firmwareParams.staged, manifest.firmware.version);
+        firmwareParams.clear_staged();
+    }
+    Semver firmwareSemver(firmwareParams.version, manifest.firmware.version);
     if (firmwareSemver.is_newer_version())
     {
-        if (update_firmware(doc["firmware"]["url"], firmwareParams))
-        { // true --> succeeded --> :
-            log_i("FW Update successfully completed. Rebooting.");
-            firmwareParams.update_version(doc["firmware"]);
-            ESP.restart();
+        log_i("Found a newer firmware version: %s", manifest.firmware.version);
+        // pending until staged: its activation then only depends on the staged state (activate_staged()).
+        // Waiting for the stage slot is settled: the image is applied again at that time (until_staging()), not re-verified
+        bool staged = stage_firmware(manifest, firmwareParams);
+        pending = !staged && deferred_stage_at == 0;
+        if (staged)
+        {
+            activate_staged(firmwareParams);
         }
     }
 
     return ConfigErr::NoErr;
 }
 
-bool Config::is_fw_signature_valid(const Firmware_Params &fw_params, const int fw_len, const uint8_t *signature)
+// Download & verify the manifest's newer firmware into the next OTA partition, unless it's already staged there.
+// A scheduled release ("activate_at") is downloaded at this device's slot of its "stage_window", before that time:
+// the fleet's downloads are spread, none is left on the activation's critical path. Return true once staged
+bool Config::stage_firmware(const Manifest &manifest, Firmware_Params &fw_params)
 {
-    RSA_PKI rsa(fw_params.public_key, fw_params.pubkey_size);
-    const esp_partition_t *next_partition = esp_ota_get_next_update_partition(NULL);
-    return rsa.verify_signature(next_partition, fw_len, signature);
+    const char *version = manifest.firmware.version;
+    const Manifest::Staging &staging = manifest.staging;
+    if (strcmp(fw_params.staged, version) == 0)
+    {
+        fw_params.update_staged(version, staging.activate_at); // the release may have been rescheduled
+        return true;
+    }
+    uint32_t now = clock_s();
+    uint32_t window = min(staging.stage_window, staging.activate_at);
+    uint32_t stage_at = staging.activate_at - window + stage_slot(version, window);
+    if (now != 0 && (int32_t)(stage_at - now) > 0)
+    {
+        log_i("Firmware %s: staging in %u s, activation in %u s", version, stage_at - now, staging.activate_at - now);
+        deferred_stage_at = stage_at;
+        return false;
+    }
+
+    fw_params.clear_staged(); // the next OTA partition gets overwritten
+    bool staged = false;
+    if (manifest.multicast.enabled)
+    {
+        staged = update_firmware_multicast(manifest, fw_params);
+    }
+    char peer_urls[LAN_Peers::max_sources][LAN_Peers::url_size];
+    uint8_t peer_count = (!staged && lan_peers != nullptr) ? lan_peers->find(version, peer_urls, LAN_Peers::max_sources) : 0;
+    if (peer_count > 0)
+    {
+        log_i("Found %u LAN peer(s) holding firmware %s: %s ...", peer_count, version, peer_urls[0]);
+        const char *urls[LAN_Peers::max_sources];
+        for (uint8_t i = 0; i < peer_count; i++)
+        {
+            urls[i] = peer_urls[i];
+        }
+        staged = update_firmware(urls, peer_count, manifest, fw_params);
+        // the peers which failed (backed off), or all of them if the image they served was rejected
+        bool any_failed = false;
+        for (uint8_t i = 0; !staged && i < peer_count; i++)
+        {
+            any_failed = any_failed || Mirrors::is_backed_off(urls[i]);
+        }
+        for (uint8_t i = 0; !staged && i < peer_count; i++)
+        {
+            if (!any_failed || Mirrors::is_backed_off(urls[i]))
+            {
+                lan_peers->forget(urls[i]);
+            }
+        }
+    }
+    const char *fw_urls[Mirrors::max_urls];
+    uint8_t fw_url_count = manifest.firmware.urls(fw_urls);
+    if (!staged && (fw_url_count == 0 || !update_firmware(fw_urls, fw_url_count, manifest, fw_params)))
+    {
+        return false;
+    }
+    log_i("Firmware %s staged", version);
+    fw_params.update_staged(version, staging.activate_at);
+    return true;
 }
 
-bool Config::update_firmware(const char *url, const Firmware_Params &fw_params)
+bool Config::activate_staged()
 {
-    bool success = true;
-    uint8_t signature[SIGN_LEN];
-
-    HTTPClient http;
-    int img_len = HTTP::get_length(http, url);
-    int fw_len = img_len - SIGN_LEN;
+    Firmware_Params fw_params;
+    return activate_staged(fw_params);
+}
 
-    if (fw_len <= 0)
+bool Config::activate_staged(Firmware_Params &fw_params)
+{
+    if (fw_params.staged[0] == '\0')
     {
-        log_i("firmware.img's size Error: Content Length must > %d", SIGN_LEN);
-        http.end();
         return false;
     }
+    uint32_t now = clock_s();
+    if (fw_params.activate_at != 0 && (now == 0 || (int32_t)((uint32_t)fw_params.activate_at - now) > 0))
+    {
+        return false;
+    }
+    esp_err_t err = esp_ota_set_boot_partition(esp_ota_get_next_update_partition(NULL)); // validates the app image
+    if (err != ESP_OK)
+    {
+        log_e("The staged firmware %s is not a valid app image (error 0x%x)", fw_params.staged, err);
+        fw_params.clear_staged();
+        return false;
+    }
+    log_i("Activating the staged firmware %s. Rebooting.", fw_params.staged);
+    strlcpy(fw_params.version, fw_params.staged, max_version_size);
+    NVS::update_string("firmware", "version", fw_params.version);
+    fw_params.clear_staged();
+    ESP.restart();
+    return true;
+}
 
-    if (!Update.begin(fw_len))
-    { // Not enough space to begin OTA
-        log_i("Firmware's length, %d bytes, exceeds the OTA space!", fw_len);
-        http.end();
+// A new image's "poll" hint (none: the checking_interval again), live for its TTL from now
+void Config::apply_poll_hint(const Manifest::Poll &poll)
+{
+    hint_interval_s = (poll.interval_s > 0) ? constrain(poll.interval_s, min_poll_interval_s, max_poll_interval_s) : 0;
+    if (hint_interval_s > 0)
+    {
+        uint32_t ttl_s = (poll.ttl_s > 0) ? min(poll.ttl_s, max_poll_interval_s) : default_poll_hint_ttl_s;
+        hint_until_ms = millis() + ttl_s * 1000UL;
+        hint_phase_s = 1 + esp_random() % hint_interval_s;
+        stats.poll_hints++;
+        log_i("Poll hint: every %u s for %u s", hint_interval_s, ttl_s);
+    }
+}
+
+uint32_t Config::next_poll_s(const Device_Params &device)
+{
+    if (retry_after_s > 0) // + up to 10%: the devices turned away together don't come back together
+        return constrain(retry_after_s + esp_random() % (retry_after_s / 10 + 1), min_poll_interval_s, max_poll_interval_s);
+    if (hint_interval_s > 0 && (int32_t)(hint_until_ms - millis()) > 0)
+    {
+        uint32_t interval_s = (hint_phase_s > 0) ? hint_phase_s : hint_interval_s;
+        hint_phase_s = 0;
+        return interval_s;
+    }
+    // a signed int of the manifest: 0 or negative would arm a 0 ms (or a wrapped) timer
+    return (uint32_t)constrain(device.checking_interval, (int)min_poll_interval_s, (int)max_poll_interval_s);
+}
+
+int32_t Config::until_staging()
+{
+    uint32_t now = clock_s();
+    if (last_img_stage_at == 0 || now == 0)
+    {
+        return -1;
+    }
+    return max((int32_t)(last_img_stage_at - now), (int32_t)0);
+}
+
+int32_t Config::until_activation()
+{
+    Firmware_Params fw_params;
+    uint32_t now = clock_s();
+    if (fw_params.staged[0] == '\0' || (fw_params.activate_at != 0 && now == 0))
+    {
+        return -1;
+    }
+    return max((int32_t)((uint32_t)fw_params.activate_at - now), (int32_t)0);
+}
+
+// The image in the next OTA partition is the one the manifest releases (its "size" & "sha256" if listed) and is signed
+// by the firmware key. The partition is read & hashed once for both checks
+bool Config::is_fw_image_valid(const Manifest::Section &firmware_obj, const Firmware_Params &fw_params, const int fw_len, const uint8_t *signature)
+{
+    if (firmware_obj.size > 0 && (uint32_t)fw_len != firmware_obj.size)
+    {
+        log_e("The firmware image has %d bytes, the manifest's %u: another release", fw_len, (unsigned)firmware_obj.size);
+        return false;
+    }
+    uint8_t digest[SHA256::digest_len];
+    if (!partition_digest(esp_ota_get_next_update_partition(NULL), fw_len, digest))
+    {
         return false;
     }
+    if (firmware_obj.has_sha256 && memcmp(digest, firmware_obj.sha256, SHA256::digest_len) != 0)
+    {
+        log_e("The firmware image's SHA-256 isn't the manifest's: another release");
+        return false;
+    }
+    uint8_t der[KeyStore::max_der_size];
+    RSA_PKI rsa(der, KeyStore::load(fw_params.key.id(), der, KeyStore::max_der_size));
+    return rsa.verify_hash(digest, signature);
+}
+
+// Download firmware.img from the best ranked of its URLs (failing over to the next ones mid-way) into the next OTA partition,
+// at the pace of the manifest's budget
+bool Config::update_firmware(const char *const *urls, const uint8_t url_count, const Manifest &manifest, const Firmware_Params &fw_params)
+{
+    const Manifest::Budget &budget = manifest.budget;
+    bool success = true;
+    uint8_t signature[SIGN_LEN];
+    int img_len = manifest.firmware.size > 0 ? (int)(manifest.firmware.size + SIGN_LEN) : -1; // a mirror serving another is skipped
+    size_t received = 0; // signature + firmware
+    bool begun = false;
+    OTA_Writer writer; // the sectors already in flash (a repeated or resumed update) are skipped
+    Throttle throttle(budget.rate_kb * 1024U, budget.slice_ms, budget.pause_ms);
+    if (budget.slice_ms > 0)
+    {
+        writer.limit_erase(OTA_Writer::sector_size); // a block erase would stall the other tasks for ~3 slices
+    }
+
+    // signature first, then the firmware into the next OTA partition (begun once its length is known)
+    auto sink = [&](uint8_t *data, size_t len)
+    {
+        if (received < SIGN_LEN)
+        {
+            if (received == 0 && img_len <= (int)SIGN_LEN)
+            {
+                log_i("firmware.img's size Error: Content Length must > %d", SIGN_LEN);
+                return false;
+            }
+            size_t n = min(len, SIGN_LEN - received);
+            memcpy(signature + received, data, n);
+            received += n;
+            data += n;
+            len -= n;
+            if (received == SIGN_LEN && !writer.begin(img_len - SIGN_LEN))
+            { // Not enough space to begin OTA
+                log_i("Firmware's length, %d bytes, exceeds the OTA space!", img_len - SIGN_LEN);
+                return false;
+            }
+            begun = received == SIGN_LEN;
+        }
+        if (len > 0 && !writer.write(data, len))
+        {
+            return false;
+        }
+        received += len;
+        return true;
+    };
 
-    http.getStream().readBytes(signature, SIGN_LEN);
     log_i("Writting a newer firmware version into Flash ... (wait 2 - 5 mins)");
-    size_t written = Update.writeStream(http.getStream());
+    // the mirrors are ranked for the image's length: the manifest's, else about the running one's
+    size_t expected_len = img_len > 0 ? (size_t)img_len : ESP.getSketchSize();
+    bool complete = Mirrors::download(urls, url_count, expected_len, img_len, sink, &throttle);
+    if (!begun)
+    {
+        return false;
+    }
 
-    if (written == fw_len)
+    int fw_len = img_len - SIGN_LEN;
+    size_t written = received - SIGN_LEN;
+    if (complete)
     {
         log_i("Written: %d successfully.", written);
     }
@@ -162,16 +920,19 @@ bool Config::update_firmware(const char *url, const Firmware_Params &fw_params)
     {
         log_i("Written only: %d/%d. Retry?", written, fw_len);
     }
+    const Throttle::Stats &paced = throttle.get_stats();
+    if (paced.slices > 0 || paced.limited_ms > 0)
+    {
+        log_i("Download budget: %u CPU slices, %u ms paused, %u ms rate-limited", paced.slices, paced.paused_ms, paced.limited_ms);
+    }
 
-    if (Update.end())
+    if (writer.end())
     {
         log_i("Signature checking ...");
-        if (!is_fw_signature_valid(fw_params, fw_len, signature))
+        if (!is_fw_image_valid(manifest.firmware, fw_params, fw_len, signature))
         {
             log_i("... failed!");
-            // --> keep this_partition for next boot AND disable next_partition by erasing some bytes:
-            const esp_partition_t *this_partition = esp_ota_get_running_partition();
-            esp_ota_set_boot_partition(this_partition);
+            // --> disable next_partition by erasing some bytes (the boot partition is only set on activation):
             const esp_partition_t *next_partition = esp_ota_get_next_update_partition(NULL);
             ESP.partitionEraseRange(next_partition, 0, ENCRYPTED_BLOCK_SIZE);
             success = false;
@@ -179,14 +940,39 @@ bool Config::update_firmware(const char *url, const Firmware_Params &fw_params)
         else
         {
             log_i("... succeeded!");
+            Firmware_Params::save_image_info(signature, fw_len);
         }
     }
     else
     {
-        log_e("Update Error: #%d", Update.getError());
         success = false;
     }
 
-    http.end();
     return success;
 }
+
+// Collect the firmware from a multicast carousel (HTTP Range requests for the missing blocks) into the next OTA partition
+bool Config::update_firmware_multicast(const Manifest &manifest, const Firmware_Params &fw_params)
+{
+    const Manifest::Multicast &multicast = manifest.multicast;
+    uint8_t signature[SIGN_LEN];
+    OTA_Multicast receiver;
+    log_i("Receiving a newer firmware version from the multicast group ...");
+    int fw_len = receiver.receive(manifest.firmware.url, multicast.group, multicast.port, multicast.timeout_s * 1000UL, signature);
+    if (fw_len <= 0)
+    {
+        return false;
+    }
+
+    log_i("Signature checking ...");
+    const esp_partition_t *next_partition = esp_ota_get_next_update_partition(NULL);
+    if (!is_fw_image_valid(manifest.firmware, fw_params, fw_len, signature))
+    {
+        log_i("... failed!");
+        ESP.partitionEraseRange(next_partition, 0, ENCRYPTED_BLOCK_SIZE);
+        return false;
+    }
+    log_i("... succeeded!");
+    Firmware_Params::save_image_info(signature, fw_len);
+    return true;
+}
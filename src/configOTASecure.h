@@ -18,10 +18,20 @@ Note:
 #include "utils/Semver.hpp"
 #include "utils/rsa_pki.h"
 #include "utils/nvs_utilities.h"
+#include "utils/sha256_utilities.h"
+#include "utils/key_store.h"
+#include "utils/catalog.h"
+#include "utils/lan_peers.h"
+#include "utils/ota_multicast.h"
+#include "utils/mirrors.h"
+#include "utils/throttle.h"
+#include "utils/ota_writer.h"
+#include "utils/notifier.h"
 
 namespace
 {
     constexpr const char *device_type = "ch4_generator";
+    constexpr const uint8_t hardware_rev = 1; // its entry in a catalog: (device_type, hardware_rev), else (device_type, 0)
 
     constexpr const char *default_conf_version = "0.0.1";
     constexpr const char *default_firm_version = "0.0.5";
@@ -30,44 +40,159 @@ namespace
 
     constexpr const size_t max_version_size = 64;
     constexpr const size_t max_url_size = 256;
-    constexpr const size_t max_content_size = 1024U; // the config.json size limit (in bytes)
-    constexpr const size_t json_doc_capacity = 1024;
+    constexpr const size_t max_content_size = 2048U; // the config.json size limit (in bytes), room for 2 inline RSA-4096 keys
+    // config.json is parsed through a filter of the known fields into a fixed-size document (see Manifest::parse)
+    constexpr const size_t manifest_filter_capacity = JSON_OBJECT_SIZE(6) + JSON_OBJECT_SIZE(8) + JSON_OBJECT_SIZE(13) + JSON_OBJECT_SIZE(3);
+    constexpr const size_t manifest_doc_capacity = manifest_filter_capacity + 2 * JSON_OBJECT_SIZE(2) + 3 * JSON_OBJECT_SIZE(3) +
+                                                   2 * JSON_ARRAY_SIZE(Mirrors::max_mirrors) + JSON_OBJECT_SIZE(8); // + the "public_key", "multicast", "budget", "poll" & "mirrors" (cut to max_mirrors before the parse), some slack
+    // config.json or, starting with this magic, the binary (TLV) manifest: tools/manifest_tlv.py
+    constexpr const uint8_t manifest_tlv_magic[] = {'O', 'T', 'M', 1};
     constexpr const size_t max_pubkey_size = 832U;
-    constexpr const uint8_t max_catalog_size = 32U;
+    constexpr const uint8_t max_catalog_size = 32U; // max entries of a catalog.img (see utils/catalog.h)
     constexpr const size_t SIGN_LEN = 512U;
+    constexpr const uint32_t min_clock_s = 1700000000UL; // the clock (SNTP) is set: a later Unix time
+    // the bounds of a server-directed polling interval (Retry-After, the manifest's "poll" hint)
+    constexpr const uint32_t min_poll_interval_s = 5;
+    constexpr const uint32_t max_poll_interval_s = 24 * 3600UL;
+    constexpr const uint32_t default_poll_hint_ttl_s = 3600;
 }
 
-// The device's parameters: should be a global object, e.g. `Device_Params device;`
+enum class ConfigErr
+{
+    NoErr = 0,
+    InvalidSign,
+    InvalidSemver,
+    InvalidJsonFormat,
+    HttpGetErr,
+    NoVersion,
+    DeserializeErr,
+    WrongDeviceType,
+    PatchBaseMismatch,
+};
+
+// The fields of config.json used by the device, resolved once from a filtered parse (or read from a binary manifest).
+// The strings point into the parsed content buffer (ArduinoJson's zero-copy mode): valid as long as that buffer.
+struct Manifest
+{
+    struct Section // "config" or "firmware"
+    {
+        const char *version{nullptr};
+        const char *url{nullptr};
+        bool url_change{false};        // "url_change?"
+        bool public_key_change{false}; // "public_key_change?"
+        const char *public_key_url{nullptr};
+        const char *key_id{nullptr};  // inline public key: "public_key": {"id": ..., "der": ...}
+        const char *key_der{nullptr}; // base64, or raw DER when key_der_len > 0 (binary manifest)
+        size_t key_der_len{0};
+        const char *mirrors[Mirrors::max_mirrors]{}; // "mirrors": [...], other URLs of the same artifact
+        uint8_t mirror_count{0};
+        const char *notify_url{nullptr}; // "config"."notify_url": the push channel (utils/notifier.h), nullptr: none
+        // "mirrors" & "notify_url" replace the kept ones: always from a full config.json (absent: none), from a patch
+        // (Manifest::base) only when present there (null: removed, RFC 7386), else they're kept
+        bool mirrors_set{false};
+        bool notify_url_set{false};
+        // "firmware"."sha256" & "size": the image (without its signature) the manifest releases. Any other image is
+        // rejected, wherever it comes from: e.g. an older, validly signed release (a rollback)
+        uint8_t sha256[SHA256::digest_len]{}; // hex in config.json, raw in a binary manifest
+        bool has_sha256{false};
+        uint32_t size{0}; // 0: not listed (an older manifest)
+
+        // "url" (if any) & the mirrors into `urls` (Mirrors::max_urls). Return their count
+        uint8_t urls(const char **list) const
+        {
+            uint8_t count = 0;
+            if (url != nullptr)
+                list[count++] = url;
+            for (uint8_t i = 0; i < mirror_count; i++)
+                list[count++] = mirrors[i];
+            return count;
+        }
+    };
+    struct Device // "device": 0 (absent, or null in a patch) --> unchanged
+    {
+        float ch4_factor{0};
+        float power_factor{0};
+        int checking_interval{0};
+    };
+    struct Multicast // "firmware"."multicast"
+    {
+        bool enabled{false};
+        const char *group{"239.255.0.1"};
+        uint16_t port{5007};
+        uint32_t timeout_s{30};
+    };
+    struct Staging // "firmware": a scheduled release, downloaded ahead of time (see Config::stage_firmware())
+    {
+        uint32_t activate_at{0};  // "activate_at": Unix time to boot the new version at. 0: right away
+        uint32_t stage_window{0}; // "stage_window": seconds before activate_at the downloads are spread over
+    };
+    struct Poll // "poll": a next-poll hint, applied by any valid image (not only a newer config version)
+    {
+        uint32_t interval_s{0}; // "interval": the polling interval instead of "checking_interval", 0: none
+        uint32_t ttl_s{0};      // "ttl": for that long from its reception (default_poll_hint_ttl_s if 0)
+    };
+    struct Budget // "firmware"."budget": the pace of a background firmware download (see utils/throttle.h), 0: no limit
+    {
+        uint32_t rate_kb{0};  // "rate": KB/s
+        uint16_t slice_ms{0}; // "slice": CPU time before a pause
+        uint16_t pause_ms{0}; // "pause"
+    };
+
+    const char *type{nullptr};
+    // A merge patch (RFC 7386) of config.json against the config version "base": the absent members are unchanged,
+    // "firmware" & "device" may be absent. nullptr: a full config.json
+    const char *base{nullptr};
+    Section config;
+    Device device;
+    Section firmware;
+    Multicast multicast;
+    Staging staging;
+    Budget budget;
+    Poll poll;
+
+    // Parse the content of config.img in place (it gets modified): config.json, or a binary manifest (by its magic).
+    // Return NoErr, DeserializeErr, InvalidJsonFormat or NoVersion
+    ConfigErr parse(uint8_t *content, const size_t len);
+    ConfigErr parse_json(char *json, const size_t len);
+    ConfigErr parse_tlv(const uint8_t *tlv, const size_t len);
+};
+
+// The device's parameters: should be a global object, e.g. `Device_Params device;`, loaded in setup()
 struct Device_Params
 {
     float ch4_factor = 25.5;
     float power_factor = 12.25;
     int checking_interval = 5; // seconds
-    Device_Params()
+
+    // Get them from NVS if existed (else store the defaults). Not in the constructor: a global object is constructed
+    // before the Arduino core (& NVS) is initialized
+    void load()
     {
-        nvs_flash_init(); // it must be called before any Pereferences::begin()
-        NVS::init_float("device", "ch4_factor", ch4_factor);
-        NVS::init_float("device", "power_factor", power_factor);
-        NVS::init_int("device", "checking_interv", checking_interval);
+        NVS::Field fields[]{
+            {"ch4_factor", ch4_factor},
+            {"power_factor", power_factor},
+            {"checking_interv", checking_interval},
+        };
+        NVS::load("device", fields);
     }
 
-    void update(const JsonObject &device_obj)
+    void update(const Manifest::Device &device_obj)
     {
-        float new_ch4_factor = device_obj["ch4_factor"];
+        float new_ch4_factor = device_obj.ch4_factor;
         if (new_ch4_factor != 0.0 && new_ch4_factor != ch4_factor)
         {
             ch4_factor = new_ch4_factor;
             NVS::update_float("device", "ch4_factor", ch4_factor);
         }
 
-        float new_power_factor = device_obj["power_factor"];
+        float new_power_factor = device_obj.power_factor;
         if (new_power_factor != 0.0 && new_power_factor != power_factor)
         {
             power_factor = new_power_factor;
             NVS::update_float("device", "power_factor", power_factor);
         }
 
-        int new_checking_interval = device_obj["checking_interval"];
+        int new_checking_interval = device_obj.checking_interval;
         if (new_checking_interval != 0 && new_checking_interval != checking_interval)
         {
             checking_interval = new_checking_interval;
@@ -76,62 +201,191 @@ struct Device_Params
     }
 };
 
+// The new public key of the "config" or "firmware" object of a verified config.json into `public_key` (max_pubkey_size bytes).
+// Return its size, 0 if no (valid) new key:
+// - inline: "public_key": {"id": "<key ID>", "der": "<base64 DER>"} (raw DER in a binary manifest) --> no extra download,
+//   authenticated by the config.img's signature
+// - older manifests: "public_key_change?": true --> GET the PEM at "public_key_url"
+inline size_t get_new_pubkey(const Manifest::Section &obj, const char *name, uint8_t *public_key)
+{
+    if (obj.key_der != nullptr)
+    {
+        size_t der_len = 0;
+        if (obj.key_der_len == 0)
+        {
+            der_len = RSA_PKI::decode_key(obj.key_der, obj.key_id, public_key, max_pubkey_size);
+        }
+        else if (obj.key_der_len <= max_pubkey_size)
+        {
+            memcpy(public_key, obj.key_der, obj.key_der_len);
+            der_len = RSA_PKI::check_key(public_key, obj.key_der_len, obj.key_id);
+        }
+        if (der_len == 0)
+        {
+            log_e("The %s's inline public key is invalid", name);
+        }
+        return der_len;
+    }
+    if (!obj.public_key_change || obj.public_key_url == nullptr)
+    {
+        return 0;
+    }
+
+    HTTPClient &http = HTTP::client();
+    int content_length = HTTP::get_length(http, obj.public_key_url);
+    if (content_length < 0)
+    {
+        log_e("HTTP GET error code: %d", -content_length);
+        HTTP::close(http);
+        return 0;
+    }
+    if (content_length >= max_pubkey_size)
+    {
+        log_e("The %s_key.pub's length > %d", name, max_pubkey_size - 1);
+        HTTP::close(http);
+        return 0;
+    }
+    size_t read = http.getStream().readBytes(public_key, content_length);
+    http.end();
+    uint8_t named[SHA256::digest_len];
+    if (HTTP::content_digest(obj.public_key_url, named))
+    { // keys/<sha256>.pub: the key its URL names, whatever the cache or server in between
+        uint8_t digest[SHA256::digest_len];
+        SHA256::Hasher hasher;
+        hasher.update(public_key, read);
+        hasher.finish(digest);
+        if (read != (size_t)content_length || memcmp(digest, named, SHA256::digest_len) != 0)
+        {
+            log_e("The %s_key.pub isn't the content its URL names (SHA-256 mismatch)", name);
+            return 0;
+        }
+    }
+
+    public_key[content_length] = '\0'; // null terminated
+    return content_length + 1;
+}
+
+// The key ID of a role ("config" or "firmware") in the KeyStore. The first time: migrate the role's former PEM
+// (NVS "<role>"/"public_key", else the default rsa_pub_key) into the KeyStore.
+inline void init_role_key(const char *role, char *key_id)
+{
+    if (KeyStore::get_role(role, key_id))
+    {
+        return;
+    }
+    uint8_t pem[max_pubkey_size];
+    size_t pem_size = NVS::get_bytes(role, "public_key", pem, max_pubkey_size);
+    if (pem_size == 0)
+    {
+        pem_size = strlcpy((char *)pem, (char *)rsa_pub_key, max_pubkey_size) + 1;
+    }
+    if (KeyStore::add(pem, pem_size, key_id))
+    {
+        KeyStore::set_role(role, key_id);
+        NVS::remove(role, "public_key");
+    }
+    else
+    {
+        key_id[0] = '\0'; // no key --> every signature check fails
+    }
+}
+
+// Store the new key of a role (see get_new_pubkey()) in the KeyStore & switch the role to it
+inline void update_role_key(const Manifest::Section &obj, const char *role, char *key_id)
+{
+    uint8_t new_key[max_pubkey_size];
+    size_t new_key_size = get_new_pubkey(obj, role, new_key);
+    char new_id[KeyStore::key_id_size];
+    if (new_key_size > 0 && KeyStore::add(new_key, new_key_size, new_id))
+    {
+        KeyStore::set_role(role, new_id);
+        strlcpy(key_id, new_id, KeyStore::key_id_size);
+        log_i("The %s's pk updated! (key %s)", role, key_id);
+    }
+}
+
+// The key ID of a role, resolved (init_role_key()) on its first use: a signature check, not the boot
+class Role_Key
+{
+public:
+    explicit Role_Key(const char *role) : role(role) {}
+
+    const char *id() const
+    {
+        if (!resolved)
+        {
+            init_role_key(role, key_id);
+            resolved = true;
+        }
+        return key_id;
+    }
+
+    void update(const Manifest::Section &obj)
+    {
+        id(); // a former PEM is migrated first: replacing the role's key erases it
+        update_role_key(obj, role, key_id);
+    }
+
+private:
+    const char *role;
+    mutable char key_id[KeyStore::key_id_size]{};
+    mutable bool resolved{false};
+};
+
 // This struct hold config's params (corresponding to the "config" obj in config.json)
 struct Config_Params
 {
     char version[max_version_size];
     char url[max_url_size];
-    uint8_t public_key[max_pubkey_size];
-    size_t pubkey_size{max_pubkey_size}; // include the null-terminator
+    char mirrors[Mirrors::max_mirror_list_size]; // the other URLs of config.img (fallbacks), space-separated
+    char notify_url[max_url_size];               // the notifier's long-poll URL ("": none)
+    Role_Key key{"config"}; // the public key (DER) is loaded from the KeyStore when a signature is checked
 
     // Initialize the config's parameters from default constants or get them from NVS if existed.
     Config_Params()
     {
         strlcpy(version, default_conf_version, max_version_size);
         strlcpy(url, default_conf_url, max_url_size);
+        mirrors[0] = '\0';
+        notify_url[0] = '\0';
 
-        if(NVS::init_string("config", "version", version, max_version_size) == 0)
-        { // no "version" key --> empty NVS --> init using the default rsa_pub_key
-            pubkey_size = strlcpy((char *)public_key, (char *)rsa_pub_key, max_pubkey_size) + 1;
-        }
-        pubkey_size = NVS::init_bytes("config", "public_key", public_key, pubkey_size, max_pubkey_size);
-
-        NVS::init_string("config", "url", url, max_url_size);
+        NVS::Field fields[]{
+            {"version", version, max_version_size},
+            {"url", url, max_url_size},
+            {"mirrors", mirrors, Mirrors::max_mirror_list_size},
+            {"notify_url", notify_url, max_url_size},
+        };
+        NVS::load("config", fields);
     }
 
     // Need to check is_newer_version()? before this update
-    void update(const JsonObject &config_obj)
+    void update(const Manifest::Section &config_obj)
     {
-        strlcpy(version, config_obj["version"], max_version_size);
+        strlcpy(version, config_obj.version, max_version_size);
         NVS::update_string("config", "version", version);
 
-        if (config_obj["url_change?"])
+        if (config_obj.url_change && config_obj.url != nullptr)
         {
-            strlcpy(url, config_obj["url"], max_url_size);
+            strlcpy(url, config_obj.url, max_url_size);
             NVS::update_string("config", "url", url);
         }
 
-        if (config_obj["public_key_change?"])
+        char new_mirrors[Mirrors::max_mirror_list_size]; // the manifest's list replaces the kept one (none if null)
+        Mirrors::join(config_obj.mirrors, config_obj.mirror_count, new_mirrors, Mirrors::max_mirror_list_size);
+        if (config_obj.mirrors_set && strcmp(new_mirrors, mirrors) != 0)
+        {
+            strlcpy(mirrors, new_mirrors, Mirrors::max_mirror_list_size);
+            NVS::update_string("config", "mirrors", mirrors);
+        }
+
+        const char *new_notify_url = (config_obj.notify_url != nullptr) ? config_obj.notify_url : ""; // null: none
+        if (config_obj.notify_url_set && strcmp(new_notify_url, notify_url) != 0 && strlen(new_notify_url) < max_url_size)
         {
-            HTTPClient http;
-            int content_length = HTTP::get_length(http, config_obj["public_key_url"]);
-            if (content_length < 0)
-            {
-                log_e("HTTP GET error code: %d", -content_length);
-                return;
-            }
-            if (content_length >= max_pubkey_size)
-            {
-                log_e("The %s_key.pub's length > %d", "config", max_pubkey_size - 1);
-                return;
-            }
-            http.getStream().readBytes(public_key, content_length);
-            http.end();
-
-            public_key[content_length] = '\0'; // null terminated
-            NVS::update_bytes("config", "public_key", public_key, content_length + 1);
-            log_i("The %s's pk updated!", "config");
+            strlcpy(notify_url, new_notify_url, max_url_size);
+            NVS::update_string("config", "notify_url", notify_url);
         }
+
+        key.update(config_obj);
     }
 };
 
@@ -139,64 +393,81 @@ struct Config_Params
 struct Firmware_Params
 {
     char version[max_version_size];
-    uint8_t public_key[max_pubkey_size]; // the null-terminator included
-    size_t pubkey_size{max_pubkey_size}; // include the null-terminator
+    Role_Key key{"firmware"};        // the public key (DER) is loaded from the KeyStore when a signature is checked
+    char staged[max_version_size]{}; // the verified version waiting in the next OTA partition ("": none)
+    int activate_at{0};              // its activation time (Unix), 0: right away
 
     // Initialize config's or firmware's parameters from default constants or get them from NVS if existed.
     Firmware_Params()
     {
         strlcpy(version, default_firm_version, max_version_size);
 
-        if (NVS::init_string("firmware", "version", version, max_version_size) == 0)
-        { // no "version" key --> empty NVS --> copy the default rsa_pub_key
-            pubkey_size = strlcpy((char *)public_key, (char *)rsa_pub_key, max_pubkey_size) + 1;
-        }
-        pubkey_size = NVS::init_bytes("firmware", "public_key", public_key, pubkey_size, max_pubkey_size);
+        NVS::Field fields[]{
+            {"version", version, max_version_size},
+            {"staged", staged, max_version_size, false},
+            {"activate_at", activate_at, false},
+        };
+        NVS::load("firmware", fields);
     }
 
     // Check is_newer_config_version()? before this update --> prevent perpetual pk update, when `"public_key_change?": true`
-    void update_pubkey(const JsonObject &firmware_obj)
+    void update_pubkey(const Manifest::Section &firmware_obj)
     {
-        if (firmware_obj["public_key_change?"])
-        {
-            HTTPClient http;
-            int content_length = HTTP::get_length(http, firmware_obj["public_key_url"]);
-            if (content_length < 0)
-            {
-                log_e("HTTP GET error code: %d", -content_length);
-                return;
-            }
-            if (content_length >= max_pubkey_size)
-            {
-                log_e("The %s_key.pub's length > %d", "firmware", max_pubkey_size - 1);
-                return;
-            }
-            http.getStream().readBytes(public_key, content_length);
-            http.end();
-
-            public_key[content_length] = '\0'; // null terminated
-            NVS::update_bytes("firmware", "public_key", public_key, content_length + 1);
-            log_i("The %s's pk updated!", "firmware");
-        }
+        key.update(firmware_obj);
     }
 
     // Need to check is_newer_version()? before this update
-    void update_version(const JsonObject &firmware_obj)
+    void update_version(const Manifest::Section &firmware_obj)
     {
-        strlcpy(version, firmware_obj["version"], max_version_size);
+        strlcpy(version, firmware_obj.version, max_version_size);
         NVS::update_string("firmware", "version", version);
     }
-};
 
-enum class ConfigErr
-{
-    NoErr = 0,
-    InvalidSign,
-    InvalidSemver,
-    InvalidJsonFormat,
-    HttpGetErr,
-    NoVersion,
-    DeserializeErr,
+    // The next OTA partition holds the verified `staged_version`, to boot at `activation` (Unix time)
+    void update_staged(const char *staged_version, const uint32_t activation)
+    {
+        if (strcmp(staged, staged_version) != 0)
+        {
+            strlcpy(staged, staged_version, max_version_size);
+            NVS::update_string("firmware", "staged", staged);
+        }
+        if ((uint32_t)activate_at != activation)
+        {
+            activate_at = activation;
+            NVS::update_int("firmware", "activate_at", activate_at);
+        }
+    }
+
+    // The next OTA partition is about to be overwritten (or booted)
+    void clear_staged()
+    {
+        if (staged[0] != '\0')
+        {
+            staged[0] = '\0';
+            NVS::remove("firmware", "staged");
+        }
+    }
+
+    // Keep the verified image's signature & length (to share the firmware with LAN peers after rebooting into it)
+    static void save_image_info(const uint8_t *signature, const int fw_len)
+    {
+        const esp_partition_t *next_partition = esp_ota_get_next_update_partition(NULL);
+        NVS::update_bytes("firmware", "signature", signature, SIGN_LEN);
+        NVS::update_int("firmware", "fw_len", fw_len);
+        NVS::update_int("firmware", "fw_addr", next_partition->address);
+    }
+
+    // Get the running image's signature & length. Return false if unknown (e.g. first flashed over USB)
+    bool load_image_info(uint8_t *signature, int &fw_len) const
+    {
+        int fw_addr = -1;
+        NVS::Field fields[]{
+            {"fw_addr", fw_addr, false},
+            {"fw_len", fw_len, false},
+            {"signature", signature, SIGN_LEN},
+        };
+        return NVS::load("firmware", fields) == 3 && (uint32_t)fw_addr == esp_ota_get_running_partition()->address;
+    }
 };
 
 /*  - Check is_newer_config_version? --> update config's & device's params
@@ -208,10 +479,57 @@ class Config
 public:
     ConfigErr check_update(Device_Params &device);
     const char *translate_err(ConfigErr errCode);
+    // Try LAN peers holding the new firmware version before the origin URL
+    void use_lan_peers(LAN_Peers *peers) { lan_peers = peers; }
+    // Keep the notifier's target (the manifest's "notify_url", the applied config version) up to date
+    void use_notifier(Notifier *notifier) { this->notifier = notifier; }
+
+    // Boot the staged firmware if its activation time has come (ESP.restart()). Return false if none is due
+    bool activate_staged();
+    // Seconds until the staged firmware's activation (0: due). -1: none staged, or the clock isn't set yet
+    int32_t until_activation();
+    // Seconds until this device's stage slot for the last config.img's firmware (0: due, the next check_update() stages
+    // it). -1: none waiting, or the clock isn't set yet
+    int32_t until_staging();
+
+    // Seconds to the next poll: the server's Retry-After after a failed poll (429/503), else the live "poll" hint of the
+    // signed manifest, else the device's checking_interval. Within [min_poll_interval_s, max_poll_interval_s], but for
+    // the first interval of a new hint: a random part of it (a fleet that got it in one period doesn't poll in lockstep).
+    // Called once per poll
+    uint32_t next_poll_s(const Device_Params &device);
+
+    struct Stats
+    {
+        uint32_t polls{0};        // config.img fetched
+        uint32_t unchanged{0};    // same config.img (& config key) as the last settled one: verify & parse skipped
+        uint32_t verified{0};     // config.img signature checks (RSA verify + JSON parse)
+        uint32_t digest_us{0};    // time spent hashing config.img
+        uint32_t verify_us{0};    // time spent verifying & parsing config.img
+        uint32_t retry_afters{0}; // failed polls answered with a Retry-After
+        uint32_t poll_hints{0};   // "poll" hints applied
+    };
+    const Stats &get_stats() const { return stats; }
 
 private:
-    bool is_signature_valid(const uint8_t *pub_key, const size_t pk_len, const uint8_t *content, const size_t contentLen, const uint8_t *signature);
-    int get_img(uint8_t *signature, uint8_t *content, const char *config_url);
-    bool is_fw_signature_valid(const Firmware_Params &fw_params, const int fw_len, const uint8_t *signature);
-    bool update_firmware(const char *url, const Firmware_Params &fw_params);
+    LAN_Peers *lan_peers{nullptr};
+    Notifier *notifier{nullptr};
+    Stats stats;
+    uint32_t retry_after_s{0};   // of the last poll, 0: it succeeded (or no Retry-After)
+    uint32_t hint_interval_s{0}; // the manifest's "poll" hint, 0: none
+    uint32_t hint_until_ms{0};
+    uint32_t hint_phase_s{0};    // the first interval of a new hint, 0: taken
+    uint32_t deferred_stage_at{0}; // set by stage_firmware(): the firmware waits for the stage slot (Unix time), 0: not
+
+    ConfigErr poll_img(Device_Params &device, Config_Params &configParams, const char *base_version, uint8_t *signature, uint8_t *content);
+    ConfigErr apply_img(Device_Params &device, Config_Params &configParams, const uint8_t *signature, const uint8_t *signed_digest,
+                        uint8_t *content, const int contentLength, const bool reapply, bool &pending);
+
+    bool is_signature_valid(const char *key_id, const uint8_t *signed_digest, const uint8_t *signature);
+    int get_img(uint8_t *signature, uint8_t *content, const char *config_url, const char *base_version, uint8_t *catalog_digest, bool &is_catalog);
+    bool is_fw_image_valid(const Manifest::Section &firmware_obj, const Firmware_Params &fw_params, const int fw_len, const uint8_t *signature);
+    bool stage_firmware(const Manifest &manifest, Firmware_Params &fw_params);
+    void apply_poll_hint(const Manifest::Poll &poll);
+    bool activate_staged(Firmware_Params &fw_params);
+    bool update_firmware(const char *const *urls, const uint8_t url_count, const Manifest &manifest, const Firmware_Params &fw_params);
+    bool update_firmware_multicast(const Manifest &manifest, const Firmware_Params &fw_params);
 };
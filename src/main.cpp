@@ -2,7 +2,7 @@
   Secured Over The Air Config:
   - using semver.c
   - using arduinojson6 with the String container
-  - using Periodic_Timer(duration, callback_function);
+  - using TimerScheduler (timers.every(interval_ms, callback_function, context));
 */
 
 /*
@@ -26,39 +26,91 @@
 */
 #include <Arduino.h>
 #include "wifi_config.h"
-#include "PeriodicTimer.h"
+#include "TimerScheduler.h"
 #include "configOTASecure.h"
 
 Device_Params device;
 Config config;
-void check_config();
-PeriodicTimer timer(check_config);
+TimerScheduler<> timers;
+TimerScheduler<>::TimerId check_timer;
+TimerScheduler<>::TimerId activation_timer;
+LAN_Peers lan_peers;
+Notifier notifier;
 
-void check_config()
+constexpr const uint32_t max_activation_wait_s = 3600; // re-checked hourly: below the timers' 2^31 ms limit
+
+// Time the activation of a staged firmware (a scheduled release) to the second, between the polls
+void schedule_activation()
+{
+    int32_t wait_s = config.until_activation();
+    uint32_t interval_s = (wait_s < 0) ? max_activation_wait_s : min((uint32_t)wait_s, max_activation_wait_s);
+    timers.set_interval(activation_timer, max(interval_s, (uint32_t)1) * 1000UL);
+}
+
+void activate_firmware(void *)
+{
+    config.activate_staged(); // reboots if due
+    schedule_activation();
+}
+
+void check_config(void *)
 {
     ConfigErr err = config.check_update(device);
     if (err != ConfigErr::NoErr)
     {
         Serial.println(config.translate_err(err));
     }
+    // the new config's checking_interval, its poll hint, or the server's Retry-After; a safety net while pushed
+    uint32_t interval_s = config.next_poll_s(device);
+    if (notifier.is_up())
+        interval_s = max(interval_s, Notifier::backstop_poll_s);
+    int32_t stage_in_s = config.until_staging(); // a scheduled release: check (& stage) at this device's slot
+    if (stage_in_s >= 0)
+        interval_s = min(interval_s, max((uint32_t)stage_in_s, (uint32_t)1));
+    timers.set_interval(check_timer, interval_s * 1000UL);
+    schedule_activation(); // a firmware may have been staged
+}
+
+void announce_firmware(void *)
+{
+    lan_peers.announce();
 }
 
 void setup()
 {
     Serial.begin(115200);
     setup_wifi(1);
+    configTime(0, 0, "pool.ntp.org", "time.google.com"); // SNTP: the activation times of the staged firmware
 
+    device.load();
     Config_Params configParams;
     Serial.printf("Config version: %s\n", configParams.version);
 
     Firmware_Params firmwareParams;
     Serial.printf("Fimrwave version: %s\n", firmwareParams.version);
     Serial.printf("device's checking_interval: %d\n", device.checking_interval);
+
+    uint8_t fw_signature[SIGN_LEN];
+    int fw_len = 0;
+    size_t sign_len = firmwareParams.load_image_info(fw_signature, fw_len) ? SIGN_LEN : 0;
+    lan_peers.begin(device_type, firmwareParams.version, fw_signature, sign_len, fw_len);
+    lan_peers.announce(); // a firmware just verified & booted: the peers may fetch it from now on
+    config.use_lan_peers(&lan_peers);
+
+    notifier.set_target(configParams.notify_url, configParams.version);
+    notifier.begin([](void *)
+                   { timers.wake(); }); // loop() takes the notification
+    config.use_notifier(&notifier);
+
+    check_timer = timers.every(config.next_poll_s(device) * 1000UL, check_config);
+    timers.every(30 * 1000UL, announce_firmware);
+    activation_timer = timers.every(max_activation_wait_s * 1000UL, activate_firmware);
 }
 
 void loop()
 {
     // put your main code here, to run repeatedly:
-    delay(10); // this speeds up the simulation
-    timer.loop(device.checking_interval);
+    if (notifier.take())
+        timers.trigger_now(check_timer); // a new config is published: check it now
+    timers.loop(); // runs the due timers, then sleeps until the next deadline
 }
@@ -0,0 +1,310 @@
+/*
+  Native (Linux) entry point of the `native` environment: one check_update() cycle of the OTA core on lib/native_hal
+  (NVS & flash emulated in files, HTTP on sockets), e.g. against a local tools/update_server.
+  - Usage: .pio/build/native/program [config_url] [polls=1]   (plain http only)
+  - State (NVS, flash.bin): $OTA_STATE_DIR, .pio/native_state by default. OTA_FLASH_TIMING=0: no flash delays.
+  - A successful firmware update ends with ESP.restart() --> exit(0), the next run boots from the new partition.
+  - OTA_TRUST_KEY=<pem>: trust the key of a local test publication (config & firmware), instead of rsa_pub_key.h's.
+  - OTA_LINK_KBPS=<kB/s>, OTA_LINK_FAIL_RATE=<fraction>: a slow, failing link (lib/native_hal's WiFiClient).
+  - OTA_SENSOR_PERIOD_MS=<ms>: a simulated periodic sensor task runs alongside (e.g. during a firmware update paced
+    by the manifest's "budget"), its release jitter & deadline misses are printed at the end.
+  - OTA_WATCH_S=<s>: the device's main loop for that long instead of the polls (like src/main.cpp): the periodic
+    checks, the activation of a staged firmware, and the push channel of the manifest's "notify_url"
+    (tools/ota_notifier.py). Each check is printed with its Unix time & its cause (poll or push): the discovery latency
+    of a publication, the idle traffic.
+    With OTA_LAN_PORT=<port> it also shares its firmware with the LAN peers (src/utils/lan_peers.h) on that port, and
+    fetches from them first: with OTA_LOCAL_IP=127.x.y.z (lib/native_hal), processes on one host are the devices of a
+    LAN (tools/fleet_loadgen.py --native --lan).
+  - The boot (src/main.cpp's setup() reads) is printed per phase: its time & NVS accesses (opens, reads, entry scans,
+    writes: the defaults stored on the first boot). The public keys aren't read before the first check_update().
+*/
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WiFiClient.h>
+#include <atomic>
+#include <chrono>
+#include "flash_emulator.h"
+#include "../TimerScheduler.h"
+#include "../configOTASecure.h"
+
+namespace
+{
+    constexpr const uint32_t sensor_work_us = 200;        // reading & filtering a sample
+    constexpr const uint32_t max_activation_wait_s = 3600; // as src/main.cpp
+    constexpr const uint32_t lan_announce_s = 30;          // as src/main.cpp
+
+    uint32_t start_us;
+    Config *checked_config{nullptr}; // its stats are printed at exit (also on ESP.restart())
+    uint32_t phase_us;
+    Preferences::Stats phase_nvs;
+
+    // The time & NVS accesses since the previous phase
+    void boot_phase(const char *name)
+    {
+        const Preferences::Stats &nvs = Preferences::stats();
+        printf("boot: %-10s %6.2f ms, nvs: %u opens, %u reads, %u scans, %u writes\n", name, (micros() - phase_us) / 1000.0,
+               nvs.opens - phase_nvs.opens, nvs.reads - phase_nvs.reads, nvs.scans - phase_nvs.scans,
+               nvs.writes - phase_nvs.writes);
+        phase_nvs = nvs;
+        phase_us = micros();
+    }
+
+    // Released every period_ms, due by the next release. Its code "runs from flash": it stalls while the flash is
+    // erased or programmed (FlashEmulator::wait_cache()), like a task on the ESP32 during an OTA write
+    struct Sensor
+    {
+        uint32_t period_ms{0};
+        std::atomic<uint32_t> samples{0};
+        std::atomic<uint32_t> misses{0};
+        std::atomic<uint32_t> max_jitter_us{0};
+        std::atomic<uint64_t> total_jitter_us{0};
+    } sensor;
+
+    void sensor_task(void *)
+    {
+        TickType_t release = xTaskGetTickCount();
+        for (;;)
+        {
+            vTaskDelayUntil(&release, pdMS_TO_TICKS(sensor.period_ms));
+            uint32_t release_us = release * portTICK_PERIOD_MS * 1000U;
+            FlashEmulator::wait_cache();
+            uint32_t jitter_us = max((int32_t)(micros() - release_us), 0);
+            uint32_t work_start_us = micros();
+            while (micros() - work_start_us < sensor_work_us)
+            {
+            }
+            if (micros() - release_us > sensor.period_ms * 1000U)
+                sensor.misses++;
+            sensor.samples++;
+            sensor.total_jitter_us += jitter_us;
+            if (jitter_us > sensor.max_jitter_us)
+                sensor.max_jitter_us = jitter_us;
+        }
+    }
+
+    // The device's main loop of src/main.cpp, for OTA_WATCH_S
+    struct Watch
+    {
+        TimerScheduler<> timers;
+        TimerScheduler<>::TimerId check_timer;
+        TimerScheduler<>::TimerId activation_timer;
+        Notifier notifier;
+        LAN_Peers lan_peers;
+        bool sharing{false}; // OTA_LAN_PORT
+        Config config;
+        Device_Params *device;
+        bool pushed{false}; // the check is due to a notification
+        bool done{false};
+    } *watch;
+
+    double unix_time()
+    {
+        using namespace std::chrono;
+        return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count() / 1000.0;
+    }
+
+    // src/main.cpp's schedule_activation()
+    void watch_schedule_activation()
+    {
+        int32_t wait_s = watch->config.until_activation();
+        uint32_t interval_s = (wait_s < 0) ? max_activation_wait_s : min((uint32_t)wait_s, max_activation_wait_s);
+        watch->timers.set_interval(watch->activation_timer, max(interval_s, (uint32_t)1) * 1000UL);
+    }
+
+    void print_config_stats(Config &config)
+    {
+        const Config::Stats &stats = config.get_stats();
+        printf("config.img: %u polls, %u unchanged, %u verified; %.2f ms/digest, %.2f ms/verify+parse\n",
+               stats.polls, stats.unchanged, stats.verified, stats.polls ? stats.digest_us / 1000.0 / stats.polls : 0.0,
+               stats.verified ? stats.verify_us / 1000.0 / stats.verified : 0.0);
+        printf("polling: %u Retry-After, %u poll hints\n", stats.retry_afters, stats.poll_hints);
+    }
+
+    void watch_check(void *)
+    {
+        ConfigErr err = watch->config.check_update(*watch->device);
+        uint32_t interval_s = watch->config.next_poll_s(*watch->device);
+        if (watch->notifier.is_up())
+            interval_s = max(interval_s, Notifier::backstop_poll_s);
+        int32_t stage_in_s = watch->config.until_staging();
+        if (stage_in_s >= 0)
+            interval_s = min(interval_s, max((uint32_t)stage_in_s, (uint32_t)1));
+        watch->timers.set_interval(watch->check_timer, interval_s * 1000UL);
+        watch_schedule_activation(); // a firmware may have been staged
+        Config_Params configParams;
+        printf("[%.3f] check_update (%s): %s, config %s, next poll in %u s\n", unix_time(), watch->pushed ? "push" : "poll",
+               watch->config.translate_err(err), configParams.version, interval_s);
+        fflush(stdout);
+        watch->pushed = false;
+    }
+
+    void watch_updates(Device_Params &device, const uint32_t duration_s)
+    {
+        watch = new Watch;
+        watch->device = &device;
+        Config_Params configParams;
+        watch->notifier.set_target(configParams.notify_url, configParams.version);
+        watch->notifier.begin([](void *)
+                              { watch->timers.wake(); });
+        watch->config.use_notifier(&watch->notifier);
+        checked_config = &watch->config;
+        const char *lan_port = getenv("OTA_LAN_PORT");
+        if (lan_port != nullptr && atoi(lan_port) > 0)
+        {
+            Firmware_Params firmwareParams;
+            uint8_t fw_signature[SIGN_LEN];
+            int fw_len = 0;
+            size_t sign_len = firmwareParams.load_image_info(fw_signature, fw_len) ? SIGN_LEN : 0;
+            watch->sharing = watch->lan_peers.begin(device_type, firmwareParams.version, fw_signature, sign_len, fw_len,
+                                                    atoi(lan_port));
+            watch->lan_peers.announce(); // as src/main.cpp's setup()
+            watch->config.use_lan_peers(&watch->lan_peers);
+            watch->timers.every(lan_announce_s * 1000UL, [](void *)
+                                { watch->lan_peers.announce(); });
+        }
+        watch->check_timer = watch->timers.every(watch->config.next_poll_s(device) * 1000UL, watch_check);
+        watch->timers.trigger_now(watch->check_timer); // the first check at once
+        watch->activation_timer = watch->timers.every(max_activation_wait_s * 1000UL, [](void *)
+                                                      {
+                                                          watch->config.activate_staged(); // reboots if due
+                                                          watch_schedule_activation(); });
+        watch->timers.after(duration_s * 1000UL, [](void *)
+                            { watch->done = true; });
+        while (!watch->done)
+        {
+            if (watch->notifier.take())
+            {
+                watch->pushed = true;
+                watch->timers.trigger_now(watch->check_timer);
+            }
+            watch->timers.loop();
+        }
+        const Notifier::Stats &stats = watch->notifier.get_stats();
+        printf("notifier: %u long-polls, %u notifications, %u idle, %u errors\n", stats.requests, stats.notifications,
+               stats.idle, stats.errors);
+    }
+
+    void print_stats()
+    {
+        if (watch != nullptr && watch->sharing)
+        {
+            const LAN_Peers::Stats &peers = watch->lan_peers.get_stats();
+            printf("lan peers: %llu bytes served in %u requests\n", (unsigned long long)peers.bytes_served, peers.served);
+        }
+        const FlashEmulator::Stats &flash = FlashEmulator::stats();
+        const Preferences::Stats &nvs = Preferences::stats();
+        printf("total: %.1f ms\n", (micros() - start_us) / 1000.0);
+        if (checked_config != nullptr)
+            print_config_stats(*checked_config);
+        printf("flash: %u sector erases, %u block erases, %llu bytes programmed, %llu bytes read, %.1f ms busy\n",
+               flash.sector_erases, flash.block_erases, (unsigned long long)flash.bytes_programmed,
+               (unsigned long long)flash.bytes_read, flash.busy_us / 1000.0);
+        printf("nvs: %u opens, %u reads, %u scans, %u writes\n", nvs.opens, nvs.reads, nvs.scans, nvs.writes);
+        const HTTP::Stats &http = HTTP::stats();
+        printf("http: %u requests, %u connects, %u reused, %u connect errors\n", http.requests, http.connects,
+               http.reuses, http.connect_errors);
+        const WiFiClient::LinkStats &link = WiFiClient::link_stats();
+        printf("link: %llu bytes received, %u injected failures\n", (unsigned long long)link.bytes_received.load(),
+               link.injected_failures.load());
+        uint8_t host_count;
+        const Mirrors::Host *hosts = Mirrors::hosts(host_count);
+        for (uint8_t i = 0; i < host_count; i++)
+        {
+            printf("mirror %s: rtt %.1f ms, %.1f KB/s, %u failures\n", hosts[i].origin, hosts[i].rtt_us / 1000.0,
+                   hosts[i].bytes_per_s / 1024.0, hosts[i].failures);
+        }
+        uint32_t samples = sensor.samples;
+        if (samples > 0)
+        {
+            printf("sensor: %u samples every %u ms, jitter %.2f ms mean / %.2f ms max, %u deadline misses (%.1f%%)\n",
+                   samples, sensor.period_ms, sensor.total_jitter_us / 1000.0 / samples, sensor.max_jitter_us / 1000.0,
+                   (unsigned)sensor.misses, 100.0 * sensor.misses / samples);
+        }
+    }
+
+    // OTA_TRUST_KEY: a PEM file as the former key of both roles (see init_role_key())
+    void provision_key(const char *path)
+    {
+        uint8_t pem[max_pubkey_size];
+        FILE *file = fopen(path, "rb");
+        size_t len = file ? fread(pem, 1, max_pubkey_size - 1, file) : 0;
+        if (file)
+            fclose(file);
+        if (len == 0)
+        {
+            printf("OTA_TRUST_KEY: can't read %s\n", path);
+            exit(1);
+        }
+        pem[len] = '\0';
+        for (const char *role : {"config", "firmware"})
+        {
+            char key_id[KeyStore::key_id_size];
+            if (!KeyStore::get_role(role, key_id))
+                NVS::update_bytes(role, "public_key", pem, len + 1);
+        }
+    }
+}
+
+#ifndef PIO_UNIT_TESTING // `pio test -e native` links the sources with the tests' main()
+
+int main(int argc, char **argv)
+{
+    start_us = micros();
+    setvbuf(stdout, nullptr, _IOLBF, 0); // the log as it happens, also into a pipe (tools/fleet_loadgen.py --native)
+    atexit(print_stats);                 // also on ESP.restart()
+    const char *sensor_period = getenv("OTA_SENSOR_PERIOD_MS");
+    if (sensor_period != nullptr && atoi(sensor_period) > 0)
+    {
+        sensor.period_ms = atoi(sensor_period);
+        xTaskCreate(sensor_task, "sensor", 4096, nullptr, 2, nullptr);
+    }
+
+    if (argc > 1)
+    {
+        NVS::update_string("config", "url", argv[1]);
+    }
+    const char *trust_key = getenv("OTA_TRUST_KEY");
+    if (trust_key != nullptr)
+    {
+        provision_key(trust_key);
+    }
+
+    // the reads of src/main.cpp's setup()
+    phase_us = micros();
+    phase_nvs = Preferences::stats();
+    Device_Params device;
+    device.load();
+    boot_phase("device");
+    Config_Params configParams;
+    boot_phase("config");
+    Firmware_Params firmwareParams;
+    boot_phase("firmware");
+    uint8_t fw_signature[SIGN_LEN];
+    int fw_len = 0;
+    bool has_image_info = firmwareParams.load_image_info(fw_signature, fw_len);
+    boot_phase("image info");
+    printf("Config version: %s, firmware version: %s, running partition: %s%s\n", configParams.version,
+           firmwareParams.version, esp_ota_get_running_partition()->label, has_image_info ? " (signed image)" : "");
+    printf("boot: %.1f ms\n", (micros() - start_us) / 1000.0);
+
+    const char *watch_s = getenv("OTA_WATCH_S");
+    if (watch_s != nullptr && atoi(watch_s) > 0)
+    {
+        watch_updates(device, atoi(watch_s));
+        return 0;
+    }
+
+    static Config config; // printed at exit
+    checked_config = &config;
+    ConfigErr err = ConfigErr::NoErr;
+    int polls = (argc > 2) ? atoi(argv[2]) : 1;
+    for (int i = 0; i < polls; i++)
+    {
+        uint32_t check_us = micros();
+        err = config.check_update(device);
+        printf("check_update: %s (%.1f ms), next poll in %u s\n", config.translate_err(err),
+               (micros() - check_us) / 1000.0, config.next_poll_s(device));
+    }
+    return err == ConfigErr::NoErr ? 0 : 1;
+}
+#endif
@@ -0,0 +1,116 @@
+#include "catalog.h"
+
+namespace
+{
+    // Compare an index record with (type, hw_rev), like strcmp
+    int compare(const uint8_t *record, const char *type, const uint8_t hw_rev)
+    {
+        int cmp = strncmp((const char *)record, type, Catalog::type_size);
+        return cmp != 0 ? cmp : (int)record[Catalog::type_size] - (int)hw_rev;
+    }
+
+    bool search(const uint8_t *index, const uint8_t count, const char *type, const uint8_t hw_rev, Catalog::Entry &entry)
+    {
+        int low = 0, high = (int)count - 1;
+        while (low <= high)
+        {
+            int mid = (low + high) / 2;
+            const uint8_t *record = index + mid * Catalog::index_entry_size;
+            int cmp = compare(record, type, hw_rev);
+            if (cmp == 0)
+            {
+                const uint8_t *field = record + Catalog::type_size + 2;
+                entry.offset = field[0] | (field[1] << 8) | (field[2] << 16) | ((uint32_t)field[3] << 24);
+                entry.len = field[4] | (field[5] << 8);
+                return true;
+            }
+            if (cmp < 0)
+                low = mid + 1;
+            else
+                high = mid - 1;
+        }
+        return false;
+    }
+
+    // Read & hash `len` bytes of the stream into `buf` (nullptr: discard them). Return false if truncated
+    bool read_hashed(Stream &stream, SHA256::Hasher &hasher, uint8_t *buf, size_t len)
+    {
+        uint8_t chunk[256];
+        while (len > 0)
+        {
+            size_t n = (buf != nullptr) ? len : min(len, sizeof(chunk));
+            uint8_t *dest = (buf != nullptr) ? buf : chunk;
+            if (stream.readBytes(dest, n) != n)
+            {
+                return false;
+            }
+            hasher.update(dest, n);
+            len -= n;
+        }
+        return true;
+    }
+}
+
+namespace Catalog
+{
+    bool find(const uint8_t *index, const uint8_t count, const char *type, const uint8_t hw_rev, Entry &entry)
+    {
+        if (strlen(type) >= type_size)
+        {
+            return false;
+        }
+        return search(index, count, type, hw_rev, entry) || (hw_rev != 0 && search(index, count, type, 0, entry));
+    }
+
+    int read_entry(Stream &stream, const size_t len, const char *type, const uint8_t hw_rev, const uint8_t max_count,
+                   uint8_t *content, const size_t max_content_size, uint8_t *digest)
+    {
+        SHA256::Hasher hasher;
+        hasher.update(content, sizeof(magic));
+        uint8_t header[header_size - sizeof(magic)];
+        if (len < header_size || !read_hashed(stream, hasher, header, sizeof(header)))
+        {
+            return -1;
+        }
+        const uint8_t count = header[0];
+        const size_t index_len = count * index_entry_size;
+        const size_t entries_pos = header_size + index_len;
+        if (count == 0 || count > max_count || index_len > max_content_size || entries_pos > len)
+        {
+            log_e("Catalog: %u entries (max %u) in %u bytes", count, max_count, (unsigned)len);
+            return -1;
+        }
+
+        // the index is kept in `content` until the entry replaces it
+        Entry entry;
+        if (!read_hashed(stream, hasher, content, index_len))
+        {
+            return -1;
+        }
+        if (!find(content, count, type, hw_rev, entry))
+        {
+            log_e("Catalog: no entry for %s (hardware rev. %u)", type, hw_rev);
+            return 0;
+        }
+        if (entry.offset < entries_pos || entry.offset + entry.len > len || entry.len == 0)
+        {
+            log_e("Catalog: the entry of %s is out of bounds", type);
+            return -1;
+        }
+        if (entry.len > max_content_size)
+        {
+            log_e("Catalog: the entry of %s > %u bytes", type, (unsigned)max_content_size);
+            return 0;
+        }
+
+        if (!read_hashed(stream, hasher, nullptr, entry.offset - entries_pos) ||
+            !read_hashed(stream, hasher, content, entry.len) ||
+            !read_hashed(stream, hasher, nullptr, len - entry.offset - entry.len))
+        {
+            log_e("Catalog: truncated");
+            return -1;
+        }
+        hasher.finish(digest);
+        return entry.len;
+    }
+}
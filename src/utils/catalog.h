@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+
+#include "sha256_utilities.h"
+
+// A signed catalog: the manifests (config.json or binary) of several device types / hardware revisions in one
+// catalog.img (signature + catalog), built by tools/ota_catalog.py. A device keeps only its own entry.
+// - header: magic "OTC\x01", count (1 byte), reserved (1 byte)
+// - index: count records of index_entry_size, sorted by (type, hw_rev):
+//   type (type_size bytes, null-padded), hw_rev (1 byte, 0: any revision), reserved (1 byte),
+//   offset (4 bytes LE, from the catalog's first byte), length (2 bytes LE)
+// - the entries (the manifests), after the index
+namespace Catalog
+{
+    constexpr const uint8_t magic[] = {'O', 'T', 'C', 1};
+    constexpr const size_t header_size = sizeof(magic) + 2;
+    constexpr const size_t type_size = 32;
+    constexpr const size_t index_entry_size = type_size + 8;
+
+    struct Entry
+    {
+        uint32_t offset;
+        uint16_t len;
+    };
+
+    // Binary search of the index (`count` records) for (type, hw_rev), else (type, 0). Return false if not found
+    bool find(const uint8_t *index, const uint8_t count, const char *type, const uint8_t hw_rev, Entry &entry);
+
+    // Read a catalog of `len` bytes whose magic is already read into `content`: keep the entry of (type, hw_rev) in
+    // `content`, skip the others, SHA-256 the whole catalog into `digest` (to check the signature).
+    // Return the entry's length, 0 if no entry (or > max_content_size), -1 if the catalog is malformed or truncated.
+    int read_entry(Stream &stream, const size_t len, const char *type, const uint8_t hw_rev, const uint8_t max_count,
+                   uint8_t *content, const size_t max_content_size, uint8_t *digest);
+}
@@ -1,25 +1,262 @@
 #include "http_utilities.h"
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+
+#include "../ca_cert.h"
+#include "sha256_utilities.h"
+
+namespace
+{
+    constexpr const size_t sha256_hex_len = 64;
+
+    // The "<sha256>" of a URL's last path segment ("<sha256>" or "<sha256>.<ext>"), nullptr if none
+    const char *digest_segment(const char *url)
+    {
+        const char *end = strpbrk(url, "?#");
+        if (end == nullptr)
+            end = url + strlen(url);
+        const char *segment = end;
+        while (segment > url && *(segment - 1) != '/')
+            segment--;
+
+        size_t hex_len = 0;
+        while (segment + hex_len < end && isxdigit((unsigned char)segment[hex_len]))
+            hex_len++;
+        return (hex_len == sha256_hex_len && (segment + hex_len == end || segment[hex_len] == '.')) ? segment : nullptr;
+    }
+
+    // The persistent connection behind HTTP::client()
+    struct Connection
+    {
+        HTTPClient http;
+        WiFiClient tcp;
+        WiFiClientSecure tls;
+        WiFiClient *connected{nullptr}; // tcp, tls or none
+        char host[HTTP::max_host_size]{};
+        uint16_t port{0};
+
+        Connection()
+        {
+            tls.setCACert(https_ca_cert); // verified in the handshake: no unauthenticated HTTPS
+        }
+    };
+
+    Connection &connection()
+    {
+        static Connection conn;
+        return conn;
+    }
+
+    HTTP::Stats stats;
+
+    // The resolved addresses of the plain-http hosts (the TLS client connects by name: SNI & the certificate check)
+    constexpr const uint8_t max_dns_entries = 4;
+    constexpr const uint32_t dns_ttl_ms = 5 * 60 * 1000UL;
+
+    struct Dns_Entry
+    {
+        char host[HTTP::max_host_size];
+        IPAddress ip;
+        uint32_t resolved_ms;
+    };
+    Dns_Entry dns_cache[max_dns_entries];
+
+    bool connect_tcp(WiFiClient &tcp, const char *host, const uint16_t port)
+    {
+        uint32_t now = millis();
+        Dns_Entry *entry = nullptr;
+        Dns_Entry *oldest = &dns_cache[0];
+        for (Dns_Entry &e : dns_cache)
+        {
+            if (strcmp(e.host, host) == 0)
+                entry = &e;
+            if (e.host[0] == '\0' || (oldest->host[0] != '\0' && now - e.resolved_ms > now - oldest->resolved_ms))
+                oldest = &e;
+        }
+        if (entry != nullptr && now - entry->resolved_ms < dns_ttl_ms)
+        {
+            stats.dns_cached++;
+            if (tcp.connect(entry->ip, port))
+                return true;
+            entry->host[0] = '\0'; // the host may have moved: resolve it again
+        }
+
+        IPAddress ip;
+        stats.dns_lookups++;
+        if (!WiFi.hostByName(host, ip))
+        {
+            log_e("DNS lookup failed: %s", host);
+            return false;
+        }
+        if (entry == nullptr)
+            entry = oldest;
+        strlcpy(entry->host, host, HTTP::max_host_size);
+        entry->ip = ip;
+        entry->resolved_ms = now;
+        return tcp.connect(ip, port);
+    }
+
+    // Begin a request: on the kept connection if it's open to the same host, else on a new one (timed).
+    // Another HTTPClient than HTTP::client(): a connection per request. `reused`: the connection is reused.
+    // Return false if the connection failed (nothing to send the request on)
+    bool begin(HTTPClient &httpClient, const char *url, bool &reused)
+    {
+        Connection &conn = connection();
+        bool https;
+        char host[HTTP::max_host_size];
+        uint16_t port;
+        reused = false;
+        if (&httpClient != &conn.http || !HTTP::parse_origin(url, https, host, port))
+        {
+            return httpClient.begin(url);
+        }
+
+        stats.requests++;
+        WiFiClient &client = https ? (WiFiClient &)conn.tls : conn.tcp;
+        reused = conn.connected == &client && port == conn.port && strcmp(host, conn.host) == 0 && client.connected();
+        if (reused)
+        {
+            stats.reuses++;
+        }
+        else
+        {
+            if (conn.connected != nullptr)
+                conn.connected->stop();
+            conn.connected = nullptr;
+            uint32_t start_us = micros();
+            if (https ? conn.tls.connect(host, port) : connect_tcp(conn.tcp, host, port))
+            {
+                stats.connects++;
+                if (https)
+                {
+                    stats.handshakes++;
+                    stats.handshake_us += micros() - start_us;
+                }
+                conn.connected = &client;
+                strlcpy(conn.host, host, HTTP::max_host_size);
+                conn.port = port;
+            }
+            else
+            {
+                stats.connect_errors++;
+                log_e("Connecting to %s:%u failed%s", host, port, https ? " (is the server's CA pinned in ca_cert.cpp?)" : "");
+                return false;
+            }
+        }
+        httpClient.setReuse(true);
+        return httpClient.begin(client, url);
+    }
+
+    // Let the CDN/proxy caches serve the immutable artifacts, revalidate the mutable ones (config.img ...)
+    void add_cache_control(HTTPClient &httpClient, const char *url)
+    {
+        if (!HTTP::is_content_addressed(url))
+        {
+            // httpClient.addHeader("Cache-Control", "no-cache");
+            // httpClient.addHeader("Cache-Control", "max-age=0, private, must-revalidate");
+            httpClient.addHeader("Cache-Control", "no-cache, max-age=5");
+        }
+    }
+
+    constexpr const uint32_t max_retry_after_s = 24 * 3600UL;
+    uint32_t last_retry_after_s = 0;
+
+    // A server under load (429 Too Many Requests, 503 Service Unavailable) may tell when to come back
+    void read_retry_after(HTTPClient &httpClient, const int responseCode)
+    {
+        last_retry_after_s = 0;
+        if (responseCode != 429 && responseCode != 503)
+            return;
+        String value = httpClient.header("Retry-After");
+        value.trim();
+        if (value.length() > 0 && value.length() <= 9 && strspn(value.c_str(), "0123456789") == value.length())
+            last_retry_after_s = min((uint32_t)value.toInt(), max_retry_after_s);
+    }
+}
 
 namespace HTTP
 {
+    HTTPClient &client()
+    {
+        return connection().http;
+    }
+
+    const Stats &stats()
+    {
+        return ::stats;
+    }
+
+    void close(HTTPClient &httpClient)
+    {
+        httpClient.end();
+        Connection &conn = connection();
+        if (&httpClient == &conn.http && conn.connected != nullptr)
+        {
+            conn.connected->stop();
+            conn.connected = nullptr;
+        }
+    }
+
+    bool parse_origin(const char *url, bool &https, char *host, uint16_t &port)
+    {
+        https = strncmp(url, "https://", 8) == 0;
+        if (!https && strncmp(url, "http://", 7) != 0)
+            return false;
+        const char *start = url + (https ? 8 : 7);
+        size_t len = strcspn(start, ":/?#");
+        if (len == 0 || len >= max_host_size)
+            return false;
+        memcpy(host, start, len);
+        host[len] = '\0';
+        port = (start[len] == ':') ? atoi(start + len + 1) : (https ? 443 : 80);
+        return true;
+    }
+
+    bool is_content_addressed(const char *url)
+    {
+        return digest_segment(url) != nullptr;
+    }
+
+    bool content_digest(const char *url, uint8_t *digest)
+    {
+        const char *segment = digest_segment(url);
+        return segment != nullptr && SHA256::from_hex(segment, sha256_hex_len, digest);
+    }
+
+    uint32_t retry_after_s()
+    {
+        return last_retry_after_s;
+    }
+
     // perform a GET request and return the content's length. 
     int get_length(HTTPClient &httpClient, const char *url)
     {
-        httpClient.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-        httpClient.begin(url);
-        // httpClient.addHeader("Cache-Control", "no-cache");
-        // httpClient.addHeader("Cache-Control", "max-age=0, private, must-revalidate");
-        httpClient.addHeader("Cache-Control", "no-cache, max-age=5");
+        int responseCode;
+        for (int attempt = 0; attempt < 2; attempt++) // a 2nd one on a new connection if the kept one was closed
+        {
+            httpClient.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+            bool reused;
+            if (!begin(httpClient, url, reused))
+            {
+                last_retry_after_s = 0;
+                return HTTPC_ERROR_CONNECTION_REFUSED;
+            }
+            add_cache_control(httpClient, url);
 
-        const char *headerKeys[]{"Content-Length"};
-        httpClient.collectHeaders(headerKeys, 1);
-        log_i("GET %s ...", url);
-        int responseCode = httpClient.GET();
+            const char *headerKeys[]{"Content-Length", "Retry-After"};
+            httpClient.collectHeaders(headerKeys, 2);
+            log_i("GET %s ...", url);
+            responseCode = httpClient.GET();
+            if (responseCode >= 0 || !reused)
+                break;
+            close(httpClient); // the kept connection was closed by the server meanwhile
+        }
+        read_retry_after(httpClient, responseCode);
 
         if (responseCode != 200)
         {
             log_i("HTTP Error Code: %d", responseCode);
-            return -responseCode;
+            return (responseCode < 0) ? responseCode : -responseCode; // < 0 either way
         }
         else
             return httpClient.header("Content-Length").toInt();
@@ -32,4 +269,45 @@ namespace HTTP
         url += ext;
         return get_length(httpClient, url.c_str());
     }
+
+    // perform a GET request of the bytes [first, last] and return the content's length, the whole length is put in *total_len
+    int get_range(HTTPClient &httpClient, const char *url, const uint32_t first, const uint32_t last, uint32_t *total_len)
+    {
+        char range[40];
+        snprintf(range, sizeof(range), "bytes=%u-%u", first, last);
+        int responseCode;
+        for (int attempt = 0; attempt < 2; attempt++) // a 2nd one on a new connection if the kept one was closed
+        {
+            httpClient.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+            bool reused;
+            if (!begin(httpClient, url, reused))
+            {
+                last_retry_after_s = 0;
+                return HTTPC_ERROR_CONNECTION_REFUSED;
+            }
+            add_cache_control(httpClient, url);
+            httpClient.addHeader("Range", range);
+
+            const char *headerKeys[]{"Content-Length", "Content-Range", "Retry-After"};
+            httpClient.collectHeaders(headerKeys, 3);
+            log_i("GET %s (%s) ...", url, range);
+            responseCode = httpClient.GET();
+            if (responseCode >= 0 || !reused)
+                break;
+            close(httpClient); // the kept connection was closed by the server meanwhile
+        }
+        read_retry_after(httpClient, responseCode);
+
+        if (responseCode != 206) // a 200 would be the whole content, not the range
+        {
+            log_i("HTTP Error Code: %d", responseCode);
+            return (responseCode < 0) ? responseCode : -responseCode; // < 0 either way
+        }
+        if (total_len != nullptr)
+        { // Content-Range: bytes <first>-<last>/<total>
+            int slash = httpClient.header("Content-Range").indexOf('/');
+            *total_len = (slash < 0) ? 0 : httpClient.header("Content-Range").substring(slash + 1).toInt();
+        }
+        return httpClient.header("Content-Length").toInt();
+    }
 }
\ No newline at end of file
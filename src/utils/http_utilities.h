@@ -4,7 +4,49 @@
 
 namespace HTTP
 {
+    constexpr const size_t max_host_size = 128;
+
+    // "http[s]://host[:port]/..." --> https, host, port. Return false for another URL
+    bool parse_origin(const char *url, bool &https, char *host, uint16_t &port);
+
+    // Content-addressed URL: its last path segment is the SHA-256 (64 hex digits) of the content, e.g. /fw/<sha256>.img.
+    // Such a URL never changes content, so it's requested cacheable; the other (mutable) URLs are requested with no-cache.
+    bool is_content_addressed(const char *url);
+    // The SHA-256 a content-addressed URL names into `digest` (SHA256::digest_len bytes). Return false for another URL:
+    // the content streamed from such a URL must be checked against it (a cache or mirror may serve anything)
+    bool content_digest(const char *url, uint8_t *digest);
+
+    // The HTTPClient of the OTA requests (one at a time, from the loop task): its connection is kept open between the
+    // requests & the check_update() cycles (keep-alive), HTTPS is authenticated with the pinned CAs (ca_cert.h).
+    // A new connection only when the host changes or the server closed it.
+    // No TLS session resumption: the core's WiFiClientSecure doesn't expose its mbedTLS session, so a connection the
+    // server closed between two polls (its idle timeout, usually < checking_interval) costs a full handshake again
+    // (Stats::handshakes). Keep-alive only saves the handshakes within a check_update() & at short intervals.
+    HTTPClient &client();
+
+    struct Stats
+    {
+        uint32_t requests{0};
+        uint32_t connects{0};       // new connections (TCP, + TLS handshake for https)
+        uint32_t reuses{0};         // requests on a kept connection: no TCP/TLS handshake
+        uint32_t handshakes{0};     // TLS handshakes (among the connects)
+        uint32_t handshake_us{0};   // time spent in them (TCP connect + TLS handshake + certificate check)
+        uint32_t connect_errors{0}; // connect/handshake failures (e.g. the server's CA isn't pinned)
+        uint32_t dns_lookups{0};    // plain-http hosts resolved
+        uint32_t dns_cached{0};     // ... or connected by their cached address
+    };
+    const Stats &stats();
+
+    // End a request whose body isn't read to the end: the rest would be taken as the next response, so the connection
+    // isn't kept (http.end() otherwise)
+    void close(HTTPClient &httpClient);
+
+    // The Retry-After of the last response if it was a 429 or 503 (delta-seconds only, an HTTP-date is ignored), else 0
+    uint32_t retry_after_s();
+
     // perform a GET request and return the content's length. 
     int get_length(HTTPClient &httpClient, const char *url);
     int get_length(HTTPClient &httpClient, const char *path, const char *ext);
+    // perform a GET request of the bytes [first, last] and return the content's length, the whole length is put in *total_len
+    int get_range(HTTPClient &httpClient, const char *url, const uint32_t first, const uint32_t last, uint32_t *total_len = nullptr);
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "key_store.h"
+
+#include <mbedtls/pk.h>
+
+#include "nvs_utilities.h"
+#include "sha256_utilities.h"
+
+namespace
+{
+    constexpr const char *nvs_namespace = "keys";
+    constexpr const char *roles[]{"config", "firmware"};
+    constexpr const size_t max_nvs_key_size = 16; // NVS keys: 15 characters + '\0'
+
+    // "k" + the first 14 hex digits of the key ID
+    void nvs_key_of(const char *key_id, char *nvs_key)
+    {
+        snprintf(nvs_key, max_nvs_key_size, "k%.14s", key_id);
+    }
+
+    void nvs_key_of_role(const char *role, char *nvs_key)
+    {
+        snprintf(nvs_key, max_nvs_key_size, "@%s", role);
+    }
+}
+
+namespace KeyStore
+{
+    bool add(const uint8_t *key, const size_t len, char *key_id)
+    {
+        mbedtls_pk_context pk;
+        mbedtls_pk_init(&pk);
+        uint8_t buf[max_der_size];
+        int der_len = 0;
+        if (!mbedtls_pk_parse_public_key(&pk, key, len) && mbedtls_pk_can_do(&pk, MBEDTLS_PK_RSA))
+        {
+            der_len = mbedtls_pk_write_pubkey_der(&pk, buf, max_der_size); // written at the end of buf
+        }
+        mbedtls_pk_free(&pk);
+        if (der_len <= 0)
+        {
+            log_e("Not a valid RSA public key!");
+            return false;
+        }
+        const uint8_t *der = buf + max_der_size - der_len;
+
+        uint8_t digest[SHA256::digest_len];
+        SHA256::Hasher hasher;
+        hasher.update(der, der_len);
+        hasher.finish(digest);
+        for (int i = 0; i < 8; i++)
+        {
+            snprintf(key_id + 2 * i, 3, "%02x", digest[i]);
+        }
+
+        char nvs_key[max_nvs_key_size];
+        nvs_key_of(key_id, nvs_key);
+        uint8_t existing[max_der_size];
+        if (NVS::get_bytes(nvs_namespace, nvs_key, existing, max_der_size) != (size_t)der_len || memcmp(existing, der, der_len) != 0)
+        {
+            NVS::update_bytes(nvs_namespace, nvs_key, der, der_len);
+            log_i("Key %s stored (%d bytes DER)", key_id, der_len);
+        }
+        return true;
+    }
+
+    size_t load(const char *key_id, uint8_t *der, const size_t max_size)
+    {
+        char nvs_key[max_nvs_key_size];
+        nvs_key_of(key_id, nvs_key);
+        return NVS::get_bytes(nvs_namespace, nvs_key, der, max_size);
+    }
+
+    bool get_role(const char *role, char *key_id)
+    {
+        char nvs_key[max_nvs_key_size];
+        nvs_key_of_role(role, nvs_key);
+        return NVS::get_string(nvs_namespace, nvs_key, key_id, key_id_size) > 0;
+    }
+
+    void set_role(const char *role, const char *key_id)
+    {
+        char previous[key_id_size];
+        bool had_key = get_role(role, previous);
+        if (had_key && strcmp(previous, key_id) == 0)
+        {
+            return;
+        }
+
+        char nvs_key[max_nvs_key_size];
+        nvs_key_of_role(role, nvs_key);
+        NVS::update_string(nvs_namespace, nvs_key, key_id);
+        if (!had_key)
+        {
+            return;
+        }
+
+        for (const char *other : roles) // erase the previous key if unused
+        {
+            char other_id[key_id_size];
+            if (get_role(other, other_id) && strcmp(other_id, previous) == 0)
+            {
+                return;
+            }
+        }
+        nvs_key_of(previous, nvs_key);
+        NVS::remove(nvs_namespace, nvs_key);
+        log_i("Key %s erased (unused)", previous);
+    }
+}
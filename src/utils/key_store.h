@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+
+// Public keys in NVS as DER, by key ID (the hex of the first 8 bytes of SHA-256(DER), as in the inline manifest keys):
+// - namespace "keys": "k<first 14 hex of the ID>" --> DER (550 bytes for RSA-4096, vs 800 for its PEM)
+//                     "@<role>" --> the key ID of a role ("config", "firmware")
+// - identical keys of several roles are stored once, a key is erased when no role uses it anymore
+// - nothing is kept in RAM: load() the DER right before a signature check
+namespace KeyStore
+{
+    constexpr const size_t key_id_size = 17; // 16 hex digits + '\0'
+    constexpr const size_t max_der_size = 600;
+
+    // Add a public key (PEM with its null-terminator, or DER), put its ID in `key_id`. Return false if not an RSA key
+    bool add(const uint8_t *key, const size_t len, char *key_id);
+
+    // Load the DER of a key, return its length, 0 if unknown
+    size_t load(const char *key_id, uint8_t *der, const size_t max_size);
+
+    // Get the key ID of a role, return false if none
+    bool get_role(const char *role, char *key_id);
+
+    // Assign a key to a role, the role's previous key is erased if no other role uses it
+    void set_role(const char *role, const char *key_id);
+}
@@ -0,0 +1,240 @@
+#include "lan_peers.h"
+#include "Semver.hpp"
+
+#include <WiFi.h>
+#include <esp_ota_ops.h>
+#include <lwip/sockets.h>
+#include <memory>
+
+bool LAN_Peers::begin(const char *device_type, const char *fw_version, const uint8_t *signature, const size_t sign_len, const size_t fw_len,
+                      const uint16_t port)
+{
+    this->device_type = device_type;
+    this->port = port;
+    strlcpy(this->fw_version, fw_version, sizeof(this->fw_version));
+    this->sign_len = (sign_len == sizeof(this->signature)) ? sign_len : 0;
+    this->fw_len = fw_len;
+    if (this->sign_len)
+    {
+        memcpy(this->signature, signature, sign_len);
+    }
+
+    if (!udp.listen(udp_port))
+    {
+        log_e("LAN peers: failed to listen on UDP port %d", udp_port);
+        return false;
+    }
+    udp.onPacket([this](AsyncUDPPacket packet)
+                 { on_announce(packet); });
+
+    if (this->sign_len && this->fw_len)
+    {
+        xTaskCreate(serve_task, "lan_peers_http", 4096, this, 1, nullptr);
+        log_i("LAN peers: serving firmware %s (%d bytes) on port %d", fw_version, fw_len, port);
+    }
+    return true;
+}
+
+// Announce message: "OTA1 <device_type> <fw_version> <http_port>", only sent when the firmware can be served.
+void LAN_Peers::announce()
+{
+    if (!sign_len || !fw_len)
+        return;
+
+    char msg[96];
+    int len = snprintf(msg, sizeof(msg), "OTA1 %s %s %u", device_type, fw_version, port);
+    udp.broadcastTo((uint8_t *)msg, len, udp_port);
+}
+
+void LAN_Peers::on_announce(AsyncUDPPacket &packet)
+{
+    if (packet.remoteIP() == WiFi.localIP())
+        return; // our own broadcast
+
+    char msg[96];
+    size_t len = min(packet.length(), sizeof(msg) - 1);
+    memcpy(msg, packet.data(), len);
+    msg[len] = '\0';
+
+    char type[32], version[32];
+    unsigned int port;
+    if (sscanf(msg, "OTA1 %31s %31s %u", type, version, &port) != 3 || strcmp(type, device_type) != 0)
+        return;
+    // only a newer firmware than ours is of use: the peers still on ours don't evict those holding a new release
+    if (!Semver(fw_version, version).is_newer_version())
+        return;
+
+    portENTER_CRITICAL(&mux);
+    uint8_t i = 0;
+    while (i < peer_count && !(peers[i].ip == packet.remoteIP()))
+        i++;
+    if (i == max_peers) // table full --> replace the oldest one
+    {
+        i = 0;
+        for (uint8_t j = 1; j < peer_count; j++)
+            if ((int32_t)(peers[j].last_seen - peers[i].last_seen) < 0)
+                i = j;
+    }
+    else if (i == peer_count)
+    {
+        peer_count++;
+    }
+    peers[i].ip = packet.remoteIP();
+    strlcpy(peers[i].version, version, sizeof(peers[i].version));
+    peers[i].port = port;
+    peers[i].last_seen = millis();
+    portEXIT_CRITICAL(&mux);
+}
+
+uint8_t LAN_Peers::find(const char *version, char (*urls)[url_size], const uint8_t max_count)
+{
+    Peer found[max_peers];
+    uint8_t count = 0;
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < peer_count; i++)
+    {
+        if (now - peers[i].last_seen > peer_timeout_ms || strcmp(peers[i].version, version) != 0)
+            continue;
+        uint8_t j = count++; // insertion: the most recently heard first
+        while (j > 0 && (int32_t)(peers[i].last_seen - found[j - 1].last_seen) > 0)
+        {
+            found[j] = found[j - 1];
+            j--;
+        }
+        found[j] = peers[i];
+    }
+    portEXIT_CRITICAL(&mux);
+
+    count = min(count, max_count);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        snprintf(urls[i], url_size, "http://%s:%u/firmware.img", found[i].ip.toString().c_str(), found[i].port);
+    }
+    return count;
+}
+
+void LAN_Peers::forget(const char *url)
+{
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < peer_count; i++)
+    {
+        char peer_url[64];
+        snprintf(peer_url, sizeof(peer_url), "http://%u.%u.%u.%u:%u/firmware.img",
+                 peers[i].ip[0], peers[i].ip[1], peers[i].ip[2], peers[i].ip[3], peers[i].port);
+        if (strcmp(peer_url, url) == 0)
+        {
+            peers[i] = peers[--peer_count];
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+// A minimal blocking HTTP server (one client at a time): the task sleeps in accept() while idle.
+void LAN_Peers::serve_task(void *arg)
+{
+    LAN_Peers *self = (LAN_Peers *)arg;
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(self->port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (listen_fd < 0 || bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 2) != 0)
+    {
+        log_e("LAN peers: failed to start the HTTP server on port %d", self->port);
+        if (listen_fd >= 0)
+            close(listen_fd);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (true)
+    {
+        int client_fd = accept(listen_fd, nullptr, nullptr);
+        if (client_fd < 0)
+            continue;
+        self->serve(client_fd);
+        close(client_fd);
+    }
+}
+
+void LAN_Peers::serve(int client_fd)
+{
+    timeval timeout{10, 0};
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[512];
+    int len = recv(client_fd, request, sizeof(request) - 1, 0);
+    if (len <= 0)
+        return;
+    request[len] = '\0';
+
+    char header[192];
+    if (strncmp(request, "GET /firmware.img ", 18) != 0)
+    {
+        len = snprintf(header, sizeof(header), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        send(client_fd, header, len, 0);
+        return;
+    }
+
+    // "Range: bytes=<first>-[<last>]": the rest of an image another peer stopped serving (Mirrors::download())
+    size_t total = sign_len + fw_len;
+    size_t first = 0, last = total - 1;
+    const char *range = strcasestr(request, "\r\nRange: bytes=");
+    if (range != nullptr)
+    {
+        unsigned long range_first, range_last;
+        int fields = sscanf(range + 15, "%lu-%lu", &range_first, &range_last);
+        if (fields < 1 || range_first >= total || (fields == 2 && range_last < range_first))
+        {
+            len = snprintf(header, sizeof(header), "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%zu\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", total);
+            send(client_fd, header, len, 0);
+            return;
+        }
+        first = range_first;
+        last = (fields == 2 && range_last < total) ? range_last : total - 1;
+        len = snprintf(header, sizeof(header), "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %zu-%zu/%zu\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                       first, last, total, last - first + 1);
+    }
+    else
+    {
+        len = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", total);
+    }
+    if (send(client_fd, header, len, 0) != len)
+        return;
+    stats.served++;
+
+    constexpr const size_t bufferSize = SPI_FLASH_SEC_SIZE;
+    std::unique_ptr<uint8_t[]> buffer{new uint8_t[bufferSize]};
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    size_t offset = first; // in signature + image
+    while (offset <= last)
+    {
+        size_t chunk;
+        const uint8_t *data;
+        if (offset < sign_len)
+        {
+            chunk = min(sign_len - offset, last + 1 - offset);
+            data = signature + offset;
+        }
+        else
+        {
+            chunk = min(bufferSize, last + 1 - offset);
+            if (esp_partition_read(running, offset - sign_len, buffer.get(), chunk) != ESP_OK)
+                chunk = 0;
+            data = buffer.get();
+        }
+        if (chunk == 0 || send(client_fd, data, chunk, 0) != (int)chunk)
+        {
+            log_i("LAN peers: serving firmware.img aborted at %zu/%zu", offset, total);
+            return;
+        }
+        offset += chunk;
+        stats.bytes_served += chunk;
+    }
+    log_i("LAN peers: served firmware.img (%zu bytes from %zu)", last + 1 - first, first);
+}
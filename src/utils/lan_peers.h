@@ -0,0 +1,67 @@
+#pragma once
+#include <Arduino.h>
+#include <AsyncUDP.h>
+
+// Peer-to-peer firmware sharing on the LAN:
+// - Each device announces (UDP broadcast) its device type & the verified firmware version it is running (at boot & then
+//   periodically); the listeners keep the peers with a newer version than theirs,
+// - ... and serves that firmware as "firmware.img" (signature + app image) from its running partition over HTTP.
+// - A device that needs a newer version downloads it from the peers first (Mirrors::download(): if one fails mid-way, the
+//   next one resumes with a Range request), the origin URL is only a fallback.
+// - Peers are not trusted: the image is still verified against the firmware's public key before booting it.
+class LAN_Peers
+{
+public:
+    static constexpr uint16_t udp_port = 3233;
+    static constexpr uint16_t http_port = 3232;
+    static constexpr uint8_t max_peers = 8;
+    static constexpr uint8_t max_sources = 3; // peers tried for one download
+    static constexpr size_t url_size = 48;    // "http://255.255.255.255:65535/firmware.img"
+    static constexpr uint32_t peer_timeout_ms = 5 * 60 * 1000UL; // forget peers not heard from for 5 mins
+
+    // Listen to the peers' announces. Serve the running firmware if its signature is known (sign_len > 0), on `port`
+    bool begin(const char *device_type, const char *fw_version, const uint8_t *signature, const size_t sign_len, const size_t fw_len,
+               const uint16_t port = http_port);
+
+    // Broadcast this device's firmware version (call it periodically)
+    void announce();
+
+    // Get the URLs of the live peers holding `version`, the most recently heard first (at most max_count). Return their count
+    uint8_t find(const char *version, char (*urls)[url_size], const uint8_t max_count);
+
+    // Drop a peer after a failed download from it
+    void forget(const char *url);
+
+    struct Stats
+    {
+        uint32_t served{0};        // firmware.img requests answered (whole or a range)
+        uint64_t bytes_served{0}; // the origin's egress saved
+    };
+    const Stats &get_stats() const { return stats; }
+
+private:
+    struct Peer
+    {
+        IPAddress ip;
+        char version[32];
+        uint16_t port;
+        uint32_t last_seen;
+    };
+
+    AsyncUDP udp;
+    Peer peers[max_peers];
+    uint8_t peer_count{0};
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+    const char *device_type{nullptr};
+    char fw_version[32]{};
+    uint8_t signature[512];
+    size_t sign_len{0};
+    size_t fw_len{0};
+    uint16_t port{http_port};
+    Stats stats;
+
+    void on_announce(AsyncUDPPacket &packet);
+    static void serve_task(void *arg);
+    void serve(int client_fd);
+};
@@ -0,0 +1,296 @@
+#include "mirrors.h"
+#include <memory>
+
+namespace
+{
+    constexpr const size_t chunk_size = 4096U;
+    constexpr const size_t min_throughput_sample = 8192U; // a shorter body mostly measures the RTT
+
+    Mirrors::Host tracked[Mirrors::max_hosts];
+    uint8_t host_count = 0;
+
+    // "host:port" of a URL. Return false if it's not an http(s) URL
+    bool origin_of(const char *url, char *origin, const size_t size)
+    {
+        bool https;
+        char host[HTTP::max_host_size];
+        uint16_t port;
+        if (!HTTP::parse_origin(url, https, host, port))
+            return false;
+        snprintf(origin, size, "%s:%u", host, port);
+        return true;
+    }
+
+    // The host of a URL: tracked from now on if `add` (replacing the least recently used one). nullptr if none
+    Mirrors::Host *find_host(const char *url, const bool add)
+    {
+        char origin[sizeof(Mirrors::Host::origin)];
+        if (!origin_of(url, origin, sizeof(origin)))
+            return nullptr;
+        for (uint8_t i = 0; i < host_count; i++)
+        {
+            if (strcmp(tracked[i].origin, origin) == 0)
+                return &tracked[i];
+        }
+        if (!add)
+            return nullptr;
+
+        Mirrors::Host *host = &tracked[host_count];
+        if (host_count < Mirrors::max_hosts)
+        {
+            host_count++;
+        }
+        else
+        {
+            uint32_t now = millis();
+            host = &tracked[0];
+            for (uint8_t i = 1; i < host_count; i++)
+            {
+                if (now - tracked[i].used_ms > now - host->used_ms)
+                    host = &tracked[i];
+            }
+        }
+        *host = Mirrors::Host{};
+        strlcpy(host->origin, origin, sizeof(host->origin));
+        return host;
+    }
+
+    bool backed_off(const Mirrors::Host *host, const uint32_t now)
+    {
+        return host != nullptr && host->failures > 0 && (int32_t)(host->retry_at_ms - now) > 0;
+    }
+
+    // The expected time (us) to GET `len` bytes from the host. 0: not measured yet
+    uint64_t expected_us(const Mirrors::Host *host, const size_t len)
+    {
+        if (host == nullptr || host->rtt_us == 0)
+            return 0;
+        uint64_t cost = host->rtt_us;
+        if (host->bytes_per_s > 0)
+            cost += (uint64_t)len * 1000000U / host->bytes_per_s;
+        return cost;
+    }
+
+    // Exponential moving average (weight 1/4), the first sample as is
+    uint32_t smooth(const uint32_t average, const uint32_t sample)
+    {
+        return (average == 0) ? sample : (uint32_t)(((uint64_t)average * 3 + sample) / 4);
+    }
+}
+
+namespace Mirrors
+{
+    void rank(const char **urls, const uint8_t count, const size_t expected_len)
+    {
+        uint32_t now = millis();
+        uint64_t costs[max_urls];
+        bool is_off[max_urls];
+        uint8_t n = min(count, max_urls);
+        for (uint8_t i = 0; i < n; i++)
+        {
+            const Host *host = find_host(urls[i], false);
+            costs[i] = expected_us(host, expected_len);
+            is_off[i] = backed_off(host, now);
+        }
+        // stable insertion sort: the given order among equals
+        for (uint8_t i = 1; i < n; i++)
+        {
+            const char *url = urls[i];
+            uint64_t cost = costs[i];
+            bool off = is_off[i];
+            int j = i - 1;
+            while (j >= 0 && (is_off[j] > off || (is_off[j] == off && costs[j] > cost)))
+            {
+                urls[j + 1] = urls[j];
+                costs[j + 1] = costs[j];
+                is_off[j + 1] = is_off[j];
+                j--;
+            }
+            urls[j + 1] = url;
+            costs[j + 1] = cost;
+            is_off[j + 1] = off;
+        }
+    }
+
+    bool is_backed_off(const char *url)
+    {
+        return backed_off(find_host(url, false), millis());
+    }
+
+    void report_success(const char *url, const uint32_t rtt_us, const size_t bytes, const uint32_t transfer_us)
+    {
+        Host *host = find_host(url, true);
+        if (host == nullptr)
+            return;
+        host->rtt_us = smooth(host->rtt_us, max(rtt_us, (uint32_t)1));
+        if (bytes >= min_throughput_sample && transfer_us > 0)
+        {
+            host->bytes_per_s = smooth(host->bytes_per_s, (uint32_t)min((uint64_t)bytes * 1000000U / transfer_us, (uint64_t)UINT32_MAX));
+        }
+        host->failures = 0;
+        host->used_ms = millis();
+    }
+
+    void report_failure(const char *url, const uint32_t retry_after_ms)
+    {
+        Host *host = find_host(url, true);
+        if (host == nullptr)
+            return;
+        if (host->failures < UINT8_MAX)
+            host->failures++;
+        uint32_t backoff_ms = min((uint32_t)(min_backoff_ms << min(host->failures - 1, 16)), max_backoff_ms);
+        backoff_ms = max(backoff_ms, min(retry_after_ms, max_backoff_ms)); // the server's own estimate
+        host->used_ms = millis();
+        host->retry_at_ms = host->used_ms + backoff_ms;
+        log_i("Mirror %s failed (%u in a row): backed off for %u s", host->origin, host->failures, backoff_ms / 1000);
+    }
+
+    const Host *hosts(uint8_t &count)
+    {
+        count = host_count;
+        return tracked;
+    }
+
+    uint8_t split(char *list, const char **urls, const uint8_t max_count)
+    {
+        uint8_t count = 0;
+        char *save = nullptr;
+        for (char *url = strtok_r(list, " ", &save); url != nullptr && count < max_count; url = strtok_r(nullptr, " ", &save))
+        {
+            urls[count++] = url;
+        }
+        return count;
+    }
+
+    uint8_t join(const char *const *urls, const uint8_t count, char *list, const size_t max_list_size)
+    {
+        uint8_t joined = 0;
+        size_t len = 0;
+        list[0] = '\0';
+        for (uint8_t i = 0; i < count; i++)
+        {
+            size_t url_len = strlen(urls[i]);
+            if (url_len == 0 || strchr(urls[i], ' ') != nullptr || len + (len > 0) + url_len >= max_list_size)
+            {
+                log_e("Mirror dropped (too long or invalid): %s", urls[i]);
+                continue;
+            }
+            if (len > 0)
+                list[len++] = ' ';
+            memcpy(list + len, urls[i], url_len + 1);
+            len += url_len;
+            joined++;
+        }
+        return joined;
+    }
+
+    bool download(const char *const *urls, const uint8_t count, const size_t expected_len, int &len,
+                  const std::function<bool(uint8_t *data, size_t len)> &sink, Throttle *throttle)
+    {
+        const char *ranked[max_urls];
+        uint8_t n = min(count, max_urls);
+        memcpy(ranked, urls, n * sizeof(const char *));
+        rank(ranked, n, expected_len);
+
+        std::unique_ptr<uint8_t[]> chunk{new uint8_t[chunk_size]};
+        HTTPClient &http = HTTP::client();
+        size_t done = 0;
+        const int known_len = len > 0 ? len : -1;
+        len = known_len;
+        SHA256::Hasher hasher;
+        uint8_t named[SHA256::digest_len]; // the digest a content-addressed URL of the artifact names
+        bool content_addressed = false;
+        for (uint8_t i = 0; i < n; i++)
+        {
+            const char *url = ranked[i];
+            uint32_t start_us = micros();
+            int body_len;
+            if (done == 0)
+            {
+                body_len = HTTP::get_length(http, url);
+                if (body_len > 0 && known_len > 0 && body_len != known_len)
+                {
+                    log_e("Mirror %s serves another content (%d bytes, expected %d)", url, body_len, known_len);
+                    body_len = -1;
+                }
+            }
+            else
+            { // resume where the previous mirror stopped: the same artifact (length) only
+                uint32_t total_len = 0;
+                log_i("Resuming at byte %u from %s", (unsigned)done, url);
+                body_len = HTTP::get_range(http, url, done, len - 1, &total_len);
+                if (body_len > 0 && (total_len != (uint32_t)len || (size_t)body_len != len - done))
+                {
+                    log_e("Mirror %s serves another content (%u bytes, expected %d)", url, total_len, len);
+                    body_len = -1;
+                }
+            }
+            if (body_len <= 0)
+            {
+                report_failure(url, HTTP::retry_after_s() * 1000UL);
+                HTTP::close(http);
+                continue;
+            }
+            if (done == 0)
+            {
+                len = body_len;
+            }
+            if (!content_addressed)
+            {
+                content_addressed = HTTP::content_digest(url, named);
+            }
+
+            uint32_t rtt_us = micros() - start_us;
+            uint32_t transfer_start_us = micros();
+            size_t received = 0;
+            uint32_t waited_ms = 0; // throttled
+            while (done < (size_t)len)
+            {
+                size_t want = min(chunk_size, (size_t)len - done);
+                if (throttle != nullptr)
+                {
+                    uint32_t wait_start_ms = millis();
+                    want = throttle->acquire(want);
+                    waited_ms += millis() - wait_start_ms;
+                }
+                size_t read = http.getStream().readBytes(chunk.get(), want);
+                hasher.update(chunk.get(), read);
+                if (read > 0 && !sink(chunk.get(), read))
+                {
+                    HTTP::close(http); // not the mirror's fault
+                    return false;
+                }
+                if (throttle != nullptr)
+                {
+                    throttle->consume(read);
+                }
+                done += read;
+                received += read;
+                if (read == 0)
+                    break; // the mirror stalled or closed the connection
+            }
+
+            if (done == (size_t)len)
+            {
+                uint8_t digest[SHA256::digest_len];
+                hasher.finish(digest);
+                if (content_addressed && memcmp(digest, named, SHA256::digest_len) != 0)
+                {
+                    log_e("Mirror %s serves another content than its URL names (SHA-256 mismatch)", url);
+                    report_failure(url);
+                    http.end();
+                    return false;
+                }
+                // the pauses aren't the mirror's time; a rate-limited transfer only measures its RTT
+                size_t measured = (throttle != nullptr && throttle->get_rate() > 0) ? 0 : received;
+                report_success(url, rtt_us, measured, micros() - transfer_start_us - waited_ms * 1000U);
+                http.end();
+                return true;
+            }
+            log_i("Mirror %s stopped at %u/%d bytes", url, (unsigned)done, len);
+            report_failure(url);
+            HTTP::close(http);
+        }
+        return false;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <Arduino.h>
+#include <functional>
+
+#include "http_utilities.h"
+#include "sha256_utilities.h"
+#include "throttle.h"
+
+// The download sources of an artifact: its "url" and the "mirrors" listed next to it by the signed manifest (e.g. a
+// LAN server, a regional cache, GitHub). Each host's RTT & throughput are measured on every request (kept in RAM
+// across the check_update() cycles): the fastest healthy mirror is used first, a failed one is backed off.
+// The mirrors aren't trusted: the artifacts are still verified against their signatures.
+namespace Mirrors
+{
+    constexpr const uint8_t max_mirrors = 4;                    // per artifact, besides its "url"
+    constexpr const uint8_t max_urls = 1 + max_mirrors;
+    constexpr const size_t max_mirror_list_size = 512;          // the config mirrors kept in NVS (space-separated)
+    constexpr const uint8_t max_hosts = 8;                      // tracked hosts, the least recently used one is replaced
+    constexpr const uint32_t min_backoff_ms = 10 * 1000UL;      // after a failure, doubled on each consecutive one
+    constexpr const uint32_t max_backoff_ms = 10 * 60 * 1000UL;
+
+    struct Host
+    {
+        char origin[HTTP::max_host_size + 6]; // "host:port"
+        uint32_t rtt_us{0};      // time to the response headers (incl. connecting), smoothed. 0: not measured yet
+        uint32_t bytes_per_s{0}; // body throughput, smoothed. 0: not measured yet
+        uint8_t failures{0};     // consecutive ones
+        uint32_t retry_at_ms{0}; // backed off until then
+        uint32_t used_ms{0};
+    };
+
+    // Order `urls` by the expected time to GET `expected_len` bytes: the hosts not measured yet first (in the given
+    // order), then the measured ones by RTT + expected_len / throughput, the backed-off ones last (a last resort)
+    void rank(const char **urls, const uint8_t count, const size_t expected_len);
+
+    // A host which failed recently (backed off)
+    bool is_backed_off(const char *url);
+
+    // A request that reached the response headers after `rtt_us`, then `bytes` of body in `transfer_us`
+    void report_success(const char *url, const uint32_t rtt_us, const size_t bytes, const uint32_t transfer_us);
+    // A failed request: backed off, at least for the server's Retry-After (429/503) if any
+    void report_failure(const char *url, const uint32_t retry_after_ms = 0);
+
+    // The tracked hosts (for logs & stats)
+    const Host *hosts(uint8_t &count);
+
+    // Split a space-separated list in place into `urls`. Return their count (at most max_urls)
+    uint8_t split(char *list, const char **urls, const uint8_t max_count);
+    // Join `urls` space-separated into `list` (the ones that don't fit are dropped). Return their count
+    uint8_t join(const char *const *urls, const uint8_t count, char *list, const size_t max_list_size);
+
+    // GET an artifact from its mirrors into `sink(data, len)` (in order, from the first byte): from the best ranked
+    // one, resumed with a Range request on the next one if a mirror fails or stalls mid-way. `len`: the artifact's
+    // length if known (> 0, e.g. listed by the signed manifest), a mirror serving another length is skipped; it's set to
+    // the artifact's length before the first sink() call. sink() returns false to abort (e.g. a flash write error).
+    // The reads (and the sink's work) are paced by `throttle` if any (a background download), its waits aren't
+    // counted in the mirrors' throughput. A content-addressed artifact (HTTP::content_digest()) is hashed as it streams:
+    // if it isn't the content its URL names, the mirror is backed off & the download fails (the sink got it already).
+    // Return true if the whole artifact went to the sink.
+    bool download(const char *const *urls, const uint8_t count, const size_t expected_len, int &len,
+                  const std::function<bool(uint8_t *data, size_t len)> &sink, Throttle *throttle = nullptr);
+}
@@ -0,0 +1,161 @@
+#include "notifier.h"
+
+#include "../ca_cert.h"
+
+namespace
+{
+    constexpr const uint32_t read_timeout_ms = (Notifier::hold_s + 10) * 1000UL; // the notifier answers within hold_s
+}
+
+bool Notifier::begin(Callback on_notify, void *ctx)
+{
+    this->on_notify = on_notify;
+    this->ctx = ctx;
+    tls.setCACert(https_ca_cert);
+    if (xTaskCreate(poll_task, "notifier", 6144, this, 1, nullptr) != pdPASS)
+    {
+        log_e("Notifier: failed to start its task");
+        return false;
+    }
+    return true;
+}
+
+void Notifier::set_target(const char *url, const char *config_version)
+{
+    bool changed = false;
+    portENTER_CRITICAL(&mux);
+    if (strcmp(this->url, url) != 0)
+    {
+        strlcpy(this->url, url, sizeof(this->url));
+        changed = true;
+    }
+    if (strcmp(this->config_version, config_version) != 0) // applied (or rolled back): wait for the one after it
+    {
+        strlcpy(this->config_version, config_version, sizeof(this->config_version));
+        strlcpy(known, config_version, sizeof(known));
+        changed = true;
+    }
+    TaskHandle_t waiting = task;
+    portEXIT_CRITICAL(&mux);
+    if (changed && waiting != nullptr)
+        xTaskNotifyGive(waiting); // a new long-poll with the new target
+}
+
+bool Notifier::take()
+{
+    bool notified = pending;
+    pending = false;
+    return notified;
+}
+
+void Notifier::poll_task(void *arg)
+{
+    static_cast<Notifier *>(arg)->run();
+}
+
+void Notifier::run()
+{
+    task = xTaskGetCurrentTaskHandle();
+    uint32_t retry_ms = min_retry_ms;
+    uint32_t signaled_ms = millis() - min_notify_gap_ms;
+    char request[max_url_size + max_version_size + 24];
+    while (true)
+    {
+        portENTER_CRITICAL(&mux);
+        bool has_url = url[0] != '\0';
+        if (has_url)
+            snprintf(request, sizeof(request), "%s%cv=%s&wait=%u", url, strchr(url, '?') ? '&' : '?', known, hold_s);
+        portEXIT_CRITICAL(&mux);
+        if (!has_url)
+        {
+            up = false;
+            tcp.stop();
+            tls.stop();
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // set_target()
+            continue;
+        }
+
+        char version[max_version_size];
+        int code = long_poll(request, version);
+        if (code == HTTP_CODE_OK || code == 204)
+        {
+            if (!up)
+                log_i("Notifier: the channel is up");
+            up = true;
+            retry_ms = min_retry_ms;
+        }
+        if (code == HTTP_CODE_OK)
+        {
+            stats.notifications++;
+            portENTER_CRITICAL(&mux);
+            strlcpy(known, version, sizeof(known));
+            portEXIT_CRITICAL(&mux);
+            log_i("Notifier: config %s is published", version);
+            for (uint8_t i = 0; i <= max_rechecks; i++)
+            {
+                signal(signaled_ms);
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(recheck_wait_ms)); // set_target(): a new applied version
+                portENTER_CRITICAL(&mux);
+                bool applied = strcmp(config_version, known) == 0;
+                portEXIT_CRITICAL(&mux);
+                if (applied)
+                    break;
+            }
+        }
+        else if (code == 204)
+        {
+            stats.idle++;
+        }
+        else
+        {
+            stats.errors++;
+            if (up)
+            {
+                log_i("Notifier: the channel is down (%d), back to polling", code);
+                up = false;
+                signal(signaled_ms);
+            }
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(retry_ms)); // or a new target
+            retry_ms = min(retry_ms * 2, max_retry_ms);
+        }
+    }
+}
+
+// Ask the loop task for a poll, min_notify_gap_ms after the last one at least
+void Notifier::signal(uint32_t &signaled_ms)
+{
+    uint32_t since_ms = millis() - signaled_ms;
+    if (since_ms < min_notify_gap_ms)
+        vTaskDelay(pdMS_TO_TICKS(min_notify_gap_ms - since_ms));
+    signaled_ms = millis();
+    pending = true;
+    if (on_notify != nullptr)
+        on_notify(ctx);
+}
+
+// One long-poll: the HTTP status code (the published version into `version` on a 200), or an HTTPClient error (< 0)
+int Notifier::long_poll(const char *request, char *version)
+{
+    stats.requests++;
+    WiFiClient &client = (strncmp(request, "https://", 8) == 0) ? tls : tcp;
+    http.setReuse(true);
+    http.setTimeout(read_timeout_ms);
+    if (!http.begin(client, request))
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    int code = http.GET();
+    if (code == HTTP_CODE_OK)
+    {
+        int len = http.getSize();
+        if (len <= 0 || len >= (int)max_version_size || http.getStream().readBytes(version, len) != (size_t)len)
+            len = 0;
+        while (len > 0 && isspace((unsigned char)version[len - 1]))
+            len--;
+        version[len] = '\0';
+        if (len == 0)
+            code = HTTPC_ERROR_CONNECTION_LOST; // not a notifier's answer
+    }
+    http.end(); // the connection is kept for the next long-poll (setReuse)
+    if (code != HTTP_CODE_OK && code != 204)
+        client.stop();
+    return code;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+
+// Push channel for an instant update discovery: a task long-polls the notifier (tools/ota_notifier.py),
+// GET <notify_url>?v=<the newest config version known>&wait=<hold_s>:
+// - 200: another config version is published (the body: that version) --> take() tells the loop task to poll
+//   config.img now (again up to max_rechecks times if that version isn't applied after it: a cache behind the
+//   publication served the former config.img), and the next long-poll waits for the version after it.
+// - 204: nothing new within hold_s --> the next long-poll right away, on the same connection (keep-alive): an idle
+//   device sends one small request per hold_s instead of a config.img poll per checking_interval.
+// - An error (an unreachable notifier, a dropped connection): the channel is down, retried with an exponential backoff.
+//   The periodic polling goes on regardless, relaxed to backstop_poll_s by the caller while is_up(); when the channel
+//   goes down take() asks for a poll right away (a notification may have been missed) & the normal interval again.
+// The notifications aren't authenticated: they only trigger a poll of the signed config.img, min_notify_gap_ms apart.
+class Notifier
+{
+public:
+    using Callback = void (*)(void *ctx);
+    static constexpr uint32_t hold_s = 50;               // below the usual NAT & proxy idle timeouts
+    static constexpr uint32_t backstop_poll_s = 15 * 60; // the polling interval while the channel is up
+    static constexpr uint32_t min_notify_gap_ms = 5000;
+    static constexpr uint8_t max_rechecks = 3;
+    static constexpr uint32_t recheck_wait_ms = 15000; // for the check's set_target()
+    static constexpr uint32_t min_retry_ms = 5000;
+    static constexpr uint32_t max_retry_ms = 5 * 60 * 1000UL;
+
+    struct Stats
+    {
+        uint32_t requests{0};      // long-polls sent
+        uint32_t notifications{0}; // answered 200: a new version
+        uint32_t idle{0};          // answered 204: nothing new
+        uint32_t errors{0};        // failed: the channel went (or stayed) down
+    };
+
+    // Start the long-poll task. `on_notify(ctx)` is called from that task when take() turns true, e.g. to wake the loop task
+    bool begin(Callback on_notify, void *ctx = nullptr);
+
+    // The notifier's URL ("": none, the channel stays down) & the applied config version (after each check_update())
+    void set_target(const char *url, const char *config_version);
+
+    // Whether to poll now: a notification (or the channel went down) since the last call
+    bool take();
+
+    bool is_up() const { return up; }
+    const Stats &get_stats() const { return stats; }
+
+private:
+    static constexpr size_t max_url_size = 256;
+    static constexpr size_t max_version_size = 64;
+
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    char url[max_url_size]{};
+    char config_version[max_version_size]{}; // the applied one
+    char known[max_version_size]{};          // the newest one known: the applied, or the last notified
+    volatile bool up{false};
+    volatile bool pending{false};
+    Callback on_notify{nullptr};
+    void *ctx{nullptr};
+    TaskHandle_t task{nullptr};
+    HTTPClient http;
+    WiFiClient tcp;
+    WiFiClientSecure tls;
+    Stats stats;
+
+    static void poll_task(void *arg);
+    void run();
+    int long_poll(const char *request, char *version);
+    void signal(uint32_t &signaled_ms);
+};
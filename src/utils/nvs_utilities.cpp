@@ -1,18 +1,151 @@
 #include "nvs_utilities.h"
 
 #include <Preferences.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#if __has_include(<esp_idf_version.h>)
+#include <esp_idf_version.h>
+#endif
 Preferences nvs_kv;
 
+namespace
+{
+    bool flash_ready = false;
+
+    // nvs_flash_init() on the first access, not in the constructor of a global object (before the core is initialized)
+    void ensure_flash()
+    {
+        if (!flash_ready)
+        {
+            nvs_flash_init(); // already done by the Arduino core on the ESP32: a no-op then
+            flash_ready = true;
+        }
+    }
+
+    bool open(const char *nvs_namespace, const bool read_only)
+    {
+        ensure_flash();
+        return nvs_kv.begin(nvs_namespace, read_only);
+    }
+
+    // ESP-IDF 5 (arduino-esp32 3.x) returns the iterator through an argument & an esp_err_t, 4.x (& lib/native_hal)
+    // returns it. Both: nullptr when there's no (other) entry, the iterator then released
+    nvs_iterator_t first_entry(const char *nvs_namespace)
+    {
+#if defined(ESP_IDF_VERSION_MAJOR) && ESP_IDF_VERSION_MAJOR >= 5
+        nvs_iterator_t it = nullptr;
+        return nvs_entry_find(NVS_DEFAULT_PART_NAME, nvs_namespace, NVS_TYPE_ANY, &it) == ESP_OK ? it : nullptr;
+#else
+        return nvs_entry_find(NVS_DEFAULT_PART_NAME, nvs_namespace, NVS_TYPE_ANY);
+#endif
+    }
+
+    nvs_iterator_t next_entry(nvs_iterator_t it)
+    {
+#if defined(ESP_IDF_VERSION_MAJOR) && ESP_IDF_VERSION_MAJOR >= 5
+        if (nvs_entry_next(&it) == ESP_OK)
+            return it;
+        nvs_release_iterator(it); // already released (nullptr) after the last entry
+        return nullptr;
+#else
+        return nvs_entry_next(it);
+#endif
+    }
+}
+
 namespace NVS
 {
     constexpr bool RW_MODE = false;
     constexpr bool RO_MODE = true;
 
+    uint8_t load(const char *nvs_namespace, Field *fields, const uint8_t count)
+    {
+        ensure_flash();
+        uint8_t found = 0;
+        nvs_iterator_t it = first_entry(nvs_namespace);
+        while (it != nullptr && found < count)
+        {
+            nvs_entry_info_t info;
+            nvs_entry_info(it, &info);
+            for (uint8_t i = 0; i < count; i++)
+            {
+                if (!fields[i].found && strcmp(info.key, fields[i].key) == 0)
+                {
+                    fields[i].found = true;
+                    found++;
+                    break;
+                }
+            }
+            it = next_entry(it);
+        }
+        nvs_release_iterator(it);
+
+        bool write_defaults = false;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            write_defaults = write_defaults || (!fields[i].found && fields[i].init);
+        }
+        if (found == 0 && !write_defaults)
+        {
+            return 0;
+        }
+
+        open(nvs_namespace, write_defaults ? RW_MODE : RO_MODE);
+        for (uint8_t i = 0; i < count; i++)
+        {
+            Field &field = fields[i];
+            if (field.found)
+            {
+                switch (field.type)
+                {
+                case Field::Type::Int:
+                    *(int *)field.value = nvs_kv.getInt(field.key, *(int *)field.value);
+                    break;
+                case Field::Type::Float:
+                    *(float *)field.value = nvs_kv.getFloat(field.key, *(float *)field.value);
+                    break;
+                case Field::Type::String:
+                    field.found = nvs_kv.getString(field.key, (char *)field.value, field.max_size) > 0; // else too long
+                    break;
+                case Field::Type::Bytes:
+                    field.found = nvs_kv.getBytes(field.key, field.value, field.max_size) > 0;
+                    break;
+                }
+            }
+            else if (field.init)
+            {
+                switch (field.type)
+                {
+                case Field::Type::Int:
+                    nvs_kv.putInt(field.key, *(int *)field.value);
+                    break;
+                case Field::Type::Float:
+                    nvs_kv.putFloat(field.key, *(float *)field.value);
+                    break;
+                case Field::Type::String:
+                    nvs_kv.putString(field.key, (const char *)field.value);
+                    break;
+                case Field::Type::Bytes:
+                    nvs_kv.putBytes(field.key, field.value, field.max_size);
+                    break;
+                }
+            }
+        }
+        nvs_kv.end();
+
+        found = 0; // a String or Bytes read may have failed (too long, another type)
+        for (uint8_t i = 0; i < count; i++)
+        {
+            found += fields[i].found;
+        }
+        return found;
+    }
+
     // init a new key-value OR get the value if existed
     int init_string(const char *nvs_namespace, const char *key, String &value)
     {
         int result;
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         if (!nvs_kv.isKey(key)) // non-existence key --> write default (the pre-existing value)
         {
             nvs_kv.putString(key, value);
@@ -31,7 +164,7 @@ namespace NVS
     int init_string(const char *nvs_namespace, const char *key, char *value, const size_t max_val_len)
     {
         int result;
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         if (!nvs_kv.isKey(key)) // non-existence key --> write default (the pre-existing value)
         {
             nvs_kv.putString(key, value);
@@ -50,7 +183,7 @@ namespace NVS
     size_t init_bytes(const char *nvs_namespace, const char *key, byte *buf, const size_t len, const size_t max_size)
     {
         size_t result;
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         if (!nvs_kv.isKey(key)) // non-existence key --> write default (the pre-existing buf's content!)
         {
             result = nvs_kv.putBytes(key, buf, len);
@@ -67,7 +200,7 @@ namespace NVS
     int init_int(const char *nvs_namespace, const char *key, int &value)
     {
         int result;
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         if (!nvs_kv.isKey(key)) // non-existence key --> write default (the pre-existing value)
         {
             nvs_kv.putInt(key, value);
@@ -86,7 +219,7 @@ namespace NVS
     int init_float(const char *nvs_namespace, const char *key, float &value)
     {
         int result;
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         if (!nvs_kv.isKey(key)) // non-existence key --> write default (the pre-existing value)
         {
             nvs_kv.putFloat(key, value);
@@ -101,11 +234,51 @@ namespace NVS
         return result;
     }
 
+    // get the value if existed, otherwise leave it untouched (no default is written). Return 0 if the key doesn't exist
+    size_t get_bytes(const char *nvs_namespace, const char *key, byte *buf, const size_t max_size)
+    {
+        size_t result = 0;
+        open(nvs_namespace, RO_MODE);
+        if (nvs_kv.isKey(key))
+        {
+            result = nvs_kv.getBytes(key, buf, max_size);
+        }
+        nvs_kv.end();
+        return result;
+    }
+
+    // get the value if existed, otherwise leave it untouched (no default is written). Return 0 if the key doesn't exist
+    size_t get_string(const char *nvs_namespace, const char *key, char *value, const size_t max_val_len)
+    {
+        size_t result = 0;
+        open(nvs_namespace, RO_MODE);
+        if (nvs_kv.isKey(key))
+        {
+            result = nvs_kv.getString(key, value, max_val_len);
+        }
+        nvs_kv.end();
+        return result;
+    }
+
+    // get the value if existed, otherwise leave it untouched (no default is written). Return 0 if the key doesn't exist
+    int get_int(const char *nvs_namespace, const char *key, int &value)
+    {
+        int result = 0;
+        open(nvs_namespace, RO_MODE);
+        if (nvs_kv.isKey(key))
+        {
+            value = nvs_kv.getInt(key);
+            result = 1;
+        }
+        nvs_kv.end();
+        return result;
+    }
+
     // update with checking change
     int update_float_if_change(const char *nvs_namespace, const char *key, const float &value)
     {
         int result;
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         if (value == nvs_kv.getFloat(key)) // the same value --> do-nothing
         {
             result = 0;
@@ -123,7 +296,7 @@ namespace NVS
     int update_int_if_change(const char *nvs_namespace, const char *key, const int &value)
     {
         int result;
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         if (value == nvs_kv.getInt(key)) // the same value
         {
             result = 0; // do nothing
@@ -140,7 +313,7 @@ namespace NVS
     // update without checking-change (you should check `is_change?` before calling this function)
     void update_float(const char *nvs_namespace, const char *key, const float &value)
     {
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         nvs_kv.putFloat(key, value);
         nvs_kv.end();
     }
@@ -148,7 +321,7 @@ namespace NVS
     // update without checking-change (you should check `is_change?` before calling this function)
     void update_int(const char *nvs_namespace, const char *key, const int &value)
     {
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         nvs_kv.putInt(key, value);
         nvs_kv.end();
     }
@@ -156,7 +329,7 @@ namespace NVS
     // update without checking-change (you should check `is_change?` before calling this function)
     void update_string(const char *nvs_namespace, const char *key, const String &value)
     { // always update (check is_change? before calling this function)
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         nvs_kv.putString(key, value);
         nvs_kv.end();
     }
@@ -164,7 +337,7 @@ namespace NVS
     // update without checking-change (you should check `is_change?` before calling this function)
     void update_string(const char *nvs_namespace, const char *key, const char *value)
     {
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         nvs_kv.putString(key, value);
         nvs_kv.end();
     }
@@ -172,8 +345,19 @@ namespace NVS
     // update without checking-change (you should check `is_change?` before calling this function)
     void update_bytes(const char *nvs_namespace, const char *key, const byte *buf, const size_t len)
     { // always update (check is_change? before calling this function)
-        nvs_kv.begin(nvs_namespace, RW_MODE);
+        open(nvs_namespace, RW_MODE);
         nvs_kv.putBytes(key, buf, len);
         nvs_kv.end();
     }
+
+    // remove a key-value (no-op if it doesn't exist)
+    void remove(const char *nvs_namespace, const char *key)
+    {
+        open(nvs_namespace, RW_MODE);
+        if (nvs_kv.isKey(key))
+        {
+            nvs_kv.remove(key);
+        }
+        nvs_kv.end();
+    }
 }
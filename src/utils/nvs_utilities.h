@@ -3,6 +3,39 @@
 
 namespace NVS
 {
+    // A value read by load(): its destination holds the default
+    struct Field
+    {
+        enum class Type : uint8_t
+        {
+            Int,
+            Float,
+            String,
+            Bytes,
+        };
+        const char *key;
+        Type type;
+        void *value;
+        size_t max_size;   // String & Bytes: the buffer's size
+        bool init;         // a missing key is written with the default (like init_*()), else left untouched (like get_*())
+        bool found{false}; // set by load()
+
+        Field(const char *key, int &value, const bool init = true) : key(key), type(Type::Int), value(&value), max_size(sizeof(int)), init(init) {}
+        Field(const char *key, float &value, const bool init = true) : key(key), type(Type::Float), value(&value), max_size(sizeof(float)), init(init) {}
+        Field(const char *key, char *value, const size_t max_size, const bool init = true) : key(key), type(Type::String), value(value), max_size(max_size), init(init) {}
+        Field(const char *key, byte *value, const size_t max_size, const bool init = false) : key(key), type(Type::Bytes), value(value), max_size(max_size), init(init) {}
+    };
+
+    // Read the fields of a namespace at once: one pass over its entries (nvs_entry_find) tells which keys exist, then one
+    // open reads them (no lookup of a missing key, no open per key) & writes the missing defaults. Return the number found
+    uint8_t load(const char *nvs_namespace, Field *fields, const uint8_t count);
+
+    template <size_t N>
+    uint8_t load(const char *nvs_namespace, Field (&fields)[N])
+    {
+        return load(nvs_namespace, fields, N);
+    }
+
     // init a new key-value OR get the value if existed
     int init_string(const char *nvs_namespace, const char *key, String &value);
 
@@ -18,6 +51,15 @@ namespace NVS
     // init a new key-value OR get the value if existed
     int init_float(const char *nvs_namespace, const char *key, float &value);
 
+    // get the value if existed, otherwise leave it untouched (no default is written). Return 0 if the key doesn't exist
+    size_t get_bytes(const char *nvs_namespace, const char *key, byte *buf, const size_t max_size);
+
+    // get the value if existed, otherwise leave it untouched (no default is written). Return 0 if the key doesn't exist
+    size_t get_string(const char *nvs_namespace, const char *key, char *value, const size_t max_val_len);
+
+    // get the value if existed, otherwise leave it untouched (no default is written). Return 0 if the key doesn't exist
+    int get_int(const char *nvs_namespace, const char *key, int &value);
+
     // update with checking change
     int update_float_if_change(const char *nvs_namespace, const char *key, const float &value);
 
@@ -38,4 +80,7 @@ namespace NVS
 
     // update without checking-change (you should check `is_change?` before calling this function)
     void update_bytes(const char *nvs_namespace, const char *key, const byte *buf, const size_t len);
-}
+
+    // remove a key-value (no-op if it doesn't exist)
+    void remove(const char *nvs_namespace, const char *key);
+}
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "ota_multicast.h"
+
+#include <lwip/sockets.h>
+#include <memory>
+#include "http_utilities.h"
+
+namespace
+{
+    constexpr const size_t sign_len = 512U;
+    constexpr const uint16_t default_block_size = 1024U; // used for the repair when no packet has been received
+}
+
+int OTA_Multicast::receive(const char *url, const char *group_ip, const uint16_t port, const uint32_t idle_timeout_ms, uint8_t *signature)
+{
+    stats = Stats{};
+    uint32_t start = millis();
+
+    // the signature & the image's length from the origin:
+    uint32_t img_len = 0;
+    HTTPClient &http = HTTP::client();
+    int len = HTTP::get_range(http, url, 0, sign_len - 1, &img_len);
+    if (len != (int)sign_len || img_len <= sign_len || http.getStream().readBytes(signature, sign_len) != sign_len)
+    {
+        log_i("Multicast OTA: failed to get the signature from %s", url);
+        HTTP::close(http);
+        return -1;
+    }
+    http.end();
+    fw_len = img_len - sign_len;
+
+    partition = esp_ota_get_next_update_partition(NULL);
+    if (esp_ota_begin(partition, fw_len, &handle) != ESP_OK)
+    { // erases the partition's range to be written
+        log_i("Firmware's length, %d bytes, exceeds the OTA space!", fw_len);
+        return -1;
+    }
+
+    uint32_t image_id;
+    memcpy(&image_id, signature, sizeof(image_id));
+    block_size = 0;
+    uint32_t received = listen(group_ip, port, image_id, idle_timeout_ms);
+    log_i("Multicast OTA: %d/%d blocks received (%d rebuilt from parity)", received, block_count, stats.recovered_blocks);
+
+    bool repaired = repair(url);
+    bitmap.reset();
+    if (!repaired)
+    {
+        esp_ota_abort(handle);
+        return -1;
+    }
+    if (esp_ota_end(handle) != ESP_OK) // validates the app image
+    {
+        log_i("Multicast OTA: invalid app image");
+        return -1;
+    }
+
+    stats.elapsed_ms = millis() - start;
+    log_i("Multicast OTA: %d bytes in %d ms, HTTP repair: %d blocks, %d bytes", fw_len, stats.elapsed_ms, stats.repaired_blocks, stats.repair_bytes);
+    return fw_len;
+}
+
+// Collect the carousel's blocks until all are received or no new block came for `idle_timeout_ms`.
+uint32_t OTA_Multicast::listen(const char *group_ip, const uint16_t port, const uint32_t image_id, const uint32_t idle_timeout_ms)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    ip_mreq group{};
+    group.imr_multiaddr.s_addr = inet_addr(group_ip);
+    group.imr_interface.s_addr = htonl(INADDR_ANY);
+    timeval timeout{0, 200 * 1000};
+    if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) != 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+    {
+        log_e("Multicast OTA: failed to join %s:%d", group_ip, port);
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+
+    std::unique_ptr<uint8_t[]> packet{new uint8_t[sizeof(Header) + max_block_size]};
+    uint32_t received = 0;
+    uint32_t last_new_block = millis();
+    while (millis() - last_new_block < idle_timeout_ms && (block_size == 0 || received < block_count))
+    {
+        int len = recv(fd, packet.get(), sizeof(Header) + max_block_size, 0);
+        if (len < (int)sizeof(Header))
+            continue;
+
+        Header header;
+        memcpy(&header, packet.get(), sizeof(Header));
+        if (memcmp(header.magic, "OTAM", 4) != 0 || header.image_id != image_id || header.fw_len != fw_len ||
+            header.block_size == 0 || header.block_size > max_block_size || len != (int)(sizeof(Header) + header.block_size))
+            continue; // not our image
+        if (block_size == 0)
+        { // the first packet of the carousel
+            block_size = header.block_size;
+            block_count = (fw_len + block_size - 1) / block_size;
+            bitmap.reset(new uint8_t[(block_count + 7) / 8]());
+        }
+        if (header.block_size != block_size)
+            continue;
+
+        uint8_t *payload = packet.get() + sizeof(Header);
+        if (header.kind == DataBlock && header.index < block_count && !has_block(header.index))
+        {
+            if (!write_block(header.index, payload))
+                break;
+            stats.multicast_blocks++;
+            received++;
+            last_new_block = millis();
+        }
+        else if (header.kind == ParityBlock && header.group_size > 0)
+        {
+            uint32_t before = stats.recovered_blocks;
+            recover(header, payload);
+            if (stats.recovered_blocks != before)
+            {
+                received++;
+                last_new_block = millis();
+            }
+        }
+    }
+
+    setsockopt(fd, IPPROTO_IP, IP_DROP_MEMBERSHIP, &group, sizeof(group));
+    close(fd);
+    return received;
+}
+
+bool OTA_Multicast::write_block(uint32_t i, const uint8_t *data)
+{
+    if (esp_ota_write_with_offset(handle, data, block_len(i), i * block_size) != ESP_OK)
+    {
+        log_e("Multicast OTA: flash write failed at block %d", i);
+        return false;
+    }
+    set_block(i);
+    return true;
+}
+
+// Rebuild the only missing block of a parity group: parity XOR (the group's other blocks, read back from flash)
+void OTA_Multicast::recover(const Header &header, uint8_t *parity)
+{
+    uint32_t first = header.index * header.group_size;
+    uint32_t last = min(first + header.group_size, block_count);
+    uint32_t missing = UINT32_MAX;
+    for (uint32_t i = first; i < last; i++)
+    {
+        if (!has_block(i))
+        {
+            if (missing != UINT32_MAX)
+                return; // 2 or more lost blocks, wait for the next carousel round
+            missing = i;
+        }
+    }
+    if (missing == UINT32_MAX)
+        return;
+
+    uint8_t block[max_block_size];
+    for (uint32_t i = first; i < last; i++)
+    {
+        if (i == missing)
+            continue;
+        size_t len = block_len(i);
+        if (esp_partition_read(partition, i * block_size, block, len) != ESP_OK)
+            return;
+        for (size_t j = 0; j < len; j++) // shorter (last) block: zero-padded
+            parity[j] ^= block[j];
+    }
+    if (write_block(missing, parity))
+        stats.recovered_blocks++;
+}
+
+// Fetch the runs of missing blocks from the origin with HTTP Range requests
+bool OTA_Multicast::repair(const char *url)
+{
+    if (block_size == 0)
+    { // nothing from the multicast group --> the whole firmware over HTTP
+        block_size = default_block_size;
+        block_count = (fw_len + block_size - 1) / block_size;
+        bitmap.reset(new uint8_t[(block_count + 7) / 8]());
+    }
+
+    constexpr const size_t bufferSize = SPI_FLASH_SEC_SIZE;
+    std::unique_ptr<uint8_t[]> buffer{new uint8_t[bufferSize]};
+    uint32_t i = 0;
+    while (i < block_count)
+    {
+        if (has_block(i))
+        {
+            i++;
+            continue;
+        }
+        uint32_t run_end = i;
+        while (run_end < block_count && !has_block(run_end))
+            run_end++;
+
+        uint32_t offset = i * block_size;
+        uint32_t end = min(run_end * block_size, fw_len);
+        HTTPClient &http = HTTP::client();
+        if (HTTP::get_range(http, url, sign_len + offset, sign_len + end - 1) != (int)(end - offset))
+        {
+            HTTP::close(http);
+            return false;
+        }
+        while (offset < end)
+        {
+            size_t chunk = min((uint32_t)bufferSize, end - offset);
+            if (http.getStream().readBytes(buffer.get(), chunk) != chunk ||
+                esp_ota_write_with_offset(handle, buffer.get(), chunk, offset) != ESP_OK)
+            {
+                log_i("Multicast OTA: HTTP repair failed at %d", offset);
+                HTTP::close(http);
+                return false;
+            }
+            offset += chunk;
+        }
+        http.end();
+
+        stats.repaired_blocks += run_end - i;
+        stats.repair_bytes += end - i * block_size;
+        for (; i < run_end; i++)
+            set_block(i);
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <memory>
+
+// Multicast OTA receiver (one transmission for all the devices of a site):
+// - A sender loops over the firmware's blocks ("carousel") on a UDP multicast group, with a XOR parity block
+//   after every `group_size` data blocks (forward error correction: one lost block per group is rebuilt).
+// - Received blocks are written straight into the next OTA partition and tracked in a bitmap.
+// - Blocks still missing when the carousel goes quiet are fetched from the HTTP URL with Range requests.
+// - The signature (& the image length) always comes from the HTTP URL, its first bytes identify the carousel's image.
+// Packet (little-endian): "OTAM" | kind u8 | group_size u8 | block_size u16 | image_id u32 | fw_len u32 | index u32 | payload
+// (payload: always `block_size` bytes, the last data block is zero-padded; image_id: the signature's first 4 bytes)
+class OTA_Multicast
+{
+public:
+    static constexpr size_t max_block_size = 1400U; // fits an Ethernet MTU with the IP/UDP/packet headers
+
+    struct Stats
+    {
+        uint32_t multicast_blocks{0}; // data blocks received from the group
+        uint32_t recovered_blocks{0}; // data blocks rebuilt from the parity blocks
+        uint32_t repaired_blocks{0};  // data blocks fetched with HTTP Range requests
+        uint32_t repair_bytes{0};
+        uint32_t elapsed_ms{0};
+    };
+
+    // Receive the firmware of the image at `url` from the multicast group into the next OTA partition.
+    // Return the firmware's length (the signature is put in `signature`), or <= 0 on failure.
+    // The caller must verify the signature before setting the boot partition.
+    int receive(const char *url, const char *group_ip, const uint16_t port, const uint32_t idle_timeout_ms, uint8_t *signature);
+
+    const Stats &get_stats() const { return stats; }
+
+private:
+    enum Kind : uint8_t
+    {
+        DataBlock = 1,
+        ParityBlock = 2,
+    };
+
+    struct __attribute__((packed)) Header
+    {
+        char magic[4];
+        uint8_t kind;
+        uint8_t group_size;
+        uint16_t block_size;
+        uint32_t image_id;
+        uint32_t fw_len;
+        uint32_t index; // data block index or parity group index
+    };
+
+    esp_ota_handle_t handle{0};
+    const esp_partition_t *partition{nullptr};
+    uint32_t fw_len{0};
+    uint16_t block_size{0};
+    uint32_t block_count{0};
+    std::unique_ptr<uint8_t[]> bitmap;
+    Stats stats;
+
+    bool has_block(uint32_t i) const { return bitmap[i / 8] & (1 << (i % 8)); }
+    void set_block(uint32_t i) { bitmap[i / 8] |= (1 << (i % 8)); }
+    size_t block_len(uint32_t i) const { return min((uint32_t)block_size, fw_len - i * block_size); }
+
+    uint32_t listen(const char *group_ip, const uint16_t port, const uint32_t image_id, const uint32_t idle_timeout_ms);
+    bool write_block(uint32_t i, const uint8_t *data);
+    void recover(const Header &header, uint8_t *parity);
+    bool repair(const char *url);
+};
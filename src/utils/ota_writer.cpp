@@ -0,0 +1,151 @@
+#include "ota_writer.h"
+
+namespace
+{
+    constexpr const size_t compare_chunk = 256U; // read back in small chunks: no second sector buffer
+    constexpr const size_t write_align = 16U;    // the flash encryption block: the last sector is padded to it
+}
+
+bool OTA_Writer::begin(const size_t image_len)
+{
+    partition = esp_ota_get_next_update_partition(NULL);
+    if (partition == nullptr || image_len == 0 || image_len > partition->size)
+    {
+        log_e("OTA writer: no room for %u bytes", (unsigned)image_len);
+        return false;
+    }
+    if (!sector)
+    {
+        sector.reset(new uint8_t[sector_size]);
+    }
+    this->image_len = image_len;
+    offset = 0;
+    fill = 0;
+    erased_end = 0;
+    changed_run = 0;
+    stats = Stats{};
+    return true;
+}
+
+bool OTA_Writer::write(const uint8_t *data, size_t len)
+{
+    if (partition == nullptr || offset + fill + len > image_len)
+    {
+        return false;
+    }
+    while (len > 0)
+    {
+        size_t n = min(len, sector_size - fill);
+        memcpy(sector.get() + fill, data, n);
+        fill += n;
+        data += n;
+        len -= n;
+        if (fill == sector_size && !flush())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OTA_Writer::finish()
+{
+    if (partition == nullptr || offset + fill != image_len || !flush())
+    {
+        log_e("OTA writer: incomplete image (%u/%u bytes)", (unsigned)progress(), (unsigned)image_len);
+        return false;
+    }
+    return true;
+}
+
+bool OTA_Writer::end()
+{
+    if (!finish())
+    {
+        return false;
+    }
+    log_i("OTA writer: %u sectors written, %u unchanged (skipped), %u erases (erase-ahead from 0x%x); %u ms erasing, %u ms programming",
+          stats.sectors_written, stats.sectors_skipped, stats.erases, stats.erase_ahead_at, stats.erase_us / 1000, stats.program_us / 1000);
+    return true;
+}
+
+// The first `len` bytes of the incoming sector are already in flash
+bool OTA_Writer::is_unchanged(const size_t len)
+{
+    uint8_t current[compare_chunk];
+    for (size_t pos = 0; pos < len; pos += compare_chunk)
+    {
+        size_t n = min(compare_chunk, len - pos);
+        if (esp_partition_read(partition, offset + pos, current, n) != ESP_OK || memcmp(current, sector.get() + pos, n) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Erase the sector at `offset`, or in erase-ahead mode up to the next block boundary (a whole block once aligned)
+bool OTA_Writer::erase()
+{
+    size_t len = sector_size;
+    if (changed_run >= erase_ahead_after)
+    {
+        size_t image_end = (image_len + sector_size - 1) / sector_size * sector_size;
+        len = min(min((offset / block_size + 1) * block_size, image_end) - offset, max_erase);
+    }
+    uint32_t start_us = micros();
+    if (esp_partition_erase_range(partition, offset, len) != ESP_OK)
+    {
+        return false;
+    }
+    stats.erase_us += micros() - start_us;
+    stats.erases++;
+    erased_end = offset + len;
+    return true;
+}
+
+bool OTA_Writer::flush()
+{
+    if (fill == 0)
+    {
+        return true;
+    }
+    if (changed_run < erase_ahead_after)
+    {
+        uint32_t start_us = micros();
+        bool unchanged = is_unchanged(fill);
+        stats.compare_us += micros() - start_us;
+        changed_run = unchanged ? 0 : changed_run + 1;
+        if (changed_run == erase_ahead_after)
+        {
+            stats.erase_ahead_at = offset;
+            log_i("OTA writer: a new image from 0x%x on, erasing ahead", (unsigned)offset);
+        }
+        if (unchanged)
+        {
+            stats.sectors_skipped++;
+            offset += sector_size;
+            fill = 0;
+            return true;
+        }
+    }
+
+    size_t len = (fill + write_align - 1) / write_align * write_align;
+    memset(sector.get() + fill, 0xFF, len - fill);
+    if (offset >= erased_end && !erase())
+    {
+        log_e("OTA writer: flash erase error at 0x%x", (unsigned)offset);
+        return false;
+    }
+    uint32_t start_us = micros();
+    if (esp_partition_write(partition, offset, sector.get(), len) != ESP_OK)
+    {
+        log_e("OTA writer: flash write error at 0x%x", (unsigned)offset);
+        return false;
+    }
+    stats.program_us += micros() - start_us;
+    stats.sectors_written++;
+    offset += sector_size;
+    fill = 0;
+    return true;
+}
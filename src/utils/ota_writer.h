@@ -0,0 +1,67 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <memory>
+
+// Sequential writer of an app image into the next OTA partition, a flash sector at a time:
+// - Each incoming sector is compared with the partition's content first; a matching one (a repeated update, or the
+//   part already written by an interrupted one) is neither erased nor programmed: a read instead of an erase.
+// - A changed sector is erased & programmed in one burst (a whole, aligned sector: full pages).
+// - Erase-ahead: after erase_ahead_after changed sectors in a row the rest is taken as a new image: no more
+//   comparing, the flash ahead of the write cursor is erased a 64KB block at a time when the cursor enters it
+//   (one block erase costs about 3 sector erases and covers 16), so the download stalls once per block.
+//   limit_erase() trades that for shorter stalls (the flash cache is off meanwhile: the other tasks' code stalls too).
+// - The image is not trusted because of the skipped sectors: the caller verifies its signature over the whole
+//   partition, then boots it (esp_ota_set_boot_partition() validates the app image) or erases its first bytes.
+class OTA_Writer
+{
+public:
+    static constexpr size_t sector_size = SPI_FLASH_SEC_SIZE;
+    static constexpr size_t block_size = 64 * 1024U;
+    static constexpr uint8_t erase_ahead_after = 2;
+
+    struct Stats
+    {
+        uint32_t sectors_written{0}; // erased & programmed
+        uint32_t sectors_skipped{0}; // already up to date in flash
+        uint32_t erases{0};          // erase operations (a sector, or up to a block ahead)
+        uint32_t erase_ahead_at{0};  // where erase-ahead started (0: never)
+        uint32_t compare_us{0};      // time spent reading back & comparing
+        uint32_t erase_us{0};
+        uint32_t program_us{0};
+    };
+
+    // Start an image of `image_len` bytes. Return false if it doesn't fit in the next OTA partition
+    bool begin(const size_t image_len);
+
+    // Erase at most `max_len` bytes (a multiple of sector_size) at a time, e.g. sector by sector under a CPU budget
+    void limit_erase(const size_t max_len) { max_erase = max(max_len, sector_size); }
+
+    // Append bytes to the image (any chunk size). Return false on a flash error or past the image's length
+    bool write(const uint8_t *data, size_t len);
+
+    // Write the last sector. Return false if the image is incomplete
+    bool finish();
+
+    // finish() & log the write stats. Return false if the image is incomplete
+    bool end();
+
+    size_t progress() const { return offset + fill; }
+    const esp_partition_t *get_partition() const { return partition; }
+    const Stats &get_stats() const { return stats; }
+
+private:
+    const esp_partition_t *partition{nullptr};
+    std::unique_ptr<uint8_t[]> sector; // the incoming sector
+    size_t image_len{0};
+    size_t offset{0}; // of the incoming sector in the partition
+    size_t fill{0};   // bytes in `sector`
+    size_t erased_end{0};   // the flash before it, from `offset` on, is erased (erase-ahead)
+    size_t max_erase{block_size};
+    uint8_t changed_run{0}; // changed sectors in a row
+    Stats stats;
+
+    bool is_unchanged(const size_t len);
+    bool erase();
+    bool flush();
+};
@@ -1,9 +1,12 @@
 #include "rsa_pki.h"
 
+#include <mbedtls/base64.h>
 #include <mbedtls/md.h>
 #include <mbedtls/pk.h>
 #include <memory>
 
+#include "sha256_utilities.h"
+
 // "Infrastructure" to verify RSA public keys
 // Construct this object from public key (*pub_key pointer and keyLen)
 // It has methods to verify_signature using segmentation wise (from data_stream) or from data_byes
@@ -23,7 +26,6 @@ RSA_PKI::RSA_PKI(const unsigned char *pub_key, const size_t keylen)
     const mbedtls_md_info_t *md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
     mbedtls_md_init(&sha);
     mbedtls_md_setup(&sha, md_info, 0);
-    mbedtls_md_starts(&sha);
 }
 
 RSA_PKI::~RSA_PKI()
@@ -64,6 +66,7 @@ bool RSA_PKI::verify_signature(Stream &data_stream, const int dataLen, const uin
     }
 
     // step-wise hashing data (SHA256) from data_stream:
+    mbedtls_md_starts(&sha); // (re)start: the same object can verify several times
     while (remainBytes > 0)
     {
         int bytesToRead = (remainBytes < bufferSize) ? remainBytes : bufferSize;
@@ -107,6 +110,7 @@ bool RSA_PKI::verify_signature(const esp_partition_t *partition, const int dataL
     }
 
     // step-wise hashing data (SHA256) from data_stream:
+    mbedtls_md_starts(&sha); // (re)start: the same object can verify several times
     uint32_t offsetPos = 0; // offset position for partitionRead(...)
     while (remainBytes > 0)
     {
@@ -144,6 +148,7 @@ bool RSA_PKI::verify_signature(const uint8_t *data, const size_t dataLen, const
         return false;
     }
 
+    mbedtls_md_starts(&sha);
     mbedtls_md_update(&sha, data, dataLen); // hashing "message --> digest" using SHA256; step-wise update
     byte hash[32];
     mbedtls_md_finish(&sha, hash);
@@ -152,3 +157,56 @@ bool RSA_PKI::verify_signature(const uint8_t *data, const size_t dataLen, const
                               hash, 32,
                               signature, 512);
 }
+
+bool RSA_PKI::verify_hash(const uint8_t *hash, const uint8_t *signature)
+{
+    if (!key_valid)
+    {
+        log_i("Invalid RSA public key!");
+        return false;
+    }
+
+    return !mbedtls_pk_verify(&rsa, MBEDTLS_MD_SHA256,
+                              hash, 32,
+                              signature, 512);
+}
+
+size_t RSA_PKI::decode_key(const char *base64_der, const char *key_id, uint8_t *der, const size_t max_size)
+{
+    if (base64_der == nullptr || key_id == nullptr)
+    {
+        return 0;
+    }
+    size_t der_len = 0;
+    if (mbedtls_base64_decode(der, max_size, &der_len, (const unsigned char *)base64_der, strlen(base64_der)) != 0)
+    {
+        log_e("Inline key %s: invalid base64 or > %d bytes", key_id, max_size);
+        return 0;
+    }
+    return check_key(der, der_len, key_id);
+}
+
+size_t RSA_PKI::check_key(const uint8_t *der, const size_t der_len, const char *key_id)
+{
+    if (key_id == nullptr)
+    {
+        return 0;
+    }
+    uint8_t digest[SHA256::digest_len];
+    SHA256::Hasher hasher;
+    hasher.update(der, der_len);
+    hasher.finish(digest);
+    char id[17];
+    for (int i = 0; i < 8; i++)
+    {
+        snprintf(id + 2 * i, 3, "%02x", digest[i]);
+    }
+    if (strcasecmp(id, key_id) != 0)
+    {
+        log_e("Inline key %s: the key ID doesn't match its content (%s)", key_id, id);
+        return 0;
+    }
+
+    RSA_PKI rsa(der, der_len);
+    return rsa.is_key_valid() ? der_len : 0;
+}
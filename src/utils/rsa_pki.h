@@ -20,6 +20,14 @@ public:
     bool verify_signature(const esp_partition_t *partition, const int dataLen, const uint8_t *signature);
     bool verify_signature(const String &data, const String &signature);
     bool verify_signature(const uint8_t *data, const size_t dataLen, const uint8_t *signature);
+    // Verify the signature of data already hashed (SHA-256, e.g. streamed through a SHA256::Hasher)
+    bool verify_hash(const uint8_t *hash, const uint8_t *signature);
+
+    // Decode an inline public key (base64 DER) & check it: `key_id` must be the hex of the first 8 bytes of SHA-256(DER)
+    // and it must be an RSA key. Return the DER's length, 0 if invalid.
+    static size_t decode_key(const char *base64_der, const char *key_id, uint8_t *der, const size_t max_size);
+    // The same checks of a raw DER key (e.g. from a binary manifest). Return der_len, 0 if invalid.
+    static size_t check_key(const uint8_t *der, const size_t der_len, const char *key_id);
 
 private:
     mbedtls_pk_context rsa;
@@ -0,0 +1,45 @@
+#include "sha256_utilities.h"
+
+namespace SHA256
+{
+    Hasher::Hasher()
+    {
+        mbedtls_md_init(&sha);
+        mbedtls_md_setup(&sha, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+        mbedtls_md_starts(&sha);
+    }
+
+    Hasher::~Hasher()
+    {
+        mbedtls_md_free(&sha);
+    }
+
+    void Hasher::update(const uint8_t *data, const size_t len)
+    {
+        mbedtls_md_update(&sha, data, len);
+    }
+
+    void Hasher::finish(uint8_t *digest)
+    {
+        mbedtls_md_finish(&sha, digest);
+    }
+
+    bool from_hex(const char *hex, const size_t len, uint8_t *digest)
+    {
+        if (len != 2 * digest_len)
+            return false;
+        for (size_t i = 0; i < len; i++)
+        {
+            char c = hex[i];
+            uint8_t nibble;
+            if (c >= '0' && c <= '9')
+                nibble = c - '0';
+            else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+                nibble = (c | 0x20) - 'a' + 10;
+            else
+                return false;
+            digest[i / 2] = (i % 2 == 0) ? nibble << 4 : digest[i / 2] | nibble;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include <mbedtls/md.h>
+
+namespace SHA256
+{
+    constexpr const size_t digest_len = 32;
+
+    // Incremental SHA-256 (mbedtls): update() with the parts, then finish() into a digest_len bytes buffer
+    class Hasher
+    {
+    public:
+        Hasher();
+        ~Hasher();
+        void update(const uint8_t *data, const size_t len);
+        void finish(uint8_t *digest);
+
+    private:
+        mbedtls_md_context_t sha;
+    };
+
+    // A digest written in hex: the `len` characters at `hex` must be its 64 hex digits (either case). Return false if not
+    bool from_hex(const char *hex, const size_t len, uint8_t *digest);
+}
@@ -0,0 +1,78 @@
+#include "throttle.h"
+
+namespace
+{
+    constexpr const size_t min_burst = 1460U; // a TCP segment
+}
+
+Throttle::Throttle(const uint32_t rate, const uint16_t slice_ms, const uint16_t pause_ms)
+    : rate(rate), slice_ms(slice_ms), pause_ms(pause_ms)
+{
+    burst = max((size_t)(rate / 4), min_burst);
+    tokens = burst;
+    refill_us = micros();
+    slice_start_ms = millis();
+}
+
+size_t Throttle::acquire(const size_t max_len)
+{
+    uint32_t busy_ms = millis() - slice_start_ms;
+    if (slice_ms > 0 && busy_ms >= slice_ms)
+    { // an overrun (e.g. a sector erase is longer than a slice) gets a longer pause: the same share of the CPU
+        stats.slices++;
+        sleep((uint32_t)((uint64_t)pause_ms * busy_ms / slice_ms), stats.paused_ms);
+    }
+    if (rate == 0)
+    {
+        return max_len;
+    }
+
+    size_t len = min(max_len, burst);
+    refill();
+    if (tokens < len)
+    {
+        sleep((uint32_t)(((uint64_t)(len - tokens) * 1000U + rate - 1) / rate), stats.limited_ms);
+        refill();
+    }
+    return len;
+}
+
+void Throttle::consume(const size_t len)
+{
+    tokens -= min(tokens, len);
+}
+
+void Throttle::refill()
+{
+    uint32_t now = micros();
+    uint64_t earned = (uint64_t)(now - refill_us) * rate / 1000000U;
+    if (earned == 0)
+    {
+        return;
+    }
+    if (tokens + earned >= burst)
+    {
+        tokens = burst;
+        refill_us = now;
+    }
+    else
+    {
+        tokens += earned;
+        refill_us += (uint32_t)(earned * 1000000U / rate); // keep the fraction of a token
+    }
+}
+
+// Any sleep lets the other tasks run: a new CPU slice starts after it
+void Throttle::sleep(const uint32_t ms, uint32_t &counter)
+{
+    if (ms > 0)
+    {
+        delay(ms);
+    }
+    else
+    {
+        yield();
+    }
+    counter += ms;
+    slice_start_ms = millis();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <Arduino.h>
+
+// Pacing of a background transfer, so that an update doesn't starve the application's tasks:
+// - Bandwidth: a token bucket of `rate` bytes/s (a burst of a quarter second at most), each read waits for its tokens.
+// - CPU: the transfer runs in slices of `slice_ms` (network reads, hashing, flash writes), then sleeps `pause_ms`
+//   (scaled up after an overrun: the transfer gets slice_ms / (slice_ms + pause_ms) of the time at most).
+// The waits are delay()s: vTaskDelay() on the ESP32, the other tasks run meanwhile. 0: no limit.
+class Throttle
+{
+public:
+    struct Stats
+    {
+        uint32_t slices{0};     // ended by the CPU budget
+        uint32_t paused_ms{0};  // slept between slices
+        uint32_t limited_ms{0}; // slept waiting for tokens
+    };
+
+    Throttle(const uint32_t rate, const uint16_t slice_ms, const uint16_t pause_ms);
+
+    // Wait as needed before reading up to `max_len` bytes. Return how many may be read now (1 .. max_len)
+    size_t acquire(const size_t max_len);
+
+    // `len` bytes were read
+    void consume(const size_t len);
+
+    uint32_t get_rate() const { return rate; }
+    const Stats &get_stats() const { return stats; }
+
+private:
+    const uint32_t rate;
+    const uint16_t slice_ms;
+    const uint16_t pause_ms;
+    size_t burst;
+    size_t tokens;
+    uint32_t refill_us;
+    uint32_t slice_start_ms;
+    Stats stats;
+
+    void refill();
+    void sleep(const uint32_t ms, uint32_t &counter);
+};
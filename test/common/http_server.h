@@ -0,0 +1,266 @@
+#pragma once
+// A minimal HTTP/1.1 server for the native tests, on 127.0.0.1 (or another loopback address: a host of a simulated LAN)
+// & an ephemeral port, one thread per connection:
+// - GET of the files under a directory (the query string is ignored), keep-alive, single byte ranges
+//   ("Range: bytes=<first>-[<last>]" --> 206), 404 when missing
+// - a test may answer some requests itself (handler(), e.g. an error status, a long-poll, a connection closed mid-body
+//   or after the response) & count them (requests())
+// - stop() closes the listening socket & the open connections: the next ones are refused, like a server gone down
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TestHttpServer
+{
+public:
+    struct Request
+    {
+        std::string path;  // without the query string
+        std::string query; // after '?', "" if none
+        std::string range;         // the Range header, "" if none
+        std::string cache_control; // the Cache-Control header, "" if none
+    };
+    struct Response
+    {
+        int status{200};
+        std::string body;
+        std::vector<std::string> headers; // "Name: value"
+        uint32_t delay_ms{0};            // before answering (a slow server, a long-poll)
+        size_t cut_at{std::string::npos}; // send the body up to there, then close (a failure mid-download)
+        bool close{false};                // close the connection after answering, unannounced (an idle timeout)
+    };
+    // Answer a request (return true), or let the file server do it (false). Called on the connection's thread
+    using Handler = std::function<bool(const Request &, Response &)>;
+
+    explicit TestHttpServer(const std::string &root, const char *ip = "127.0.0.1") : root(root), ip(ip)
+    {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int yes = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(ip);
+        socklen_t len = sizeof(addr);
+        if (bind(listen_fd, (sockaddr *)&addr, len) != 0 || listen(listen_fd, 64) != 0 ||
+            getsockname(listen_fd, (sockaddr *)&addr, &len) != 0)
+        {
+            perror("TestHttpServer");
+            abort();
+        }
+        server_port = ntohs(addr.sin_port);
+        acceptor = std::thread([this]
+                               { accept_loop(); });
+    }
+
+    ~TestHttpServer()
+    {
+        stop();
+        acceptor.join();
+        while (active_connections > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    void stop()
+    {
+        if (stopped.exchange(true))
+            return;
+        shutdown(listen_fd, SHUT_RDWR);
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int fd : open_fds)
+            shutdown(fd, SHUT_RDWR);
+    }
+
+    uint16_t port() const { return server_port; }
+
+    // "http://<ip>:<port><path>"
+    std::string url(const std::string &path = "/") const
+    {
+        return "http://" + ip + ":" + std::to_string(server_port) + path;
+    }
+
+    // The file served at `path`
+    std::string file(const std::string &path) const { return root + path; }
+
+    void handler(Handler fn)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        custom = fn;
+    }
+
+    uint32_t requests() const { return request_count; }
+    uint32_t connections() const { return connection_count; }
+
+    // The requests of a path so far (the query string ignored)
+    uint32_t requests(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t count = 0;
+        for (const std::string &p : paths)
+            count += (p == path);
+        return count;
+    }
+
+private:
+    std::string root;
+    std::string ip;
+    int listen_fd{-1};
+    uint16_t server_port{0};
+    std::thread acceptor;
+    std::atomic<bool> stopped{false};
+    std::atomic<uint32_t> request_count{0};
+    std::atomic<uint32_t> connection_count{0};
+    std::atomic<uint32_t> active_connections{0};
+    std::set<int> open_fds;
+    std::mutex mutex;
+    Handler custom;
+    std::vector<std::string> paths;
+
+    void accept_loop()
+    {
+        while (!stopped)
+        {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0)
+                break;
+            connection_count++;
+            active_connections++;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                open_fds.insert(fd);
+            }
+            std::thread([this, fd]
+                        {
+                            serve(fd);
+                            {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                open_fds.erase(fd);
+                            }
+                            close(fd);
+                            active_connections--; })
+                .detach();
+        }
+        close(listen_fd);
+    }
+
+    static bool read_head(int fd, std::string &head)
+    {
+        char c;
+        while (head.size() < 8192 && recv(fd, &c, 1, 0) == 1)
+        {
+            head += c;
+            if (head.size() >= 4 && head.compare(head.size() - 4, 4, "\r\n\r\n") == 0)
+                return true;
+        }
+        return false;
+    }
+
+    static std::string header_value(const std::string &head, const char *name)
+    {
+        std::istringstream lines(head);
+        std::string line;
+        size_t name_len = strlen(name);
+        while (std::getline(lines, line))
+        {
+            if (line.size() > name_len && strncasecmp(line.c_str(), name, name_len) == 0 && line[name_len] == ':')
+            {
+                std::string value = line.substr(name_len + 1);
+                value.erase(0, value.find_first_not_of(' '));
+                value.erase(value.find_last_not_of("\r ") + 1);
+                return value;
+            }
+        }
+        return "";
+    }
+
+    void serve(int fd)
+    {
+        std::string head;
+        while (!stopped && read_head(fd, head))
+        {
+            std::string target = head.substr(head.find(' ') + 1);
+            target = target.substr(0, target.find(' '));
+            Request request;
+            size_t query = target.find('?');
+            request.path = target.substr(0, query);
+            request.query = (query == std::string::npos) ? "" : target.substr(query + 1);
+            request.range = header_value(head, "Range");
+            request.cache_control = header_value(head, "Cache-Control");
+            bool keep_alive = strcasecmp(header_value(head, "Connection").c_str(), "close") != 0;
+            head.clear();
+            request_count++;
+
+            Response response;
+            Handler fn;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                paths.push_back(request.path);
+                fn = custom;
+            }
+            if (!fn || !fn(request, response))
+                serve_file(request, response);
+            if (response.delay_ms > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(response.delay_ms));
+
+            std::string reply = "HTTP/1.1 " + std::to_string(response.status) + " X\r\nContent-Length: " +
+                                std::to_string(response.body.size()) + "\r\nConnection: " +
+                                (keep_alive ? "keep-alive" : "close") + "\r\n";
+            for (const std::string &header : response.headers)
+                reply += header + "\r\n";
+            reply += "\r\n" + response.body;
+            bool cut = response.cut_at < response.body.size();
+            if (cut)
+                reply.resize(reply.size() - response.body.size() + response.cut_at);
+            if (send(fd, reply.data(), reply.size(), MSG_NOSIGNAL) != (ssize_t)reply.size() || !keep_alive || cut ||
+                response.close)
+                return;
+        }
+    }
+
+    void serve_file(const Request &request, Response &response)
+    {
+        struct stat st;
+        std::string path = root + request.path;
+        std::ifstream file(path, std::ios::binary);
+        if (request.path.find("..") != std::string::npos || stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || !file)
+        {
+            response.status = 404;
+            return;
+        }
+        response.body.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        size_t first, last;
+        if (request.range.compare(0, 6, "bytes=") != 0)
+            return;
+        int fields = sscanf(request.range.c_str() + 6, "%zu-%zu", &first, &last);
+        size_t size = response.body.size();
+        if (fields < 1 || first >= size)
+        {
+            response.status = 416;
+            response.headers.push_back("Content-Range: bytes */" + std::to_string(size));
+            response.body.clear();
+            return;
+        }
+        if (fields < 2 || last >= size)
+            last = size - 1;
+        response.status = 206;
+        response.headers.push_back("Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" +
+                                   std::to_string(size));
+        response.body = response.body.substr(first, last - first + 1);
+    }
+};
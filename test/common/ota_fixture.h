@@ -0,0 +1,231 @@
+#pragma once
+// Fixtures of the native tests: a fresh device (its NVS & flash in a temp directory), the releases published by
+// tools/ota_pack.py (TLV manifests, signed by a throw-away RSA-4096 key made with openssl) & served by TestHttpServer,
+// and the check --> reboot sequence of the end-to-end tests (Site, check()).
+#include <Arduino.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <map>
+#include <string>
+
+#include "configOTASecure.h"
+#include "http_server.h"
+
+namespace OtaFixture
+{
+    // The project directory (tools/ is run from there), from this header's path
+    inline std::string project_dir()
+    {
+        char path[PATH_MAX];
+        if (realpath(__FILE__, path) == nullptr)
+            return ".";
+        std::string dir(path);
+        return dir.substr(0, dir.rfind("/test/common/"));
+    }
+
+    inline std::string temp_dir(const char *name)
+    {
+        std::string pattern = std::string("/tmp/") + name + ".XXXXXX";
+        if (mkdtemp(&pattern[0]) == nullptr)
+        {
+            perror(pattern.c_str());
+            abort();
+        }
+        return pattern;
+    }
+
+    inline bool run(const std::string &command)
+    {
+        return system((command + " > /dev/null 2>&1").c_str()) == 0;
+    }
+
+    inline void write_file(const std::string &path, const std::string &content)
+    {
+        std::ofstream(path, std::ios::binary) << content;
+    }
+
+    inline std::string read_file(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // An app image of `size` bytes (the 0xE9 magic byte the flash emulator validates, then pseudo-random bytes)
+    inline std::string app_image(size_t size, uint32_t seed)
+    {
+        std::string image(size, '\0');
+        image[0] = (char)0xE9;
+        for (size_t i = 1; i < size; i++)
+        {
+            seed = seed * 1103515245U + 12345U;
+            image[i] = (char)(seed >> 16);
+        }
+        return image;
+    }
+
+    // A TestHttpServer of a new temp directory holding `files` (path under the root --> content)
+    inline TestHttpServer *serve_files(const char *name, const std::map<std::string, std::string> &files)
+    {
+        std::string root = temp_dir(name);
+        for (const auto &file : files)
+            write_file(root + "/" + file.first, file.second);
+        return new TestHttpServer(root);
+    }
+
+    // A new emulated device: its state directory (NVS, flash). Call before the first NVS or flash access of the program
+    inline std::string use_new_device()
+    {
+        std::string dir = temp_dir("ota_device");
+        setenv("OTA_STATE_DIR", dir.c_str(), 1);
+        setenv("OTA_FLASH_TIMING", "0", 1);
+        nvs_flash_init(); // as at boot: the NVS partition ready for the provisioning
+        // as flashed over USB: a valid app image in the partition it runs from
+        const esp_partition_t *running = esp_ota_get_running_partition();
+        std::string image = app_image(SPI_FLASH_SEC_SIZE, 0);
+        esp_partition_erase_range(running, 0, image.size());
+        esp_partition_write(running, 0, image.data(), image.size());
+        return dir;
+    }
+
+    // A publication directory & its signing key; publish() runs tools/ota_pack.py into it
+    class Publisher
+    {
+    public:
+        Publisher() : dir(temp_dir("ota_publish"))
+        {
+            key = dir + "/key.pem";
+            pub = dir + "/key.pub";
+            if (!run("openssl genrsa -out " + key + " 4096") || !run("openssl rsa -in " + key + " -pubout -out " + pub))
+                abort();
+            mkdir((dir + "/root").c_str(), 0755);
+        }
+
+        std::string root() const { return dir + "/root"; }
+        std::string public_key() const { return read_file(pub); }
+        std::string public_key_path() const { return pub; }
+
+        // The public key in DER, as the device keeps a key received inline
+        std::string public_key_der() const
+        {
+            std::string der = dir + "/key.der";
+            return run("openssl rsa -pubin -in " + pub + " -outform DER -out " + der) ? read_file(der) : "";
+        }
+
+        // Trust the publisher's key on the device, as the former key of both roles (init_role_key() migrates it)
+        void provision() const
+        {
+            std::string pem = public_key();
+            NVS::update_bytes("config", "public_key", (const byte *)pem.c_str(), pem.size() + 1);
+            NVS::update_bytes("firmware", "public_key", (const byte *)pem.c_str(), pem.size() + 1);
+        }
+
+        // Publish config `config_version` with firmware `firmware_version` (`image`) under `base_url`; `args`: more
+        // tools/ota_pack.py options (e.g. "--activate-at +60"). The first call makes the template, the next ones continue
+        // from the published config.json
+        bool publish(const std::string &base_url, const char *config_version, const char *firmware_version,
+                     const std::string &image, const std::string &args = "")
+        {
+            std::string manifest = root() + "/config.json";
+            if (!published)
+            {
+                manifest = dir + "/template.json";
+                write_file(manifest, R"({"type": "ch4_generator", "config": {"version": "0.0.1", "url_change?": false, "url": ")" +
+                                         base_url + R"(/config.img", "public_key_change?": false, "public_key_url": ""}, )"
+                                         R"("device": {"ch4_factor": 25.5, "power_factor": 12.25, "checking_interval": 60}, )"
+                                         R"("firmware": {"version": "0.0.1", "url": "", "public_key_change?": false, "public_key_url": ""}})");
+            }
+            write_file(dir + "/firmware.bin", image);
+            bool ok = run("python3 " + project_dir() + "/tools/ota_pack.py --format tlv --manifest " + manifest +
+                          " --config-key " + key + " --firmware-key " + key + " --out " + root() + " --base-url " +
+                          base_url + " --firmware " + dir + "/firmware.bin --firmware-version " + firmware_version +
+                          " --config-version " + config_version + " " + args);
+            published = published || ok;
+            return ok && access((root() + "/config.img").c_str(), R_OK) == 0;
+        }
+
+        // Sign `entries` ("<type>[:<hw_rev>]=<config.json> ...") into root()/catalog.img (tools/ota_catalog.py)
+        bool publish_catalog(const std::string &entries)
+        {
+            return run("python3 " + project_dir() + "/tools/ota_catalog.py --format tlv --config-key " + key +
+                       " --out " + root() + "/catalog.img " + entries);
+        }
+
+        // The published firmware.img (signature + `image`) of a firmware, "" if none
+        std::string firmware_path(const std::string &image) const
+        {
+            std::string fw_dir = root() + "/fw/";
+            DIR *entries = opendir(fw_dir.c_str());
+            std::string found;
+            while (entries != nullptr && found.empty())
+            {
+                dirent *entry = readdir(entries);
+                if (entry == nullptr)
+                    break;
+                if (entry->d_type != DT_REG)
+                    continue;
+                std::string content = read_file(fw_dir + entry->d_name);
+                if (content.size() == image.size() + SIGN_LEN && content.compare(SIGN_LEN, image.size(), image) == 0)
+                    found = fw_dir + entry->d_name;
+            }
+            if (entries != nullptr)
+                closedir(entries);
+            return found;
+        }
+
+    private:
+        std::string dir;
+        std::string key;
+        std::string pub;
+        bool published{false};
+    };
+
+    // What ESP.restart() throws in a Site's process: the test goes on after the "reboot"
+    struct Rebooted
+    {
+    };
+
+    // The fixture of the end-to-end tests: this process is a new device trusting a publisher's key, its config URL on
+    // the publisher's server, its reboots caught (Rebooted). Construct it before the first NVS or flash access
+    struct Site
+    {
+        std::string device_dir{use_new_device()};
+        Publisher publisher;
+        TestHttpServer server{publisher.root()};
+
+        Site()
+        {
+            publisher.provision();
+            NVS::update_string("config", "url", server.url("/config.img").c_str());
+            ESP.on_restart = []
+            { throw Rebooted(); };
+        }
+
+        bool publish(const char *config_version, const char *firmware_version, const std::string &image,
+                     const std::string &args = "")
+        {
+            return publisher.publish(server.url(""), config_version, firmware_version, image, args);
+        }
+    };
+
+    // One check_update() of the device (a fresh Config: as after a boot), true if it rebooted
+    inline bool check(ConfigErr &err, LAN_Peers *peers = nullptr)
+    {
+        Device_Params device;
+        device.load();
+        Config config;
+        config.use_lan_peers(peers);
+        try
+        {
+            err = config.check_update(device);
+        }
+        catch (const Rebooted &)
+        {
+            return true;
+        }
+        return false;
+    }
+}
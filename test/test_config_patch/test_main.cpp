@@ -0,0 +1,234 @@
+// Config patches on lib/native_hal: check_update() asks for config.img?base=<applied version>, the server answers as
+// tools/update_server does (patches/<base>.img generated by tools/ota_pack.py, else the full config.img). A patch
+// updates the changed device parameters only; a patch of another base (ConfigErr::PatchBaseMismatch) makes the device
+// fetch the full config.img in the same check.
+#include <unity.h>
+
+#include <vector>
+
+#include "../common/ota_fixture.h"
+
+namespace
+{
+    OtaFixture::Site *site;
+
+    // The config.img requests' queries & the bases of the patches served, in order
+    std::vector<std::string> queries;
+    std::vector<std::string> patches_served;
+
+    // update_server: config.img?base=<version> --> patches/<version>.img if any. `fixed_base`: the patch of that base
+    // whatever the query (a server mixing up the versions)
+    void serve_patches(const std::string &fixed_base = "")
+    {
+        queries.clear();
+        patches_served.clear();
+        site->server.handler([fixed_base](const TestHttpServer::Request &request, TestHttpServer::Response &response)
+                              {
+                                  if (request.path != "/config.img")
+                                      return false;
+                                  queries.push_back(request.query);
+                                  if (request.query.compare(0, 5, "base=") != 0)
+                                      return false;
+                                  std::string base = fixed_base.empty() ? request.query.substr(5) : fixed_base;
+                                  std::string patch =
+                                      OtaFixture::read_file(site->publisher.root() + "/patches/" + base + ".img");
+                                  if (patch.empty())
+                                      return false;
+                                  patches_served.push_back(base);
+                                  response.body = patch;
+                                  return true; });
+    }
+
+    // Edit the published config.json (the next publish() continues from it)
+    void set_published(const std::string &from, const std::string &to)
+    {
+        std::string path = site->publisher.root() + "/config.json";
+        std::string manifest = OtaFixture::read_file(path);
+        size_t at = manifest.find(from);
+        TEST_ASSERT_TRUE(at != std::string::npos);
+        OtaFixture::write_file(path, manifest.replace(at, from.size(), to));
+    }
+
+    void assert_config_version(const char *version)
+    {
+        Config_Params config_params;
+        TEST_ASSERT_EQUAL_STRING(version, config_params.version);
+    }
+
+    // Apply the config section of the manifest `json` (JSON, or its binary manifest if `tlv`) as check_update() does
+    void apply_config(const std::string &json, const bool tlv)
+    {
+        std::string dir = OtaFixture::temp_dir("config_patch");
+        OtaFixture::write_file(dir + "/patch.json", json);
+        std::string content = json;
+        if (tlv)
+        {
+            TEST_ASSERT_TRUE(OtaFixture::run("python3 " + OtaFixture::project_dir() + "/tools/manifest_tlv.py " + dir +
+                                             "/patch.json " + dir + "/patch.bin"));
+            content = OtaFixture::read_file(dir + "/patch.bin");
+        }
+        Manifest manifest;
+        TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)manifest.parse((uint8_t *)&content[0], content.size()));
+        Config_Params config_params;
+        config_params.update(manifest.config);
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// The first release: no history, no patch --> the full config.img
+void test_first_release_is_the_full_image()
+{
+    serve_patches();
+    TEST_ASSERT_TRUE(site->publish("0.0.2", "0.0.1", OtaFixture::app_image(1000, 0)));
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    assert_config_version("0.0.2");
+    TEST_ASSERT_EQUAL_UINT32(1, queries.size());
+    TEST_ASSERT_EQUAL_STRING("base=0.0.1", queries[0].c_str()); // the applied version before the check
+    TEST_ASSERT_EQUAL_UINT32(0, patches_served.size());
+}
+
+// One device parameter changed: the patch against 0.0.2 updates it, the others are kept
+void test_patch_updates_the_changed_parameters()
+{
+    set_published("\"ch4_factor\": 25.5", "\"ch4_factor\": 30.5");
+    TEST_ASSERT_TRUE(site->publish("0.0.3", "0.0.1", OtaFixture::app_image(1000, 0)));
+    serve_patches();
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    assert_config_version("0.0.3");
+    TEST_ASSERT_EQUAL_UINT32(1, patches_served.size());
+    TEST_ASSERT_EQUAL_STRING("0.0.2", patches_served[0].c_str());
+    TEST_ASSERT_TRUE(OtaFixture::read_file(site->publisher.root() + "/patches/0.0.2.img").size() <
+                     OtaFixture::read_file(site->publisher.root() + "/config.img").size());
+    Device_Params device;
+    device.load();
+    TEST_ASSERT_EQUAL_FLOAT(30.5, device.ch4_factor);
+    TEST_ASSERT_EQUAL_FLOAT(12.25, device.power_factor);
+    TEST_ASSERT_EQUAL_INT(60, device.checking_interval);
+}
+
+// A patch of another base is rejected, the full config.img fetched in the same check
+void test_patch_of_another_base_falls_back_to_the_full_image()
+{
+    set_published("\"power_factor\": 12.25", "\"power_factor\": 14.5");
+    TEST_ASSERT_TRUE(site->publish("0.0.4", "0.0.1", OtaFixture::app_image(1000, 0)));
+    serve_patches("0.0.2"); // the device has 0.0.3
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    assert_config_version("0.0.4");
+    TEST_ASSERT_EQUAL_UINT32(2, queries.size());
+    TEST_ASSERT_EQUAL_STRING("base=0.0.3", queries[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("", queries[1].c_str());
+    Device_Params device;
+    device.load();
+    TEST_ASSERT_EQUAL_FLOAT(30.5, device.ch4_factor);
+    TEST_ASSERT_EQUAL_FLOAT(14.5, device.power_factor);
+}
+
+// A server without patches (a static host: the query ignored) sends the full config.img
+void test_server_without_patches_sends_the_full_image()
+{
+    set_published("\"checking_interval\": 60", "\"checking_interval\": 30");
+    TEST_ASSERT_TRUE(site->publish("0.0.5", "0.0.1", OtaFixture::app_image(1000, 0), "--patches 0"));
+    serve_patches();
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    assert_config_version("0.0.5");
+    TEST_ASSERT_EQUAL_UINT32(1, queries.size());
+    TEST_ASSERT_EQUAL_UINT32(0, patches_served.size());
+    Device_Params device;
+    device.load();
+    TEST_ASSERT_EQUAL_INT(30, device.checking_interval);
+}
+
+// "firmware" is sent whole in a patch: a new firmware is flashed & booted from it
+void test_patch_carries_the_new_firmware()
+{
+    std::string image = OtaFixture::app_image(200000, 1);
+    TEST_ASSERT_TRUE(site->publish("0.0.6", "1.0.0", image));
+    serve_patches();
+    ConfigErr err;
+    TEST_ASSERT_TRUE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_UINT32(1, patches_served.size());
+    TEST_ASSERT_EQUAL_STRING("0.0.5", patches_served[0].c_str());
+    const esp_partition_t *boot = esp_ota_get_boot_partition();
+    TEST_ASSERT_EQUAL_STRING("app1", boot->label);
+    std::string flashed(image.size(), '\0');
+    esp_partition_read(boot, 0, &flashed[0], image.size());
+    TEST_ASSERT_TRUE(flashed == image);
+    assert_config_version("0.0.6");
+    Firmware_Params firmware_params;
+    TEST_ASSERT_EQUAL_STRING("1.0.0", firmware_params.version);
+}
+
+// Removed from config.json: null in the patch (a binary one: an empty record), the device drops them
+void test_patch_null_removes_the_mirrors_and_notify_url()
+{
+    set_published("\"version\": \"0.0.6\"", "\"version\": \"0.0.6\", \"notify_url\": \"http://10.0.0.9/notify\"");
+    TEST_ASSERT_TRUE(site->publish("0.0.7", "1.0.0", OtaFixture::app_image(200000, 1), "--mirror-url http://10.0.0.9/ota"));
+    serve_patches();
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    {
+        Config_Params config_params;
+        TEST_ASSERT_EQUAL_STRING("http://10.0.0.9/ota/config.img", config_params.mirrors);
+        TEST_ASSERT_EQUAL_STRING("http://10.0.0.9/notify", config_params.notify_url);
+    }
+
+    set_published("\"notify_url\": \"http://10.0.0.9/notify\",", "");
+    TEST_ASSERT_TRUE(site->publish("0.0.8", "1.0.0", OtaFixture::app_image(200000, 1)));
+    serve_patches();
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    TEST_ASSERT_EQUAL_UINT32(1, patches_served.size());
+    TEST_ASSERT_EQUAL_STRING("0.0.7", patches_served[0].c_str());
+    Config_Params config_params;
+    TEST_ASSERT_EQUAL_STRING("0.0.8", config_params.version);
+    TEST_ASSERT_EQUAL_STRING("", config_params.mirrors);
+    TEST_ASSERT_EQUAL_STRING("", config_params.notify_url);
+}
+
+// A patch without "mirrors" & "notify_url" (RFC 7386: unchanged) keeps them, in both formats
+void test_patch_without_the_mirrors_keeps_them()
+{
+    NVS::update_string("config", "mirrors", "http://10.0.0.9/ota/config.img");
+    NVS::update_string("config", "notify_url", "http://10.0.0.9/notify");
+    apply_config(R"({"base": "0.0.8", "config": {"version": "0.0.9"}})", false);
+    apply_config(R"({"base": "0.0.9", "config": {"version": "0.0.10"}})", true);
+    Config_Params config_params;
+    TEST_ASSERT_EQUAL_STRING("0.0.10", config_params.version);
+    TEST_ASSERT_EQUAL_STRING("http://10.0.0.9/ota/config.img", config_params.mirrors);
+    TEST_ASSERT_EQUAL_STRING("http://10.0.0.9/notify", config_params.notify_url);
+
+    apply_config(R"({"base": "0.0.10", "config": {"version": "0.0.11", "mirrors": null}})", false);
+    apply_config(R"({"base": "0.0.11", "config": {"version": "0.0.12", "notify_url": null}})", true);
+    Config_Params cleared;
+    TEST_ASSERT_EQUAL_STRING("", cleared.mirrors);
+    TEST_ASSERT_EQUAL_STRING("", cleared.notify_url);
+}
+
+int main(int argc, char **argv)
+{
+    site = new OtaFixture::Site();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_first_release_is_the_full_image);
+    RUN_TEST(test_patch_updates_the_changed_parameters);
+    RUN_TEST(test_patch_of_another_base_falls_back_to_the_full_image);
+    RUN_TEST(test_server_without_patches_sends_the_full_image);
+    RUN_TEST(test_patch_carries_the_new_firmware);
+    RUN_TEST(test_patch_null_removes_the_mirrors_and_notify_url);
+    RUN_TEST(test_patch_without_the_mirrors_keeps_them);
+    int failures = UNITY_END();
+    site->server.handler(nullptr);
+    delete site;
+    return failures;
+}
@@ -0,0 +1,110 @@
+// The kept connection of HTTP::client() (src/utils/http_utilities.h) on lib/native_hal: the requests to one host share
+// a connection, a connection the server closed or another host's is replaced.
+#include <unity.h>
+
+#include "../common/ota_fixture.h"
+#include "utils/http_utilities.h"
+
+namespace
+{
+    constexpr const int request_count = 10;
+    constexpr const size_t file_size = 4096;
+
+    TestHttpServer *server;
+    TestHttpServer *other; // another host (port)
+
+    struct Run
+    {
+        uint32_t connections{0}; // accepted by the servers
+        uint32_t connects{0};    // HTTP::Stats
+        uint32_t reuses{0};
+    };
+
+    // `count` GETs of /file.bin by HTTP::client(), from no kept connection. `close_each`: HTTP::close() after each one (a
+    // new connection per request). `alternate`: every other request to the other server
+    Run fetch(const int count, const bool close_each, const bool alternate = false)
+    {
+        HTTPClient &http = HTTP::client();
+        HTTP::close(http);
+        Run run;
+        HTTP::Stats before = HTTP::stats();
+        uint32_t connections = server->connections() + other->connections();
+        for (int i = 0; i < count; i++)
+        {
+            TestHttpServer *target = (alternate && i % 2 == 1) ? other : server;
+            TEST_ASSERT_EQUAL_INT((int)file_size, HTTP::get_length(http, target->url("/file.bin").c_str()));
+            TEST_ASSERT_EQUAL_UINT32(file_size, http.getString().length());
+            if (close_each)
+                HTTP::close(http);
+            else
+                http.end();
+        }
+        run.connections = server->connections() + other->connections() - connections;
+        run.connects = HTTP::stats().connects - before.connects;
+        run.reuses = HTTP::stats().reuses - before.reuses;
+        return run;
+    }
+}
+
+void setUp() {}
+void tearDown()
+{
+    server->handler(nullptr);
+}
+
+// One host: one connection, the next requests reuse it
+void test_requests_share_the_kept_connection()
+{
+    Run run = fetch(request_count, false);
+    TEST_ASSERT_EQUAL_UINT32(1, run.connections);
+    TEST_ASSERT_EQUAL_UINT32(1, run.connects);
+    TEST_ASSERT_EQUAL_UINT32(request_count - 1, run.reuses);
+}
+
+// Closed after each request: a connection per request
+void test_closed_connection_costs_a_connect_per_request()
+{
+    Run run = fetch(request_count, true);
+    TEST_ASSERT_EQUAL_UINT32(request_count, run.connections);
+    TEST_ASSERT_EQUAL_UINT32(request_count, run.connects);
+    TEST_ASSERT_EQUAL_UINT32(0, run.reuses);
+}
+
+// The server closes each connection after its response (an idle timeout): the next request connects again
+void test_connection_closed_by_the_server_is_replaced()
+{
+    server->handler([](const TestHttpServer::Request &, TestHttpServer::Response &response)
+                    {
+                        response.close = true;
+                        return false; });
+    Run run = fetch(request_count, false);
+    TEST_ASSERT_EQUAL_UINT32(request_count, run.connections);
+    TEST_ASSERT_EQUAL_UINT32(request_count, run.connects);
+}
+
+// One kept connection: alternating between two hosts replaces it every request
+void test_other_host_replaces_the_kept_connection()
+{
+    Run run = fetch(request_count, false, true);
+    TEST_ASSERT_EQUAL_UINT32(request_count, run.connections);
+    TEST_ASSERT_EQUAL_UINT32(0, run.reuses);
+}
+
+int main(int argc, char **argv)
+{
+    std::string root = OtaFixture::temp_dir("http_reuse");
+    OtaFixture::write_file(root + "/file.bin", OtaFixture::app_image(file_size, 3));
+    server = new TestHttpServer(root);
+    other = new TestHttpServer(root);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_requests_share_the_kept_connection);
+    RUN_TEST(test_closed_connection_costs_a_connect_per_request);
+    RUN_TEST(test_connection_closed_by_the_server_is_replaced);
+    RUN_TEST(test_other_host_replaces_the_kept_connection);
+    int failures = UNITY_END();
+    HTTP::close(HTTP::client());
+    delete other;
+    delete server;
+    return failures;
+}
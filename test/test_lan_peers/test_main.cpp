@@ -0,0 +1,355 @@
+// Firmware sharing between the devices of a LAN (src/utils/lan_peers.h) on lib/native_hal, the LAN simulated on the
+// loopback (each device a host 127.x.y.z: OTA_LOCAL_IP):
+// - a fleet of device processes (this program run as "device ...", rebooting = exiting & being run again) updating from
+//   one origin, without then with the LAN peers: the origin's firmware requests (its egress) drop,
+// - a peer's firmware.img server (whole, Range --> 206, a range past the end or reversed --> 416),
+// - an in-process device downloading from fake peers (TestHttpServers on 127.0.0.3/4 announcing themselves): a peer
+//   failing mid-way resumed on the next one with a Range request; a tampered image rejected for the origin's.
+#include <unity.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <vector>
+
+#include "../common/ota_fixture.h"
+
+namespace
+{
+    constexpr const size_t fw_size = 200000;
+    constexpr const int fleet_size = 6;
+    constexpr const uint32_t stagger_ms = 800; // between the fleet's first checks
+
+    OtaFixture::Site *site;
+    std::string image;
+    std::string pem_path;
+    LAN_Peers lan_peers; // the in-process device's
+
+    // A TCP port free at the moment
+    uint16_t free_port()
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        socklen_t len = sizeof(addr);
+        bind(fd, (sockaddr *)&addr, len);
+        getsockname(fd, (sockaddr *)&addr, &len);
+        close(fd);
+        return ntohs(addr.sin_port);
+    }
+
+    // A device process of the fleet: its own NVS & flash, its own address, run again after each reboot
+    struct Device
+    {
+        std::string state_dir{OtaFixture::temp_dir("ota_fleet")};
+        std::string ip;
+        uint16_t lan_port; // 0: no LAN peers
+        uint32_t first_check_ms;
+        pid_t pid{0};
+        int boots{0};
+
+        void spawn()
+        {
+            std::string exe = "/proc/self/exe", url = site->server.url("/config.img");
+            std::string port = std::to_string(lan_port), first = std::to_string(first_check_ms);
+            char *argv[]{&exe[0], (char *)"device", &url[0], &pem_path[0], &port[0], &first[0], nullptr};
+            std::vector<std::string> vars{"OTA_STATE_DIR=" + state_dir, "OTA_LOCAL_IP=" + ip, "OTA_FLASH_TIMING=0"};
+            std::vector<char *> env;
+            for (std::string &var : vars)
+                env.push_back(&var[0]);
+            env.push_back(nullptr);
+            std::string log = state_dir + "/log.txt";
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            posix_spawn(&pid, exe.c_str(), &actions, nullptr, argv, env.data());
+            posix_spawn_file_actions_destroy(&actions);
+            boots++;
+        }
+
+        // Run it again if it rebooted. Return false if it failed
+        bool poll()
+        {
+            int status;
+            if (pid == 0 || waitpid(pid, &status, WNOHANG) != pid)
+                return true;
+            pid = 0;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                return false;
+            spawn();
+            return true;
+        }
+
+        bool updated() const { return boots > 1; }
+
+        void kill()
+        {
+            if (pid != 0)
+            {
+                ::kill(pid, SIGKILL);
+                waitpid(pid, nullptr, 0);
+                pid = 0;
+            }
+        }
+    };
+
+    std::vector<Device> fleet;
+
+    // The origin's requests of the published `img` (fw/<sha256>.img)
+    uint32_t origin_requests_of(const std::string &img)
+    {
+        return site->server.requests(site->publisher.firmware_path(img).substr(site->publisher.root().size()));
+    }
+
+    // Start a fleet of `fleet_size` devices, the i-th one checking at i * stagger_ms first; wait until all of them
+    // rebooted into the new firmware. Return the origin's firmware requests
+    uint32_t update_fleet(const bool lan, const char *name)
+    {
+        for (Device &device : fleet)
+            device.kill();
+        fleet.clear();
+        fleet.resize(fleet_size);
+        uint32_t origin_requests = origin_requests_of(image);
+        for (int i = 0; i < fleet_size; i++)
+        {
+            fleet[i].ip = "127.1.0." + std::to_string(i + 1);
+            fleet[i].lan_port = lan ? free_port() : 0;
+            fleet[i].first_check_ms = i * stagger_ms;
+            fleet[i].spawn();
+        }
+        for (int wait_ms = 0; wait_ms < 60000; wait_ms += 10)
+        {
+            bool updated = true;
+            for (Device &device : fleet)
+            {
+                TEST_ASSERT_TRUE_MESSAGE(device.poll(), ("a device failed: see " + device.state_dir).c_str());
+                updated = updated && device.updated();
+            }
+            if (updated)
+            {
+                origin_requests = origin_requests_of(image) - origin_requests;
+                printf("%s: %d devices updated, %u firmware downloads from the origin (%u bytes of egress)\n", name,
+                       fleet_size, origin_requests, origin_requests * (unsigned)(SIGN_LEN + fw_size));
+                return origin_requests;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        TEST_FAIL_MESSAGE("the fleet didn't update");
+        return 0;
+    }
+
+    // "OTA1 <type> <version> <port>" broadcast from `ip`, as a peer on that host would announce itself
+    void announce_from(const std::string &ip, const char *version, const uint16_t port)
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(ip.c_str());
+        bind(fd, (sockaddr *)&addr, sizeof(addr));
+        std::string msg = std::string("OTA1 ") + device_type + " " + version + " " + std::to_string(port);
+        addr.sin_port = htons(LAN_Peers::udp_port);
+        addr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+        sendto(fd, msg.data(), msg.size(), 0, (sockaddr *)&addr, sizeof(addr));
+        close(fd);
+    }
+
+    // Wait for the in-process device to know `count` peers holding `version`
+    void wait_peers(const char *version, const uint8_t count, char (*urls)[LAN_Peers::url_size])
+    {
+        for (int i = 0; i < 1000 && lan_peers.find(version, urls, LAN_Peers::max_sources) < count; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        TEST_ASSERT_EQUAL_UINT8(count, lan_peers.find(version, urls, LAN_Peers::max_sources));
+    }
+
+    // The first `size` bytes of the partition booted next
+    std::string boot_image(const size_t size)
+    {
+        std::string content(size, '\0');
+        esp_partition_read(esp_ota_get_boot_partition(), 0, &content[0], content.size());
+        return content;
+    }
+
+    // A fleet device: check for updates periodically, share its firmware on the LAN (lan_port != 0)
+    int run_device(char **argv)
+    {
+        nvs_flash_init();
+        std::string pem = OtaFixture::read_file(argv[3]);
+        NVS::update_bytes("config", "public_key", (const byte *)pem.c_str(), pem.size() + 1);
+        NVS::update_bytes("firmware", "public_key", (const byte *)pem.c_str(), pem.size() + 1);
+        NVS::update_string("config", "url", argv[2]);
+        ESP.on_restart = []
+        {
+            fflush(stdout);
+            _exit(0); // (the LAN_Peers tasks still running)
+        };
+
+        uint16_t lan_port = atoi(argv[4]);
+        Device_Params device;
+        device.load();
+        Firmware_Params firmwareParams;
+        static LAN_Peers peers;
+        Config config;
+        if (lan_port != 0)
+        {
+            uint8_t fw_signature[SIGN_LEN];
+            int fw_len = 0;
+            size_t sign_len = firmwareParams.load_image_info(fw_signature, fw_len) ? SIGN_LEN : 0;
+            peers.begin(device_type, firmwareParams.version, fw_signature, sign_len, fw_len, lan_port);
+            peers.announce();
+            config.use_lan_peers(&peers);
+        }
+        delay(atoi(argv[5]));
+        while (true)
+        {
+            config.check_update(device);
+            peers.announce();
+            delay(200);
+        }
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Without LAN peers each device downloads the firmware from the origin
+void test_fleet_without_lan_peers()
+{
+    TEST_ASSERT_EQUAL_UINT32(fleet_size, update_fleet(false, "without LAN peers"));
+}
+
+// With LAN peers the devices updated first serve the others: the origin serves far fewer downloads
+void test_fleet_with_lan_peers()
+{
+    uint32_t origin_requests = update_fleet(true, "with LAN peers");
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1, origin_requests);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(fleet_size / 2, origin_requests);
+}
+
+// An updated device serves signature + image: whole, a range of it, 416 past the end or reversed
+void test_peer_serves_its_firmware()
+{
+    const Device &peer = fleet.back();
+    std::string url = "http://" + peer.ip + ":" + std::to_string(peer.lan_port) + "/firmware.img";
+    std::string img = OtaFixture::read_file(site->publisher.firmware_path(image));
+    HTTPClient http;
+    int len = 0;
+    for (int i = 0; i < 200 && len <= 0; i++) // (the peer just rebooted into the firmware)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        len = HTTP::get_length(http, url.c_str());
+    }
+    TEST_ASSERT_EQUAL_INT(img.size(), len);
+    String whole = http.getString();
+    http.end();
+    TEST_ASSERT_TRUE(std::string(whole.c_str(), whole.length()) == img);
+
+    uint32_t total_len = 0;
+    TEST_ASSERT_EQUAL_INT(1000, HTTP::get_range(http, url.c_str(), 100000, 100999, &total_len));
+    TEST_ASSERT_EQUAL_UINT32(img.size(), total_len);
+    String range = http.getString();
+    http.end();
+    TEST_ASSERT_TRUE(std::string(range.c_str(), range.length()) == img.substr(100000, 1000));
+
+    TEST_ASSERT_EQUAL_INT(-416, HTTP::get_range(http, url.c_str(), img.size(), img.size() + 10));
+    http.end();
+    TEST_ASSERT_EQUAL_INT(-416, HTTP::get_range(http, url.c_str(), 100999, 100000));
+    http.end();
+}
+
+void test_stop_the_fleet()
+{
+    for (Device &device : fleet)
+        device.kill();
+}
+
+// Two peers announce the new firmware: the last heard one fails after 100 KB, the other one serves the rest (a Range
+// request), nothing from the origin
+void test_download_resumed_on_the_next_peer()
+{
+    std::string img = OtaFixture::read_file(site->publisher.firmware_path(image));
+    std::string peer_root = OtaFixture::temp_dir("lan_peer");
+    OtaFixture::write_file(peer_root + "/firmware.img", img);
+    TestHttpServer peer_a(peer_root, "127.0.0.3"), peer_b(peer_root, "127.0.0.4");
+    std::string range;
+    std::mutex mutex;
+    peer_a.handler([](const TestHttpServer::Request &, TestHttpServer::Response &response)
+                   {
+                       response.cut_at = 100000;
+                       return false; });
+    peer_b.handler([&](const TestHttpServer::Request &request, TestHttpServer::Response &)
+                   {
+                       std::lock_guard<std::mutex> lock(mutex);
+                       range = request.range;
+                       return false; });
+    lan_peers.begin(device_type, "0.0.5", nullptr, 0, 0, free_port()); // (the fleet gone: not among its peers)
+    char urls[LAN_Peers::max_sources][LAN_Peers::url_size];
+    announce_from("127.0.0.4", "0.0.6", peer_b.port());
+    wait_peers("0.0.6", 1, urls);
+    announce_from("127.0.0.3", "0.0.6", peer_a.port());
+    wait_peers("0.0.6", 2, urls);
+    std::string peer_a_url = peer_a.url("/firmware.img");
+    TEST_ASSERT_EQUAL_STRING(peer_a_url.c_str(), urls[0]); // the last heard first
+
+    uint32_t origin_requests = origin_requests_of(image);
+    ConfigErr err;
+    TEST_ASSERT_TRUE(OtaFixture::check(err, &lan_peers));
+    TEST_ASSERT_EQUAL_UINT32(1, peer_a.requests());
+    TEST_ASSERT_EQUAL_UINT32(1, peer_b.requests());
+    std::string rest = "bytes=100000-" + std::to_string(img.size() - 1);
+    TEST_ASSERT_EQUAL_STRING(rest.c_str(), range.c_str());
+    TEST_ASSERT_EQUAL_UINT32(origin_requests, origin_requests_of(image));
+    TEST_ASSERT_TRUE(boot_image(image.size()) == image);
+    peer_a.handler(nullptr);
+    peer_b.handler(nullptr);
+}
+
+// Peers aren't trusted: a peer serving a tampered image is forgotten, the firmware comes from the origin
+void test_tampered_peer_image_is_rejected()
+{
+    std::string next_image = OtaFixture::app_image(fw_size, 8);
+    TEST_ASSERT_TRUE(site->publish("0.0.3", "0.0.7", next_image));
+    std::string img = OtaFixture::read_file(site->publisher.firmware_path(next_image));
+    img[img.size() / 2] ^= 0x01;
+    std::string peer_root = OtaFixture::temp_dir("lan_peer");
+    OtaFixture::write_file(peer_root + "/firmware.img", img);
+    TestHttpServer tampering(peer_root, "127.0.0.5");
+    char urls[LAN_Peers::max_sources][LAN_Peers::url_size];
+    announce_from("127.0.0.5", "0.0.7", tampering.port());
+    wait_peers("0.0.7", 1, urls);
+
+    uint32_t origin_requests = origin_requests_of(next_image);
+    ConfigErr err;
+    TEST_ASSERT_TRUE(OtaFixture::check(err, &lan_peers));
+    TEST_ASSERT_EQUAL_UINT32(1, tampering.requests());
+    TEST_ASSERT_EQUAL_UINT32(origin_requests + 1, origin_requests_of(next_image));
+    TEST_ASSERT_EQUAL_UINT8(0, lan_peers.find("0.0.7", urls, LAN_Peers::max_sources));
+    TEST_ASSERT_TRUE(boot_image(next_image.size()) == next_image);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 6 && strcmp(argv[1], "device") == 0)
+        return run_device(argv);
+
+    site = new OtaFixture::Site();
+    image = OtaFixture::app_image(fw_size, 7);
+    if (!site->publish("0.0.2", "0.0.6", image))
+        return 1;
+    pem_path = site->device_dir + "/key.pub";
+    OtaFixture::write_file(pem_path, site->publisher.public_key());
+
+    UNITY_BEGIN();
+    RUN_TEST(test_fleet_without_lan_peers);
+    RUN_TEST(test_fleet_with_lan_peers);
+    RUN_TEST(test_peer_serves_its_firmware);
+    RUN_TEST(test_stop_the_fleet);
+    RUN_TEST(test_download_resumed_on_the_next_peer);
+    RUN_TEST(test_tampered_peer_image_is_rejected);
+    int failures = UNITY_END();
+    fflush(stdout);
+    _exit(failures); // the LAN peers' tasks never end: no static destructors under their feet
+}
@@ -0,0 +1,298 @@
+// The mirrors of an artifact (src/utils/mirrors.h) on lib/native_hal: the ranking by measured RTT & throughput, the
+// backoff of a failed host, and Mirrors::download() against TestHttpServers: the faster mirror first, a mirror failing
+// mid-download resumed on the next one with a Range request, a mirror down or serving another content (length) skipped,
+// a content-addressed URL serving another content rejected.
+// The hosts' measurements are global & kept: each test uses its own hosts (ports, or made-up URLs).
+#include <unity.h>
+
+#include "../common/ota_fixture.h"
+#include "utils/mirrors.h"
+#include "utils/sha256_utilities.h"
+
+namespace
+{
+    constexpr const size_t fw_size = 300000;
+
+    std::string root;  // firmware.bin
+    std::string other; // firmware.bin of another size
+    std::string image;
+
+    // "<sha256 of content>.img": a content-addressed name
+    std::string content_name(const std::string &content)
+    {
+        uint8_t digest[SHA256::digest_len];
+        SHA256::Hasher hasher;
+        hasher.update((const uint8_t *)content.data(), content.size());
+        hasher.finish(digest);
+        char hex[2 * SHA256::digest_len + 1];
+        for (size_t i = 0; i < SHA256::digest_len; i++)
+            snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+        return std::string(hex) + ".img";
+    }
+
+    std::string url_of(const TestHttpServer &server)
+    {
+        return server.url("/firmware.bin");
+    }
+
+    const Mirrors::Host *host_of(const char *url)
+    {
+        char origin[sizeof(Mirrors::Host::origin)];
+        bool https;
+        char host[HTTP::max_host_size];
+        uint16_t port;
+        HTTP::parse_origin(url, https, host, port);
+        snprintf(origin, sizeof(origin), "%s:%u", host, port);
+        uint8_t count;
+        const Mirrors::Host *hosts = Mirrors::hosts(count);
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (strcmp(hosts[i].origin, origin) == 0)
+                return &hosts[i];
+        }
+        return nullptr;
+    }
+
+    // Mirrors::download() of `urls` into a string, `known_len` the artifact's length if > 0. Return true if complete
+    bool download(std::vector<std::string> urls, std::string &received, int known_len = -1)
+    {
+        const char *list[Mirrors::max_urls];
+        for (size_t i = 0; i < urls.size(); i++)
+            list[i] = urls[i].c_str();
+        received.clear();
+        int len = known_len;
+        return Mirrors::download(list, urls.size(), fw_size, len, [&](uint8_t *data, size_t size)
+                                 {
+                                     received.append((const char *)data, size);
+                                     return true; });
+    }
+
+    // The Range requests received by a server through handler() (cleared from the server before it goes)
+    struct RangeCounter
+    {
+        std::atomic<uint32_t> count{0};
+        std::string last;
+        std::mutex mutex;
+
+        TestHttpServer::Handler handler()
+        {
+            return [this](const TestHttpServer::Request &request, TestHttpServer::Response &)
+            {
+                if (!request.range.empty())
+                {
+                    count++;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    last = request.range;
+                }
+                return false;
+            };
+        }
+    };
+}
+
+void setUp() {}
+void tearDown() {}
+
+// No measurement: the given order
+void test_unmeasured_hosts_keep_their_order()
+{
+    const char *urls[]{"http://10.0.0.1/a", "http://10.0.0.2/a", "http://10.0.0.3/a"};
+    Mirrors::rank(urls, 3, fw_size);
+    TEST_ASSERT_EQUAL_STRING("http://10.0.0.1/a", urls[0]);
+    TEST_ASSERT_EQUAL_STRING("http://10.0.0.2/a", urls[1]);
+    TEST_ASSERT_EQUAL_STRING("http://10.0.0.3/a", urls[2]);
+}
+
+// The expected time RTT + length / throughput: the low-RTT host for a small file, the fast one for a large file.
+// The hosts not measured yet are tried first (to be measured)
+void test_rank_by_expected_time()
+{
+    const char *near = "http://10.0.1.1/fw.img"; // 20 ms, 100 KB/s
+    const char *far = "http://10.0.1.2/fw.img";  // 200 ms, 10 MB/s
+    const char *unknown = "http://10.0.1.3/fw.img";
+    Mirrors::report_success(near, 20000, 100 * 1024, 1000000);
+    Mirrors::report_success(far, 200000, 10 * 1024 * 1024, 1000000);
+
+    const char *small[]{far, near, unknown};
+    Mirrors::rank(small, 3, 1024);
+    TEST_ASSERT_EQUAL_STRING(unknown, small[0]);
+    TEST_ASSERT_EQUAL_STRING(near, small[1]);
+    TEST_ASSERT_EQUAL_STRING(far, small[2]);
+
+    const char *large[]{near, far};
+    Mirrors::rank(large, 2, 1024 * 1024);
+    TEST_ASSERT_EQUAL_STRING(far, large[0]);
+    TEST_ASSERT_EQUAL_STRING(near, large[1]);
+}
+
+// A failed host goes last (a last resort) until a success; its backoff doubles on each failure in a row, up to
+// max_backoff_ms, and lasts at least the server's Retry-After
+void test_failed_host_is_backed_off()
+{
+    const char *failing = "http://10.0.2.1/fw.img";
+    const char *slow = "http://10.0.2.2/fw.img";
+    Mirrors::report_success(failing, 1000, 0, 0);
+    Mirrors::report_success(slow, 900000, 0, 0);
+    Mirrors::report_failure(failing);
+    TEST_ASSERT_TRUE(Mirrors::is_backed_off(failing));
+    const char *urls[]{failing, slow};
+    Mirrors::rank(urls, 2, fw_size);
+    TEST_ASSERT_EQUAL_STRING(slow, urls[0]);
+
+    const Mirrors::Host *host = host_of(failing);
+    TEST_ASSERT_NOT_NULL(host);
+    TEST_ASSERT_EQUAL_UINT32(Mirrors::min_backoff_ms, host->retry_at_ms - host->used_ms);
+    Mirrors::report_failure(failing);
+    TEST_ASSERT_EQUAL_UINT32(2 * Mirrors::min_backoff_ms, host->retry_at_ms - host->used_ms);
+    Mirrors::report_failure(failing, 300 * 1000UL); // Retry-After: 300
+    TEST_ASSERT_EQUAL_UINT32(300 * 1000UL, host->retry_at_ms - host->used_ms);
+    for (int i = 0; i < 10; i++)
+        Mirrors::report_failure(failing);
+    TEST_ASSERT_EQUAL_UINT32(Mirrors::max_backoff_ms, host->retry_at_ms - host->used_ms);
+
+    Mirrors::report_success(failing, 1000, 0, 0);
+    TEST_ASSERT_FALSE(Mirrors::is_backed_off(failing));
+    Mirrors::rank(urls, 2, fw_size);
+    TEST_ASSERT_EQUAL_STRING(failing, urls[0]);
+}
+
+// Once both are measured, the mirror answering faster gets the downloads
+void test_download_prefers_the_faster_mirror()
+{
+    TestHttpServer slow(root), fast(root);
+    slow.handler([](const TestHttpServer::Request &, TestHttpServer::Response &response)
+                 {
+                     response.delay_ms = 150;
+                     return false; });
+    std::string received;
+    TEST_ASSERT_TRUE(download({url_of(slow)}, received));
+    TEST_ASSERT_TRUE(download({url_of(fast)}, received));
+    uint32_t slow_requests = slow.requests();
+    TEST_ASSERT_TRUE(download({url_of(slow), url_of(fast)}, received));
+    TEST_ASSERT_TRUE(received == image);
+    TEST_ASSERT_EQUAL_UINT32(slow_requests, slow.requests());
+    TEST_ASSERT_EQUAL_UINT32(2, fast.requests());
+    slow.handler(nullptr);
+}
+
+// The first mirror closes the connection after 100 KB: the next one serves the rest (a Range request), the failed one
+// is backed off
+void test_failover_resumes_with_a_range_request()
+{
+    TestHttpServer cutting(root), backup(root);
+    cutting.handler([](const TestHttpServer::Request &, TestHttpServer::Response &response)
+                    {
+                        response.cut_at = 100000;
+                        return false; });
+    RangeCounter backup_ranges;
+    backup.handler(backup_ranges.handler());
+    std::string received;
+    TEST_ASSERT_TRUE(download({url_of(cutting), url_of(backup)}, received));
+    TEST_ASSERT_TRUE(received == image);
+    TEST_ASSERT_EQUAL_UINT32(1, cutting.requests());
+    TEST_ASSERT_EQUAL_UINT32(1, backup.requests());
+    TEST_ASSERT_EQUAL_UINT32(1, backup_ranges.count);
+    TEST_ASSERT_EQUAL_STRING("bytes=100000-299999", backup_ranges.last.c_str());
+    TEST_ASSERT_TRUE(Mirrors::is_backed_off(url_of(cutting).c_str()));
+    cutting.handler(nullptr);
+    backup.handler(nullptr);
+}
+
+// A mirror gone down: skipped for the next one, and ranked last while backed off
+void test_mirror_down_is_skipped()
+{
+    TestHttpServer down(root), up(root);
+    std::string down_url = url_of(down);
+    down.stop();
+    std::string received;
+    TEST_ASSERT_TRUE(download({down_url, url_of(up)}, received));
+    TEST_ASSERT_TRUE(received == image);
+    TEST_ASSERT_TRUE(Mirrors::is_backed_off(down_url.c_str()));
+    std::string up_url = url_of(up);
+    const char *urls[]{down_url.c_str(), up_url.c_str()};
+    Mirrors::rank(urls, 2, fw_size);
+    TEST_ASSERT_EQUAL_STRING(up_url.c_str(), urls[0]);
+}
+
+// The resume must be the same artifact: a mirror with another length is rejected, the next one completes it
+void test_mirror_with_another_content_is_rejected()
+{
+    TestHttpServer cutting(root), stale(other), good(root);
+    cutting.handler([](const TestHttpServer::Request &, TestHttpServer::Response &response)
+                    {
+                        response.cut_at = 50000;
+                        return false; });
+    std::string received;
+    TEST_ASSERT_TRUE(download({url_of(cutting), url_of(stale), url_of(good)}, received));
+    TEST_ASSERT_TRUE(received == image);
+    TEST_ASSERT_EQUAL_UINT32(1, stale.requests());
+    TEST_ASSERT_TRUE(Mirrors::is_backed_off(url_of(stale).c_str()));
+    TEST_ASSERT_EQUAL_UINT32(1, good.requests());
+    cutting.handler(nullptr);
+}
+
+// The artifact's length known (listed by the signed manifest): a mirror with another one is skipped from its first
+// request & backed off, nothing of it goes to the sink
+void test_known_length_skips_another_content()
+{
+    TestHttpServer stale(other), good(root);
+    std::string received;
+    TEST_ASSERT_TRUE(download({url_of(stale), url_of(good)}, received, fw_size));
+    TEST_ASSERT_TRUE(received == image);
+    TEST_ASSERT_EQUAL_UINT32(1, stale.requests());
+    TEST_ASSERT_TRUE(Mirrors::is_backed_off(url_of(stale).c_str()));
+    TEST_ASSERT_EQUAL_UINT32(1, good.requests());
+}
+
+// A content-addressed URL (<sha256>.img) is checked as it streams: a mirror serving another content of the same length
+// under that name fails the download & is backed off, the named content passes
+void test_content_addressed_mismatch_is_rejected()
+{
+    std::string name = "/" + content_name(image);
+    std::string forged_root = OtaFixture::temp_dir("mirrors_forged"), named_root = OtaFixture::temp_dir("mirrors_named");
+    OtaFixture::write_file(forged_root + name, OtaFixture::app_image(fw_size, 6));
+    OtaFixture::write_file(named_root + name, image);
+    TestHttpServer forged(forged_root), named(named_root);
+    std::string received;
+    TEST_ASSERT_FALSE(download({forged.url(name)}, received));
+    TEST_ASSERT_TRUE(Mirrors::is_backed_off(forged.url(name).c_str()));
+    TEST_ASSERT_TRUE(download({named.url(name)}, received));
+    TEST_ASSERT_TRUE(received == image);
+}
+
+// Every mirror failing: the download fails
+void test_all_mirrors_failing()
+{
+    TestHttpServer a(root), b(root);
+    std::string a_url = url_of(a), b_url = url_of(b);
+    a.stop();
+    b.stop();
+    std::string received;
+    TEST_ASSERT_FALSE(download({a_url, b_url}, received));
+    TEST_ASSERT_TRUE(Mirrors::is_backed_off(a_url.c_str()));
+    TEST_ASSERT_TRUE(Mirrors::is_backed_off(b_url.c_str()));
+}
+
+int main(int argc, char **argv)
+{
+    root = OtaFixture::temp_dir("mirrors");
+    other = OtaFixture::temp_dir("mirrors_other");
+    image = OtaFixture::app_image(fw_size, 4);
+    OtaFixture::write_file(root + "/firmware.bin", image);
+    OtaFixture::write_file(other + "/firmware.bin", OtaFixture::app_image(fw_size + 1000, 5));
+
+    UNITY_BEGIN();
+    RUN_TEST(test_unmeasured_hosts_keep_their_order);
+    RUN_TEST(test_rank_by_expected_time);
+    RUN_TEST(test_failed_host_is_backed_off);
+    RUN_TEST(test_download_prefers_the_faster_mirror);
+    RUN_TEST(test_failover_resumes_with_a_range_request);
+    RUN_TEST(test_mirror_down_is_skipped);
+    RUN_TEST(test_mirror_with_another_content_is_rejected);
+    RUN_TEST(test_known_length_skips_another_content);
+    RUN_TEST(test_content_addressed_mismatch_is_rejected);
+    RUN_TEST(test_all_mirrors_failing);
+    int failures = UNITY_END();
+    HTTP::close(HTTP::client());
+    return failures;
+}
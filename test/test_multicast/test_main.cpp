@@ -0,0 +1,148 @@
+// The multicast OTA receiver (src/utils/ota_multicast.h) on lib/native_hal against tools/ota_multicast_sender.py over
+// the loopback: a carousel with a share of its packets dropped (--loss), the parity blocks rebuilding the single losses
+// of a group, HTTP Range requests fetching the rest. Each run prints its completion time & its repair traffic.
+#include <unity.h>
+
+#include <atomic>
+#include <thread>
+
+#include "../common/ota_fixture.h"
+#include "utils/ota_multicast.h"
+
+namespace
+{
+    constexpr const char *group_ip = "239.255.0.77";
+    constexpr const uint16_t port = 5077;
+    constexpr const uint32_t idle_timeout_ms = 1500;
+    constexpr const size_t fw_size = 150000;
+
+    TestHttpServer *server;
+    std::string path;  // the published firmware.img
+    std::string image; // its signature + firmware
+
+    struct Run
+    {
+        int len{0};
+        OTA_Multicast::Stats stats;
+        uint32_t range_requests{0}; // the repair's (not the signature's)
+        uint32_t range_bytes{0};
+    };
+
+    // receive() with the sender started once the receiver listens; rounds == 0: no sender
+    Run receive(const double loss, const int rounds, const uint32_t group_size = 8)
+    {
+        Run run;
+        std::atomic<uint32_t> range_requests{0}, range_bytes{0};
+        server->handler([&](const TestHttpServer::Request &request, TestHttpServer::Response &)
+                        {
+                            unsigned long first, last;
+                            if (sscanf(request.range.c_str(), "bytes=%lu-%lu", &first, &last) == 2 && first >= SIGN_LEN)
+                            {
+                                range_requests++;
+                                range_bytes += last - first + 1;
+                            }
+                            return false; });
+        std::thread sender([&]
+                           {
+                               if (rounds == 0)
+                                   return;
+                               delay(300); // the receiver gets the signature, then joins the group
+                               char args[160];
+                               snprintf(args, sizeof(args), " --group %s --port %u --rate 4000 --rounds %d --loss %.2f --seed 1 --group-size %u",
+                                        group_ip, port, rounds, loss, group_size);
+                               OtaFixture::run("python3 " + OtaFixture::project_dir() + "/tools/ota_multicast_sender.py " + path + args); });
+
+        OTA_Multicast multicast;
+        uint8_t signature[SIGN_LEN];
+        run.len = multicast.receive(server->url("/firmware.img").c_str(), group_ip, port, idle_timeout_ms, signature);
+        sender.join();
+        server->handler(nullptr);
+        run.stats = multicast.get_stats();
+        run.range_requests = range_requests;
+        run.range_bytes = range_bytes;
+        printf("loss %2.0f%%, %d round(s): %5u ms, %u multicast blocks, %u rebuilt, %u repaired (%u bytes in %u Range requests)\n",
+               loss * 100, rounds, run.stats.elapsed_ms, run.stats.multicast_blocks, run.stats.recovered_blocks,
+               run.stats.repaired_blocks, run.stats.repair_bytes, run.range_requests);
+        TEST_ASSERT_EQUAL_MEMORY(image.data(), signature, SIGN_LEN);
+        return run;
+    }
+
+    // The received firmware in the next OTA partition is the published one
+    void assert_received(const Run &run)
+    {
+        TEST_ASSERT_EQUAL_INT((int)fw_size, run.len);
+        std::string written(fw_size, '\0');
+        esp_partition_read(esp_ota_get_next_update_partition(NULL), 0, &written[0], fw_size);
+        TEST_ASSERT_TRUE(written == image.substr(SIGN_LEN));
+        uint32_t blocks = (fw_size + 1023) / 1024;
+        TEST_ASSERT_EQUAL_UINT32(blocks, run.stats.multicast_blocks + run.stats.recovered_blocks + run.stats.repaired_blocks);
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Every packet: the firmware from the group alone
+void test_lossless_carousel_needs_no_repair()
+{
+    Run run = receive(0, 1);
+    assert_received(run);
+    TEST_ASSERT_EQUAL_UINT32((fw_size + 1023) / 1024, run.stats.multicast_blocks);
+    TEST_ASSERT_EQUAL_UINT32(0, run.range_requests);
+}
+
+// 5% loss, 8 data blocks per parity block: most groups lose one block at most, rebuilt from the parity
+void test_parity_rebuilds_single_losses()
+{
+    Run run = receive(0.05, 1);
+    assert_received(run);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, run.stats.recovered_blocks);
+    TEST_ASSERT_EQUAL_UINT32(run.stats.repair_bytes, run.range_bytes);
+}
+
+// 30% loss: groups with several lost blocks; HTTP Range requests fetch exactly the missing ones
+void test_range_requests_fill_the_gaps()
+{
+    Run run = receive(0.30, 1);
+    assert_received(run);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, run.stats.repaired_blocks);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, run.range_requests);
+    TEST_ASSERT_EQUAL_UINT32(run.stats.repair_bytes, run.range_bytes);
+    TEST_ASSERT_LESS_THAN_UINT32(fw_size / 2, run.range_bytes); // the gaps only
+}
+
+// A second round fills most of the first one's gaps: less repair traffic
+void test_second_round_reduces_the_repair()
+{
+    Run one = receive(0.30, 1);
+    Run two = receive(0.30, 2);
+    assert_received(two);
+    TEST_ASSERT_LESS_THAN_UINT32(one.range_bytes, two.range_bytes);
+}
+
+// No carousel: the whole firmware over HTTP
+void test_silent_group_falls_back_to_http()
+{
+    Run run = receive(0, 0);
+    assert_received(run);
+    TEST_ASSERT_EQUAL_UINT32(0, run.stats.multicast_blocks);
+    TEST_ASSERT_EQUAL_UINT32(fw_size, run.range_bytes);
+}
+
+int main(int argc, char **argv)
+{
+    OtaFixture::use_new_device();
+    image = OtaFixture::app_image(SIGN_LEN, 7) + OtaFixture::app_image(fw_size, 8); // an unchecked "signature"
+    server = OtaFixture::serve_files("ota_multicast", {{"firmware.img", image}});
+    path = server->file("/firmware.img");
+
+    UNITY_BEGIN();
+    RUN_TEST(test_lossless_carousel_needs_no_repair);
+    RUN_TEST(test_parity_rebuilds_single_losses);
+    RUN_TEST(test_range_requests_fill_the_gaps);
+    RUN_TEST(test_second_round_reduces_the_repair);
+    RUN_TEST(test_silent_group_falls_back_to_http);
+    int failures = UNITY_END();
+    delete server;
+    return failures;
+}
@@ -0,0 +1,461 @@
+// The OTA flow end to end on lib/native_hal: check_update() against signed releases, the signature checks, the
+// firmware written to the emulated flash & the "reboot" into it.
+#include <unity.h>
+
+#include "../common/ota_fixture.h"
+
+namespace
+{
+    OtaFixture::Site *site;
+
+    std::string read_partition(const esp_partition_t *partition, size_t size)
+    {
+        std::string content(size, '\0');
+        esp_partition_read(partition, 0, &content[0], size);
+        return content;
+    }
+
+    // A config.json with every field of Manifest, more firmware mirrors than the document has room for (20)
+    const char full_manifest_json[] = R"~~~({"type": "ch4_generator", "poll": {"interval": 60, "ttl": 7200},
+        "config": {"version": "2.0.0", "url": "http://10.0.0.1/config.img", "url_change?": true,
+                   "public_key_change?": false, "public_key_url": "", "notify_url": "http://10.0.0.1/notify",
+                   "mirrors": ["http://m1/config.img", "http://m2/config.img", "http://m3/config.img",
+                               "http://m4/config.img", "http://m5/config.img", "http://m6/config.img"]},
+        "device": {"ch4_factor": 30.5, "power_factor": 2.25, "checking_interval": 90},
+        "firmware": {"version": "3.0.0", "url": "http://10.0.0.1/fw/a.img", "public_key_change?": false,
+                     "public_key_url": "", "activate_at": 1800000000, "stage_window": 600,
+                     "budget": {"rate": 64, "slice": 10, "pause": 40},
+                     "multicast": {"group": "239.1.2.3", "port": 5000, "timeout": 45},
+                     "sha256": "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f", "size": 300000,
+                     "mirrors": ["http://m1/fw/a.img", "http://m2/fw/a.img", "http://m3/fw/a.img", "http://m4/fw/a.img",
+                                 "http://m5/fw/a.img", "http://m6/fw/a.img", "http://m7/fw/a.img", "http://m8/fw/a.img",
+                                 "http://m9/fw/a.img", "http://m10/fw/a.img", "http://m11/fw/a.img", "http://m12/fw/a.img",
+                                 "http://m13/fw/a.img", "http://m14/fw/a.img", "http://m15/fw/a.img", "http://m16/fw/a.img",
+                                 "http://m17/fw/a.img", "http://m18/fw/a.img", "http://m19/fw/a.img", "http://m20/fw/a.img"]}})~~~";
+
+    void assert_same_section(const Manifest::Section &expected, const Manifest::Section &actual)
+    {
+        TEST_ASSERT_EQUAL_STRING(expected.version, actual.version);
+        TEST_ASSERT_EQUAL_STRING(expected.url, actual.url);
+        TEST_ASSERT_EQUAL(expected.url_change, actual.url_change);
+        TEST_ASSERT_EQUAL_STRING(expected.notify_url, actual.notify_url);
+        TEST_ASSERT_EQUAL_UINT32(expected.mirror_count, actual.mirror_count);
+        for (uint8_t i = 0; i < actual.mirror_count; i++)
+            TEST_ASSERT_EQUAL_STRING(expected.mirrors[i], actual.mirrors[i]);
+        TEST_ASSERT_EQUAL(expected.has_sha256, actual.has_sha256);
+        TEST_ASSERT_EQUAL_MEMORY(expected.sha256, actual.sha256, SHA256::digest_len);
+        TEST_ASSERT_EQUAL_UINT32(expected.size, actual.size);
+    }
+
+    // Publish a config (no new firmware), return a copy of its config.json: an entry of a catalog
+    std::string publish_entry(const char *config_version)
+    {
+        TEST_ASSERT_TRUE(site->publish(config_version, "1.1.0", OtaFixture::app_image(1000, 3)));
+        std::string path = site->device_dir + "/config-" + config_version + ".json";
+        OtaFixture::write_file(path, OtaFixture::read_file(site->publisher.root() + "/config.json"));
+        return path;
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// A new config: verified with the provisioned key, applied
+void test_new_config_is_applied()
+{
+    TEST_ASSERT_TRUE(site->publish("0.0.2", "0.0.1", OtaFixture::app_image(1000, 0)));
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    Config_Params config_params;
+    TEST_ASSERT_EQUAL_STRING("0.0.2", config_params.version);
+    Firmware_Params firmware_params;
+    TEST_ASSERT_EQUAL_STRING("0.0.5", firmware_params.version); // older firmware: not downloaded
+    TEST_ASSERT_EQUAL_UINT32(1, site->server.requests("/config.img"));
+}
+
+// A config.img signed by another key: rejected, nothing applied
+void test_foreign_signature_is_rejected()
+{
+    OtaFixture::Publisher other;
+    TEST_ASSERT_TRUE(other.publish(site->server.url(""), "0.0.3", "0.0.1", OtaFixture::app_image(1000, 0)));
+    TEST_ASSERT_TRUE(site->publish("0.0.3", "0.0.1", OtaFixture::app_image(1000, 0)));
+    site->server.handler([&](const TestHttpServer::Request &request, TestHttpServer::Response &response)
+                         {
+                             if (request.path != "/config.img")
+                                 return false;
+                             response.body = OtaFixture::read_file(other.root() + "/config.img");
+                             return true; });
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    site->server.handler(nullptr);
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::InvalidSign, (int)err);
+    Config_Params config_params;
+    TEST_ASSERT_EQUAL_STRING("0.0.2", config_params.version);
+}
+
+// A firmware image altered after signing: written to the flash, rejected by its signature check, not booted
+void test_tampered_firmware_is_not_booted()
+{
+    std::string image = OtaFixture::app_image(200000, 1);
+    TEST_ASSERT_TRUE(site->publish("0.1.0", "0.9.0", image));
+    std::string path = site->publisher.firmware_path(image);
+    TEST_ASSERT_FALSE(path.empty());
+    std::string published = OtaFixture::read_file(path);
+    published[published.size() / 2] ^= 0x01;
+    OtaFixture::write_file(path, published);
+
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_STRING("app0", esp_ota_get_boot_partition()->label);
+    Firmware_Params firmware_params;
+    TEST_ASSERT_EQUAL_STRING("0.0.5", firmware_params.version);
+    TEST_ASSERT_EQUAL_STRING("", firmware_params.staged);
+}
+
+// Another validly signed image (an older release, the same size) served at the new release's URL: it isn't the content
+// the URL & the manifest's "sha256" name, rejected before it's staged, nothing is booted
+void test_other_signed_release_is_rejected()
+{
+    std::string older = OtaFixture::app_image(200000, 7);
+    TEST_ASSERT_TRUE(site->publish("0.1.1", "0.9.1", older));
+    std::string older_img = OtaFixture::read_file(site->publisher.firmware_path(older));
+    std::string image = OtaFixture::app_image(200000, 8);
+    TEST_ASSERT_TRUE(site->publish("0.1.2", "0.9.2", image));
+    OtaFixture::write_file(site->publisher.firmware_path(image), older_img);
+
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_STRING("app0", esp_ota_get_boot_partition()->label);
+    Firmware_Params firmware_params;
+    TEST_ASSERT_EQUAL_STRING("0.0.5", firmware_params.version);
+    TEST_ASSERT_EQUAL_STRING("", firmware_params.staged);
+}
+
+// The origin's firmware.img gone, its mirror serving an older, validly signed release of the same size: downloaded in
+// full, then rejected (not the content the URL & the manifest's "sha256" name) before it's staged
+void test_older_release_on_a_mirror_is_rejected()
+{
+    std::string older = OtaFixture::app_image(200000, 9);
+    TEST_ASSERT_TRUE(site->publish("0.1.3", "0.9.3", older));
+    std::string older_img = OtaFixture::read_file(site->publisher.firmware_path(older));
+    std::string mirror_root = OtaFixture::temp_dir("ota_mirror");
+    TestHttpServer mirror(mirror_root);
+    std::string image = OtaFixture::app_image(200000, 10);
+    TEST_ASSERT_TRUE(site->publish("0.1.4", "0.9.4", image, "--mirror-url " + mirror.url("/")));
+    std::string fw_path = site->publisher.firmware_path(image);
+    mkdir((mirror_root + "/fw").c_str(), 0755);
+    OtaFixture::write_file(mirror_root + fw_path.substr(site->publisher.root().size()), older_img);
+    remove(fw_path.c_str());
+
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_UINT32(1, mirror.requests());
+    TEST_ASSERT_EQUAL_STRING("app0", esp_ota_get_boot_partition()->label);
+    Firmware_Params firmware_params;
+    TEST_ASSERT_EQUAL_STRING("0.0.5", firmware_params.version);
+    TEST_ASSERT_EQUAL_STRING("", firmware_params.staged);
+}
+
+// check --> verify --> flash --> reboot: the next boot runs the new firmware from the other partition. (The process
+// can't boot again: the running partition stays the first one, the test checks what the next boot reads)
+void test_new_firmware_is_flashed_and_booted()
+{
+    std::string image = OtaFixture::app_image(300000, 2);
+    TEST_ASSERT_TRUE(site->publish("0.2.0", "1.0.0", image));
+    ConfigErr err;
+    TEST_ASSERT_TRUE(OtaFixture::check(err));
+
+    const esp_partition_t *boot = esp_ota_get_boot_partition();
+    TEST_ASSERT_EQUAL_STRING("app1", boot->label);
+    TEST_ASSERT_TRUE(read_partition(boot, image.size()) == image);
+    Config_Params config_params;
+    TEST_ASSERT_EQUAL_STRING("0.2.0", config_params.version);
+    Firmware_Params firmware_params;
+    TEST_ASSERT_EQUAL_STRING("1.0.0", firmware_params.version);
+    // the image info of the next boot (load_image_info() once running from that partition)
+    int fw_addr = -1, fw_len = 0;
+    uint8_t signature[SIGN_LEN];
+    TEST_ASSERT_TRUE(NVS::get_int("firmware", "fw_addr", fw_addr));
+    TEST_ASSERT_TRUE(NVS::get_int("firmware", "fw_len", fw_len));
+    TEST_ASSERT_EQUAL_UINT32(SIGN_LEN, NVS::get_bytes("firmware", "signature", signature, SIGN_LEN));
+    TEST_ASSERT_EQUAL_UINT32(boot->address, (uint32_t)fw_addr);
+    TEST_ASSERT_EQUAL_INT((int)image.size(), fw_len);
+    TEST_ASSERT_EQUAL_MEMORY(OtaFixture::read_file(site->publisher.firmware_path(image)).data(), signature, SIGN_LEN);
+}
+
+// The firmware's content-addressed URL (fw/<sha256>.img) is fetched cacheable, the config.img pointer with no-cache
+void test_only_the_config_is_fetched_with_no_cache()
+{
+    std::string image = OtaFixture::app_image(1000, 3);
+    TEST_ASSERT_TRUE(site->publish("0.3.0", "1.1.0", image));
+    std::string fw_path = site->publisher.firmware_path(image).substr(site->publisher.root().size());
+    std::map<std::string, std::string> cache_control;
+    std::mutex mutex;
+    site->server.handler([&](const TestHttpServer::Request &request, TestHttpServer::Response &)
+                         {
+                             std::lock_guard<std::mutex> lock(mutex);
+                             cache_control[request.path] = request.cache_control;
+                             return false; });
+    ConfigErr err;
+    TEST_ASSERT_TRUE(OtaFixture::check(err));
+    site->server.handler(nullptr);
+    TEST_ASSERT_TRUE(cache_control["/config.img"].find("no-cache") != std::string::npos);
+    TEST_ASSERT_EQUAL_UINT32(1, cache_control.count(fw_path));
+    TEST_ASSERT_EQUAL_STRING("", cache_control[fw_path].c_str());
+}
+
+// The same release again: nothing newer, no download
+void test_up_to_date_device_downloads_nothing()
+{
+    uint32_t requests = site->server.requests();
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    TEST_ASSERT_EQUAL_UINT32(requests + 1, site->server.requests()); // config.img only
+}
+
+// The same config.img polled again: its verdict is remembered, no RSA verify nor parsing; a new one is verified
+void test_unchanged_config_is_not_verified_again()
+{
+    Device_Params device;
+    device.load();
+    Config config;
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)config.check_update(device));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)config.check_update(device));
+    TEST_ASSERT_EQUAL_UINT32(2, config.get_stats().polls);
+    TEST_ASSERT_EQUAL_UINT32(2, config.get_stats().unchanged);
+    TEST_ASSERT_EQUAL_UINT32(0, config.get_stats().verified);
+
+    TEST_ASSERT_TRUE(site->publish("0.3.1", "1.1.0", OtaFixture::app_image(1000, 3)));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)config.check_update(device));
+    TEST_ASSERT_EQUAL_UINT32(1, config.get_stats().verified);
+    Config_Params config_params;
+    TEST_ASSERT_EQUAL_STRING("0.3.1", config_params.version);
+}
+
+// A new firmware key carried inline in the signed config (--inline-keys): kept as DER in the KeyStore, no key download;
+// then the publisher's own key rolled out again the same way: one key for both roles again, the other one erased
+void test_inline_firmware_key_is_rotated()
+{
+    OtaFixture::Publisher next;
+    uint32_t requests = site->server.requests();
+    TEST_ASSERT_TRUE(site->publish("0.4.0", "1.1.0", OtaFixture::app_image(1000, 3),
+                                   "--inline-keys --firmware-pub " + next.public_key_path()));
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    TEST_ASSERT_EQUAL_UINT32(requests + 1, site->server.requests()); // config.img only
+    std::string der = next.public_key_der();
+    Firmware_Params firmware_params;
+    uint8_t stored[KeyStore::max_der_size];
+    TEST_ASSERT_EQUAL_UINT32(der.size(), KeyStore::load(firmware_params.key.id(), stored, sizeof(stored)));
+    TEST_ASSERT_EQUAL_MEMORY(der.data(), stored, der.size());
+    std::string next_id = firmware_params.key.id();
+
+    TEST_ASSERT_TRUE(site->publish("0.4.1", "1.1.0", OtaFixture::app_image(1000, 3),
+                                   "--inline-keys --firmware-pub " + site->publisher.public_key_path()));
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    Config_Params config_params;
+    Firmware_Params rotated_back;
+    TEST_ASSERT_EQUAL_STRING(config_params.key.id(), rotated_back.key.id());
+    der = site->publisher.public_key_der();
+    TEST_ASSERT_EQUAL_UINT32(der.size(), KeyStore::load(rotated_back.key.id(), stored, sizeof(stored)));
+    TEST_ASSERT_EQUAL_MEMORY(der.data(), stored, der.size());
+    TEST_ASSERT_EQUAL_UINT32(0, KeyStore::load(next_id.c_str(), stored, sizeof(stored)));
+}
+
+// A catalog (tools/ota_catalog.py) at the config URL: the device applies the entry of its hardware revision, else of
+// revision 0; a catalog without its type fails like a bad download
+void test_catalog_entry_of_the_device_is_applied()
+{
+    std::string a = publish_entry("0.5.0"), b = publish_entry("0.5.1");
+    NVS::update_string("config", "url", site->server.url("/catalog.img").c_str());
+    ConfigErr err;
+    TEST_ASSERT_TRUE(site->publisher.publish_catalog("ch4_generator:2=" + a + " ch4_generator:1=" + b + " sensor=" + a));
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    TEST_ASSERT_EQUAL_STRING("0.5.1", Config_Params().version);
+
+    std::string c = publish_entry("0.5.2");
+    TEST_ASSERT_TRUE(site->publisher.publish_catalog("ch4_generator:2=" + a + " ch4_generator=" + c));
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_STRING("0.5.2", Config_Params().version);
+
+    TEST_ASSERT_TRUE(site->publisher.publish_catalog("sensor=" + c));
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::HttpGetErr, (int)err);
+    TEST_ASSERT_EQUAL_STRING("0.5.2", Config_Params().version);
+    NVS::update_string("config", "url", site->server.url("/config.img").c_str());
+}
+
+// A scheduled release (--activate-at): staged into the idle partition with no reboot, then booted once its activation
+// time has come, without another download
+void test_scheduled_release_is_staged_then_activated()
+{
+    esp_ota_set_boot_partition(esp_ota_get_running_partition());
+    std::string image = OtaFixture::app_image(100000, 4);
+    // a stage window of ~30 years: this device's slot in it is (but for a 1e-5 chance) already past
+    TEST_ASSERT_TRUE(site->publish("0.6.0", "1.2.0", image, "--activate-at +3600 --stage-window 1000000000"));
+    ConfigErr err;
+    TEST_ASSERT_FALSE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)err);
+    Firmware_Params firmware_params;
+    TEST_ASSERT_EQUAL_STRING("1.1.0", firmware_params.version);
+    TEST_ASSERT_EQUAL_STRING("1.2.0", firmware_params.staged);
+    TEST_ASSERT_EQUAL_STRING("app0", esp_ota_get_boot_partition()->label);
+    TEST_ASSERT_TRUE(read_partition(esp_ota_get_next_update_partition(NULL), image.size()) == image);
+    TEST_ASSERT_INT_WITHIN(30, 3585, Config().until_activation());
+
+    uint32_t requests = site->server.requests();
+    TEST_ASSERT_TRUE(site->publish("0.6.1", "1.2.0", image, "--activate-at +0")); // rescheduled to now
+    TEST_ASSERT_TRUE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_UINT32(requests + 1, site->server.requests()); // config.img only
+    TEST_ASSERT_EQUAL_STRING("app1", esp_ota_get_boot_partition()->label);
+    Firmware_Params activated;
+    TEST_ASSERT_EQUAL_STRING("1.2.0", activated.version);
+    TEST_ASSERT_EQUAL_STRING("", activated.staged);
+}
+
+// A stage slot ahead (--stage-window): nothing downloaded before it, and the polls until then don't verify the same
+// config.img again
+void test_release_waits_for_the_stage_slot()
+{
+    TEST_ASSERT_TRUE(site->publish("0.7.0", "1.3.0", OtaFixture::app_image(1000, 5),
+                                   "--activate-at +86400 --stage-window 86400"));
+    uint32_t requests = site->server.requests();
+    Device_Params device;
+    device.load();
+    Config config;
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)config.check_update(device));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)config.check_update(device));
+    TEST_ASSERT_EQUAL_UINT32(requests + 2, site->server.requests()); // config.img only
+    TEST_ASSERT_EQUAL_UINT32(1, config.get_stats().verified);
+    TEST_ASSERT_EQUAL_UINT32(1, config.get_stats().unchanged);
+    TEST_ASSERT_GREATER_THAN(0, config.until_staging());
+    TEST_ASSERT_EQUAL_STRING("", Firmware_Params().staged);
+    TEST_ASSERT_EQUAL_STRING("0.7.0", Config_Params().version);
+}
+
+// A poll answered 503 + Retry-After: the next one after that long (+ up to 10%), then the checking_interval again
+void test_retry_after_delays_the_next_poll()
+{
+    site->server.handler([](const TestHttpServer::Request &request, TestHttpServer::Response &response)
+                         {
+                             if (request.path != "/config.img")
+                                 return false;
+                             response.status = 503;
+                             response.headers.push_back("Retry-After: 120");
+                             return true; });
+    Device_Params device;
+    device.load();
+    Config config;
+    TEST_ASSERT_FALSE(config.check_update(device) == ConfigErr::NoErr);
+    site->server.handler(nullptr);
+    TEST_ASSERT_EQUAL_UINT32(1, config.get_stats().retry_afters);
+    TEST_ASSERT_UINT32_WITHIN(6, 126, config.next_poll_s(device));
+
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)config.check_update(device));
+    TEST_ASSERT_EQUAL_UINT32(60, config.next_poll_s(device));
+}
+
+// A "poll" hint of the signed manifest (--poll-hint): it replaces the checking_interval for its TTL, its first interval
+// a random part of it (the fleet doesn't poll in lockstep). A checking_interval of 0 is kept within the bounds
+void test_poll_hint_replaces_the_interval()
+{
+    TEST_ASSERT_TRUE(site->publish("0.8.0", "1.2.0", OtaFixture::app_image(1000, 4), "--poll-hint 30,3600"));
+    Device_Params device;
+    device.load();
+    Config config;
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)config.check_update(device));
+    TEST_ASSERT_EQUAL_UINT32(1, config.get_stats().poll_hints);
+    uint32_t first_s = config.next_poll_s(device); // (once: it uses up the random phase)
+    TEST_ASSERT_UINT32_WITHIN(15, 16, first_s);
+    TEST_ASSERT_EQUAL_UINT32(30, config.next_poll_s(device));
+
+    Config unhinted;
+    device.checking_interval = 0;
+    TEST_ASSERT_EQUAL_UINT32(min_poll_interval_s, unhinted.next_poll_s(device));
+}
+
+// A config.json with every field reads like its binary manifest (tools/manifest_tlv.py): mirrors (cut to the first
+// max_mirrors, not a NoMemory), notify_url, activate_at, budget, poll, multicast, sha256 & size
+void test_json_manifest_reads_as_its_tlv()
+{
+    std::string json_path = site->device_dir + "/full.json", tlv_path = site->device_dir + "/full.bin";
+    OtaFixture::write_file(json_path, full_manifest_json);
+    TEST_ASSERT_TRUE(OtaFixture::run("python3 " + OtaFixture::project_dir() + "/tools/manifest_tlv.py " + json_path + " " + tlv_path));
+    std::string json = full_manifest_json, tlv = OtaFixture::read_file(tlv_path);
+    Manifest from_json, from_tlv;
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)from_json.parse((uint8_t *)&json[0], json.size()));
+    TEST_ASSERT_EQUAL_INT((int)ConfigErr::NoErr, (int)from_tlv.parse((uint8_t *)&tlv[0], tlv.size()));
+
+    TEST_ASSERT_EQUAL_UINT32(Mirrors::max_mirrors, from_json.firmware.mirror_count);
+    TEST_ASSERT_EQUAL_STRING("http://m4/fw/a.img", from_json.firmware.mirrors[Mirrors::max_mirrors - 1]);
+    TEST_ASSERT_EQUAL_STRING("http://10.0.0.1/notify", from_json.config.notify_url);
+    assert_same_section(from_tlv.config, from_json.config);
+    assert_same_section(from_tlv.firmware, from_json.firmware);
+    TEST_ASSERT_EQUAL_STRING(from_tlv.type, from_json.type);
+    TEST_ASSERT_EQUAL_INT(90, from_json.device.checking_interval);
+    TEST_ASSERT_EQUAL_INT(from_tlv.device.checking_interval, from_json.device.checking_interval);
+    TEST_ASSERT_EQUAL_FLOAT(from_tlv.device.ch4_factor, from_json.device.ch4_factor);
+    TEST_ASSERT_EQUAL_UINT32(1800000000UL, from_json.staging.activate_at);
+    TEST_ASSERT_EQUAL_UINT32(from_tlv.staging.activate_at, from_json.staging.activate_at);
+    TEST_ASSERT_EQUAL_UINT32(from_tlv.staging.stage_window, from_json.staging.stage_window);
+    TEST_ASSERT_EQUAL_UINT32(64, from_json.budget.rate_kb);
+    TEST_ASSERT_EQUAL_UINT32(from_tlv.budget.rate_kb, from_json.budget.rate_kb);
+    TEST_ASSERT_EQUAL_UINT32(from_tlv.budget.slice_ms, from_json.budget.slice_ms);
+    TEST_ASSERT_EQUAL_UINT32(from_tlv.budget.pause_ms, from_json.budget.pause_ms);
+    TEST_ASSERT_EQUAL_UINT32(60, from_json.poll.interval_s);
+    TEST_ASSERT_EQUAL_UINT32(from_tlv.poll.interval_s, from_json.poll.interval_s);
+    TEST_ASSERT_EQUAL_UINT32(from_tlv.poll.ttl_s, from_json.poll.ttl_s);
+    TEST_ASSERT_TRUE(from_json.multicast.enabled);
+    TEST_ASSERT_EQUAL_STRING(from_tlv.multicast.group, from_json.multicast.group);
+    TEST_ASSERT_EQUAL_UINT32(from_tlv.multicast.port, from_json.multicast.port);
+    TEST_ASSERT_EQUAL_UINT32(from_tlv.multicast.timeout_s, from_json.multicast.timeout_s);
+}
+
+// A release published as config.json (--format json, the other tests publish binary manifests) with a mirror, a
+// download budget, a poll hint & an activation time already come: downloaded at that pace & booted
+void test_json_release_is_booted()
+{
+    esp_ota_set_boot_partition(esp_ota_get_running_partition());
+    TestHttpServer mirror(site->publisher.root());
+    std::string image = OtaFixture::app_image(50000, 11);
+    TEST_ASSERT_TRUE(site->publish("0.9.0", "1.4.0", image, "--format json --mirror-url " + mirror.url("/") +
+                                                                 " --budget 64,10,40 --poll-hint 30,3600 --activate-at +0"));
+    TEST_ASSERT_EQUAL_UINT8('{', OtaFixture::read_file(site->publisher.root() + "/config.img")[SIGN_LEN]);
+    ConfigErr err;
+    TEST_ASSERT_TRUE(OtaFixture::check(err));
+    TEST_ASSERT_EQUAL_STRING("app1", esp_ota_get_boot_partition()->label);
+    TEST_ASSERT_TRUE(read_partition(esp_ota_get_boot_partition(), image.size()) == image);
+    TEST_ASSERT_EQUAL_STRING("0.9.0", Config_Params().version);
+    TEST_ASSERT_EQUAL_STRING("1.4.0", Firmware_Params().version);
+}
+
+int main(int argc, char **argv)
+{
+    site = new OtaFixture::Site();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_new_config_is_applied);
+    RUN_TEST(test_foreign_signature_is_rejected);
+    RUN_TEST(test_tampered_firmware_is_not_booted);
+    RUN_TEST(test_other_signed_release_is_rejected);
+    RUN_TEST(test_older_release_on_a_mirror_is_rejected);
+    RUN_TEST(test_new_firmware_is_flashed_and_booted);
+    RUN_TEST(test_only_the_config_is_fetched_with_no_cache);
+    RUN_TEST(test_up_to_date_device_downloads_nothing);
+    RUN_TEST(test_unchanged_config_is_not_verified_again);
+    RUN_TEST(test_inline_firmware_key_is_rotated);
+    RUN_TEST(test_catalog_entry_of_the_device_is_applied);
+    RUN_TEST(test_scheduled_release_is_staged_then_activated);
+    RUN_TEST(test_release_waits_for_the_stage_slot);
+    RUN_TEST(test_retry_after_delays_the_next_poll);
+    RUN_TEST(test_poll_hint_replaces_the_interval);
+    RUN_TEST(test_json_manifest_reads_as_its_tlv);
+    RUN_TEST(test_json_release_is_booted);
+    int failures = UNITY_END();
+    delete site;
+    return failures;
+}
@@ -0,0 +1,189 @@
+// The push channel (src/utils/notifier.h) on lib/native_hal against a scripted notifier (TestHttpServer): 204 keeps the
+// channel up on one connection, 200 asks for a poll then rechecks until the version is applied, the errors back off
+// exponentially. The clock is simulated: the notifier's waits advance it at once, each long-poll records its time.
+#include <unity.h>
+
+#include <deque>
+
+#include "../common/ota_fixture.h"
+#include "utils/notifier.h"
+
+namespace
+{
+    TestHttpServer *server;
+    Notifier notifier;
+
+    struct LongPoll
+    {
+        std::string query;
+        uint32_t at_ms;
+    };
+
+    // The notifier's answers in order; an idle 204 when none is left
+    std::mutex mutex;
+    std::deque<TestHttpServer::Response> script;
+    std::vector<LongPoll> polls;
+    std::vector<uint32_t> notified_ms; // on_notify() calls
+    std::string apply_on_notify;       // the version set_target() applies from on_notify() ("": none, not applied)
+
+    TestHttpServer::Response answer(const int status, const std::string &body = "")
+    {
+        TestHttpServer::Response response;
+        response.status = status;
+        response.body = body;
+        return response;
+    }
+
+    void on_notify(void *)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        notified_ms.push_back(millis());
+        if (!apply_on_notify.empty()) // the loop task's check_update() applying it
+            notifier.set_target(server->url("/notify").c_str(), apply_on_notify.c_str());
+    }
+
+    // Answer the next long-polls with `responses`. Return the number of long-polls so far
+    size_t play(std::initializer_list<TestHttpServer::Response> responses)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        script.assign(responses);
+        notified_ms.clear();
+        return polls.size();
+    }
+
+    // Wait (real time) for the long-poll after the script: the notifier is done with it. Return the script's long-polls
+    // & the next one
+    std::vector<LongPoll> wait_played(const size_t from, const size_t count)
+    {
+        for (int i = 0; i < 10000; i++)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (script.empty() && polls.size() >= from + count + 1)
+                    return std::vector<LongPoll>(polls.begin() + from, polls.begin() + from + count + 1);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        TEST_FAIL_MESSAGE("the notifier didn't play the script");
+        return {};
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Nothing new: one long-poll after another on the same connection, the channel up, no poll asked for
+void test_idle_keeps_the_channel_up()
+{
+    size_t from = play({answer(204), answer(204), answer(204)});
+    std::vector<LongPoll> played = wait_played(from, 3);
+    TEST_ASSERT_TRUE(notifier.is_up());
+    TEST_ASSERT_FALSE(notifier.take());
+    TEST_ASSERT_EQUAL_UINT32(1, server->connections());
+    TEST_ASSERT_EQUAL_STRING("v=0.0.1&wait=50", played[0].query.c_str());
+    TEST_ASSERT_EQUAL_UINT32(played[0].at_ms, played[3].at_ms); // each right after the previous one
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(3, notifier.get_stats().idle);
+}
+
+// A new version: a poll asked for, then max_rechecks more recheck_wait_ms apart while it isn't applied (a cache behind
+// the publication); the next long-poll waits for the version after it
+void test_unapplied_version_is_rechecked()
+{
+    size_t from = play({answer(200, "0.0.2\n")});
+    std::vector<LongPoll> played = wait_played(from, 1);
+    TEST_ASSERT_TRUE(notifier.take());
+    std::lock_guard<std::mutex> lock(mutex);
+    TEST_ASSERT_EQUAL_UINT32(1 + Notifier::max_rechecks, notified_ms.size());
+    for (size_t i = 1; i < notified_ms.size(); i++)
+        TEST_ASSERT_EQUAL_UINT32(Notifier::recheck_wait_ms, notified_ms[i] - notified_ms[i - 1]);
+    TEST_ASSERT_EQUAL_STRING("v=0.0.2&wait=50", played[1].query.c_str());
+    TEST_ASSERT_EQUAL_UINT32(Notifier::recheck_wait_ms, played[1].at_ms - notified_ms.back());
+}
+
+// A new version applied by the check it triggered: no recheck
+void test_applied_version_ends_the_rechecks()
+{
+    apply_on_notify = "0.0.3";
+    size_t from = play({answer(200, "0.0.3")});
+    std::vector<LongPoll> played = wait_played(from, 1);
+    TEST_ASSERT_TRUE(notifier.take());
+    std::lock_guard<std::mutex> lock(mutex);
+    apply_on_notify.clear();
+    TEST_ASSERT_EQUAL_UINT32(1, notified_ms.size());
+    TEST_ASSERT_EQUAL_STRING("v=0.0.3&wait=50", played[1].query.c_str());
+}
+
+// Errors (HTTP errors, a body cut short): the channel is down, a poll is asked for once, the long-polls back off from
+// min_retry_ms, doubling; a 204 brings the channel up & resets the backoff
+void test_errors_back_off_exponentially()
+{
+    TestHttpServer::Response cut = answer(200, "0.0.9");
+    cut.cut_at = 2;
+    uint32_t errors = notifier.get_stats().errors;
+    size_t from = play({answer(500), answer(503), cut, answer(404), answer(500), answer(204)});
+    std::vector<LongPoll> played = wait_played(from, 6);
+    TEST_ASSERT_EQUAL_UINT32(errors + 5, notifier.get_stats().errors);
+    TEST_ASSERT_TRUE(notifier.take());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        TEST_ASSERT_EQUAL_UINT32(1, notified_ms.size()); // when it went down
+    }
+    TEST_ASSERT_TRUE(notifier.is_up());
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(Notifier::min_retry_ms, played[1].at_ms - played[0].at_ms); // + the notify gap
+    for (size_t i = 2; i <= 5; i++)
+        TEST_ASSERT_EQUAL_UINT32(Notifier::min_retry_ms << (i - 1), played[i].at_ms - played[i - 1].at_ms);
+    TEST_ASSERT_EQUAL_UINT32(played[5].at_ms, played[6].at_ms);
+
+    from = play({answer(500), answer(500), answer(204)});
+    played = wait_played(from, 3);
+    TEST_ASSERT_EQUAL_UINT32(Notifier::min_retry_ms, played[1].at_ms - played[0].at_ms);
+    TEST_ASSERT_EQUAL_UINT32(2 * Notifier::min_retry_ms, played[2].at_ms - played[1].at_ms);
+}
+
+// The backoff is capped at max_retry_ms
+void test_backoff_is_capped()
+{
+    std::initializer_list<TestHttpServer::Response> errors{answer(500), answer(500), answer(500), answer(500),
+                                                           answer(500), answer(500), answer(500), answer(500),
+                                                           answer(500), answer(204)};
+    size_t from = play(errors);
+    std::vector<LongPoll> played = wait_played(from, errors.size());
+    for (size_t i = 2; i < errors.size(); i++) // (the 1st one: + the notify gap)
+    {
+        uint32_t backoff_ms = min(Notifier::min_retry_ms << (i - 1), Notifier::max_retry_ms);
+        TEST_ASSERT_EQUAL_UINT32(backoff_ms, played[i].at_ms - played[i - 1].at_ms);
+    }
+    TEST_ASSERT_EQUAL_UINT32(Notifier::max_retry_ms, played[9].at_ms - played[8].at_ms);
+    TEST_ASSERT_TRUE(notifier.take());
+}
+
+int main(int argc, char **argv)
+{
+    simulate_clock(1000);
+    server = new TestHttpServer(OtaFixture::temp_dir("notifier"));
+    server->handler([](const TestHttpServer::Request &request, TestHttpServer::Response &response)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        polls.push_back({request.query, millis()});
+                        if (script.empty())
+                        {
+                            response = answer(204);
+                            response.delay_ms = 20; // (real time) an idle notifier holding the long-poll
+                            return true;
+                        }
+                        response = script.front();
+                        script.pop_front();
+                        return true; });
+    notifier.set_target(server->url("/notify").c_str(), "0.0.1");
+    notifier.begin(on_notify);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_keeps_the_channel_up);
+    RUN_TEST(test_unapplied_version_is_rechecked);
+    RUN_TEST(test_applied_version_ends_the_rechecks);
+    RUN_TEST(test_errors_back_off_exponentially);
+    RUN_TEST(test_backoff_is_capped);
+    int failures = UNITY_END();
+    fflush(stdout);
+    _exit(failures); // the notifier's task never ends: no static destructors under its feet
+}
@@ -0,0 +1,94 @@
+// Throttle (src/utils/throttle.h), the pacing of a budgeted firmware download, on the simulated clock of lib/native_hal
+// (its delay()s advance the clock): the token bucket's rate & burst, the CPU slices & their pauses, scaled after an
+// overrun.
+#include <unity.h>
+
+#include "utils/throttle.h"
+
+namespace
+{
+    constexpr const size_t chunk = 1460; // a TCP segment, as Mirrors::download() reads
+
+    // Read `total` bytes through `throttle`, each chunk costing `work_ms` of CPU. Return the elapsed ms
+    uint32_t transfer(Throttle &throttle, const size_t total, const uint32_t work_ms)
+    {
+        uint32_t start_ms = millis();
+        for (size_t done = 0; done < total;)
+        {
+            size_t len = throttle.acquire(min(chunk, total - done));
+            advance_clock(work_ms);
+            throttle.consume(len);
+            done += len;
+        }
+        return millis() - start_ms;
+    }
+}
+
+void setUp()
+{
+    simulate_clock(1000);
+}
+void tearDown() {}
+
+// No budget: every read at once, no wait
+void test_no_budget_never_waits()
+{
+    Throttle throttle(0, 0, 0);
+    TEST_ASSERT_EQUAL_UINT32(8192, throttle.acquire(8192));
+    TEST_ASSERT_EQUAL_UINT32(0, transfer(throttle, 100000, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, throttle.get_stats().slices);
+    TEST_ASSERT_EQUAL_UINT32(0, throttle.get_stats().limited_ms);
+}
+
+// 10 KB/s: 100 KB take ~10 s (less the first burst of a quarter second), all of it waiting for tokens
+void test_rate_limits_the_transfer()
+{
+    Throttle throttle(10000, 0, 0);
+    uint32_t elapsed_ms = transfer(throttle, 100000, 0);
+    TEST_ASSERT_UINT32_WITHIN(150, 9750, elapsed_ms);
+    TEST_ASSERT_EQUAL_UINT32(elapsed_ms, throttle.get_stats().limited_ms);
+    TEST_ASSERT_EQUAL_UINT32(0, throttle.get_stats().slices);
+}
+
+// A read never asks for more than the burst, a small rate still gets a whole TCP segment
+void test_reads_are_bounded_by_the_burst()
+{
+    Throttle fast(40000, 0, 0);
+    TEST_ASSERT_EQUAL_UINT32(10000, fast.acquire(65536));
+    Throttle slow(1000, 0, 0);
+    TEST_ASSERT_EQUAL_UINT32(chunk, slow.acquire(65536));
+}
+
+// 10 ms slices, 40 ms pauses: the transfer gets a fifth of the time
+void test_cpu_slices_are_followed_by_pauses()
+{
+    Throttle throttle(0, 10, 40);
+    uint32_t elapsed_ms = transfer(throttle, 100 * chunk, 2); // 200 ms of work
+    const Throttle::Stats &stats = throttle.get_stats();
+    TEST_ASSERT_UINT32_WITHIN(1, 19, stats.slices);
+    TEST_ASSERT_EQUAL_UINT32(40 * stats.slices, stats.paused_ms);
+    TEST_ASSERT_EQUAL_UINT32(200 + stats.paused_ms, elapsed_ms);
+}
+
+// A slice overrun (a 45 ms sector erase in a 10 ms slice) gets a pause scaled to keep the same share
+void test_overrun_gets_a_longer_pause()
+{
+    Throttle throttle(0, 10, 40);
+    throttle.acquire(chunk);
+    advance_clock(45);
+    throttle.consume(chunk);
+    throttle.acquire(chunk);
+    TEST_ASSERT_EQUAL_UINT32(1, throttle.get_stats().slices);
+    TEST_ASSERT_EQUAL_UINT32(180, throttle.get_stats().paused_ms);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_budget_never_waits);
+    RUN_TEST(test_rate_limits_the_transfer);
+    RUN_TEST(test_reads_are_bounded_by_the_burst);
+    RUN_TEST(test_cpu_slices_are_followed_by_pauses);
+    RUN_TEST(test_overrun_gets_a_longer_pause);
+    return UNITY_END();
+}
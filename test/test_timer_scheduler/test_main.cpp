@@ -0,0 +1,223 @@
+// TimerScheduler (src/TimerScheduler.h): the deadline order of its heap, early triggers & wake-ups, re-arming, the
+// millis() wraparound, and its wakeups against the polling loop it replaced, on the simulated clock of lib/native_hal.
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "TimerScheduler.h"
+
+namespace
+{
+    struct Call
+    {
+        char name;
+        uint32_t at_ms;
+    };
+    Call calls[32];
+    uint8_t call_count;
+
+    void record(void *ctx)
+    {
+        if (call_count < 32)
+            calls[call_count++] = Call{*(const char *)ctx, millis()};
+    }
+
+    std::string call_names()
+    {
+        std::string names;
+        for (uint8_t i = 0; i < call_count; i++)
+            names += calls[i].name;
+        return names;
+    }
+
+    // loop() until `count` calls were recorded (the simulated clock jumps over each wait)
+    template <uint8_t Capacity>
+    void run_until(TimerScheduler<Capacity> &timers, uint8_t count)
+    {
+        for (int i = 0; i < 100 && call_count < count; i++)
+            timers.loop();
+    }
+
+    const char a = 'a', b = 'b', c = 'c', d = 'd', e = 'e';
+}
+
+void setUp()
+{
+    call_count = 0;
+}
+
+void tearDown() {}
+
+// Real clock: wake() from another task ends loop()'s wait before the next deadline
+void test_wake_ends_the_wait()
+{
+    TimerScheduler<> timers;
+    auto id = timers.every(3600000, record, (void *)&a);
+    std::atomic<bool> event{false};
+    std::atomic<bool> returned{false};
+    std::thread other([&]
+                      {
+                          std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                          event = true;
+                          while (!returned) // until loop() has taken its task as the owner & waits
+                          {
+                              timers.wake();
+                              std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                          } });
+    auto start = std::chrono::steady_clock::now();
+    timers.loop();
+    returned = true;
+    auto waited_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    other.join();
+    TEST_ASSERT_TRUE(event);
+    TEST_ASSERT_LESS_THAN(1000, waited_ms);
+    TEST_ASSERT_EQUAL_UINT8(0, call_count);
+
+    timers.trigger_now(id); // the owner's reaction to the event (e.g. an early check asked for)
+    TEST_ASSERT_EQUAL_UINT32(0, timers.until_next_deadline()); // due: the next loop() runs it
+}
+
+// The callbacks run in deadline order, whatever the order of their creation; a cancelled timer doesn't run
+void test_deadline_order()
+{
+    simulate_clock(1000);
+    TimerScheduler<> timers;
+    timers.after(50, record, (void *)&e);
+    timers.after(10, record, (void *)&a);
+    auto cancelled = timers.after(25, record, (void *)&c);
+    timers.after(30, record, (void *)&c);
+    timers.after(20, record, (void *)&b);
+    timers.after(40, record, (void *)&d);
+    timers.cancel(cancelled);
+    run_until(timers, 5);
+    TEST_ASSERT_EQUAL_STRING("abcde", call_names().c_str());
+    TEST_ASSERT_EQUAL_UINT32(1010, calls[0].at_ms);
+    TEST_ASSERT_EQUAL_UINT32(1050, calls[4].at_ms);
+    TEST_ASSERT_FALSE(timers.is_active(cancelled));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, timers.until_next_deadline()); // one-shots: nothing left
+}
+
+// A full scheduler refuses a timer; a freed slot is reused
+void test_capacity()
+{
+    simulate_clock(0);
+    TimerScheduler<3> timers;
+    TimerScheduler<3>::TimerId ids[3];
+    for (uint8_t i = 0; i < 3; i++)
+        ids[i] = timers.after(100 + i, record, (void *)&a);
+    TEST_ASSERT_EQUAL_UINT8(TimerScheduler<3>::InvalidTimer, timers.after(10, record, (void *)&b));
+    timers.cancel(ids[1]);
+    TEST_ASSERT_EQUAL_UINT8(ids[1], timers.after(10, record, (void *)&b));
+    run_until(timers, 3);
+    TEST_ASSERT_EQUAL_STRING("baa", call_names().c_str());
+}
+
+// trigger_now() makes a periodic timer due at once, its period then counts from that call
+void test_trigger_now()
+{
+    simulate_clock(5000);
+    TimerScheduler<> timers;
+    auto id = timers.every(1000, record, (void *)&a);
+    advance_clock(300);
+    timers.trigger_now(id);
+    timers.loop();
+    TEST_ASSERT_EQUAL_UINT8(1, call_count);
+    TEST_ASSERT_EQUAL_UINT32(5300, calls[0].at_ms);
+    run_until(timers, 2);
+    TEST_ASSERT_EQUAL_UINT32(6300, calls[1].at_ms);
+}
+
+// set_interval() from the timer's own callback re-arms it with the new period; from outside, it counts from now
+void test_set_interval_rearms()
+{
+    simulate_clock(0);
+    static TimerScheduler<> timers;
+    static TimerScheduler<>::TimerId id;
+    id = timers.every(1000, [](void *ctx)
+                      {
+                          record(ctx);
+                          timers.set_interval(id, 5000); },
+                      (void *)&a);
+    run_until(timers, 2);
+    TEST_ASSERT_EQUAL_UINT32(1000, calls[0].at_ms);
+    TEST_ASSERT_EQUAL_UINT32(6000, calls[1].at_ms);
+
+    TimerScheduler<> outside;
+    auto other = outside.every(1000, record, (void *)&b);
+    advance_clock(500);
+    uint32_t set_at = millis();
+    outside.set_interval(other, 200); // due 200 ms from now, not 200 ms after its creation
+    run_until(outside, 4);
+    TEST_ASSERT_EQUAL_UINT32(set_at + 200, calls[2].at_ms);
+    TEST_ASSERT_EQUAL_UINT32(set_at + 400, calls[3].at_ms);
+}
+
+// Deadlines on both sides of the millis() wraparound (~49.7 days) keep their order & periods
+void test_millis_wraparound()
+{
+    simulate_clock(UINT32_MAX - 1500);
+    TimerScheduler<> timers;
+    timers.every(1000, record, (void *)&a); // UINT32_MAX - 500, then 499 (wrapped), 1499 ...
+    timers.after(2500, record, (void *)&b); // 999 (wrapped)
+    timers.after(1200, record, (void *)&c); // UINT32_MAX - 300
+    run_until(timers, 5);
+    TEST_ASSERT_EQUAL_STRING("acaba", call_names().c_str());
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX - 500, calls[0].at_ms);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX - 300, calls[1].at_ms);
+    TEST_ASSERT_EQUAL_UINT32(499, calls[2].at_ms);
+    TEST_ASSERT_EQUAL_UINT32(999, calls[3].at_ms);
+    TEST_ASSERT_EQUAL_UINT32(1499, calls[4].at_ms);
+}
+
+// A check every 5 s for an hour: the polling loop it replaced (delay(10), then PeriodicTimer's millis() test) woke the
+// loop task every 10 ms, the scheduler once per check; the checks are the same and the task is idle in between
+void test_wakeups_against_the_polling_loop()
+{
+    constexpr uint32_t interval_ms = 5000;
+    constexpr uint32_t duration_ms = 3600000;
+    simulate_clock(0);
+    uint32_t polling_wakeups = 0, polling_checks = 0;
+    uint32_t last_check_ms = millis();
+    while (millis() < duration_ms)
+    {
+        delay(10);
+        polling_wakeups++;
+        if (millis() - last_check_ms >= interval_ms)
+        {
+            polling_checks++;
+            last_check_ms = millis();
+        }
+    }
+
+    simulate_clock(0);
+    static uint32_t checks;
+    checks = 0;
+    TimerScheduler<> timers;
+    timers.every(interval_ms, [](void *)
+                 { checks++; });
+    while (millis() < duration_ms)
+        timers.loop();
+    const TimerScheduler<>::Stats &stats = timers.get_stats();
+    printf("1 h, a check every %u ms: polling loop %u wakeups for %u checks, scheduler %u wakeups for %u checks (idle %u ms)\n",
+           interval_ms, polling_wakeups, polling_checks, stats.wakeups, checks, stats.idle_ms);
+    TEST_ASSERT_EQUAL_UINT32(duration_ms / 10, polling_wakeups);
+    TEST_ASSERT_EQUAL_UINT32(polling_checks - 1, checks); // (the polling loop's last check: at the end of the hour)
+    TEST_ASSERT_EQUAL_UINT32(checks + 1, stats.wakeups);    // + the first wait
+    TEST_ASSERT_EQUAL_UINT32(duration_ms, stats.idle_ms);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_wake_ends_the_wait); // first: the real clock
+    RUN_TEST(test_deadline_order);
+    RUN_TEST(test_capacity);
+    RUN_TEST(test_trigger_now);
+    RUN_TEST(test_set_interval_rearms);
+    RUN_TEST(test_millis_wraparound);
+    RUN_TEST(test_wakeups_against_the_polling_loop);
+    return UNITY_END();
+}
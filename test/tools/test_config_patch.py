@@ -0,0 +1,206 @@
+"""
+tools/config_patch.py: merge_patch() (RFC 7386), make_patch() round-trips & the signed patches of publish_patches().
+- Run: python3 -m unittest discover -s test/tools
+"""
+import copy
+import glob
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "..", "tools"))
+import config_patch  # noqa: E402
+import manifest_tlv  # noqa: E402
+import ota_pack  # noqa: E402
+
+
+def manifest(version, **device):
+    """A config.json like the published ones (tools/ota_pack.py)"""
+    return {
+        "type": "ch4_generator",
+        "config": {"version": version, "url_change?": False, "url": "http://127.0.0.1/config.img",
+                   "public_key_change?": False, "public_key_url": ""},
+        "device": dict({"ch4_factor": 25.5, "power_factor": 12.25, "checking_interval": 60}, **device),
+        "firmware": {"version": "1.0.0", "url": "http://127.0.0.1/fw/0.img", "public_key_change?": False,
+                     "public_key_url": ""},
+    }
+
+
+def apply(base, patch):
+    """The device's view: the patch (without its "base") merged into the base config.json"""
+    patch = {key: value for key, value in patch.items() if key != "base"}
+    return config_patch.merge_patch(base, patch)
+
+
+class MergePatchTest(unittest.TestCase):
+    def test_rfc7386_examples(self):
+        # RFC 7386, appendix A
+        examples = [
+            ({"a": "b"}, {"a": "c"}, {"a": "c"}),
+            ({"a": "b"}, {"b": "c"}, {"a": "b", "b": "c"}),
+            ({"a": "b"}, {"a": None}, {}),
+            ({"a": "b", "b": "c"}, {"a": None}, {"b": "c"}),
+            ({"a": ["b"]}, {"a": "c"}, {"a": "c"}),
+            ({"a": "c"}, {"a": ["b"]}, {"a": ["b"]}),
+            ({"a": {"b": "c"}}, {"a": {"b": "d", "c": None}}, {"a": {"b": "d"}}),
+            ({"a": [{"b": "c"}]}, {"a": [1]}, {"a": [1]}),
+            (["a", "b"], ["c", "d"], ["c", "d"]),
+            ({"a": "b"}, ["c"], ["c"]),
+            ({"a": "foo"}, None, None),
+            ({"a": "foo"}, "bar", "bar"),
+            ({"e": None}, {"a": 1}, {"e": None, "a": 1}),
+            ([1, 2], {"a": "b", "c": None}, {"a": "b"}),
+            ({}, {"a": {"bb": {"ccc": None}}}, {"a": {"bb": {}}}),
+        ]
+        for target, patch, result in examples:
+            with self.subTest(target=target, patch=patch):
+                self.assertEqual(result, config_patch.merge_patch(target, patch))
+
+    def test_target_is_not_modified(self):
+        target = {"a": {"b": 1}}
+        config_patch.merge_patch(target, {"a": {"b": 2, "c": 3}})
+        self.assertEqual({"a": {"b": 1}}, target)
+
+    def test_diff_round_trips(self):
+        old = {"a": 1, "b": {"c": 2, "d": [1, 2]}, "e": "x"}
+        for new in ({"a": 1, "b": {"c": 2, "d": [1, 2]}, "e": "x"},  # unchanged: an empty patch
+                    {"a": 2, "b": {"c": 2, "d": [1, 2, 3]}},  # changed, list replaced, removed
+                    {"a": 1, "b": "flat", "e": "x", "f": {"g": True}},  # object --> value, added object
+                    {}):
+            with self.subTest(new=new):
+                self.assertEqual(new, config_patch.merge_patch(old, config_patch.diff(old, new)))
+        self.assertEqual({}, config_patch.diff(old, copy.deepcopy(old)))
+
+
+class MakePatchTest(unittest.TestCase):
+    def test_changed_device_key_only(self):
+        old, new = manifest("0.0.1"), manifest("0.0.2", ch4_factor=30.5)
+        patch = config_patch.make_patch(old, new)
+        self.assertEqual("0.0.1", patch["base"])
+        self.assertEqual({"ch4_factor": 30.5}, patch["device"])
+        self.assertNotIn("type", patch)  # unchanged members are left out
+        self.assertEqual(new, apply(old, patch))
+
+    def test_config_and_firmware_are_sent_whole(self):
+        old, new = manifest("0.0.1"), manifest("0.0.2")
+        patch = config_patch.make_patch(old, new)
+        self.assertEqual(new["config"], patch["config"])
+        self.assertEqual(new["firmware"], patch["firmware"])  # unchanged: a failed update is retried from the patch
+
+    def test_removed_keys_are_null(self):
+        old, new = manifest("0.0.1", extra=1), manifest("0.0.2")
+        old["firmware"]["mirrors"] = ["http://mirror/fw/0.img"]
+        patch = config_patch.make_patch(old, new)
+        self.assertIsNone(patch["device"]["extra"])
+        self.assertIsNone(patch["firmware"]["mirrors"])  # sent whole, merged all the same
+        self.assertEqual(new, apply(old, patch))
+
+    def test_poll_hint_is_sent_whole_while_set(self):
+        old, new = manifest("0.0.1"), manifest("0.0.2")
+        old["poll"] = new["poll"] = {"interval": 30, "ttl": 600}
+        self.assertEqual(new["poll"], config_patch.make_patch(old, new)["poll"])
+        del new["poll"]
+        patch = config_patch.make_patch(old, new)
+        self.assertIsNone(patch["poll"])
+        self.assertEqual(new, apply(old, patch))
+
+    def test_round_trips_over_a_release_history(self):
+        history = [manifest("0.0.1")]
+        for version, change in (("0.0.2", lambda m: m["device"].update(ch4_factor=26.0)),
+                                ("0.0.3", lambda m: m["firmware"].update(version="1.1.0", activate_at=1800000000)),
+                                ("0.0.4", lambda m: m.update(poll={"interval": 15})),
+                                ("0.0.5", lambda m: m["config"].update(mirrors=["http://mirror/config.img"])),
+                                ("0.0.6", lambda m: (m.pop("poll"), m["device"].pop("power_factor"),
+                                                     m["config"].pop("mirrors")))):
+            new = copy.deepcopy(history[-1])
+            new["config"]["version"] = version
+            change(new)
+            history.append(new)
+        for i, old in enumerate(history[:-1]):
+            for new in history[i + 1:]:
+                with self.subTest(base=old["config"]["version"], version=new["config"]["version"]):
+                    self.assertEqual(new, apply(old, config_patch.make_patch(old, new)))
+
+    def test_unrepresentable_change_is_refused(self):
+        old, new = manifest("0.0.1"), manifest("0.0.2", ch4_factor=None)  # a null can't be set by a merge patch
+        with self.assertRaises(ValueError):
+            config_patch.make_patch(old, new)
+
+
+class PublishPatchesTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.key_dir = tempfile.TemporaryDirectory()
+        cls.key = os.path.join(cls.key_dir.name, "key.pem")
+        cls.pub = os.path.join(cls.key_dir.name, "key.pub")
+        subprocess.run(["openssl", "genrsa", "-out", cls.key, "4096"], check=True, capture_output=True)
+        subprocess.run(["openssl", "rsa", "-in", cls.key, "-pubout", "-out", cls.pub], check=True, capture_output=True)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.key_dir.cleanup()
+
+    def setUp(self):
+        self.out = tempfile.TemporaryDirectory()
+        self.addCleanup(self.out.cleanup)
+
+    def publish(self, version, fmt="json", keep=2, **device):
+        new = manifest(version, **device)
+        return new, config_patch.publish_patches(self.out.name, new, self.key, fmt, keep)
+
+    def verify(self, path):
+        """The signed content of a patch file, its signature checked with the public key"""
+        with open(path, "rb") as f:
+            image = f.read()
+        signature, content = image[:ota_pack.SIGN_LEN], image[ota_pack.SIGN_LEN:]
+        sig_path = path + ".sig"
+        with open(sig_path, "wb") as f:
+            f.write(signature)
+        verified = subprocess.run(["openssl", "dgst", "-sha256", "-verify", self.pub, "-signature", sig_path],
+                                  input=content, capture_output=True)
+        os.remove(sig_path)
+        self.assertEqual(0, verified.returncode, verified.stdout + verified.stderr)
+        return content
+
+    def patches(self):
+        return sorted(os.path.basename(path) for path in glob.glob(os.path.join(self.out.name, "patches", "*.img")))
+
+    def test_first_version_has_no_patch(self):
+        _, sizes = self.publish("0.0.1")
+        self.assertEqual([], sizes)
+        self.assertTrue(os.path.exists(os.path.join(self.out.name, "history", "0.0.1.json")))
+
+    def test_signed_patches_of_the_last_versions(self):
+        bases = [self.publish(version, ch4_factor=25.5 + i)[0] for i, version in enumerate(("0.0.1", "0.0.2", "0.0.3"))]
+        new, sizes = self.publish("0.0.4", ch4_factor=40.0)
+        self.assertEqual(["0.0.2.img", "0.0.3.img"], self.patches())  # 0.0.1.img: older than the last 2, deleted
+        self.assertEqual(["0.0.2", "0.0.3"], sorted(base for base, _, _ in sizes))
+        for base in bases[1:]:
+            version = base["config"]["version"]
+            patch = json.loads(self.verify(os.path.join(self.out.name, "patches", version + ".img")))
+            self.assertEqual(version, patch["base"])
+            self.assertEqual(new, apply(base, patch))
+        for _, size, full in sizes:
+            self.assertLess(size, full)
+
+    def test_tlv_patches_carry_their_base(self):
+        self.publish("0.0.1", fmt="tlv")
+        self.publish("0.0.2", fmt="tlv", ch4_factor=30.5)
+        patch = manifest_tlv.decode(self.verify(os.path.join(self.out.name, "patches", "0.0.1.img")))
+        self.assertEqual("0.0.1", patch["base"])
+        self.assertEqual("0.0.2", patch["config"]["version"])
+        self.assertEqual(30.5, patch["device"]["ch4_factor"])
+        self.assertNotIn("checking_interval", patch["device"])  # unchanged: kept by the device
+
+    def test_no_patches_kept(self):
+        self.publish("0.0.1")
+        self.publish("0.0.2")
+        self.publish("0.0.3", keep=0)
+        self.assertEqual([], self.patches())
+
+
+if __name__ == "__main__":
+    unittest.main()
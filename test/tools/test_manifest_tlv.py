@@ -0,0 +1,71 @@
+"""
+tools/manifest_tlv.py: config.json --> binary manifest --> config.json round-trips, the records Manifest::parse_tlv()
+relies on (skipped unknown tags, truncation).
+- Run: python3 -m unittest discover -s test/tools
+"""
+import base64
+import json
+import os
+import struct
+import sys
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "..", "tools"))
+import manifest_tlv  # noqa: E402
+
+DER = base64.b64encode(bytes(range(256)) * 2).decode()  # (not a key: the converter doesn't parse it)
+SHA256 = bytes(range(32)).hex()
+
+
+def manifest():
+    return {
+        "type": "ch4_generator",
+        "config": {"version": "0.0.2", "url_change?": False, "url": "http://10.0.0.1/config.img",
+                   "public_key_change?": False, "public_key_url": ""},
+        "device": {"ch4_factor": 25.5, "power_factor": 12.25, "checking_interval": 60},
+        "firmware": {"version": "0.0.6", "url": "http://10.0.0.1/fw/ab.img", "public_key_change?": True,
+                     "public_key_url": "http://10.0.0.1/keys/cd.pub",
+                     "public_key": {"id": "0123456789abcdef", "der": DER},
+                     "multicast": {"group": "239.1.2.3", "port": 5000, "timeout": 30000},
+                     "sha256": SHA256, "size": 300000},
+    }
+
+
+class ManifestTlvTest(unittest.TestCase):
+    def test_round_trip(self):
+        data = manifest_tlv.encode(manifest())
+        self.assertTrue(data.startswith(manifest_tlv.MAGIC))
+        self.assertEqual(manifest(), manifest_tlv.decode(data))
+
+    def test_smaller_than_the_json(self):
+        data = manifest_tlv.encode(manifest())
+        self.assertLess(len(data), len(json.dumps(manifest(), separators=(",", ":"))))
+        self.assertIn(base64.b64decode(DER), data)  # the key as raw DER
+        self.assertIn(bytes.fromhex(SHA256), data)  # the firmware's digest raw
+
+    def test_unknown_tags_are_skipped(self):
+        data = manifest_tlv.encode(manifest()) + struct.pack("<BH", 0x7F, 3) + b"new"
+        self.assertEqual(manifest_tlv.decode(manifest_tlv.encode(manifest())), manifest_tlv.decode(data))
+
+    def test_truncated_record_is_rejected(self):
+        data = manifest_tlv.encode(manifest())
+        with self.assertRaises(ValueError):
+            manifest_tlv.decode(data[:-1])
+        with self.assertRaises(ValueError):
+            manifest_tlv.decode(b"{}")
+
+    def test_null_round_trip(self):
+        patch = {"base": "0.0.2", "config": {"version": "0.0.3", "mirrors": None, "notify_url": None}}
+        data = manifest_tlv.encode(patch)
+        self.assertIn(struct.pack("<BH", 0x17, 0), data)  # an empty record: removed, unlike an absent one
+        self.assertEqual(patch, {key: value for key, value in manifest_tlv.decode(data).items() if value})
+
+    def test_missing_section_is_rejected(self):
+        doc = manifest()
+        del doc["device"]
+        with self.assertRaises(ValueError):
+            manifest_tlv.encode(doc)
+
+
+if __name__ == "__main__":
+    unittest.main()
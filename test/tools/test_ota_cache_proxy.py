@@ -0,0 +1,171 @@
+"""
+tools/ota_cache_proxy.py against a fake upstream (an in-process HTTP server counting its requests).
+- Run: python3 -m unittest discover -s test/tools
+"""
+import asyncio
+import concurrent.futures
+import hashlib
+import http.server
+import os
+import sys
+import threading
+import time
+import unittest
+import urllib.error
+import urllib.request
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "..", "tools"))
+import ota_cache_proxy  # noqa: E402
+
+
+class FakeUpstream:
+    """The origin: files (path --> body), ETag & If-None-Match, an optional delay & failure mode"""
+
+    def __init__(self):
+        self.files = {}
+        self.requests = []  # (path, If-None-Match)
+        self.delay = 0
+        self.failing = False
+        upstream = self
+
+        class Handler(http.server.BaseHTTPRequestHandler):
+            def do_GET(self):
+                path = self.path.lstrip("/")
+                upstream.requests.append((path, self.headers.get("If-None-Match")))
+                time.sleep(upstream.delay)
+                body = upstream.files.get(path)
+                if upstream.failing or body is None:
+                    self.send_response(500 if upstream.failing else 404)
+                    self.send_header("Content-Length", "0")
+                    self.end_headers()
+                    return
+                etag = '"%s"' % hashlib.sha256(body).hexdigest()[:16]
+                if self.headers.get("If-None-Match") == etag:
+                    self.send_response(304)
+                    self.send_header("ETag", etag)
+                    self.end_headers()
+                    return
+                self.send_response(200)
+                self.send_header("ETag", etag)
+                self.send_header("Content-Length", str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, *args):
+                pass
+
+        self.server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+        self.url = "http://127.0.0.1:%d/" % self.server.server_address[1]
+        threading.Thread(target=self.server.serve_forever, daemon=True).start()
+
+    def requests_of(self, path):
+        return [request for request in self.requests if request[0] == path]
+
+    def close(self):
+        self.server.shutdown()
+        self.server.server_close()
+
+
+def get(url, headers=None):
+    """(status, body, headers) of a GET, the errors included"""
+    request = urllib.request.Request(url, headers=headers or {})
+    try:
+        with urllib.request.urlopen(request, timeout=10) as response:
+            return response.status, response.read(), response.headers
+    except urllib.error.HTTPError as e:
+        return e.code, e.read(), e.headers
+
+
+class CacheProxyTest(unittest.IsolatedAsyncioTestCase):
+    interval = 60
+
+    async def asyncSetUp(self):
+        # the devices' own threads: the proxy's upstream fetches run in the loop's default executor
+        self.devices = concurrent.futures.ThreadPoolExecutor(16)
+        self.upstream = FakeUpstream()
+        self.cache = ota_cache_proxy.Cache(self.upstream.url, self.interval, 64 * 10**6, timeout=5)
+        self.server = await asyncio.start_server(lambda r, w: ota_cache_proxy.handle(r, w, self.cache), "127.0.0.1", 0,
+                                                 limit=ota_cache_proxy.MAX_HEADER_SIZE)
+        self.url = "http://127.0.0.1:%d/" % self.server.sockets[0].getsockname()[1]
+
+    async def asyncTearDown(self):
+        self.server.close()
+        await self.server.wait_closed()
+        await asyncio.to_thread(self.upstream.close)
+        self.devices.shutdown()
+
+    async def get(self, path, headers=None):
+        return await asyncio.get_running_loop().run_in_executor(self.devices, get, self.url + path, headers)
+
+    async def test_signed_image_passes_through_byte_for_byte(self):
+        image = bytes(range(256)) * 64 + os.urandom(100000)  # a signature + firmware, every byte value
+        self.upstream.files["m5stack/firmware.img"] = image
+        status, body, _ = await self.get("m5stack/firmware.img")
+        self.assertEqual(200, status)
+        self.assertEqual(image, body)
+
+    async def test_devices_are_served_from_memory_within_the_interval(self):
+        self.upstream.files["config.img"] = b"v1" * 300
+        for _ in range(5):
+            status, body, _ = await self.get("config.img")
+            self.assertEqual((200, b"v1" * 300), (status, body))
+        self.assertEqual(1, len(self.upstream.requests_of("config.img")))
+        self.assertEqual(4, self.cache.stats.hits)
+
+    async def test_concurrent_misses_make_one_upstream_fetch(self):
+        self.upstream.files["config.img"] = b"config"
+        self.upstream.delay = 0.3
+        results = await asyncio.gather(*(self.get("config.img") for _ in range(10)))
+        self.assertTrue(all(result[:2] == (200, b"config") for result in results))
+        self.assertEqual(1, len(self.upstream.requests_of("config.img")))
+        self.assertEqual(9, self.cache.stats.collapsed)
+
+    async def test_content_addressed_path_is_never_revalidated(self):
+        path = "fw/%s.img" % hashlib.sha256(b"fw").hexdigest()
+        self.upstream.files[path] = b"fw"
+        self.cache.interval = 0
+        for _ in range(3):
+            self.assertEqual(b"fw", (await self.get(path))[1])
+        self.assertEqual(1, len(self.upstream.requests_of(path)))
+
+    async def test_upstream_is_revalidated_once_per_interval(self):
+        self.upstream.files["config.img"] = b"v1"
+        self.cache.interval = 0.2
+        await self.get("config.img")
+        await asyncio.sleep(0.3)
+        self.assertEqual(b"v1", (await self.get("config.img"))[1])  # a conditional GET, answered 304
+        requests = self.upstream.requests_of("config.img")
+        self.assertEqual(2, len(requests))
+        self.assertIsNone(requests[0][1])
+        self.assertIsNotNone(requests[1][1])
+        self.assertEqual(1, self.cache.stats.revalidations)
+
+        self.upstream.files["config.img"] = b"v2"  # published: seen after the next interval
+        self.assertEqual(b"v1", (await self.get("config.img"))[1])
+        await asyncio.sleep(0.3)
+        self.assertEqual(b"v2", (await self.get("config.img"))[1])
+
+    async def test_upstream_error_serves_the_stale_copy(self):
+        self.upstream.files["config.img"] = b"v1"
+        self.cache.interval = 0.1
+        await self.get("config.img")
+        self.upstream.failing = True
+        await asyncio.sleep(0.2)
+        self.assertEqual((200, b"v1"), (await self.get("config.img"))[:2])
+        self.assertEqual(1, self.cache.stats.upstream_errors)
+        self.assertEqual(502, (await self.get("never_fetched.img"))[0])
+
+    async def test_ranges_and_etags_are_served_by_the_proxy(self):
+        self.upstream.files["firmware.img"] = bytes(range(256)) * 8
+        status, body, headers = await self.get("firmware.img", {"Range": "bytes=512-1023"})
+        self.assertEqual(206, status)
+        self.assertEqual((bytes(range(256)) * 8)[512:1024], body)
+        self.assertEqual("bytes 512-1023/2048", headers["Content-Range"])
+        status, _, _ = await self.get("firmware.img", {"If-None-Match": headers["ETag"]})
+        self.assertEqual(304, status)
+        self.assertEqual(416, (await self.get("firmware.img", {"Range": "bytes=4096-"}))[0])
+        self.assertEqual(1, len(self.upstream.requests_of("firmware.img")))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""
+Compare micro-benchmark results (src/bench, one JSON line per benchmark) with a stored baseline.
+
+- Input: the output of the native_bench program or a serial monitor log of devkit-v1-bench (other lines are ignored),
+  or of several runs (one file each): a benchmark is then compared by its best run, and saved as the median of the
+  runs. A slow run (a noisy host) doesn't fail the gate; a regression slows down every run.
+- Baseline: tools/bench_baseline.json by default, keyed by platform then benchmark name: ns_per_op (the median)
+  or memory_bytes (a memory figure, e.g. a parser's peak document size).
+- A benchmark regresses when it is worse (slower / bigger) than baseline * (1 + --tolerance): the exit status is then 1,
+  so the comparison can gate a build. Missing baseline entries are reported, not failed.
+- Record / refresh the baseline of a platform on the reference machine/board: --save
+- Usage: python3 tools/bench_compare.py bench.json [bench2.json ...] [--baseline tools/bench_baseline.json]
+         [--tolerance 0.15] [--save]
+- Build gate: pio run -e native_bench -t bench (tools/pio_bench.py)
+"""
+import argparse
+import json
+import os
+import statistics
+import sys
+
+DEFAULT_BASELINE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "bench_baseline.json")
+METRICS = ("ns_per_op", "memory_bytes")  # both: lower is better
+
+
+def metric_of(result):
+    return next(m for m in METRICS if m in result)
+
+
+def read_results(path):
+    results = {}  # (platform, name) --> result
+    with open(path, errors="replace") as f:
+        for line in f:
+            start = line.find('{"bench"')
+            if start < 0:
+                continue
+            try:
+                result = json.loads(line[start:])
+            except json.JSONDecodeError:
+                continue  # a truncated serial line
+            results[(result.get("platform", "native"), result["bench"])] = result
+    return results
+
+
+def combine_runs(runs, pick):
+    """One result per benchmark of several runs: its metric is pick() of the runs' (min: the best, median)"""
+    results = {}
+    for key in {key for run in runs for key in run}:
+        of_key = [run[key] for run in runs if key in run]
+        metric = metric_of(of_key[0])
+        results[key] = dict(of_key[0], **{metric: pick([result[metric] for result in of_key])})
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("results", nargs="+", help="benchmark output(s) (JSON lines, possibly inside a serial log)")
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE)
+    parser.add_argument("--tolerance", type=float, default=0.15, help="allowed slowdown, fraction of the baseline")
+    parser.add_argument("--save", action="store_true", help="store the results as the baseline of their platform")
+    args = parser.parse_args()
+
+    runs = [read_results(path) for path in args.results]
+    if not any(runs):
+        sys.exit(f"no benchmark results in {' '.join(args.results)}")
+    results = combine_runs([run for run in runs if run], statistics.median if args.save else min)
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    if args.save:
+        for (platform, name), result in results.items():
+            metric = metric_of(result)
+            baseline.setdefault(platform, {})[name] = {metric: result[metric], "bytes": result.get("bytes", 0)}
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print(f"{len(results)} results saved to {args.baseline}")
+        return
+
+    regressions = 0
+    print(f"{'benchmark (ns/op or bytes)':<40} {'baseline':>14} {'now':>14} {'change':>9}")
+    for (platform, name), result in sorted(results.items()):
+        metric = metric_of(result)
+        now = result[metric]
+        base = baseline.get(platform, {}).get(name, {}).get(metric)
+        label = f"{platform}/{name}"
+        if base is None:
+            print(f"{label:<40} {'-':>14} {now:>14.1f} {'new':>9}")
+            continue
+        change = now / base - 1 if base else 0.0
+        regressed = change > args.tolerance
+        regressions += regressed
+        print(f"{label:<40} {base:>14.1f} {now:>14.1f} {change:>+8.1%}" + ("  REGRESSION" if regressed else ""))
+        if metric == "ns_per_op" and result.get("bytes"):
+            print(f"{'':<40} {'':>14} {result['bytes'] * 1e3 / now:>11.2f} MB/s")
+
+    if regressions:
+        sys.exit(f"{regressions} benchmark(s) worse than the baseline by more than {args.tolerance:.0%}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+Config patches: RFC 7386 merge patches of config.json against the older config versions, signed like config.img.
+
+- The devices poll config.img?base=<their config version>; tools/update_server answers with
+  patches/<version>.img when it exists (else the full config.img, as the static hosts do).
+- A patch = the merge patch from the base config.json to the current one + "base": <the base's config version>.
+  The device rejects a patch of another base and fetches the full config.img instead.
+- The device keeps no copy of config.json, so the patch is made self-contained where the device needs it:
+  "config" & "firmware" are always sent whole (small; a device whose firmware update failed retries it from the
+  patch; their removed keys are null: the device drops its mirrors & notify_url), "poll" too when set (a hint
+  missing from an image ends it), "device" and the other members key by key (a removed key is null: the device
+  keeps its value).
+- Every patch is checked: applied to the base (RFC 7386), it must give the current config.json.
+- tools/ota_pack.py keeps the published versions in <out>/history/ & (re)generates the patches of the last
+  --patches versions on every run, older patches are deleted.
+- Usage: python3 tools/config_patch.py old_config.json new_config.json      (print the patch & the sizes)
+         python3 tools/config_patch.py --out publish --config-key config_key.pem [--keep 8] [--format tlv]
+"""
+import argparse
+import copy
+import glob
+import json
+import os
+import sys
+
+import manifest_tlv
+import ota_pack
+
+WHOLE_SECTIONS = ("config", "firmware")
+WHOLE_IF_SET = ("poll",)
+
+
+def merge_patch(target, patch):
+    """RFC 7386: apply `patch` to `target`, return the result."""
+    if not isinstance(patch, dict):
+        return copy.deepcopy(patch)
+    result = copy.deepcopy(target) if isinstance(target, dict) else {}
+    for key, value in patch.items():
+        if value is None:
+            result.pop(key, None)
+        else:
+            result[key] = merge_patch(result.get(key), value)
+    return result
+
+
+def diff(old, new):
+    """The RFC 7386 merge patch turning `old` into `new` (objects)."""
+    patch = {}
+    for key in old.keys() - new.keys():
+        patch[key] = None
+    for key, value in new.items():
+        if key not in old:
+            patch[key] = value
+        elif isinstance(value, dict) and isinstance(old[key], dict):
+            sub = diff(old[key], value)
+            if sub:
+                patch[key] = sub
+        elif value != old[key]:
+            patch[key] = value
+    return patch
+
+
+def version_key(manifest):
+    version = manifest["config"]["version"].split("-")[0].split("+")[0]
+    return tuple(int(n) if n.isdigit() else 0 for n in version.split("."))
+
+
+def make_patch(old, new):
+    """The device patch from the config.json `old` to `new` (see the rules above)."""
+    patch = diff(old, new)
+    for section in WHOLE_SECTIONS + WHOLE_IF_SET:
+        if section not in new:
+            continue
+        patch[section] = copy.deepcopy(new[section])
+        if isinstance(old.get(section), dict):  # merged into the base: its removed keys are null
+            patch[section].update((key, None) for key in old[section].keys() - new[section].keys())
+    if merge_patch(old, patch) != new:
+        raise ValueError(f"the patch from {old['config']['version']} doesn't give {new['config']['version']}")
+    patch["base"] = old["config"]["version"]
+    return patch
+
+
+def encode(manifest, fmt):
+    if fmt == "tlv":
+        return manifest_tlv.encode(manifest)
+    return json.dumps(manifest, separators=(",", ":")).encode()
+
+
+def publish_patches(out_dir, manifest, key_path, fmt="json", keep=8):
+    """Save `manifest` (the published config.json) in the history, write the signed patches of the last `keep`
+    versions against it, delete the others. Return [(base version, patch size, full size)]."""
+    history_dir = os.path.join(out_dir, "history")
+    version = manifest["config"]["version"]
+    ota_pack.publish(out_dir, f"history/{version}.json", json.dumps(manifest, separators=(",", ":")).encode())
+
+    history = []
+    for path in glob.glob(os.path.join(history_dir, "*.json")):
+        with open(path) as f:
+            history.append(json.load(f))
+    history.sort(key=version_key)
+    bases = [old for old in history if old["config"]["version"] != version][-keep:] if keep > 0 else []
+
+    full_size = len(encode(manifest, fmt))
+    written, sizes = set(), []
+    for old in bases:
+        try:
+            patch = make_patch(old, manifest)
+        except (ValueError, KeyError) as e:
+            print(f"no patch from {old.get('config', {}).get('version')}: {e}", file=sys.stderr)
+            continue
+        content = encode(patch, fmt)
+        if len(content) >= full_size:
+            continue  # not worth it: the device gets the full image
+        rel_path = f"patches/{patch['base']}.img"
+        ota_pack.publish(out_dir, rel_path, ota_pack.sign(content, key_path) + content)
+        written.add(os.path.join(out_dir, rel_path))
+        sizes.append((patch["base"], len(content), full_size))
+
+    for path in glob.glob(os.path.join(out_dir, "patches", "*.img")):
+        if path not in written:  # a patch to an older version
+            os.remove(path)
+    return sizes
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("old", nargs="?", help="the base config.json")
+    parser.add_argument("new", nargs="?", help="the current config.json")
+    parser.add_argument("--out", help="the published root directory (its config.json & history/)")
+    parser.add_argument("--config-key", help="private key (PEM) signing the patches")
+    parser.add_argument("--keep", type=int, default=8, help="patches from the last N versions")
+    parser.add_argument("--format", choices=("json", "tlv"), default="json")
+    args = parser.parse_args()
+
+    if args.old and args.new:
+        with open(args.old) as f:
+            old = json.load(f)
+        with open(args.new) as f:
+            new = json.load(f)
+        try:
+            patch = make_patch(old, new)
+        except (ValueError, KeyError) as e:
+            sys.exit(str(e))
+        print(json.dumps(patch, indent=2))
+        print(f"patch: {len(encode(patch, args.format))} bytes, full: {len(encode(new, args.format))} bytes ({args.format})",
+              file=sys.stderr)
+        return
+    if not (args.out and args.config_key):
+        parser.error("old & new config.json, or --out and --config-key")
+
+    with open(os.path.join(args.out, "config.json")) as f:
+        manifest = json.load(f)
+    for base, size, full in publish_patches(args.out, manifest, args.config_key, args.format, args.keep):
+        print(f"patches/{base}.img: {size} bytes (full: {full})")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,442 @@
+#!/usr/bin/env python3
+"""
+Fleet load generator: thousands of virtual OTA devices polling an update server (e.g. tools/update_server).
+
+- Each virtual device runs the request sequence of Config::check_update():
+  GET config.img --> split the signature (512 bytes) & config.json (a binary manifest, a catalog entry) --> compare the "config" & "firmware" semvers
+  with its own --> apply "device.checking_interval" --> GET firmware.img when the firmware version is newer.
+  (no RSA verification: it only models the load on the backend)
+- Realistic polling: the devices start at random phases, each poll is delayed by checking_interval +/- jitter.
+- Link speed: each device reads its bodies at a random rate in [--min-kbps, --max-kbps].
+- Failure injection: --fail-rate drops a request (connection closed) before or in the middle of a body.
+- Scheduled releases ("firmware"."activate_at", Config::stage_firmware()): a device downloads the firmware at its
+  random slot of the "stage_window" before the activation time ("staged"), and "reboots" into it at that moment
+  (its activation timer), without a download on the critical path.
+- Server-directed polling (Config::next_poll_s()): a 429/503 with "Retry-After: <seconds>" delays the next poll by
+  that much + up to 10%; a new config.img's "poll" hint {"interval", "ttl"} replaces checking_interval for its TTL
+  (default 1 h), its first interval a random part of it. Both within [5 s, 24 h]. E.g. tools/update_server's max_polls_per_s, tools/ota_pack.py --poll-hint.
+- Push channel (src/utils/notifier.h): with --notify <URL of tools/ota_notifier.py> each device also long-polls the
+  notifier, checks config.img as soon as it's notified, and polls every 15 min only while the channel is up.
+  The discovery latency (the device saw --target-version, from the first device seeing it) compares it with polling.
+- Report: request rate, bytes served, the response latency (connect --> response head, p50/p99: the server's part,
+  before the simulated link paces the body), the peak server load (bytes per second, concurrent firmware downloads), time
+  to fleet convergence on --target-version, and the histogram of the per-device update latency (from the first
+  device seeing the new firmware version to this device updated).
+- Only plain HTTP (a LAN server), one connection per request like the device's HTTPClient.
+- --native <program of env:native>: each virtual device is that program in its main loop (OTA_WATCH_S) on its own
+  emulated NVS & flash: the real Config::check_update(), signature checks, flash writes & reboots (the program started
+  again when it exits). Link speed & failures by lib/native_hal (OTA_LINK_KBPS, OTA_LINK_FAIL_RATE), the public key of
+  the publication by --trust-key; the interval, the poll hints & the push channel are the manifest's. The request &
+  byte counts are the programs' own (at their exit), the live report counts checks. A process per device: a few
+  hundred per host core.
+  --lan: the devices are a LAN (each its own loopback address, OTA_LOCAL_IP): they announce & serve their firmware to
+  each other (src/utils/lan_peers.h) and fetch it from their peers first; the report splits the bytes into the
+  origin's egress & the peers'.
+- Usage: python3 tools/fleet_loadgen.py http://127.0.0.1:8080/config.img --devices 5000 --duration 600 --target-version 0.0.6
+         python3 tools/fleet_loadgen.py http://127.0.0.1:8080/config.img --native .pio/build/native/program --trust-key key.pub --devices 200 ...
+"""
+import argparse
+import asyncio
+import json
+import os
+import random
+import re
+import tempfile
+import time
+from urllib.parse import urlsplit
+
+import manifest_tlv
+import ota_catalog
+
+SIGN_LEN = 512
+CHUNK = 4096
+MIN_POLL_INTERVAL, MAX_POLL_INTERVAL = 5, 24 * 3600  # seconds, the bounds of Config::next_poll_s()
+DEFAULT_POLL_HINT_TTL = 3600
+NOTIFY_HOLD, BACKSTOP_POLL = 50, 15 * 60  # seconds, Notifier::hold_s & backstop_poll_s
+NOTIFY_GAP, NOTIFY_MIN_RETRY, NOTIFY_MAX_RETRY = 5, 5, 300
+NOTIFY_RECHECKS, NOTIFY_RECHECK_WAIT = 3, 15  # Notifier::max_rechecks & recheck_wait_ms
+
+
+class Stats:
+    def __init__(self):
+        self.requests = 0
+        self.failed = 0
+        self.bytes = 0
+        self.status = {}
+        self.first_seen = None  # the first time a device saw the target firmware version
+        self.updated_at = {}  # device id --> time of its firmware update
+        self.staged = set()  # device ids with the target firmware staged, waiting for its activation
+        self.bytes_per_second = {}  # second since the start --> bytes served
+        self.downloads = 0  # firmware downloads in progress
+        self.peak_downloads = 0
+        self.retry_afters = 0  # polls answered with a Retry-After
+        self.hinted = set()  # device ids polling at a "poll" hint's interval
+        self.long_polls = 0  # requests to the notifier (among the requests)
+        self.pushed = set()  # device ids with the push channel up
+        self.seen_at = {}  # device id --> the time it saw the target firmware version
+        self.checks = 0  # check_update() calls of the --native devices
+        self.peer_bytes = 0  # --lan: served by the devices to their peers
+        self.latencies = []  # seconds from the connect to the response head (not of the held long-polls)
+        self.start = time.monotonic()
+
+    def served(self, length):
+        self.bytes += length
+        second = int(time.monotonic() - self.start)
+        self.bytes_per_second[second] = self.bytes_per_second.get(second, 0) + length
+
+
+def parse_semver(version):
+    match = re.match(r"^v?(\d+)\.(\d+)\.(\d+)(?:-([0-9A-Za-z.-]+))?", version or "")
+    if not match:
+        return None
+    major, minor, patch, prerelease = match.groups()
+    # a release is newer than its prereleases
+    return (int(major), int(minor), int(patch), (1,) if prerelease is None else (0, prerelease))
+
+
+def is_newer(current, candidate):
+    current, candidate = parse_semver(current), parse_semver(candidate)
+    return current is not None and candidate is not None and candidate > current
+
+
+async def http_get(url, kbps, args, stats, timeout=None):
+    """GET the url at a link speed of `kbps` kB/s, return (status, body, Retry-After seconds or 0) or None on a
+    (injected) failure. `timeout`: of the response (a held long-poll), args.timeout by default"""
+    parts = urlsplit(url)
+    stats.requests += 1
+    if random.random() < args.fail_rate / 2:
+        stats.failed += 1
+        return None  # injected: connection failure
+
+    start = time.monotonic()
+    try:
+        reader, writer = await asyncio.wait_for(asyncio.open_connection(parts.hostname, parts.port or 80), args.timeout)
+    except (OSError, asyncio.TimeoutError):
+        stats.failed += 1
+        return None
+    try:
+        path = parts.path + ("?" + parts.query if parts.query else "")
+        writer.write(f"GET {path} HTTP/1.1\r\nHost: {parts.netloc}\r\nCache-Control: no-cache, max-age=5\r\nConnection: close\r\n\r\n".encode())
+        await writer.drain()
+        head = await asyncio.wait_for(reader.readuntil(b"\r\n\r\n"), timeout or args.timeout)
+        status = int(head.split(b" ", 2)[1])
+        if timeout is None:
+            stats.latencies.append(time.monotonic() - start)
+        stats.status[status] = stats.status.get(status, 0) + 1
+        length_match = re.search(rb"(?i)content-length:\s*(\d+)", head)
+        length = int(length_match.group(1)) if length_match else 0
+        retry_match = re.search(rb"(?i)retry-after:\s*(\d+)\r\n", head)  # delta-seconds only, like the device
+        retry_after = int(retry_match.group(1)) if retry_match and status in (429, 503) else 0
+        drop_at = random.randrange(length) if length and random.random() < args.fail_rate / 2 else None
+
+        body = bytearray()
+        while len(body) < length:
+            chunk = await asyncio.wait_for(reader.read(min(CHUNK, length - len(body))), args.timeout)
+            if not chunk:
+                break
+            body += chunk
+            stats.served(len(chunk))
+            if drop_at is not None and len(body) >= drop_at:
+                stats.failed += 1
+                return None  # injected: connection dropped in the middle of the body
+            await asyncio.sleep(len(chunk) / (kbps * 1024))
+        if len(body) < length:
+            stats.failed += 1
+            return None
+        return status, bytes(body), retry_after
+    except (OSError, ValueError, IndexError, asyncio.TimeoutError, asyncio.IncompleteReadError, asyncio.LimitOverrunError):
+        stats.failed += 1
+        return None
+    finally:
+        writer.close()
+
+
+async def listen(device_id, args, stats, channel, wake, deadline):
+    """The long-polls of a device to the notifier (Notifier::run())"""
+    retry = NOTIFY_MIN_RETRY
+    signaled = 0
+
+    def signal():
+        nonlocal signaled
+        signaled = time.monotonic()
+        wake.set()
+
+    while time.monotonic() < deadline:
+        stats.long_polls += 1
+        response = await http_get(f"{args.notify}?v={channel['known']}&wait={NOTIFY_HOLD}", 1000, args, stats, NOTIFY_HOLD + 10)
+        if response is not None and response[0] in (200, 204):
+            channel["up"], retry = True, NOTIFY_MIN_RETRY
+            stats.pushed.add(device_id)
+            if response[0] == 200 and response[1].strip():
+                channel["known"] = response[1].strip().decode()
+                for _ in range(NOTIFY_RECHECKS + 1):  # again while not applied (a stale config.img)
+                    await asyncio.sleep(max(0.0, signaled + NOTIFY_GAP - time.monotonic()))
+                    signal()
+                    applied = channel["applied"]
+                    for _ in range(int(NOTIFY_RECHECK_WAIT * 10)):
+                        if channel["applied"] != applied:
+                            break
+                        await asyncio.sleep(0.1)
+                    if channel["applied"] == channel["known"]:
+                        break
+            continue
+        if channel["up"]:
+            channel["up"] = False  # back to polling, at once (a notification may have been missed)
+            stats.pushed.discard(device_id)
+            await asyncio.sleep(max(0.0, signaled + NOTIFY_GAP - time.monotonic()))
+            signal()
+        await asyncio.sleep(retry)
+        retry = min(retry * 2, NOTIFY_MAX_RETRY)
+
+
+async def device(device_id, args, stats, deadline):
+    config_url = args.url
+    config_version = args.config_version
+    firmware_version = args.firmware_version
+    staged, activate_at = None, 0  # a downloaded & "verified" firmware waiting for its activation time
+    interval = args.interval
+    hint_interval, hint_until, hint_phase = 0, 0, 0  # a "poll" hint, its first interval: a random part of it
+    last_content = None
+    kbps = random.uniform(args.min_kbps, args.max_kbps)
+    channel = {"up": False, "known": config_version, "applied": config_version}  # the push channel: up, the newest version known
+    wake = asyncio.Event()
+    if args.notify:
+        asyncio.ensure_future(listen(device_id, args, stats, channel, wake, deadline))
+
+    await asyncio.sleep(random.uniform(0, interval))  # random polling phase
+    while time.monotonic() < deadline:
+        response = await http_get(config_url, kbps, args, stats)
+        retry_after = response[2] if response is not None else 0
+        if response is not None and response[0] == 200 and len(response[1]) > SIGN_LEN:
+            try:
+                content = response[1][SIGN_LEN:]
+                if content.startswith(ota_catalog.MAGIC):
+                    content = ota_catalog.find_entry(content, args.device_type) or b""
+                doc = manifest_tlv.decode(content) if content.startswith(manifest_tlv.MAGIC) else json.loads(content)
+                config, firmware = doc["config"], doc["firmware"]
+            except (ValueError, KeyError, TypeError):
+                config = firmware = None
+            if config is not None and content != last_content:  # a new image: its hint (or none) from now on
+                last_content = content
+                poll = doc.get("poll") or {}
+                hint_interval = min(max(poll.get("interval") or 0, MIN_POLL_INTERVAL), MAX_POLL_INTERVAL) if poll.get("interval") else 0
+                hint_until = time.monotonic() + min(poll.get("ttl") or DEFAULT_POLL_HINT_TTL, MAX_POLL_INTERVAL)
+                hint_phase = random.uniform(1, hint_interval) if hint_interval else 0
+            if config is not None:
+                if is_newer(config_version, config.get("version")):
+                    config_version = config["version"]
+                    if config.get("url_change?") and config.get("url"):
+                        config_url = config["url"]
+                    interval = doc.get("device", {}).get("checking_interval") or interval
+                    channel["known"] = channel["applied"] = config_version
+
+                target = firmware.get("version")
+                if target == args.target_version:
+                    stats.first_seen = stats.first_seen or time.monotonic()
+                    stats.seen_at.setdefault(device_id, time.monotonic())
+                if staged is not None and staged != target:
+                    staged = None  # withdrawn or superseded
+                    stats.staged.discard(device_id)
+                if is_newer(firmware_version, target) and staged is None:
+                    activate_at = firmware.get("activate_at") or 0
+                    window = min(firmware.get("stage_window") or 0, activate_at)
+                    slot = random.Random(f"{device_id}/{target}").uniform(0, window)  # stable per device & version
+                    if time.time() >= activate_at - window + slot:
+                        stats.downloads += 1
+                        stats.peak_downloads = max(stats.peak_downloads, stats.downloads)
+                        fw = await http_get(firmware.get("url"), kbps, args, stats)
+                        stats.downloads -= 1
+                        if fw is not None and fw[0] == 200 and len(fw[1]) > SIGN_LEN:
+                            staged = target  # "flashed & verified" into the next OTA partition
+                            stats.staged.add(device_id)
+
+        if staged is not None and time.time() >= activate_at:
+            firmware_version, staged = staged, None  # "rebooted" into it
+            stats.staged.discard(device_id)
+            if firmware_version == args.target_version:
+                stats.updated_at[device_id] = time.monotonic()
+        hinted = hint_interval > 0 and time.monotonic() < hint_until
+        (stats.hinted.add if hinted else stats.hinted.discard)(device_id)
+        if retry_after > 0:
+            stats.retry_afters += 1
+            delay = min(max(retry_after * random.uniform(1, 1.1), MIN_POLL_INTERVAL), MAX_POLL_INTERVAL)
+        else:
+            delay = max(0.1, (hint_interval if hinted else interval) * random.uniform(1 - args.jitter, 1 + args.jitter))
+            if hinted and hint_phase:
+                delay, hint_phase = hint_phase, 0
+        if channel["up"]:
+            delay = max(delay, BACKSTOP_POLL)
+        if staged is not None:
+            delay = min(delay, max(0.0, activate_at - time.time()))  # the activation timer
+        delay = min(delay, max(0.0, deadline - time.monotonic()))
+        try:
+            await asyncio.wait_for(wake.wait(), delay)  # or notified (maybe during the poll)
+        except asyncio.TimeoutError:
+            pass
+        wake.clear()
+
+
+NATIVE_BOOT = re.compile(r"^Config version: (\S+), firmware version: (\S+), running partition")
+NATIVE_CHECK = re.compile(r"^\[[\d.]+\] check_update \((?:poll|push)\): (.+), config \S+, next poll in")
+NATIVE_FOUND = re.compile(r"Found a newer firmware version: (\S+)")
+NATIVE_STAGED = re.compile(r"Firmware (\S+) staged")
+NATIVE_TOTALS = [  # the program's stats at exit --> Stats attributes
+    (re.compile(r"^http: (\d+) requests"), "requests"),
+    (re.compile(r"^link: (\d+) bytes received"), "bytes"),
+    (re.compile(r"^polling: (\d+) Retry-After"), "retry_afters"),
+    (re.compile(r"^notifier: (\d+) long-polls"), "long_polls"),
+    (re.compile(r"^lan peers: (\d+) bytes served"), "peer_bytes"),
+]
+
+
+async def native_device(device_id, args, stats, deadline):
+    """A device of --native: the native program in its main loop, "rebooted" (started again) whenever it exits"""
+    state_dir = os.path.join(args.state_dir, f"device_{device_id}")
+    os.makedirs(state_dir, exist_ok=True)
+    env = dict(os.environ, OTA_STATE_DIR=state_dir, OTA_LINK_KBPS=f"{random.uniform(args.min_kbps, args.max_kbps):.1f}",
+               OTA_LINK_FAIL_RATE=str(args.fail_rate))
+    if args.trust_key:
+        env["OTA_TRUST_KEY"] = args.trust_key
+    if args.lan:  # 127.1.0.1, 127.1.0.2 ... (127.0.0.1: the server), each serving its firmware on its own port
+        env.update(OTA_LOCAL_IP=f"127.1.{device_id // 250}.{device_id % 250 + 1}", OTA_LAN_PORT=str(20000 + device_id))
+    command = [args.native, args.url]  # the first boot stores the config URL
+    booted = None  # the firmware version of the previous boot
+    downloading = False
+
+    await asyncio.sleep(random.uniform(0, args.interval))  # random boot phase
+    while deadline - time.monotonic() >= 1:
+        env["OTA_WATCH_S"] = str(int(deadline - time.monotonic()))
+        process = await asyncio.create_subprocess_exec(*command, env=env, stdout=asyncio.subprocess.PIPE,
+                                                       stderr=asyncio.subprocess.DEVNULL)
+        command = [args.native]
+        async for raw in process.stdout:
+            line = raw.decode(errors="replace")
+            if match := NATIVE_BOOT.match(line):
+                firmware_version = match.group(2)
+                if booted is not None and firmware_version != booted and firmware_version == args.target_version:
+                    stats.updated_at[device_id] = time.monotonic()
+                booted = firmware_version
+                stats.staged.discard(device_id)
+            elif match := NATIVE_CHECK.match(line):
+                stats.checks += 1
+                stats.failed += match.group(1) != "No Error"
+            elif (match := NATIVE_FOUND.search(line)) and match.group(1) == args.target_version:
+                stats.first_seen = stats.first_seen or time.monotonic()
+                stats.seen_at.setdefault(device_id, time.monotonic())
+            elif "Writting a newer firmware version" in line:
+                downloading = True
+                stats.downloads += 1
+                stats.peak_downloads = max(stats.peak_downloads, stats.downloads)
+            elif downloading and ("Written" in line or "HTTP Error" in line):
+                downloading = False
+                stats.downloads -= 1
+            elif match := NATIVE_STAGED.search(line):
+                stats.staged.add(device_id)
+            else:
+                for pattern, attribute in NATIVE_TOTALS:
+                    if match := pattern.match(line):
+                        setattr(stats, attribute, getattr(stats, attribute) + int(match.group(1)))
+        await process.wait()
+        if downloading:
+            downloading = False
+            stats.downloads -= 1
+
+
+def histogram(values, buckets=10):
+    if not values:
+        return "  (no device updated)"
+    low, high = min(values), max(values)
+    width = (high - low) / buckets or 1
+    counts = [0] * buckets
+    for value in values:
+        counts[min(int((value - low) / width), buckets - 1)] += 1
+    peak = max(counts)
+    return "\n".join(f"  {low + i * width:8.1f}s - {low + (i + 1) * width:8.1f}s | {'#' * (40 * n // peak):40} {n}"
+                     for i, n in enumerate(counts))
+
+
+async def report(args, stats, deadline):
+    last_requests, last_time = 0, time.monotonic()
+    while time.monotonic() < deadline:
+        await asyncio.sleep(min(args.report_every, deadline - time.monotonic()))
+        now = time.monotonic()
+        requests = stats.checks if args.native else stats.requests
+        if args.native:
+            print(f"[{now - stats.start:7.1f}s] {(requests - last_requests) / (now - last_time):8.1f} checks/s, "
+                  f"{stats.failed} failed, {stats.downloads:5} downloading, {len(stats.staged)} staged, "
+                  f"{len(stats.updated_at)}/{args.devices} updated", flush=True)
+        else:
+            print(f"[{now - stats.start:7.1f}s] {(requests - last_requests) / (now - last_time):8.1f} req/s, "
+                  f"{stats.bytes / 1e6:10.2f} MB served, {stats.downloads:5} downloading, {len(stats.staged)} staged, "
+                  f"{len(stats.hinted)} on a poll hint, {stats.retry_afters} Retry-After, "
+                  + (f"{len(stats.pushed)} pushed, " if args.notify else "") +
+                  f"{len(stats.updated_at)}/{args.devices} updated", flush=True)
+        last_requests, last_time = requests, now
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("url", help="the config.img URL (plain http)")
+    parser.add_argument("--devices", type=int, default=1000)
+    parser.add_argument("--duration", type=float, default=300, help="seconds")
+    parser.add_argument("--interval", type=float, default=5, help="default checking_interval (seconds)")
+    parser.add_argument("--jitter", type=float, default=0.1, help="+/- fraction of the polling interval")
+    parser.add_argument("--min-kbps", type=float, default=20, help="slowest link (kB/s)")
+    parser.add_argument("--max-kbps", type=float, default=200, help="fastest link (kB/s)")
+    parser.add_argument("--fail-rate", type=float, default=0.01, help="fraction of the requests failed on purpose")
+    parser.add_argument("--timeout", type=float, default=30)
+    parser.add_argument("--config-version", default="0.0.1", help="the devices' initial config version")
+    parser.add_argument("--firmware-version", default="0.0.5", help="the devices' initial firmware version")
+    parser.add_argument("--target-version", help="the firmware version to converge on")
+    parser.add_argument("--device-type", default="ch4_generator", help="the devices' entry in a catalog.img")
+    parser.add_argument("--report-every", type=float, default=10)
+    parser.add_argument("--notify", help="the long-poll URL of tools/ota_notifier.py (the push channel)")
+    parser.add_argument("--native", help="the native program (env:native): devices running the real OTA core")
+    parser.add_argument("--trust-key", help="--native: the publication's public key (PEM), provisioned on each device")
+    parser.add_argument("--state-dir", help="--native: the devices' NVS & flash (a temporary directory by default)")
+    parser.add_argument("--lan", action="store_true", help="--native: the devices share their firmware on a simulated LAN")
+    args = parser.parse_args()
+    if args.native:
+        args.native = os.path.abspath(args.native)
+        args.state_dir = args.state_dir or tempfile.mkdtemp(prefix="fleet_loadgen.")
+
+    stats = Stats()
+    deadline = stats.start + args.duration
+    run = native_device if args.native else device
+    await asyncio.gather(report(args, stats, deadline), *(run(i, args, stats, deadline) for i in range(args.devices)))
+
+    elapsed = time.monotonic() - stats.start
+    if args.native:
+        print(f"\n{stats.requests} requests in {elapsed:.1f}s: {stats.requests / elapsed:.1f} req/s, "
+              f"{stats.checks} checks, {stats.failed} failed (device state: {args.state_dir})")
+    else:
+        print(f"\n{stats.requests} requests in {elapsed:.1f}s: {stats.requests / elapsed:.1f} req/s, {stats.failed} failed, status: {stats.status}")
+    if args.notify or (args.native and stats.long_polls):
+        polls = stats.requests - stats.long_polls
+        print(f"  {polls} config/firmware requests ({polls / elapsed:.1f} req/s), {stats.long_polls} long-polls ({stats.long_polls / elapsed:.1f} req/s)")
+    if stats.latencies:
+        latencies = sorted(stats.latencies)
+        print(f"response latency ({len(latencies)} requests, connect --> head): p50 {latencies[len(latencies) // 2] * 1000:.1f} ms, "
+              f"p99 {latencies[int(len(latencies) * 0.99)] * 1000:.1f} ms, max {latencies[-1] * 1000:.1f} ms")
+    print(f"{stats.bytes / 1e6:.2f} MB served ({stats.bytes / elapsed / 1e6:.2f} MB/s)")
+    if args.lan:
+        print(f"  origin egress {(stats.bytes - stats.peer_bytes) / 1e6:.2f} MB, LAN peers {stats.peer_bytes / 1e6:.2f} MB")
+    print((f"peak load: {max(stats.bytes_per_second.values(), default=0) / 1e6:.2f} MB/s (1 s), " if not args.native else "peak load: ") +
+          f"{stats.peak_downloads} concurrent firmware downloads")
+    if args.target_version:
+        discovery = sorted(t - stats.first_seen for t in stats.seen_at.values())
+        if discovery:
+            print(f"discovery latency ({len(discovery)} devices saw {args.target_version}): p50 {discovery[len(discovery) // 2]:.2f}s, "
+                  f"p99 {discovery[int(len(discovery) * 0.99)]:.2f}s, max {discovery[-1]:.2f}s "
+                  f"(from the first one, at {time.time() - (time.monotonic() - stats.first_seen):.3f})")
+        latencies = sorted(t - stats.first_seen for t in stats.updated_at.values()) if stats.first_seen else []
+        converged = len(latencies) == args.devices
+        print(f"{len(latencies)}/{args.devices} devices on {args.target_version}" +
+              (f", fleet converged in {latencies[-1]:.1f}s" if converged else ", fleet not converged"))
+        if latencies:
+            print(f"update latency: p50 {latencies[len(latencies) // 2]:.1f}s, p99 {latencies[int(len(latencies) * 0.99)]:.1f}s")
+        print(histogram(latencies))
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
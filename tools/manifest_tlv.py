@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+"""
+Converter: config.json <--> the binary (TLV) manifest, the compact alternative to config.json inside config.img.
+
+- The devices tell the formats apart by the first bytes of the signed content: "OTM\\x01" --> binary, else JSON,
+  so both work with the same config URL (see Manifest::parse).
+- Layout: the magic, then records: tag (1 byte), length (2 bytes, little-endian), value. Read in place by the device
+  (no allocation, no copy): the strings are null-terminated inside their value, the numbers little-endian.
+  Unknown tags are skipped (older devices ignore the newer fields).
+- The inline public keys ("public_key": {"id", "der"}) are carried as raw DER (no base64).
+- "mirrors" (a list of URLs): one record per mirror, with the same tag.
+- The firmware's "sha256" is carried raw (32 bytes, no hex).
+- The config's "mirrors" & "notify_url" set to null (or []) in a patch: an empty record (the device drops them; absent,
+  it keeps them).
+- Usage: python3 tools/manifest_tlv.py config.json config.bin      (then sign config.bin like config.json)
+         python3 tools/manifest_tlv.py --decode config.bin          (print it back as JSON)
+         python3 tools/manifest_tlv.py --c-array config.json        (a C array, e.g. for src/bench/bench_vectors.h)
+"""
+import argparse
+import base64
+import json
+import struct
+import sys
+
+MAGIC = b"OTM\x01"
+
+# tag --> (section, field, type), the tags of Manifest::parse_tlv() in src/configOTASecure.cpp
+TAGS = {
+    0x01: (None, "type", "str"),
+    0x02: (None, "base", "str"),  # a config patch (tools/config_patch.py)
+    0x10: ("config", "version", "str"),
+    0x11: ("config", "url", "str"),
+    0x12: ("config", "url_change?", "bool"),
+    0x13: ("config", "public_key_change?", "bool"),
+    0x14: ("config", "public_key_url", "str"),
+    0x15: ("config", "public_key.id", "str"),
+    0x16: ("config", "public_key.der", "der"),
+    0x17: ("config", "mirrors", "strs"),  # one record per mirror
+    0x18: ("config", "notify_url", "str"),  # the push channel (tools/ota_notifier.py)
+    0x20: ("firmware", "version", "str"),
+    0x21: ("firmware", "url", "str"),
+    0x22: ("firmware", "url_change?", "bool"),
+    0x23: ("firmware", "public_key_change?", "bool"),
+    0x24: ("firmware", "public_key_url", "str"),
+    0x25: ("firmware", "public_key.id", "str"),
+    0x26: ("firmware", "public_key.der", "der"),
+    0x27: ("firmware", "mirrors", "strs"),
+    0x29: ("firmware", "sha256", "hex"),  # of firmware.bin: the devices reject any other image (raw 32 bytes)
+    0x2A: ("firmware", "size", "u32"),
+    0x30: ("device", "ch4_factor", "f32"),
+    0x31: ("device", "power_factor", "f32"),
+    0x32: ("device", "checking_interval", "i32"),
+    0x40: ("multicast", None, "none"),  # present: the firmware is (also) multicast
+    0x41: ("multicast", "group", "str"),
+    0x42: ("multicast", "port", "u16"),
+    0x43: ("multicast", "timeout", "u32"),
+    0x50: ("budget", "rate", "u32"),  # the background download's pace (firmware.budget)
+    0x51: ("budget", "slice", "u16"),
+    0x52: ("budget", "pause", "u16"),
+    0x60: ("firmware", "activate_at", "u32"),  # a scheduled release: staged ahead, booted at that Unix time
+    0x61: ("firmware", "stage_window", "u32"),
+    0x70: ("poll", "interval", "u32"),  # a next-poll hint: the polling interval for "ttl" seconds
+    0x71: ("poll", "ttl", "u32"),
+}
+FIRMWARE_OBJECTS = ("multicast", "budget")  # the sections nested in "firmware"
+NULLABLE = {0x17, 0x18}  # null (removed by a patch, RFC 7386) --> an empty record
+MISSING = object()
+
+
+def section_of(manifest, section):
+    if section is None:
+        return manifest
+    if section in FIRMWARE_OBJECTS:
+        return manifest.get("firmware", {}).get(section)
+    return manifest.get(section)
+
+
+def get_field(obj, field):
+    for name in field.split("."):
+        if not isinstance(obj, dict) or name not in obj:
+            return MISSING
+        obj = obj[name]
+    return obj
+
+
+def encode_value(kind, value):
+    if kind == "str":
+        return str(value).encode() + b"\0"
+    if kind == "bool":
+        return struct.pack("<B", bool(value))
+    if kind == "der":
+        return base64.b64decode(value)
+    if kind == "hex":
+        return bytes.fromhex(value)
+    if kind == "f32":
+        return struct.pack("<f", value)
+    if kind == "i32":
+        return struct.pack("<i", value)
+    if kind == "u16":
+        return struct.pack("<H", value)
+    if kind == "u32":
+        return struct.pack("<I", value)
+    return b""
+
+
+def encode(manifest):
+    """The binary manifest of a config.json document (dict)."""
+    for section in ("config",) if "base" in manifest else ("config", "device", "firmware"):
+        if not isinstance(manifest.get(section), dict):
+            raise ValueError(f'config.json: no "{section}" object')
+    out = bytearray(MAGIC)
+    for tag, (section, field, kind) in TAGS.items():
+        obj = section_of(manifest, section)
+        if obj is None:
+            continue
+        value = obj if field is None else get_field(obj, field)
+        if tag in NULLABLE and value in (None, []):
+            out += struct.pack("<BH", tag, 0)
+            continue
+        if value is MISSING or value is None:
+            continue
+        for item in value if kind == "strs" else [value]:
+            data = encode_value("str" if kind == "strs" else kind, item)
+            if len(data) > 0xFFFF:
+                raise ValueError(f"{section}.{field}: {len(data)} bytes, > 65535")
+            out += struct.pack("<BH", tag, len(data)) + data
+    return bytes(out)
+
+
+def decode(data):
+    """The config.json document (dict) of a binary manifest."""
+    if not data.startswith(MAGIC):
+        raise ValueError("not a binary manifest")
+    manifest = {"config": {}, "device": {}, "firmware": {}}
+    pos = len(MAGIC)
+    while pos < len(data):
+        if pos + 3 > len(data):
+            raise ValueError(f"truncated record at {pos}")
+        tag, length = struct.unpack_from("<BH", data, pos)
+        value = data[pos + 3:pos + 3 + length]
+        if len(value) != length:
+            raise ValueError(f"truncated record at {pos}")
+        pos += 3 + length
+        if tag not in TAGS:
+            continue
+        section, field, kind = TAGS[tag]
+        if section in FIRMWARE_OBJECTS:
+            obj = manifest["firmware"].setdefault(section, {})
+        else:
+            obj = manifest if section is None else manifest.setdefault(section, {})
+        if field is None:
+            continue
+        if tag in NULLABLE and length == 0:
+            obj[field] = None
+            continue
+        if kind == "strs":
+            obj.setdefault(field, []).append(value.rstrip(b"\0").decode())
+            continue
+        if kind == "str":
+            parsed = value.rstrip(b"\0").decode()
+        elif kind == "bool":
+            parsed = bool(value[0])
+        elif kind == "der":
+            parsed = base64.b64encode(value).decode()
+        elif kind == "hex":
+            parsed = value.hex()
+        else:
+            parsed = struct.unpack("<" + {"f32": "f", "i32": "i", "u16": "H", "u32": "I"}[kind], value)[0]
+        *parents, name = field.split(".")
+        for parent in parents:
+            obj = obj.setdefault(parent, {})
+        obj[name] = parsed
+    return manifest
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="config.json (or a binary manifest with --decode)")
+    parser.add_argument("output", nargs="?", help="default: stdout")
+    group = parser.add_mutually_exclusive_group()
+    group.add_argument("--decode", action="store_true", help="binary manifest --> JSON")
+    group.add_argument("--c-array", action="store_true", help="print the binary manifest as a C array")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+    try:
+        if args.decode:
+            out = (json.dumps(decode(data), indent=2) + "\n").encode()
+        else:
+            out = encode(json.loads(data))
+            print(f"{args.input}: {len(data)} bytes of JSON --> {len(out)} bytes", file=sys.stderr)
+            if args.c_array:
+                lines = [", ".join(f"0x{b:02x}" for b in out[i:i + 16]) for i in range(0, len(out), 16)]
+                out = ("static const uint8_t bench_config_tlv[] = {\n    " + ",\n    ".join(lines) + "};\n").encode()
+    except ValueError as e:
+        sys.exit(f"{args.input}: {e}")
+
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(out)
+    else:
+        sys.stdout.buffer.write(out)
+
+
+if __name__ == "__main__":
+    main()
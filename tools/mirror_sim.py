@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Mirror simulator: serve a directory of artifacts from several local "mirrors" of different speeds, with injected
+outages, to exercise the devices' mirror ranking & mid-download failover (src/utils/mirrors.h), e.g. with the
+native build: list http://127.0.0.1:<port>/... URLs as the "mirrors" of config.json.
+
+- Each --mirror is "<port>[,rate=<KB/s>][,rtt=<ms>][,cut=<bytes>][,down=<start>-<end>][,status=<code>]":
+  rate: body throughput, rtt: delay before the response headers,
+  cut: close the connection after that many body bytes of each response (a failure mid-download),
+  down: refuse the connections between these seconds after the start (an outage), status: answer every GET with it.
+- GET & single byte ranges (206), keep-alive. Every request is logged with the mirror's port.
+- Usage: python3 tools/mirror_sim.py publish --mirror 8081,rate=50,cut=300000 --mirror 8082,rate=2000,rtt=40
+         --mirror 8083,down=0-30
+"""
+import argparse
+import os
+import re
+import socket
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+RANGE = re.compile(r"bytes=(\d+)-(\d*)$")
+START = time.monotonic()
+
+
+def parse_mirror(spec):
+    port, *options = spec.split(",")
+    mirror = {"port": int(port), "rate": 0, "rtt": 0, "cut": 0, "down": None, "status": 0}
+    for option in options:
+        name, _, value = option.partition("=")
+        if name == "down":
+            start, _, end = value.partition("-")
+            mirror["down"] = (float(start), float(end))
+        elif name in mirror and name != "port":
+            mirror[name] = int(value)
+        else:
+            raise argparse.ArgumentTypeError(f"{spec}: unknown option {name}")
+    return mirror
+
+
+def make_handler(root, mirror):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, fmt, *args):
+            print(f"[{mirror['port']}] {self.address_string()} {fmt % args}", flush=True)
+
+        def do_GET(self):
+            if mirror["rtt"]:
+                time.sleep(mirror["rtt"] / 1000)
+            if mirror["status"]:
+                self.send_error(mirror["status"])
+                return
+            path = os.path.normpath(os.path.join(root, self.path.split("?")[0].lstrip("/")))
+            if not path.startswith(os.path.abspath(root)) or not os.path.isfile(path):
+                self.send_error(404)
+                return
+            with open(path, "rb") as f:
+                body = f.read()
+
+            first, last, status = 0, len(body) - 1, 200
+            match = RANGE.match(self.headers.get("Range", ""))
+            if match:
+                first = int(match.group(1))
+                last = min(int(match.group(2) or last), len(body) - 1)
+                if first > last:
+                    self.send_error(416)
+                    return
+                status = 206
+            self.send_response(status)
+            self.send_header("Content-Length", str(last - first + 1))
+            if status == 206:
+                self.send_header("Content-Range", f"bytes {first}-{last}/{len(body)}")
+            self.end_headers()
+            self.send_body(body[first:last + 1])
+
+        def send_body(self, body):
+            chunk = 1460
+            sent = 0
+            while sent < len(body):
+                if mirror["cut"] and sent >= mirror["cut"]:
+                    self.log_message("cut after %d bytes", sent)
+                    self.close_connection = True
+                    self.connection.shutdown(socket.SHUT_RDWR)
+                    return
+                data = body[sent:sent + chunk]
+                self.wfile.write(data)
+                sent += len(data)
+                if mirror["rate"]:
+                    time.sleep(len(data) / (mirror["rate"] * 1024))
+
+    return Handler
+
+
+class MirrorServer(ThreadingHTTPServer):
+    daemon_threads = True
+
+    def __init__(self, root, mirror):
+        super().__init__(("", mirror["port"]), make_handler(root, mirror))
+        self.mirror = mirror
+
+    def verify_request(self, request, client_address):
+        down = self.mirror["down"]
+        if down and down[0] <= time.monotonic() - START < down[1]:
+            print(f"[{self.mirror['port']}] {client_address[0]} refused (outage)", flush=True)
+            return False
+        return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("root", help="the artifacts directory (e.g. the output of tools/ota_pack.py)")
+    parser.add_argument("--mirror", type=parse_mirror, action="append", required=True)
+    args = parser.parse_args()
+
+    servers = [MirrorServer(args.root, mirror) for mirror in args.mirror]
+    for server in servers:
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+        print(f"mirror {server.mirror}", flush=True)
+    try:
+        while True:
+            time.sleep(3600)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""
+Caching LAN proxy for the update artifacts hosted on GitHub (raw.githubusercontent.com) or any other HTTP(S) origin.
+
+- The devices poll the proxy (plain HTTP on the LAN) instead of the origin: set their config "url" (and the
+  "firmware"/"public_key_url" URLs of config.json) to http://<proxy>:<port>/<path under --upstream>.
+- Every path is revalidated upstream at most once per --interval (conditional GET with the ETag/Last-Modified),
+  all the devices in between are served from memory: the origin sees one client, whatever the fleet size.
+  Content-addressed paths (.../<sha256>.img, see tools/ota_pack.py) are immutable: fetched once, never revalidated.
+- Concurrent misses of a path are collapsed into a single upstream fetch (the other requests wait for it).
+- The bodies are passed through byte-for-byte (no transcoding/rewriting), so the signed config.img/firmware.img
+  still verify on the devices.
+- On an upstream error the last good copy is served (stale) for another interval, a path never fetched gives 502.
+- Serves GET/HEAD, If-None-Match (304) & single byte ranges (206, used by the multicast repair), keep-alive.
+- Memory: least recently used entries are dropped above --max-mb.
+- Usage: python3 tools/ota_cache_proxy.py --upstream https://raw.githubusercontent.com/tuan-karma/fota_firmware_test/main/
+         --port 8080 --interval 60
+- Tests (against a fake upstream): python3 -m unittest discover -s test/tools
+"""
+import argparse
+import asyncio
+import collections
+import re
+import time
+import urllib.error
+import urllib.request
+import zlib
+
+MAX_HEADER_SIZE = 8192
+CONTENT_ADDRESSED = re.compile(r"(^|/)[0-9a-fA-F]{64}(\.[^/]*)?$")  # .../<sha256>[.ext], see tools/ota_pack.py
+
+
+class Entry:
+    def __init__(self, path, body, upstream_etag, last_modified, content_type):
+        self.body = body
+        self.immutable = CONTENT_ADDRESSED.search(path) is not None  # never revalidated
+        self.upstream_etag = upstream_etag
+        # served to the devices (If-None-Match): the origin's one, else derived from the content
+        self.etag = upstream_etag or '"%x-%08x"' % (len(body), zlib.crc32(body))
+        self.last_modified = last_modified
+        self.content_type = content_type
+        self.checked_at = time.monotonic()  # the last successful (re)validation upstream
+
+
+class Stats:
+    def __init__(self):
+        self.requests = 0
+        self.hits = 0  # served without asking upstream
+        self.fetches = 0  # upstream requests: 200 (new content)
+        self.revalidations = 0  # upstream requests: 304 (not modified)
+        self.upstream_errors = 0
+        self.collapsed = 0  # requests which waited for another request's upstream fetch
+        self.bytes_served = 0
+        self.bytes_fetched = 0
+
+
+class Cache:
+    def __init__(self, upstream, interval, max_bytes, timeout):
+        self.upstream = upstream.rstrip("/") + "/"
+        self.interval = interval
+        self.max_bytes = max_bytes
+        self.timeout = timeout
+        self.entries = collections.OrderedDict()  # path --> Entry, LRU order
+        self.inflight = {}  # path --> Future of the running upstream fetch
+        self.stats = Stats()
+
+    async def get(self, path):
+        """Returns the Entry of `path` (possibly stale), None if the origin never served it."""
+        entry = self.entries.get(path)
+        if entry is not None:
+            self.entries.move_to_end(path)
+            if entry.immutable or time.monotonic() - entry.checked_at < self.interval:
+                self.stats.hits += 1
+                return entry
+
+        future = self.inflight.get(path)
+        if future is not None:
+            self.stats.collapsed += 1
+            return await asyncio.shield(future)
+
+        future = asyncio.get_running_loop().create_future()
+        self.inflight[path] = future
+        try:
+            entry = await self.refresh(path, entry)
+            future.set_result(entry)
+        except Exception as e:  # never leave the waiters hanging
+            future.set_exception(e)
+            raise
+        finally:
+            del self.inflight[path]
+        return entry
+
+    async def refresh(self, path, entry):
+        try:
+            status, body, headers = await asyncio.to_thread(self.fetch, path, entry)
+        except (urllib.error.URLError, OSError) as e:
+            self.stats.upstream_errors += 1
+            print(f"upstream error for /{path}: {e}" + (", serving the stale copy" if entry else ""))
+            return self.stale(entry)
+
+        if status == 304 and entry is not None:
+            self.stats.revalidations += 1
+            entry.checked_at = time.monotonic()
+            return entry
+        if status != 200:
+            self.stats.upstream_errors += 1
+            print(f"upstream /{path}: HTTP {status}" + (", serving the stale copy" if entry else ""))
+            return self.stale(entry)
+
+        self.stats.fetches += 1
+        self.stats.bytes_fetched += len(body)
+        fresh = Entry(path, body, headers.get("ETag"), headers.get("Last-Modified"),
+                      headers.get("Content-Type", "application/octet-stream"))
+        self.entries[path] = fresh
+        self.entries.move_to_end(path)
+        self.evict()
+        return fresh
+
+    def stale(self, entry):
+        if entry is not None:
+            entry.checked_at = time.monotonic()  # retry upstream after an interval, not on every request
+        return entry
+
+    def fetch(self, path, entry):
+        request = urllib.request.Request(self.upstream + path, headers={"User-Agent": "ota-cache-proxy"})
+        if entry is not None:  # conditional GET: a 304 costs the origin (& its rate limit) almost nothing
+            if entry.upstream_etag:
+                request.add_header("If-None-Match", entry.upstream_etag)
+            if entry.last_modified:
+                request.add_header("If-Modified-Since", entry.last_modified)
+        try:
+            with urllib.request.urlopen(request, timeout=self.timeout) as response:
+                return response.status, response.read(), response.headers
+        except urllib.error.HTTPError as e:
+            return e.code, b"", e.headers
+
+    def evict(self):
+        total = sum(len(e.body) for e in self.entries.values())
+        while total > self.max_bytes and len(self.entries) > 1:
+            _, entry = self.entries.popitem(last=False)
+            total -= len(entry.body)
+
+
+def parse_range(value, size):
+    """(first, last) of a single "bytes=" range, None if absent, False if not satisfiable."""
+    if value is None:
+        return None
+    m = re.fullmatch(r"bytes=(\d*)-(\d*)", value.strip())
+    if not m or (m.group(1) == "" and m.group(2) == ""):
+        return None  # unsupported (e.g. multiple ranges): the whole body
+    if m.group(1) == "":  # suffix range
+        first, last = max(0, size - int(m.group(2))), size - 1
+    else:
+        first = int(m.group(1))
+        last = min(int(m.group(2)), size - 1) if m.group(2) else size - 1
+    if first >= size or first > last:
+        return False
+    return first, last
+
+
+async def respond(writer, status, reason, headers, body=b""):
+    lines = [f"HTTP/1.1 {status} {reason}"] + [f"{k}: {v}" for k, v in headers.items()]
+    writer.write(("\r\n".join(lines) + "\r\n\r\n").encode() + body)
+    await writer.drain()
+
+
+async def handle(reader, writer, cache):
+    try:
+        while True:
+            try:
+                head = await reader.readuntil(b"\r\n\r\n")
+            except (asyncio.IncompleteReadError, asyncio.LimitOverrunError, ConnectionError):
+                return
+            lines = head.decode("latin-1").split("\r\n")
+            method, target, version = (lines[0].split(" ") + ["", ""])[:3]
+            headers = {}
+            for line in lines[1:]:
+                if ":" in line:
+                    key, value = line.split(":", 1)
+                    headers[key.strip().lower()] = value.strip()
+            keep_alive = headers.get("connection", "").lower() != "close" and version == "HTTP/1.1"
+            cache.stats.requests += 1
+
+            if method not in ("GET", "HEAD"):
+                await respond(writer, 405, "Method Not Allowed", {"Content-Length": 0, "Connection": "close"})
+                return
+            path = target.split("?", 1)[0].lstrip("/")
+            entry = await cache.get(path) if path else None
+            common = {"Connection": "keep-alive" if keep_alive else "close"}
+            if entry is None:
+                await respond(writer, 502, "Bad Gateway", {**common, "Content-Length": 0})
+            elif headers.get("if-none-match") == entry.etag:
+                await respond(writer, 304, "Not Modified", {**common, "ETag": entry.etag})
+            else:
+                size = len(entry.body)
+                common.update({"ETag": entry.etag, "Accept-Ranges": "bytes", "Content-Type": entry.content_type,
+                               "Cache-Control": "public, max-age=31536000, immutable" if entry.immutable else "no-cache"})
+                byte_range = parse_range(headers.get("range"), size)
+                if byte_range is False:
+                    await respond(writer, 416, "Range Not Satisfiable",
+                                  {**common, "Content-Range": f"bytes */{size}", "Content-Length": 0})
+                elif byte_range:
+                    first, last = byte_range
+                    body = entry.body[first:last + 1] if method == "GET" else b""
+                    await respond(writer, 206, "Partial Content", {**common, "Content-Range": f"bytes {first}-{last}/{size}",
+                                                                   "Content-Length": last - first + 1}, body)
+                    cache.stats.bytes_served += len(body)
+                else:
+                    body = entry.body if method == "GET" else b""
+                    await respond(writer, 200, "OK", {**common, "Content-Length": size}, body)
+                    cache.stats.bytes_served += len(body)
+            if not keep_alive:
+                return
+    except ConnectionError:
+        pass
+    finally:
+        writer.close()
+
+
+async def report(cache, every):
+    while True:
+        await asyncio.sleep(every)
+        s = cache.stats
+        print(f"{s.requests} requests: {s.hits} hits, {s.collapsed} collapsed, upstream {s.fetches} fetches + "
+              f"{s.revalidations} revalidations, {s.upstream_errors} errors; {s.bytes_served / 1e6:.2f} MB served, "
+              f"{s.bytes_fetched / 1e6:.2f} MB fetched, {len(cache.entries)} entries")
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--upstream", required=True, help="origin base URL, e.g. https://raw.githubusercontent.com/<user>/<repo>/main/")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--interval", type=float, default=60, help="seconds between upstream revalidations of a path")
+    parser.add_argument("--timeout", type=float, default=30, help="upstream timeout (seconds)")
+    parser.add_argument("--max-mb", type=float, default=64, help="memory limit of the cached bodies")
+    parser.add_argument("--report-every", type=float, default=60)
+    args = parser.parse_args()
+
+    cache = Cache(args.upstream, args.interval, int(args.max_mb * 1e6), args.timeout)
+    server = await asyncio.start_server(lambda r, w: handle(r, w, cache), args.host, args.port, limit=MAX_HEADER_SIZE)
+    print(f"proxying {cache.upstream} on {args.host}:{args.port}, revalidating every {args.interval:g}s")
+    asyncio.create_task(report(cache, args.report_every))
+    async with server:
+        await server.serve_forever()
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""
+Catalog builder: the manifests of several device types / hardware revisions signed as one catalog.img.
+
+- The devices whose config "url" points at catalog.img keep their own entry only: (device_type, hardware_rev) of
+  configOTASecure.h, else (device_type, revision 0 = any), found by a binary search of the sorted index. The
+  other entries are only hashed (the signature covers the whole catalog). See src/utils/catalog.h for the layout.
+- Each entry is a config.json (compact) or, with --format tlv, a binary manifest (tools/manifest_tlv.py). Its
+  "type" is set to the entry's device type: the devices reject a manifest of another type.
+- Signing with openssl like tools/ota_pack.py, written atomically (rename).
+- Usage: python3 tools/ota_catalog.py --config-key config_key.pem --out publish/catalog.img
+         ch4_generator=ch4/config.json ch4_generator:2=ch4_rev2/config.json sensor=sensor/config.json [--format tlv]
+         python3 tools/ota_catalog.py --list publish/catalog.img
+"""
+import argparse
+import json
+import os
+import struct
+import sys
+
+import manifest_tlv
+import ota_pack
+
+MAGIC = b"OTC\x01"
+TYPE_SIZE = 32
+INDEX_ENTRY = struct.Struct(f"<{TYPE_SIZE}sBxIH")
+MAX_CATALOG_SIZE = 32  # max_catalog_size of configOTASecure.h
+
+
+def parse_entry(arg):
+    key, sep, path = arg.partition("=")
+    if not sep:
+        raise ValueError(f"{arg}: expected <type>[:<hw_rev>]=<config.json>")
+    device_type, _, hw_rev = key.partition(":")
+    hw_rev = int(hw_rev or 0)
+    if not device_type or len(device_type.encode()) >= TYPE_SIZE or not 0 <= hw_rev <= 255:
+        raise ValueError(f"{arg}: the type must have 1..{TYPE_SIZE - 1} bytes, the hardware revision 0..255")
+    return device_type, hw_rev, path
+
+
+def build(entries, fmt):
+    """The catalog of [(type, hw_rev, manifest dict)]."""
+    if not 0 < len(entries) <= MAX_CATALOG_SIZE:
+        raise ValueError(f"{len(entries)} entries, the devices accept 1..{MAX_CATALOG_SIZE}")
+    entries = sorted(entries, key=lambda e: (e[0].encode(), e[1]))  # the devices' order: strncmp, then hw_rev
+    keys = [(t, r) for t, r, _ in entries]
+    if len(set(keys)) != len(keys):
+        raise ValueError("duplicated (type, hardware revision) entries")
+
+    bodies = []
+    for device_type, hw_rev, manifest in entries:
+        manifest = dict(manifest, type=device_type)
+        body = manifest_tlv.encode(manifest) if fmt == "tlv" else json.dumps(manifest, separators=(",", ":")).encode()
+        if len(body) > ota_pack.MAX_CONTENT_SIZE:
+            raise ValueError(f"{device_type}:{hw_rev}: {len(body)} bytes, the devices accept <= {ota_pack.MAX_CONTENT_SIZE}")
+        bodies.append(body)
+
+    offset = len(MAGIC) + 2 + len(entries) * INDEX_ENTRY.size
+    catalog = bytearray(MAGIC + bytes([len(entries), 0]))
+    for (device_type, hw_rev, _), body in zip(entries, bodies):
+        catalog += INDEX_ENTRY.pack(device_type.encode(), hw_rev, offset, len(body))
+        offset += len(body)
+    for body in bodies:
+        catalog += body
+    return bytes(catalog)
+
+
+def find_entry(catalog, device_type, hw_rev=0):
+    """The manifest (bytes) of (device_type, hw_rev), else (device_type, 0), in a catalog (without the signature)."""
+    count = catalog[len(MAGIC)]
+    index = {}
+    for i in range(count):
+        raw_type, rev, offset, length = INDEX_ENTRY.unpack_from(catalog, len(MAGIC) + 2 + i * INDEX_ENTRY.size)
+        index[(raw_type.rstrip(b"\0").decode(), rev)] = catalog[offset:offset + length]
+    return index.get((device_type, hw_rev), index.get((device_type, 0)))
+
+
+def list_catalog(path):
+    with open(path, "rb") as f:
+        catalog = f.read()[ota_pack.SIGN_LEN:]
+    if not catalog.startswith(MAGIC):
+        sys.exit(f"{path}: not a catalog")
+    count = catalog[len(MAGIC)]
+    print(f"{path}: {count} entries, {len(catalog)} bytes")
+    for i in range(count):
+        raw_type, hw_rev, offset, length = INDEX_ENTRY.unpack_from(catalog, len(MAGIC) + 2 + i * INDEX_ENTRY.size)
+        body = catalog[offset:offset + length]
+        manifest = manifest_tlv.decode(body) if body.startswith(manifest_tlv.MAGIC) else json.loads(body)
+        device_type = raw_type.rstrip(b"\0").decode()
+        print(f"  {device_type}:{hw_rev} @{offset} {length} bytes: "
+              f"config {manifest['config'].get('version')}, firmware {manifest['firmware'].get('version')}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("entries", nargs="*", help="<type>[:<hw_rev>]=<config.json>")
+    parser.add_argument("--config-key", help="private key (PEM) signing catalog.img")
+    parser.add_argument("--out", help="the catalog.img to write")
+    parser.add_argument("--format", choices=("json", "tlv"), default="json", help="the manifest format of the entries")
+    parser.add_argument("--list", metavar="CATALOG_IMG", help="print the entries of a catalog.img")
+    args = parser.parse_args()
+    if args.list:
+        list_catalog(args.list)
+        return
+    if not (args.entries and args.config_key and args.out):
+        parser.error("entries, --config-key and --out are needed to build a catalog")
+
+    try:
+        entries = []
+        for arg in args.entries:
+            device_type, hw_rev, path = parse_entry(arg)
+            with open(path) as f:
+                entries.append((device_type, hw_rev, json.load(f)))
+        catalog = build(entries, args.format)
+    except ValueError as e:
+        sys.exit(str(e))
+
+    out_dir, name = os.path.split(os.path.abspath(args.out))
+    ota_pack.publish(out_dir, name, ota_pack.sign(catalog, args.config_key) + catalog)
+    print(f"{args.out}: {len(entries)} entries, {len(catalog)} bytes")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""
+Multicast OTA carousel sender (see src/utils/ota_multicast.h for the receiver & the packet format).
+
+- Loops over the firmware of a signed firmware.img (signature + firmware) on a UDP multicast group,
+  with a XOR parity block after every `--group-size` data blocks.
+- The devices get the signature from the HTTP URL of the same firmware.img, so the sent image must be identical.
+- Usage: python3 tools/ota_multicast_sender.py firmware.img --group 239.255.0.1 --port 5007 --rounds 3
+- `--loss 0.05` drops 5% of the packets on purpose (to test the parity & the HTTP repair paths), `--seed` makes the
+  drops reproducible (test/test_multicast).
+"""
+import argparse
+import random
+import socket
+import struct
+import time
+
+SIGN_LEN = 512
+HEADER = struct.Struct("<4sBBHIII")  # magic, kind, group_size, block_size, image_id, fw_len, index
+DATA_BLOCK, PARITY_BLOCK = 1, 2
+MAX_BLOCK_SIZE = 1400
+
+
+def blocks_of(firmware, block_size):
+    for offset in range(0, len(firmware), block_size):
+        yield firmware[offset:offset + block_size].ljust(block_size, b"\0")
+
+
+def xor_blocks(blocks):
+    parity = bytearray(len(blocks[0]))
+    for block in blocks:
+        for i, byte in enumerate(block):
+            parity[i] ^= byte
+    return bytes(parity)
+
+
+def packets(image, block_size, group_size):
+    signature, firmware = image[:SIGN_LEN], image[SIGN_LEN:]
+    image_id = struct.unpack("<I", signature[:4])[0]
+    blocks = list(blocks_of(firmware, block_size))
+    for group in range(0, len(blocks), group_size):
+        members = blocks[group:group + group_size]
+        for i, block in enumerate(members):
+            yield HEADER.pack(b"OTAM", DATA_BLOCK, group_size, block_size, image_id, len(firmware), group + i) + block
+        yield HEADER.pack(b"OTAM", PARITY_BLOCK, group_size, block_size, image_id, len(firmware), group // group_size) + xor_blocks(members)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", help="the signed firmware.img")
+    parser.add_argument("--group", default="239.255.0.1")
+    parser.add_argument("--port", type=int, default=5007)
+    parser.add_argument("--block-size", type=int, default=1024)
+    parser.add_argument("--group-size", type=int, default=8, help="data blocks per parity block")
+    parser.add_argument("--rate", type=float, default=500, help="packets per second")
+    parser.add_argument("--rounds", type=int, default=0, help="carousel rounds (0: forever)")
+    parser.add_argument("--ttl", type=int, default=1)
+    parser.add_argument("--loss", type=float, default=0.0, help="fraction of packets dropped on purpose")
+    parser.add_argument("--seed", type=int, help="of the --loss drops (the same packets dropped on every run)")
+    args = parser.parse_args()
+    random.seed(args.seed)
+
+    if not 0 < args.block_size <= MAX_BLOCK_SIZE or not 0 < args.group_size < 256:
+        parser.error(f"--block-size must be in (0, {MAX_BLOCK_SIZE}] and --group-size in (0, 256)")
+    with open(args.image, "rb") as f:
+        image = f.read()
+    if len(image) <= SIGN_LEN:
+        parser.error("the image must be longer than its signature")
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, args.ttl)
+    carousel = list(packets(image, args.block_size, args.group_size))
+    interval = 1.0 / args.rate
+
+    rounds = 0
+    while args.rounds == 0 or rounds < args.rounds:
+        sent = dropped = 0
+        next_send = time.monotonic()
+        for packet in carousel:
+            if random.random() < args.loss:
+                dropped += 1
+            else:
+                sock.sendto(packet, (args.group, args.port))
+                sent += 1
+            next_send += interval
+            time.sleep(max(0.0, next_send - time.monotonic()))
+        rounds += 1
+        print(f"round {rounds}: {sent} packets sent, {dropped} dropped")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""
+Notifier: the push channel of the devices (src/utils/notifier.h), a long-poll HTTP endpoint announcing the
+publications of config.img, so that the devices check it right away instead of at their next poll.
+
+- GET /notify?v=<the device's newest known config version>&wait=<seconds>: answered at once with 200 & the published
+  config version (text) if it differs, else held until the next publication (200) or for `wait` seconds (at most
+  --max-hold) --> 204 No Content. Keep-alive: the devices long-poll again on the same connection.
+- The published version: "config"."version" of <published dir>/config.json (written by tools/ota_pack.py along
+  with config.img), checked every --check-every seconds, announced --settle seconds later: the time for the servers
+  & caches to serve the new config.img (tools/update_server revalidates its files every second). A device that still
+  gets the former one checks again (Notifier::max_rechecks).
+- The notifications carry no authority: the devices still poll & verify the signed config.img.
+- The held requests are coroutines on one asyncio loop: thousands of idle devices cost a socket each.
+- Usage: python3 tools/ota_notifier.py publish [--port 8090]
+         with "config": {"notify_url": "http://<host>:8090/notify"} in tools/ota_pack.py's --manifest template.
+"""
+import argparse
+import asyncio
+import json
+import os
+import time
+from urllib.parse import parse_qs, urlsplit
+
+
+class Publication:
+    def __init__(self, path, settle):
+        self.path = path
+        self.settle = settle
+        self.version = None
+        self.mtime = None
+        self.changed = asyncio.Event()
+        self.waiting = 0
+
+    async def check(self):
+        try:
+            mtime = os.stat(self.path).st_mtime_ns
+            if mtime == self.mtime:
+                return
+            with open(self.path) as f:
+                version = json.load(f)["config"]["version"]
+        except (OSError, ValueError, KeyError, TypeError):
+            return  # not (yet) published, or being replaced
+        self.mtime = mtime
+        if version != self.version:
+            if self.version is not None:
+                await asyncio.sleep(self.settle)
+            print(f"[{time.time():.3f}] config {version} published, {self.waiting} devices notified", flush=True)
+            self.version = version
+            self.changed.set()  # wakes the held requests
+            self.changed = asyncio.Event()
+
+    async def watch(self, period):
+        while True:
+            await self.check()
+            await asyncio.sleep(period)
+
+    async def wait_for_other(self, known, hold):
+        """The published version once it differs from `known`, None after `hold` seconds"""
+        deadline = time.monotonic() + hold
+        while self.version is None or self.version == known:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return None
+            self.waiting += 1
+            try:
+                await asyncio.wait_for(self.changed.wait(), remaining)
+            except asyncio.TimeoutError:
+                pass
+            finally:
+                self.waiting -= 1
+        return self.version
+
+
+async def respond(writer, status, body=b""):
+    reason = {200: "OK", 204: "No Content", 400: "Bad Request", 404: "Not Found"}[status]
+    head = f"HTTP/1.1 {status} {reason}\r\nCache-Control: no-store\r\n"
+    if status != 204:
+        head += f"Content-Type: text/plain\r\nContent-Length: {len(body)}\r\n"
+    writer.write(head.encode() + b"\r\n" + body)
+    await writer.drain()
+
+
+def make_handler(publication, args):
+    async def handle(reader, writer):
+        try:
+            while True:
+                head = await reader.readuntil(b"\r\n\r\n")
+                request_line = head.split(b"\r\n", 1)[0].decode("latin-1")
+                method, target, _ = (request_line.split(" ") + ["", ""])[:3]
+                url = urlsplit(target)
+                if method != "GET" or url.path != args.path:
+                    await respond(writer, 404 if method == "GET" else 400)
+                    continue
+                query = parse_qs(url.query)
+                known = query.get("v", [""])[0]
+                try:
+                    hold = min(float(query.get("wait", [args.max_hold])[0]), args.max_hold)
+                except ValueError:
+                    hold = args.max_hold
+                version = await publication.wait_for_other(known, hold)
+                if version is None:
+                    await respond(writer, 204)
+                else:
+                    await respond(writer, 200, version.encode() + b"\n")
+        except (OSError, asyncio.IncompleteReadError, asyncio.LimitOverrunError):
+            pass
+        finally:
+            writer.close()
+
+    return handle
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("root", help="the published directory (tools/ota_pack.py --out)")
+    parser.add_argument("--port", type=int, default=8090)
+    parser.add_argument("--path", default="/notify")
+    parser.add_argument("--max-hold", type=float, default=60, help="seconds a request is held at most")
+    parser.add_argument("--check-every", type=float, default=0.2, help="seconds between the checks of config.json")
+    parser.add_argument("--settle", type=float, default=1.5, help="seconds from a publication to its announcement")
+    args = parser.parse_args()
+
+    publication = Publication(os.path.join(args.root, "config.json"), args.settle)
+    await publication.check()
+    server = await asyncio.start_server(make_handler(publication, args), port=args.port, backlog=4096)
+    print(f"notifier on port {args.port}{args.path}, config {publication.version}", flush=True)
+    async with server:
+        await asyncio.gather(server.serve_forever(), publication.watch(args.check_every))
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+"""
+Packer: sign & publish the OTA artifacts under content-addressed (immutable) URLs.
+
+- firmware.img = RSA-4096 signature (512 bytes) + firmware.bin, published as <out>/fw/<sha256 of firmware.img>.img.
+  The signed config.json names the image: "firmware"."sha256" & "size" of firmware.bin. The devices reject any
+  other image, from the URL, a mirror or a LAN peer: e.g. an older, validly signed release (a rollback).
+- a new public key (PEM) is published as <out>/keys/<sha256 of the PEM>.pub; with --inline-keys it's also carried
+  inside the signed config.json ("public_key": {"id": <hex of SHA-256(DER)[:8]>, "der": <base64 DER>}): the devices
+  get it without an extra download, authenticated by the current config key. The URL stays for the older devices.
+- config.json (the --manifest template) gets the new URLs & versions, is signed and published as <out>/config.img:
+  the only mutable artifact, the small "pointer" the devices poll with no-cache. <out>/config.json is its
+  readable copy, the template of the next run. --format tlv: config.img carries the binary manifest instead
+  (tools/manifest_tlv.py, about half the size, read in place by the devices).
+- Config patches: every published config.json is kept in <out>/history/, the merge patches from the last --patches
+  versions to the new one are signed into <out>/patches/<base version>.img (tools/config_patch.py), served by
+  tools/update_server for config.img?base=<version>.
+- Mirrors: --mirror-url <root URL> (up to 4) lists the other places the published root is copied to (a LAN server, a
+  regional cache ...): firmware.img & config.img get them as "mirrors", the devices rank them by speed & fail over
+  to them (src/utils/mirrors.h). config.img's mirrors are only fallbacks of its "url" (a stale copy isn't used first).
+- Scheduled release: --activate-at <Unix time | +seconds> [--stage-window <seconds>] lets the devices download &
+  verify the firmware ahead of time, each at its own slot of the window before the activation, and boot it at that
+  moment ("firmware"."activate_at" & "stage_window", Config::stage_firmware()). Without it: right away.
+- Download budget: --budget <KB/s>[,<slice ms>,<pause ms>] paces the devices' firmware download ("firmware"."budget",
+  src/utils/throttle.h): a rate limit, and CPU slices followed by pauses for the application's tasks. 0: none.
+- Poll hint: --poll-hint <seconds>[,<ttl seconds>] makes the devices poll config.img at that interval for the TTL
+  (default 1 h), then at their "checking_interval" again ("poll", Config::next_poll_s()): a fleet slowed down under
+  load or sped up during a rollout without a new "device" config. Not kept from the template: a hint is per run.
+- The devices request the content-addressed URLs cacheable (HTTP::is_content_addressed()), so CDNs & proxies
+  (tools/ota_cache_proxy.py) serve them; a new build never overwrites an old URL. Old artifacts are left in place.
+- Signing with openssl (like `openssl dgst -sha256 -sign key.pem`), the files are written atomically (rename),
+  tools/update_server picks them up on the fly.
+- Usage: python3 tools/ota_pack.py --manifest config.json --config-key config_key.pem --out publish
+         --base-url http://10.130.0.141/ --firmware .pio/build/devkit-v1/firmware.bin --firmware-key firmware_key.pem
+         --firmware-version 0.0.6 [--firmware-pub new_firmware_key.pub] [--config-pub new_config_key.pub] [--inline-keys]
+         [--format tlv] [--mirror-url http://cache.example.com/ota/] [--budget 64,10,40]
+         [--activate-at +86400 --stage-window 43200] [--poll-hint 60,3600]
+"""
+import argparse
+import base64
+import hashlib
+import json
+import os
+import subprocess
+import sys
+import time
+
+import config_patch
+import manifest_tlv
+
+SIGN_LEN = 512
+MAX_CONTENT_SIZE = 2048  # max_content_size of configOTASecure.h
+LEGACY_MAX_CONTENT_SIZE = 1024  # devices before the inline keys
+MAX_PUBKEY_SIZE = 832  # max_pubkey_size of configOTASecure.h (null-terminator included)
+MAX_MIRRORS = 4  # Mirrors::max_mirrors of src/utils/mirrors.h
+
+
+def sign(data, key_path):
+    signature = subprocess.run(["openssl", "dgst", "-sha256", "-sign", key_path], input=data,
+                               stdout=subprocess.PIPE, check=True).stdout
+    if len(signature) != SIGN_LEN:
+        sys.exit(f"{key_path}: a {len(signature) * 8}-bit signature, the devices expect RSA-4096")
+    return signature
+
+
+def publish(out_dir, rel_path, data):
+    path = os.path.join(out_dir, rel_path)
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    tmp = path + ".tmp"
+    with open(tmp, "wb") as f:
+        f.write(data)
+    os.replace(tmp, path)
+    return rel_path
+
+
+def publish_content_addressed(out_dir, folder, data, ext):
+    digest = hashlib.sha256(data).hexdigest()
+    rel_path = f"{folder}/{digest}{ext}"
+    if not os.path.exists(os.path.join(out_dir, rel_path)):  # immutable: never rewritten
+        publish(out_dir, rel_path, data)
+    return rel_path
+
+
+def publish_key(args, name, section, pub_path):
+    with open(pub_path, "rb") as f:
+        pem = f.read()
+    if len(pem) >= MAX_PUBKEY_SIZE:
+        sys.exit(f"{pub_path}: {len(pem)} bytes, the devices accept < {MAX_PUBKEY_SIZE}")
+    rel_path = publish_content_addressed(args.out, "keys", pem, ".pub")
+    section["public_key_change?"] = True
+    section["public_key_url"] = args.base_url + rel_path
+    if args.inline_keys:
+        der = subprocess.run(["openssl", "pkey", "-pubin", "-in", pub_path, "-outform", "DER"],
+                             stdout=subprocess.PIPE, check=True).stdout
+        key_id = hashlib.sha256(der).hexdigest()[:16]
+        section["public_key"] = {"id": key_id, "der": base64.b64encode(der).decode()}
+        print(f"{name} key: {rel_path}, inline ID {key_id}")
+    else:
+        print(f"{name} key: {rel_path}")
+
+
+def bump_patch(version):
+    major, minor, patch = version.split("-")[0].split("+")[0].split(".")
+    return f"{major}.{minor}.{int(patch) + 1}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--manifest", required=True, help="config.json template (its URLs & versions are updated)")
+    parser.add_argument("--config-key", required=True, help="private key (PEM) signing config.img")
+    parser.add_argument("--out", required=True, help="the published root directory")
+    parser.add_argument("--base-url", required=True, help="the URL of the published root, e.g. http://10.130.0.141/")
+    parser.add_argument("--firmware", help="firmware.bin to publish")
+    parser.add_argument("--firmware-key", help="private key (PEM) signing firmware.img")
+    parser.add_argument("--firmware-version", help="the version of --firmware")
+    parser.add_argument("--firmware-pub", help="new firmware public key (PEM) to roll out")
+    parser.add_argument("--config-pub", help="new config public key (PEM) to roll out")
+    parser.add_argument("--config-version", help="default: the manifest's version with the patch bumped")
+    parser.add_argument("--inline-keys", action="store_true", help="carry the new public keys inside config.json")
+    parser.add_argument("--format", choices=("json", "tlv"), default="json", help="the manifest format inside config.img")
+    parser.add_argument("--patches", type=int, default=8, help="config patches from the last N versions (0: none)")
+    parser.add_argument("--mirror-url", action="append", default=[], help="the URL of a copy of the published root")
+    parser.add_argument("--activate-at", help="boot the firmware at this Unix time (or +<seconds> from now)")
+    parser.add_argument("--stage-window", type=int, default=0, help="seconds before --activate-at to spread the downloads over")
+    parser.add_argument("--budget", help="the firmware download's pace: <KB/s>[,<slice ms>,<pause ms>] (0: unlimited)")
+    parser.add_argument("--poll-hint", help="the devices' polling interval for a while: <seconds>[,<ttl seconds>]")
+    args = parser.parse_args()
+    if args.firmware and not (args.firmware_key and args.firmware_version):
+        parser.error("--firmware needs --firmware-key and --firmware-version")
+    if not args.base_url.endswith("/"):
+        args.base_url += "/"
+    if len(args.mirror_url) > MAX_MIRRORS:
+        parser.error(f"--mirror-url: the devices use up to {MAX_MIRRORS} mirrors")
+    args.mirror_url = [url if url.endswith("/") else url + "/" for url in args.mirror_url]
+    if args.activate_at is not None:
+        try:
+            at = int(args.activate_at)
+        except ValueError:
+            parser.error("--activate-at: a Unix time or +<seconds>")
+        args.activate_at = int(time.time()) + at if args.activate_at.startswith("+") else at
+    if args.stage_window and args.activate_at is None:
+        parser.error("--stage-window needs --activate-at")
+    if args.budget is not None:
+        try:
+            values = [int(value) for value in args.budget.split(",")]
+        except ValueError:
+            values = []
+        if len(values) not in (1, 3) or min(values) < 0 or max(values[1:], default=0) > 0xFFFF:
+            parser.error("--budget: <KB/s>[,<slice ms>,<pause ms>], e.g. 64,10,40")
+        args.budget = dict(zip(("rate", "slice", "pause"), values))
+    if args.poll_hint is not None:
+        try:
+            values = [int(value) for value in args.poll_hint.split(",")]
+        except ValueError:
+            values = []
+        if len(values) not in (1, 2) or min(values) <= 0:
+            parser.error("--poll-hint: <seconds>[,<ttl seconds>], e.g. 60,3600")
+        args.poll_hint = dict(zip(("interval", "ttl"), values))
+
+    with open(args.manifest) as f:
+        manifest = json.load(f)
+    config, firmware = manifest["config"], manifest["firmware"]
+
+    if args.firmware:
+        with open(args.firmware, "rb") as f:
+            fw = f.read()
+        image = sign(fw, args.firmware_key) + fw
+        rel_path = publish_content_addressed(args.out, "fw", image, ".img")
+        firmware["url"] = args.base_url + rel_path
+        firmware["version"] = args.firmware_version
+        firmware["sha256"] = hashlib.sha256(fw).hexdigest()
+        firmware["size"] = len(fw)
+        firmware["mirrors"] = [url + rel_path for url in args.mirror_url]
+        for field in ("activate_at", "stage_window"):  # a release is scheduled explicitly, not by the template
+            firmware.pop(field, None)
+        print(f"firmware {args.firmware_version}: {rel_path} ({len(image)} bytes)")
+
+    # a key is only fetched by the devices when its "public_key_change?" is set
+    for section in (config, firmware):
+        section["public_key_change?"] = False
+        section.pop("public_key", None)
+    if args.config_pub:
+        publish_key(args, "config", config, args.config_pub)
+    if args.firmware_pub:
+        publish_key(args, "firmware", firmware, args.firmware_pub)
+
+    if args.activate_at is not None:
+        firmware["activate_at"] = args.activate_at
+        if args.stage_window:
+            firmware["stage_window"] = args.stage_window
+        print(f"firmware {firmware['version']}: activation at {time.strftime('%Y-%m-%d %H:%M:%S UTC', time.gmtime(args.activate_at))}"
+              + (f", staged over the {args.stage_window} s before" if args.stage_window else ""))
+    if args.budget is not None:
+        firmware["budget"] = {name: value for name, value in args.budget.items() if value}
+        if not firmware["budget"]:
+            firmware.pop("budget")
+    manifest.pop("poll", None)
+    if args.poll_hint is not None:
+        manifest["poll"] = args.poll_hint
+        print(f"poll hint: every {args.poll_hint['interval']} s" + (f" for {args.poll_hint['ttl']} s" if "ttl" in args.poll_hint else ""))
+    config["mirrors"] = [url + "config.img" for url in args.mirror_url]
+    for section in (config, firmware):
+        if not section.get("mirrors"):
+            section.pop("mirrors", None)
+    config["version"] = args.config_version or bump_patch(config["version"])
+    if args.format == "tlv":
+        content = manifest_tlv.encode(manifest)  # only understood by the devices with Manifest::parse_tlv()
+    else:
+        content = json.dumps(manifest, separators=(",", ":")).encode()
+    if len(content) > MAX_CONTENT_SIZE:
+        sys.exit(f"config.img: {len(content)} bytes of manifest, the devices accept <= {MAX_CONTENT_SIZE}")
+    if len(content) > LEGACY_MAX_CONTENT_SIZE:
+        print(f"warning: the manifest has {len(content)} bytes, the devices without inline keys accept <= {LEGACY_MAX_CONTENT_SIZE}")
+    publish(args.out, "config.img", sign(content, args.config_key) + content)
+    publish(args.out, "config.json", (json.dumps(manifest, indent=2) + "\n").encode())  # unsigned copy: the next --manifest
+    print(f"config {config['version']}: config.img ({len(content)} bytes of {args.format} manifest)")
+    for base, size, _ in config_patch.publish_patches(args.out, manifest, args.config_key, args.format, args.patches):
+        print(f"  patches/{base}.img: {size} bytes")
+
+
+if __name__ == "__main__":
+    main()
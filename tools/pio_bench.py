@@ -0,0 +1,35 @@
+"""
+PlatformIO extra script of env:native_bench: the `bench` target runs the micro-benchmarks & gates on the baseline.
+
+- pio run -e native_bench -t bench: builds the program, runs it BENCH_RUNS times (default 3, each run's JSON lines in
+  $BUILD_DIR/bench_<n>.json), then tools/bench_compare.py keeps each benchmark's best run & fails the build on a
+  regression beyond BENCH_TOLERANCE (default 0.25: a best-of-3 of a shared host strays up to ~15% from the baseline)
+  of tools/bench_baseline.json
+- Refresh the baseline on the reference machine (the median of each benchmark's runs, BENCH_RUNS=6 or more):
+  BENCH_RUNS=6 pio run -e native_bench -t bench_save
+"""
+import os
+
+Import("env")  # noqa: F821 (SCons)
+
+runs = int(os.environ.get("BENCH_RUNS", "3"))
+tolerance = os.environ.get("BENCH_TOLERANCE", "0.25")
+program = "$BUILD_DIR/${PROGNAME}${PROGSUFFIX}"
+outputs = " ".join(f"$BUILD_DIR/bench_{n}.json" for n in range(runs))
+compare = f'"$PYTHONEXE" "$PROJECT_DIR/tools/bench_compare.py" {outputs}'
+bench_runs = [f'"{program}" > "$BUILD_DIR/bench_{n}.json"' for n in range(runs)]
+
+env.AddCustomTarget(  # noqa: F821
+    name="bench",
+    dependencies=program,
+    actions=bench_runs + [f"{compare} --tolerance {tolerance}"],
+    title="Bench",
+    description="Run the micro-benchmarks, compare with tools/bench_baseline.json",
+)
+env.AddCustomTarget(  # noqa: F821
+    name="bench_save",
+    dependencies=program,
+    actions=bench_runs + [f"{compare} --save"],
+    title="Bench baseline",
+    description="Run the micro-benchmarks, store them as tools/bench_baseline.json",
+)
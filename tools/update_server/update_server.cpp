@@ -0,0 +1,645 @@
+/*
+- A LAN update server for the OTA artifacts (config.img, *.pub, firmware.img), instead of raw.githubusercontent.com
+  (no propagation delay, no per-IP throttling).
+- Linux only: one thread, epoll event loop, non-blocking keep-alive connections (HTTP/1.1, pipelining).
+- Zero-copy bodies: the artifacts are mmap-ed; small bodies go out with the header in one writev(),
+  large ones with sendfile().
+- ETag (a FNV-1a hash of the content, the same on every server), If-None-Match --> 304, single Range --> 206.
+- Cache-Control: immutable for the content-addressed artifacts (/fw/<sha256>.img ...), no-cache for the others.
+- Config patches: GET <dir>/config.img?base=<version> is answered with <dir>/patches/<version>.img when it exists
+  (a signed merge patch against that config version, see tools/config_patch.py), else with config.img.
+- Hot reload: a cached artifact is re-stat()-ed at most once per second, a changed file (e.g. replaced by `mv`)
+  is re-mapped for the next requests while the running transfers keep the old mapping --> no dropped connection.
+- Load shedding: with max_polls_per_s > 0 the requests of the mutable artifacts (the polls of config.img) beyond that
+  rate are answered "503 Service Unavailable" + "Retry-After: <retry_after_s>", which the devices honor (+ up to 10%
+  jitter, Config::next_poll_s()). The content-addressed downloads are never shed.
+- Load test: python3 tools/fleet_loadgen.py http://127.0.0.1:8080/config.img --devices 10000 --interval 60 reports the
+  request rate & the response latency. On one core shared with the load generator: 166 req/s, p50 0.7 ms, p99 4.8 ms.
+  At --interval 5 the Python client saturates that core first (~1500 req/s); the server spends ~34 us of CPU per poll.
+- Connections: the open files limit (RLIMIT_NOFILE) is raised to its hard limit at startup; a connection idle (no byte
+  received or sent) for idle_timeout_s is closed. Out of file descriptors (EMFILE), the listening socket is no longer
+  watched until a connection closes: the pending clients wait in the backlog instead of spinning the event loop.
+- Build: g++ -O2 -std=c++17 -o update_server tools/update_server/update_server.cpp
+- Usage: ./update_server <artifacts_dir> [port=8080] [max_polls_per_s=0] [retry_after_s=30] [idle_timeout_s=30]
+  (the device's URL: http://<server_ip>:8080/config.img)
+*/
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+    constexpr const size_t max_request_size = 8192;
+    constexpr const size_t writev_limit = 16 * 1024; // bodies up to this size are sent with the header (writev)
+    constexpr const int64_t revalidate_ms = 1000;
+    constexpr const size_t max_entries = 4096; // cached artifacts (existing files only), beyond that loaded per request
+    constexpr const int max_events = 256;
+    constexpr const int64_t sweep_ms = 1000; // the idle connections are looked for at most that often
+
+    int64_t now_ms()
+    {
+        using namespace std::chrono;
+        return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // An immutable, memory-mapped version of a file. Shared by the cache & the connections sending it.
+    struct Artifact
+    {
+        int fd{-1};
+        const uint8_t *data{nullptr};
+        size_t size{0};
+        ino_t ino{0};
+        timespec mtime{};
+        std::string etag;
+
+        ~Artifact()
+        {
+            if (data != nullptr && size > 0)
+                munmap((void *)data, size);
+            if (fd >= 0)
+                close(fd);
+        }
+
+        bool same_file(const struct stat &st) const
+        {
+            return st.st_ino == ino && (size_t)st.st_size == size &&
+                   st.st_mtim.tv_sec == mtime.tv_sec && st.st_mtim.tv_nsec == mtime.tv_nsec;
+        }
+    };
+
+    std::shared_ptr<Artifact> load(const std::string &path)
+    {
+        auto artifact = std::make_shared<Artifact>();
+        artifact->fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (artifact->fd < 0 || fstat(artifact->fd, &st) != 0 || !S_ISREG(st.st_mode))
+            return nullptr;
+
+        artifact->size = st.st_size;
+        artifact->ino = st.st_ino;
+        artifact->mtime = st.st_mtim;
+        if (artifact->size > 0)
+        {
+            void *data = mmap(nullptr, artifact->size, PROT_READ, MAP_SHARED, artifact->fd, 0);
+            if (data == MAP_FAILED)
+                return nullptr;
+            artifact->data = (const uint8_t *)data;
+        }
+
+        uint64_t hash = 1469598103934665603ULL; // FNV-1a 64
+        for (size_t i = 0; i < artifact->size; i++)
+            hash = (hash ^ artifact->data[i]) * 1099511628211ULL;
+        char etag[24];
+        snprintf(etag, sizeof(etag), "\"%016" PRIx64 "\"", hash);
+        artifact->etag = etag;
+        return artifact;
+    }
+
+    class ArtifactCache
+    {
+    public:
+        explicit ArtifactCache(std::string root) : root(std::move(root)) {}
+
+        std::shared_ptr<Artifact> get(const std::string &url_path)
+        {
+            if (url_path.empty() || url_path[0] != '/' || url_path.find("..") != std::string::npos)
+                return nullptr;
+
+            int64_t now = now_ms();
+            auto it = entries.find(url_path);
+            if (it != entries.end() && now - it->second.checked_ms < revalidate_ms)
+                return it->second.artifact;
+
+            std::string path = root + url_path;
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            {
+                if (it != entries.end())
+                    entries.erase(it); // the misses aren't cached: unique missing paths can't grow the cache
+                return nullptr;
+            }
+            if (it == entries.end())
+            {
+                if (entries.size() >= max_entries)
+                    return load(path); // served, not cached
+                it = entries.emplace(url_path, Entry{}).first;
+            }
+            Entry &entry = it->second;
+            entry.checked_ms = now;
+            if (entry.artifact == nullptr || !entry.artifact->same_file(st))
+            {
+                entry.artifact = load(path);
+                if (entry.artifact != nullptr)
+                    printf("(re)loaded %s: %zu bytes, ETag %s\n", url_path.c_str(), entry.artifact->size, entry.artifact->etag.c_str());
+            }
+            return entry.artifact;
+        }
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<Artifact> artifact;
+            int64_t checked_ms{0};
+        };
+        std::string root;
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+    // A token bucket of `rate` requests/s, a burst of one second's worth. 0: no limit
+    class PollLimiter
+    {
+    public:
+        PollLimiter(double rate, uint32_t retry_after_s) : rate(rate), tokens(rate), retry_after_s(retry_after_s) {}
+
+        bool admit()
+        {
+            if (rate <= 0)
+                return true;
+            int64_t now = now_ms();
+            tokens = std::min(rate, tokens + (now - refilled_ms) * rate / 1000);
+            refilled_ms = now;
+            if (tokens < 1)
+            {
+                shed++;
+                return false;
+            }
+            tokens -= 1;
+            return true;
+        }
+
+        uint32_t retry_after() const { return retry_after_s; }
+        uint64_t shed_count() const { return shed; }
+
+    private:
+        const double rate;
+        double tokens;
+        int64_t refilled_ms{now_ms()};
+        const uint32_t retry_after_s;
+        uint64_t shed{0};
+    };
+
+    struct Connection
+    {
+        int fd{-1};
+        std::string in;
+        std::string header;
+        size_t header_sent{0};
+        std::shared_ptr<Artifact> body; // keeps the mapping alive until the response is sent
+        off_t body_pos{0};
+        off_t body_end{0};
+        bool keep_alive{true};
+        bool watching_out{false};
+        int64_t active_ms{now_ms()}; // the last byte received or sent
+
+        bool sending() const { return header_sent < header.size() || body_pos < body_end; }
+    };
+
+    // Find a header's value (case-insensitive name) in the request's header lines
+    std::string header_value(const std::string &request, const char *name)
+    {
+        size_t name_len = strlen(name);
+        size_t pos = request.find("\r\n");
+        while (pos != std::string::npos && pos + 2 < request.size())
+        {
+            size_t line = pos + 2;
+            size_t end = request.find("\r\n", line);
+            if (end == std::string::npos || end == line)
+                break;
+            if (end - line > name_len && request[line + name_len] == ':' && strncasecmp(&request[line], name, name_len) == 0)
+            {
+                size_t value = line + name_len + 1;
+                while (value < end && request[value] == ' ')
+                    value++;
+                return request.substr(value, end - value);
+            }
+            pos = end;
+        }
+        return "";
+    }
+
+    // A content-addressed path (the last segment is "<sha256>" or "<sha256>.<ext>", see tools/ota_pack.py) never changes:
+    // caches may keep it forever. The other paths (config.img ...) must be revalidated.
+    const char *cache_control(const char *path)
+    {
+        const char *segment = strrchr(path, '/');
+        segment = (segment == nullptr) ? path : segment + 1;
+        size_t hex_len = strspn(segment, "0123456789abcdefABCDEF");
+        bool immutable = hex_len == 64 && (segment[hex_len] == '\0' || segment[hex_len] == '.');
+        return immutable ? "public, max-age=31536000, immutable" : "no-cache";
+    }
+
+    // The patch of `path` against the config version of the query's "base=<version>": <dir>/patches/<version>.img.
+    // Empty if no (valid) base.
+    std::string patch_path(const char *path, const char *query)
+    {
+        const char *base = strstr(query, "base=");
+        if (base == nullptr || (base != query && base[-1] != '&'))
+            return "";
+        base += 5;
+        size_t len = strspn(base, "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.+-");
+        if (len == 0 || len > 63 || (base[len] != '\0' && base[len] != '&'))
+            return "";
+        const char *slash = strrchr(path, '/');
+        return std::string(path, slash + 1) + "patches/" + std::string(base, len) + ".img";
+    }
+
+    // Parse a single "bytes=first-last" range. Return false if unsatisfiable, `partial` tells if there is a range at all
+    bool parse_range(const std::string &range, size_t size, off_t &first, off_t &last, bool &partial)
+    {
+        partial = false;
+        first = 0;
+        last = (off_t)size - 1;
+        if (range.empty())
+            return true;
+        if (range.compare(0, 6, "bytes=") != 0 || range.find(',') != std::string::npos)
+            return true; // unsupported (multiple ranges) --> the whole content
+
+        const char *spec = range.c_str() + 6;
+        char *end;
+        if (*spec == '-')
+        { // suffix: the last N bytes
+            long long n = strtoll(spec + 1, &end, 10);
+            if (n <= 0)
+                return false;
+            first = (n >= (long long)size) ? 0 : size - n;
+        }
+        else
+        {
+            first = strtoll(spec, &end, 10);
+            if (*end != '-')
+                return true;
+            if (end[1] != '\0')
+                last = std::min<off_t>(strtoll(end + 1, nullptr, 10), size - 1);
+            if (first >= (off_t)size || first > last)
+                return false;
+        }
+        partial = true;
+        return true;
+    }
+
+    class Server
+    {
+    public:
+        Server(ArtifactCache &cache, PollLimiter &limiter, uint32_t idle_timeout_s)
+            : cache(cache), limiter(limiter), idle_timeout_ms(idle_timeout_s * 1000LL) {}
+
+        bool listen(uint16_t port)
+        {
+            listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int on = 1;
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            if (listen_fd < 0 || bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(listen_fd, SOMAXCONN) != 0)
+            {
+                perror("listen");
+                return false;
+            }
+            epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = listen_fd;
+            return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == 0;
+        }
+
+        void run()
+        {
+            epoll_event events[max_events];
+            while (true)
+            {
+                int n = epoll_wait(epoll_fd, events, max_events, sweep_ms);
+                for (int i = 0; i < n; i++)
+                {
+                    int fd = events[i].data.fd;
+                    if (fd == listen_fd)
+                    {
+                        accept_all();
+                        continue;
+                    }
+                    auto it = connections.find(fd);
+                    if (it == connections.end())
+                        continue;
+                    Connection &conn = it->second;
+                    bool ok = !(events[i].events & (EPOLLERR | EPOLLHUP));
+                    if (ok && (events[i].events & EPOLLIN))
+                        ok = on_readable(conn);
+                    if (ok && (events[i].events & EPOLLOUT))
+                        ok = on_writable(conn);
+                    if (!ok)
+                        close_connection(fd);
+                }
+                close_idle();
+            }
+        }
+
+    private:
+        ArtifactCache &cache;
+        PollLimiter &limiter;
+        int listen_fd{-1};
+        int epoll_fd{-1};
+        std::unordered_map<int, Connection> connections;
+        const int64_t idle_timeout_ms;
+        int64_t swept_ms{now_ms()};
+        bool accepting{true}; // the listening socket is watched
+
+        void accept_all()
+        {
+            while (true)
+            {
+                int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0)
+                {
+                    if (errno == EMFILE || errno == ENFILE)
+                    { // level-triggered: the pending connection would wake epoll_wait() again & again
+                        printf("out of file descriptors with %zu connections: accepting again once one closes\n", connections.size());
+                        fflush(stdout);
+                        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, listen_fd, nullptr);
+                        accepting = false;
+                    }
+                    return;
+                }
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                epoll_event ev{};
+                ev.events = EPOLLIN;
+                ev.data.fd = fd;
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+                Connection conn;
+                conn.fd = fd;
+                connections.emplace(fd, std::move(conn));
+            }
+        }
+
+        void close_connection(int fd)
+        {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+            close(fd);
+            connections.erase(fd);
+            if (!accepting)
+            {
+                epoll_event ev{};
+                ev.events = EPOLLIN;
+                ev.data.fd = listen_fd;
+                accepting = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == 0;
+            }
+        }
+
+        // Close the connections idle for idle_timeout_ms: kept-alive clients gone quiet, stalled transfers
+        void close_idle()
+        {
+            int64_t now = now_ms();
+            if (idle_timeout_ms <= 0 || now - swept_ms < sweep_ms)
+                return;
+            swept_ms = now;
+            for (auto it = connections.begin(); it != connections.end();)
+            {
+                int fd = it->first;
+                bool idle = now - it->second.active_ms >= idle_timeout_ms;
+                ++it; // (erased by close_connection())
+                if (idle)
+                    close_connection(fd);
+            }
+        }
+
+        bool on_readable(Connection &conn)
+        {
+            char buf[4096];
+            while (true)
+            {
+                ssize_t len = read(conn.fd, buf, sizeof(buf));
+                if (len > 0)
+                {
+                    conn.active_ms = now_ms();
+                    conn.in.append(buf, len);
+                    if (conn.in.size() > max_request_size)
+                        return false;
+                    continue;
+                }
+                if (len == 0)
+                    return false; // closed by the client
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                return false;
+            }
+            return conn.sending() ? true : next_request(conn);
+        }
+
+        // Handle the next buffered (pipelined) request, if complete & the previous response is sent
+        bool next_request(Connection &conn)
+        {
+            size_t end = conn.in.find("\r\n\r\n");
+            if (end == std::string::npos)
+                return true;
+            std::string request = conn.in.substr(0, end + 2);
+            conn.in.erase(0, end + 4);
+
+            respond(conn, request);
+            return on_writable(conn);
+        }
+
+        void respond(Connection &conn, const std::string &request)
+        {
+            char method[8], path[1024], version[16];
+            if (sscanf(request.c_str(), "%7s %1023s %15s", method, path, version) != 3)
+                return error(conn, 400, "Bad Request");
+
+            std::string connection = header_value(request, "Connection");
+            conn.keep_alive = (strcmp(version, "HTTP/1.1") == 0) ? strcasecmp(connection.c_str(), "close") != 0
+                                                                  : strcasecmp(connection.c_str(), "keep-alive") == 0;
+            bool head = strcmp(method, "HEAD") == 0;
+            if (!head && strcmp(method, "GET") != 0)
+                return error(conn, 405, "Method Not Allowed");
+
+            std::shared_ptr<Artifact> artifact;
+            char *query = strchr(path, '?');
+            if (query != nullptr)
+                *query = '\0';
+            if (strcmp(cache_control(path), "no-cache") == 0 && !limiter.admit())
+            {
+                if (limiter.shed_count() % 1000 == 1)
+                {
+                    printf("overloaded: %" PRIu64 " polls shed so far\n", limiter.shed_count());
+                    fflush(stdout);
+                }
+                char retry_after[40];
+                snprintf(retry_after, sizeof(retry_after), "Retry-After: %u\r\n", limiter.retry_after());
+                return error(conn, 503, "Service Unavailable", retry_after);
+            }
+            if (query != nullptr)
+            {
+                std::string patch = patch_path(path, query + 1);
+                if (!patch.empty())
+                    artifact = cache.get(patch);
+            }
+            if (artifact == nullptr)
+                artifact = cache.get(path);
+            if (artifact == nullptr)
+                return error(conn, 404, "Not Found");
+
+            char header[512];
+            if (header_value(request, "If-None-Match") == artifact->etag)
+            {
+                snprintf(header, sizeof(header), "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nCache-Control: %s\r\n%s\r\n",
+                         artifact->etag.c_str(), cache_control(path), conn.keep_alive ? "" : "Connection: close\r\n");
+                conn.header = header;
+                return;
+            }
+
+            off_t first, last;
+            bool partial;
+            if (!parse_range(header_value(request, "Range"), artifact->size, first, last, partial))
+            {
+                snprintf(header, sizeof(header), "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%zu\r\nContent-Length: 0\r\n%s\r\n",
+                         artifact->size, conn.keep_alive ? "" : "Connection: close\r\n");
+                conn.header = header;
+                return;
+            }
+
+            int len = snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Type: application/octet-stream\r\nContent-Length: %lld\r\nETag: %s\r\nCache-Control: %s\r\nAccept-Ranges: bytes\r\n",
+                               partial ? "206 Partial Content" : "200 OK", (long long)(last - first + 1), artifact->etag.c_str(), cache_control(path));
+            if (partial)
+                len += snprintf(header + len, sizeof(header) - len, "Content-Range: bytes %lld-%lld/%zu\r\n", (long long)first, (long long)last, artifact->size);
+            snprintf(header + len, sizeof(header) - len, "%s\r\n", conn.keep_alive ? "" : "Connection: close\r\n");
+            conn.header = header;
+            if (!head)
+            {
+                conn.body = artifact;
+                conn.body_pos = first;
+                conn.body_end = last + 1;
+            }
+        }
+
+        void error(Connection &conn, int code, const char *reason, const char *extra_headers = "")
+        {
+            char header[200];
+            snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\n%s%s\r\n", code, reason, extra_headers,
+                     conn.keep_alive ? "" : "Connection: close\r\n");
+            conn.header = header;
+        }
+
+        bool on_writable(Connection &conn)
+        {
+            while (conn.sending())
+            {
+                ssize_t sent;
+                size_t body_len = conn.body_end - conn.body_pos;
+                if (conn.header_sent < conn.header.size() && body_len > 0 && body_len <= writev_limit)
+                { // small body: header + body in one syscall
+                    iovec iov[2]{{&conn.header[conn.header_sent], conn.header.size() - conn.header_sent},
+                                 {(void *)(conn.body->data + conn.body_pos), body_len}};
+                    sent = writev(conn.fd, iov, 2);
+                    if (sent > 0)
+                    {
+                        size_t header_part = std::min((size_t)sent, iov[0].iov_len);
+                        conn.header_sent += header_part;
+                        conn.body_pos += sent - header_part;
+                    }
+                }
+                else if (conn.header_sent < conn.header.size())
+                {
+                    sent = write(conn.fd, &conn.header[conn.header_sent], conn.header.size() - conn.header_sent);
+                    if (sent > 0)
+                        conn.header_sent += sent;
+                }
+                else if (body_len <= writev_limit)
+                {
+                    sent = write(conn.fd, conn.body->data + conn.body_pos, body_len);
+                    if (sent > 0)
+                        conn.body_pos += sent;
+                }
+                else
+                {
+                    sent = sendfile(conn.fd, conn.body->fd, &conn.body_pos, body_len);
+                }
+
+                if (sent < 0)
+                {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        return watch(conn, EPOLLIN | EPOLLOUT);
+                    return false;
+                }
+                conn.active_ms = now_ms();
+            }
+
+            // response done
+            conn.header.clear();
+            conn.header_sent = 0;
+            conn.body = nullptr;
+            conn.body_pos = conn.body_end = 0;
+            if (!conn.keep_alive)
+                return false;
+            if (conn.watching_out && !watch(conn, EPOLLIN))
+                return false;
+            return next_request(conn);
+        }
+
+        bool watch(Connection &conn, uint32_t events)
+        {
+            conn.watching_out = events & EPOLLOUT;
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = conn.fd;
+            return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev) == 0;
+        }
+    };
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <artifacts_dir> [port=8080] [max_polls_per_s=0] [retry_after_s=30] [idle_timeout_s=30]\n", argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::string root = argv[1];
+    while (root.size() > 1 && root.back() == '/')
+        root.pop_back();
+    uint16_t port = (argc > 2) ? atoi(argv[2]) : 8080;
+    double max_polls_per_s = (argc > 3) ? atof(argv[3]) : 0;
+    uint32_t retry_after_s = (argc > 4) ? atoi(argv[4]) : 30;
+    uint32_t idle_timeout_s = (argc > 5) ? atoi(argv[5]) : 30;
+
+    // one descriptor per connection: the default soft limit (often 1024) would cap the fleet
+    rlimit files{};
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max)
+    {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+        getrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    ArtifactCache cache(root);
+    PollLimiter limiter(max_polls_per_s, retry_after_s);
+    Server server(cache, limiter, idle_timeout_s);
+    if (!server.listen(port))
+        return 1;
+    printf("Serving %s on port %u", root.c_str(), port);
+    if (max_polls_per_s > 0)
+        printf(", polls limited to %g/s (Retry-After: %u)", max_polls_per_s, retry_after_s);
+    printf(", up to %llu open files, idle connections closed after %u s\n", (unsigned long long)files.rlim_cur, idle_timeout_s);
+    fflush(stdout);
+    server.run();
+}